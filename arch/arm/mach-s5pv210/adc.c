@@ -98,18 +98,20 @@ static int s3c_adc_open(struct inode *inode, struct file *file)
 	return 0;
 }
 
-static unsigned int s3c_adc_convert(void)
+static void s3c_adc_convert_begin(void)
 {
-	unsigned int adc_return = 0;
-	unsigned long data0;
-	unsigned long data1;
-
 	writel((readl(base_addr + S3C_ADCCON) | S3C_ADCCON_PRSCEN) & ~S3C_ADCCON_STDBM,
 		base_addr + S3C_ADCCON);
 
 	writel((adc_port & 0xF), base_addr + S3C_ADCMUX);
 
 	udelay(10);
+}
+
+static unsigned int s3c_adc_convert_one(void)
+{
+	unsigned long data0;
+	unsigned long data1;
 
 	writel(readl(base_addr + S3C_ADCCON) | S3C_ADCCON_ENABLE_START,
 		base_addr + S3C_ADCCON);
@@ -120,13 +122,25 @@ static unsigned int s3c_adc_convert(void)
 
 	data1 = readl(base_addr + S3C_ADCDAT0);
 
+	if (plat_data->resolution == 12)
+		return data1 & S3C_ADCDAT0_XPDATA_MASK_12BIT;
+	else
+		return data1 & S3C_ADCDAT0_XPDATA_MASK;
+}
+
+static void s3c_adc_convert_end(void)
+{
 	writel((readl(base_addr + S3C_ADCCON) | S3C_ADCCON_STDBM) & ~S3C_ADCCON_PRSCEN,
 		base_addr + S3C_ADCCON);
+}
 
-	if (plat_data->resolution == 12)
-		adc_return = data1 & S3C_ADCDAT0_XPDATA_MASK_12BIT;
-	else
-		adc_return = data1 & S3C_ADCDAT0_XPDATA_MASK;
+static unsigned int s3c_adc_convert(void)
+{
+	unsigned int adc_return = 0;
+
+	s3c_adc_convert_begin();
+	adc_return = s3c_adc_convert_one();
+	s3c_adc_convert_end();
 
 	return adc_return;
 }
@@ -164,6 +178,44 @@ int s3c_adc_get_adc_data(int channel)
 }
 EXPORT_SYMBOL(s3c_adc_get_adc_data);
 
+/*
+ * Convert the same channel count times back to back. The lock, the
+ * register save/restore, the mux switch and its settling delay are paid
+ * once for the whole batch instead of once per sample.
+ */
+int s3c_adc_get_adc_data_batch(int channel, int *data, int count)
+{
+	int cur_adc_port = 0;
+	int i;
+
+#ifdef ADC_WITH_TOUCHSCREEN
+	mutex_lock(&adc_mutex);
+	s3c_adc_save_SFR_on_ADC();
+#else
+	mutex_lock(&adc_mutex);
+#endif
+
+	cur_adc_port = adc_port;
+	adc_port = channel;
+
+	s3c_adc_convert_begin();
+	for (i = 0; i < count; i++)
+		data[i] = s3c_adc_convert_one();
+	s3c_adc_convert_end();
+
+	adc_port = cur_adc_port;
+
+#ifdef ADC_WITH_TOUCHSCREEN
+	s3c_adc_restore_SFR_on_ADC();
+	mutex_unlock(&adc_mutex);
+#else
+	mutex_unlock(&adc_mutex);
+#endif
+
+	return count;
+}
+EXPORT_SYMBOL(s3c_adc_get_adc_data_batch);
+
 int s3c_adc_get(struct s3c_adc_request *req)
 {
 	unsigned adc_channel = req->channel;
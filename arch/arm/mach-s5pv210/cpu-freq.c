@@ -21,6 +21,8 @@
 #include <linux/suspend.h>
 #include <linux/regulator/consumer.h>
 #include <linux/gpio.h>
+#include <linux/mutex.h>
+#include <linux/pm_qos_params.h>
 #include <asm/system.h>
 
 #include <mach/map.h>
@@ -66,10 +68,23 @@ struct s5pv210_dvs_conf {
 };
 
 #ifdef CONFIG_DVFS_LIMIT
-static unsigned int g_dvfs_high_lock_token = 0;
-static unsigned int g_dvfs_high_lock_limit = 4;
-static unsigned int g_dvfslockval[DVFS_LOCK_TOKEN_NUM];
-//static DEFINE_MUTEX(dvfs_high_lock);
+/*
+ * Each token owns a PM_QOS_CPU_FREQ_MIN request, which the cpufreq core
+ * applies as the policy minimum. The names show up in debugfs pm_qos/.
+ */
+static const char *dvfs_lock_names[DVFS_LOCK_TOKEN_NUM] = {
+	[DVFS_LOCK_TOKEN_1]	= "dvfs_mfc",
+	[DVFS_LOCK_TOKEN_2]	= "dvfs_fimc",
+	[DVFS_LOCK_TOKEN_3]	= "dvfs_snd_rp",
+	[DVFS_LOCK_TOKEN_4]	= "dvfs_tv",
+	[DVFS_LOCK_TOKEN_5]	= "dvfs_early_susp",
+	[DVFS_LOCK_TOKEN_6]	= "dvfs_apps",
+	[DVFS_LOCK_TOKEN_7]	= "dvfs_touch",
+	[DVFS_LOCK_TOKEN_8]	= "dvfs_usb",
+	[DVFS_LOCK_TOKEN_9]	= "dvfs_bt",
+};
+static struct pm_qos_request_list *dvfs_lock_req[DVFS_LOCK_TOKEN_NUM];
+static DEFINE_MUTEX(dvfs_lock_mutex);
 #endif
 
 const unsigned long arm_volt_max = 1350000;
@@ -262,65 +277,43 @@ static void s5pv210_cpufreq_clksrcs_APLL2MPLL(unsigned int index,
 }
 
 #ifdef CONFIG_DVFS_LIMIT
+/* Keep the cpu at or above perf_level until the token is unlocked */
 int s5pv210_lock_dvfs_high_level(uint nToken, uint perf_level)
 {
-	uint freq_level;
-	struct cpufreq_policy *cpu_policy = cpufreq_cpu_get(0);
-
-	if(cpu_policy ==NULL)
-	{
-		printk(KERN_WARNING "failed to modify the cpu frequency.\n");
-		return -EFAULT;
-	}
-	else
-	{
-		printk(KERN_DEBUG "[CPU] %s : lock with token(%d) level(%d) current(%X)\n",	__func__, nToken, perf_level, g_dvfs_high_lock_token);
-	}
+	struct pm_qos_request_list *req;
 
-	if (g_dvfs_high_lock_token & (1 << nToken))
-		return 0;
-
-	if (perf_level > (MAX_PERF_LEVEL - 1))
-		return 0;
-
-	//mutex_lock(&dvfs_high_lock);
-
-	g_dvfs_high_lock_token |= (1 << nToken);
-	g_dvfslockval[nToken] = perf_level;
-
-	if (perf_level <  g_dvfs_high_lock_limit)
-		g_dvfs_high_lock_limit = perf_level;
+	if (nToken >= DVFS_LOCK_TOKEN_NUM || perf_level > (MAX_PERF_LEVEL - 1))
+		return -EINVAL;
 
-	//mutex_unlock(&dvfs_high_lock);
+	mutex_lock(&dvfs_lock_mutex);
+	req = dvfs_lock_req[nToken];
+	if (!req) {
+		req = pm_qos_add_request_named(PM_QOS_CPU_FREQ_MIN,
+				PM_QOS_DEFAULT_VALUE, dvfs_lock_names[nToken]);
+		dvfs_lock_req[nToken] = req;
+	}
+	mutex_unlock(&dvfs_lock_mutex);
 
-	freq_level = freq_table[perf_level].frequency;
+	if (!req)
+		return -ENOMEM;
 
-	cpufreq_driver_target(cpu_policy, freq_level, CPUFREQ_RELATION_L);
+	pm_qos_update_request(req, freq_table[perf_level].frequency);
 	return 0;
 }
 EXPORT_SYMBOL(s5pv210_lock_dvfs_high_level);
 
 int s5pv210_unlock_dvfs_high_level(unsigned int nToken)
 {
-	unsigned int i;
-
-	//mutex_lock(&dvfs_high_lock);
+	struct pm_qos_request_list *req;
 
-	g_dvfs_high_lock_token &= ~(1 << nToken);
-	g_dvfslockval[nToken] = MAX_PERF_LEVEL;
-	g_dvfs_high_lock_limit = MAX_PERF_LEVEL;
-
-	if (g_dvfs_high_lock_token) {
-		for (i = 0; i < DVFS_LOCK_TOKEN_NUM; i++) {
-			if (g_dvfslockval[i] < g_dvfs_high_lock_limit)
-				g_dvfs_high_lock_limit = g_dvfslockval[i];
-		}
-	}
-
-	//mutex_unlock(&dvfs_high_lock);
+	if (nToken >= DVFS_LOCK_TOKEN_NUM)
+		return -EINVAL;
 
-	printk(KERN_DEBUG "[CPU] %s : unlock with token(%d) current(%X)\n", __func__, nToken, g_dvfs_high_lock_token);
+	mutex_lock(&dvfs_lock_mutex);
+	req = dvfs_lock_req[nToken];
+	mutex_unlock(&dvfs_lock_mutex);
 
+	pm_qos_update_request(req, PM_QOS_DEFAULT_VALUE);
 	return 0;
 }
 EXPORT_SYMBOL(s5pv210_unlock_dvfs_high_level);
@@ -445,13 +438,6 @@ static int s5pv210_cpufreq_target(struct cpufreq_policy *policy,
 		goto out;
 	}
 
-#ifdef CONFIG_DVFS_LIMIT
-	if (g_dvfs_high_lock_token) {
-		if (index > g_dvfs_high_lock_limit)
-			index = g_dvfs_high_lock_limit;
-	}
-#endif
-
 	arm_clk = freq_table[index].frequency;
 
 	s3c_freqs.freqs.new = arm_clk;
@@ -760,11 +746,6 @@ static int __init s5pv210_cpufreq_driver_init(struct cpufreq_policy *policy)
 	memcpy(&s3c_freqs.old, &clk_info[level], sizeof(struct s3c_freq));
 	previous_arm_volt = dvs_conf[level].arm_volt;
 
-#ifdef CONFIG_DVFS_LIMIT
-	for(i = 0; i < DVFS_LOCK_TOKEN_NUM; i++)
-		g_dvfslockval[i] = MAX_PERF_LEVEL;
-#endif
-
 	return cpufreq_frequency_table_cpuinfo(policy, freq_table);
 }
 
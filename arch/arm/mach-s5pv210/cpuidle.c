@@ -16,6 +16,15 @@
 #include <linux/cpuidle.h>
 #include <linux/dma-mapping.h>
 #include <linux/io.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/math64.h>
+#include <linux/pm_qos_params.h>
 #include <asm/proc-fns.h>
 #include <asm/cacheflush.h>
 
@@ -187,6 +196,324 @@ static int check_rtcint(void)
 	return current_cnt < 0x40;
 }
 
+/*
+ * Deep idle pays a VIC/GPIO save and restore and a cache flush on every
+ * entry, so it is only worth it for long enough idles. The length is
+ * predicted like the menu governor does: the time to the next timer is
+ * scaled by a correction factor learnt per length bucket, and capped by
+ * the average of recent residencies when those are steady.
+ */
+static unsigned int didle_residency = 5000;	/* us */
+module_param(didle_residency, uint, 0644);
+MODULE_PARM_DESC(didle_residency, "Shortest predicted idle worth a didle (us)");
+
+static unsigned int didle_exit_latency = 300;	/* us */
+module_param(didle_exit_latency, uint, 0644);
+MODULE_PARM_DESC(didle_exit_latency, "didle wakeup latency checked against pm_qos (us)");
+
+static int didle_predict = 1;
+module_param(didle_predict, bool, 0644);
+MODULE_PARM_DESC(didle_predict, "Only enter didle when a long idle is predicted");
+
+#define S5P_IDLE_BUCKETS	6
+#define S5P_IDLE_RESOLUTION	1024
+#define S5P_IDLE_DECAY		8
+#define S5P_IDLE_HISTORY	8
+
+struct s5p_idle_predictor {
+	unsigned int	correction[S5P_IDLE_BUCKETS];
+	unsigned int	history[S5P_IDLE_HISTORY];
+	unsigned int	history_idx;
+	unsigned int	bucket;
+	u64		expected;	/* us */
+	unsigned int	predicted;	/* us */
+};
+
+static struct s5p_idle_predictor s5p_predictor;
+
+static int s5p_idle_bucket(u64 duration)
+{
+	if (duration < 10)
+		return 0;
+	if (duration < 100)
+		return 1;
+	if (duration < 1000)
+		return 2;
+	if (duration < 10000)
+		return 3;
+	if (duration < 100000)
+		return 4;
+	return 5;
+}
+
+/* Average of the recent residencies if they are steady, else UINT_MAX */
+static unsigned int s5p_idle_repeating(struct s5p_idle_predictor *pred)
+{
+	u64 avg = 0, variance = 0;
+	s64 diff;
+	int i;
+
+	for (i = 0; i < S5P_IDLE_HISTORY; i++)
+		avg += pred->history[i];
+	avg = div_u64(avg, S5P_IDLE_HISTORY);
+
+	for (i = 0; i < S5P_IDLE_HISTORY; i++) {
+		diff = (s64)pred->history[i] - (s64)avg;
+		variance += diff * diff;
+	}
+	variance = div_u64(variance, S5P_IDLE_HISTORY);
+
+	/* standard deviation below avg / 6, compared squared */
+	if (avg && variance * 36 <= avg * avg)
+		return avg;
+
+	return UINT_MAX;
+}
+
+static unsigned int s5p_idle_predict(void)
+{
+	struct s5p_idle_predictor *pred = &s5p_predictor;
+	u64 predicted;
+
+	pred->expected = ktime_to_us(tick_nohz_get_sleep_length());
+	pred->bucket = s5p_idle_bucket(pred->expected);
+
+	predicted = div_u64(pred->expected * pred->correction[pred->bucket],
+			    S5P_IDLE_RESOLUTION * S5P_IDLE_DECAY);
+	predicted = min_t(u64, predicted, s5p_idle_repeating(pred));
+	pred->predicted = min_t(u64, predicted, UINT_MAX);
+
+	return pred->predicted;
+}
+
+static void s5p_idle_learn(unsigned int residency)
+{
+	struct s5p_idle_predictor *pred = &s5p_predictor;
+	unsigned int factor, measured = residency;
+
+	/* woken up by the timer we predicted from */
+	if (measured > pred->expected)
+		measured = pred->expected;
+
+	factor = pred->correction[pred->bucket];
+	factor -= factor / S5P_IDLE_DECAY;
+	if (pred->expected)
+		factor += div_u64((u64)S5P_IDLE_RESOLUTION * measured,
+				  pred->expected);
+	else
+		factor += S5P_IDLE_RESOLUTION;
+	pred->correction[pred->bucket] = factor ? factor : 1;
+
+	pred->history[pred->history_idx] = residency;
+	pred->history_idx = (pred->history_idx + 1) % S5P_IDLE_HISTORY;
+}
+
+/* Statistics, in debugfs s5p_idle. Writing to it resets them. */
+enum {
+	S5P_IDLE_WFI,
+	S5P_IDLE_DIDLE,
+	S5P_IDLE_STATES,
+};
+
+/* why didle was not entered, the first check that failed is counted */
+enum {
+	S5P_IDLE_READY,
+	S5P_IDLE_BUSY_GATING,
+	S5P_IDLE_BUSY_SDMMC,
+	S5P_IDLE_BUSY_USBOTG,
+	S5P_IDLE_BUSY_RTC,
+	S5P_IDLE_BUSY_IDMA,
+	S5P_IDLE_BUSY_BT,
+	S5P_IDLE_BUSY_LATENCY,
+	S5P_IDLE_BUSY_PREDICT,
+	S5P_IDLE_BUSY_VIC,
+	S5P_IDLE_REASONS,
+};
+
+/* didle wakeup sources from S5P_WAKEUP_STAT */
+enum {
+	S5P_IDLE_WAKE_EINT,
+	S5P_IDLE_WAKE_RTC_ALARM,
+	S5P_IDLE_WAKE_RTC_TICK,
+	S5P_IDLE_WAKE_I2S,
+	S5P_IDLE_WAKE_OTHER,
+	S5P_IDLE_WAKE_SOURCES,
+};
+
+#define S5P_IDLE_HIST		10	/* <32, <64 ... <8192, >=8192 us */
+
+struct s5p_idle_stats {
+	u32	entries[S5P_IDLE_STATES];
+	u64	time[S5P_IDLE_STATES];		/* us */
+	u32	residency_hist[S5P_IDLE_STATES][S5P_IDLE_HIST];
+	u32	exit_hist[S5P_IDLE_HIST];
+	s64	exit_max;			/* us */
+	u32	busy[S5P_IDLE_REASONS];
+	u32	wake[S5P_IDLE_WAKE_SOURCES];
+	u32	too_short;	/* didle shorter than didle_residency */
+	u32	missed;		/* predicted short, but long enough */
+};
+
+static struct s5p_idle_stats s5p_idle_stats;
+static DEFINE_SPINLOCK(s5p_idle_stats_lock);
+
+static const char *s5p_idle_state_names[] = {
+	[S5P_IDLE_WFI]		= "wfi",
+	[S5P_IDLE_DIDLE]	= "didle",
+};
+
+static const char *s5p_idle_busy_names[] = {
+	[S5P_IDLE_READY]	= "entered",
+	[S5P_IDLE_BUSY_GATING]	= "gating",
+	[S5P_IDLE_BUSY_SDMMC]	= "sdmmc",
+	[S5P_IDLE_BUSY_USBOTG]	= "usbotg",
+	[S5P_IDLE_BUSY_RTC]	= "rtc",
+	[S5P_IDLE_BUSY_IDMA]	= "idma",
+	[S5P_IDLE_BUSY_BT]	= "bt",
+	[S5P_IDLE_BUSY_LATENCY]	= "latency",
+	[S5P_IDLE_BUSY_PREDICT]	= "predict",
+	[S5P_IDLE_BUSY_VIC]	= "vic_pending",
+};
+
+static const char *s5p_idle_wake_names[] = {
+	[S5P_IDLE_WAKE_EINT]		= "eint",
+	[S5P_IDLE_WAKE_RTC_ALARM]	= "rtc_alarm",
+	[S5P_IDLE_WAKE_RTC_TICK]	= "rtc_tick",
+	[S5P_IDLE_WAKE_I2S]		= "i2s",
+	[S5P_IDLE_WAKE_OTHER]		= "other",
+};
+
+static int s5p_idle_hist_bucket(s64 us)
+{
+	int i;
+
+	for (i = 0; i < S5P_IDLE_HIST - 1; i++) {
+		if (us < (32LL << i))
+			break;
+	}
+
+	return i;
+}
+
+static void s5p_idle_account(int state, int reason, unsigned int residency)
+{
+	struct s5p_idle_stats *stats = &s5p_idle_stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&s5p_idle_stats_lock, flags);
+	stats->busy[reason]++;
+	if (reason != S5P_IDLE_BUSY_VIC) {
+		stats->entries[state]++;
+		stats->time[state] += residency;
+		stats->residency_hist[state][s5p_idle_hist_bucket(residency)]++;
+	}
+	if (state == S5P_IDLE_DIDLE && residency < didle_residency)
+		stats->too_short++;
+	if (reason == S5P_IDLE_BUSY_PREDICT && residency >= didle_residency)
+		stats->missed++;
+	spin_unlock_irqrestore(&s5p_idle_stats_lock, flags);
+}
+
+/* called with interrupts disabled, right after waking up from didle */
+static void s5p_idle_account_wakeup(u32 wakeup_stat, s64 exit_us)
+{
+	struct s5p_idle_stats *stats = &s5p_idle_stats;
+
+	spin_lock(&s5p_idle_stats_lock);
+	if (wakeup_stat & (1 << 0))
+		stats->wake[S5P_IDLE_WAKE_EINT]++;
+	else if (wakeup_stat & (1 << 1))
+		stats->wake[S5P_IDLE_WAKE_RTC_ALARM]++;
+	else if (wakeup_stat & (1 << 2))
+		stats->wake[S5P_IDLE_WAKE_RTC_TICK]++;
+	else if (wakeup_stat & (1 << 13))
+		stats->wake[S5P_IDLE_WAKE_I2S]++;
+	else
+		stats->wake[S5P_IDLE_WAKE_OTHER]++;
+
+	stats->exit_hist[s5p_idle_hist_bucket(exit_us)]++;
+	if (exit_us > stats->exit_max)
+		stats->exit_max = exit_us;
+	spin_unlock(&s5p_idle_stats_lock);
+}
+
+static void s5p_idle_show_hist(struct seq_file *s, u32 *hist)
+{
+	int i;
+
+	for (i = 0; i < S5P_IDLE_HIST - 1; i++)
+		seq_printf(s, "  <%-5d %u\n", 32 << i, hist[i]);
+	seq_printf(s, "  >=%-4d %u\n", 32 << (i - 1), hist[i]);
+}
+
+static int s5p_idle_stats_show(struct seq_file *s, void *unused)
+{
+	struct s5p_idle_stats *copy;
+	unsigned long flags;
+	int i;
+
+	copy = kmalloc(sizeof(*copy), GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&s5p_idle_stats_lock, flags);
+	*copy = s5p_idle_stats;
+	spin_unlock_irqrestore(&s5p_idle_stats_lock, flags);
+
+	for (i = 0; i < S5P_IDLE_STATES; i++) {
+		seq_printf(s, "%s: %u entries, %llu ms\n",
+				s5p_idle_state_names[i], copy->entries[i],
+				div_u64(copy->time[i], USEC_PER_MSEC));
+		seq_printf(s, "%s residency (us)\n", s5p_idle_state_names[i]);
+		s5p_idle_show_hist(s, copy->residency_hist[i]);
+	}
+
+	seq_printf(s, "didle exit latency (us), max %lld\n", copy->exit_max);
+	s5p_idle_show_hist(s, copy->exit_hist);
+
+	seq_printf(s, "didle decision:\n");
+	for (i = 0; i < S5P_IDLE_REASONS; i++)
+		seq_printf(s, "  %-12s %u\n", s5p_idle_busy_names[i],
+				copy->busy[i]);
+
+	seq_printf(s, "didle wakeup:\n");
+	for (i = 0; i < S5P_IDLE_WAKE_SOURCES; i++)
+		seq_printf(s, "  %-12s %u\n", s5p_idle_wake_names[i],
+				copy->wake[i]);
+
+	seq_printf(s, "mispredicted: %u too short, %u missed\n",
+			copy->too_short, copy->missed);
+
+	kfree(copy);
+
+	return 0;
+}
+
+static int s5p_idle_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, s5p_idle_stats_show, NULL);
+}
+
+static ssize_t s5p_idle_stats_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&s5p_idle_stats_lock, flags);
+	memset(&s5p_idle_stats, 0, sizeof(s5p_idle_stats));
+	spin_unlock_irqrestore(&s5p_idle_stats_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations s5p_idle_stats_fops = {
+	.open		= s5p_idle_stats_open,
+	.read		= seq_read,
+	.write		= s5p_idle_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /*
  * Before entering, didle mode GPIO Powe Down Mode
  * Configuration register has to be set with same state
@@ -250,10 +577,14 @@ static int s5p_enter_idle_state(struct cpuidle_device *dev,
 	return idle_time;
 }
 
-static void s5p_enter_didle(void)
+/* Returns 0 when didle was skipped for a pending interrupt */
+static int s5p_enter_didle(void)
 {
 	unsigned long tmp;
 	unsigned long save_eint_mask;
+	ktime_t wakeup = ktime_set(0, 0);
+	u32 wakeup_stat = 0;
+	int entered = 0;
 
 	/* store the physical address of the register recovery block */
 	__raw_writel(phy_regs_save, S5P_INFORM2);
@@ -334,6 +665,10 @@ static void s5p_enter_didle(void)
 	/* restore the cpu state using the kernel's cpu init code. */
 	cpu_init();
 
+	wakeup = ktime_get();
+	wakeup_stat = __raw_readl(S5P_WAKEUP_STAT);
+	entered = 1;
+
 skipped_didle:
 	__raw_writel(save_eint_mask, S5P_EINT_WAKEUP_MASK);
 
@@ -357,39 +692,49 @@ skipped_didle:
 	__raw_writel(vic_regs[1], S5P_VIC1REG(VIC_INT_ENABLE));
 	__raw_writel(vic_regs[2], S5P_VIC2REG(VIC_INT_ENABLE));
 	__raw_writel(vic_regs[3], S5P_VIC3REG(VIC_INT_ENABLE));
+
+	if (entered)
+		s5p_idle_account_wakeup(wakeup_stat,
+				ktime_us_delta(ktime_get(), wakeup));
+
+	return entered;
 }
 
 #ifdef CONFIG_RFKILL
 extern volatile int bt_is_running;
 #endif
 
+/* Returns the first check which keeps us out of didle, or 0 */
 static int s5p_idle_bm_check(void)
 {
-	if (check_power_clock_gating()	|| loop_sdmmc_check() ||
-	    check_usbotg_op()		|| check_rtcint())
-		return 1;
+	if (check_power_clock_gating())
+		return S5P_IDLE_BUSY_GATING;
+	if (loop_sdmmc_check())
+		return S5P_IDLE_BUSY_SDMMC;
+	if (check_usbotg_op())
+		return S5P_IDLE_BUSY_USBOTG;
+	if (check_rtcint())
+		return S5P_IDLE_BUSY_RTC;
 #ifdef CONFIG_S5P_INTERNAL_DMA
-	else if (check_idmapos())
-		return 1;
+	if (check_idmapos())
+		return S5P_IDLE_BUSY_IDMA;
 #endif
 #ifdef CONFIG_RFKILL
-		else if(bt_is_running)
-			return 1;
+	if (bt_is_running)
+		return S5P_IDLE_BUSY_BT;
 #endif
 
-	else
-		return 0;
+	return S5P_IDLE_READY;
 }
 
 extern void bt_uart_rts_ctrl(int flag);
 
 /* Actual code that puts the SoC in different idle states */
 static int s5p_enter_didle_state(struct cpuidle_device *dev,
-				struct cpuidle_state *state)
+				struct cpuidle_state *state, int *entered)
 {
 	struct timeval before, after;
 	int idle_time;
-	
 
 	#ifdef CONFIG_RFKILL
 	/* BT-UART RTS Control (RTS Low) */
@@ -399,7 +744,7 @@ static int s5p_enter_didle_state(struct cpuidle_device *dev,
 	local_irq_disable();
 	do_gettimeofday(&before);
 
-	s5p_enter_didle();
+	*entered = s5p_enter_didle();
 	do_gettimeofday(&after);
 	local_irq_enable();
 	idle_time = (after.tv_sec - before.tv_sec) * USEC_PER_SEC +
@@ -416,10 +761,35 @@ static int s5p_enter_didle_state(struct cpuidle_device *dev,
 static int s5p_enter_idle_bm(struct cpuidle_device *dev,
 				struct cpuidle_state *state)
 {
-	if (s5p_idle_bm_check())
-		return s5p_enter_idle_state(dev, state);
-	else
-		return s5p_enter_didle_state(dev, state);
+	unsigned int predicted;
+	int reason, idle_time, entered;
+
+	predicted = s5p_idle_predict();
+
+	reason = s5p_idle_bm_check();
+	if (reason == S5P_IDLE_READY && didle_predict) {
+		if (pm_qos_request(PM_QOS_CPU_DMA_LATENCY) < didle_exit_latency)
+			reason = S5P_IDLE_BUSY_LATENCY;
+		else if (predicted < didle_residency)
+			reason = S5P_IDLE_BUSY_PREDICT;
+	}
+
+	if (reason != S5P_IDLE_READY) {
+		idle_time = s5p_enter_idle_state(dev, state);
+	} else {
+		idle_time = s5p_enter_didle_state(dev, state, &entered);
+		if (!entered)
+			reason = S5P_IDLE_BUSY_VIC;
+	}
+
+	/* do_gettimeofday() may step backwards */
+	if (idle_time < 0)
+		idle_time = 0;
+	s5p_idle_account(reason == S5P_IDLE_READY ? S5P_IDLE_DIDLE :
+			 S5P_IDLE_WFI, reason, idle_time);
+	s5p_idle_learn(idle_time);
+
+	return idle_time;
 }
 
 static DEFINE_PER_CPU(struct cpuidle_device, s5p_cpuidle_device);
@@ -438,6 +808,10 @@ static int s5p_init_cpuidle(void)
 	int i = 0;
 	int ret;
 
+	for (i = 0; i < S5P_IDLE_BUCKETS; i++)
+		s5p_predictor.correction[i] =
+			S5P_IDLE_RESOLUTION * S5P_IDLE_DECAY;
+
 	ret = cpuidle_register_driver(&s5p_idle_driver);
 	if (ret) {
 		printk(KERN_ERR "%s: Failed registering driver\n", __func__);
@@ -469,6 +843,9 @@ static int s5p_init_cpuidle(void)
 	}
 	printk(KERN_INFO "cpuidle: phy_regs_save:0x%x\n", phy_regs_save);
 
+	debugfs_create_file("s5p_idle", S_IRUGO | S_IWUSR, NULL, NULL,
+			    &s5p_idle_stats_fops);
+
 	/* Allocate memory region to access IP's directly */
 	for (i = 0 ; i < MAX_CHK_DEV ; i++) {
 
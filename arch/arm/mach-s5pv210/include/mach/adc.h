@@ -31,6 +31,7 @@ struct s3c_adc_mach_info {
 };
 
 extern int s3c_adc_get_adc_data(int channel);
+extern int s3c_adc_get_adc_data_batch(int channel, int *data, int count);
 void __init s3c_adc_set_platdata(struct s3c_adc_mach_info *pd);
 
 #endif /* __ASM_PLAT_ADC_H */
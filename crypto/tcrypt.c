@@ -26,6 +26,7 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/slab.h>
 #include "tcrypt.h"
 #include "internal.h"
 
@@ -35,7 +36,7 @@
 #define TVMEMSIZE	4
 
 /*
-* Used by test_cipher_speed()
+* Used by test_cipher_speed() and test_comp_speed()
 */
 #define ENCRYPT 1
 #define DECRYPT 0
@@ -711,6 +712,221 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+/*
+ * Used by test_comp_speed(): page contents resembling what gets swapped
+ * out or compressed by filesystems, from very to not compressible.
+ */
+enum {
+	COMP_PAGE_SPARSE,	/* mostly zero, data at the start */
+	COMP_PAGE_TEXT,		/* words from a small vocabulary */
+	COMP_PAGE_HEAP,		/* pointers and small integers */
+	COMP_PAGE_RANDOM,
+	COMP_PAGE_KINDS
+};
+
+static const char *comp_page_names[COMP_PAGE_KINDS] = {
+	"sparse", "text", "heap", "random"
+};
+
+/* Pages are generated from a fixed seed so runs can be compared */
+static u32 comp_rand(u32 *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static void comp_page_fill(u8 *p, int kind)
+{
+	static const char *words[] = {
+		"the ", "page ", "of ", "memory ", "and ", "is ", "swap ", "\n"
+	};
+	u32 seed = kind + 1;
+	unsigned int i;
+	u32 v;
+
+	switch (kind) {
+	case COMP_PAGE_SPARSE:
+		memset(p, 0, PAGE_SIZE);
+		for (i = 0; i < PAGE_SIZE / 8; i++)
+			p[i] = comp_rand(&seed);
+		break;
+	case COMP_PAGE_TEXT:
+		for (i = 0; i < PAGE_SIZE; ) {
+			const char *w = words[comp_rand(&seed) & 7];
+
+			while (*w && i < PAGE_SIZE)
+				p[i++] = *w++;
+		}
+		break;
+	case COMP_PAGE_HEAP:
+		for (i = 0; i < PAGE_SIZE; i += sizeof(v)) {
+			if (comp_rand(&seed) & 3)
+				v = 0xc0100000 + (comp_rand(&seed) & 0xfff) * 8;
+			else
+				v = comp_rand(&seed) & 0xff;
+			memcpy(p + i, &v, sizeof(v));
+		}
+		break;
+	default:
+		for (i = 0; i < PAGE_SIZE; i++)
+			p[i] = comp_rand(&seed);
+		break;
+	}
+}
+
+static int test_comp_op(struct crypto_comp *tfm, int enc, const u8 *src,
+			unsigned int slen, u8 *dst, unsigned int dlen)
+{
+	if (enc)
+		return crypto_comp_compress(tfm, src, slen, dst, &dlen);
+	else
+		return crypto_comp_decompress(tfm, src, slen, dst, &dlen);
+}
+
+static int test_comp_jiffies(struct crypto_comp *tfm, int enc, const u8 *src,
+			     unsigned int slen, u8 *dst, unsigned int dlen,
+			     int sec)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = test_comp_op(tfm, enc, src, slen, dst, dlen);
+		if (ret)
+			return ret;
+	}
+
+	printk("%6u opers/sec, %9lu bytes/sec\n",
+	       bcount / sec, ((long)bcount * PAGE_SIZE) / sec);
+
+	return 0;
+}
+
+static int test_comp_cycles(struct crypto_comp *tfm, int enc, const u8 *src,
+			    unsigned int slen, u8 *dst, unsigned int dlen)
+{
+	unsigned long cycles = 0;
+	int ret = 0;
+	int i;
+
+	local_bh_disable();
+	local_irq_disable();
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = test_comp_op(tfm, enc, src, slen, dst, dlen);
+		if (ret)
+			goto out;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = test_comp_op(tfm, enc, src, slen, dst, dlen);
+		end = get_cycles();
+
+		if (ret)
+			goto out;
+
+		cycles += end - start;
+	}
+
+out:
+	local_irq_enable();
+	local_bh_enable();
+
+	if (ret)
+		return ret;
+
+	printk("%6lu cycles/operation, %4lu cycles/byte\n",
+	       cycles / 8, cycles / (8 * PAGE_SIZE));
+
+	return 0;
+}
+
+/*
+ * Compresses and decompresses single pages of each kind. Speeds are given
+ * in uncompressed bytes for both directions.
+ */
+static void test_comp_speed(const char *algo, unsigned int sec)
+{
+	struct crypto_comp *tfm;
+	unsigned int clen, dlen;
+	u8 *comp;
+	int i, ret;
+
+	printk(KERN_INFO "\ntesting speed of %s\n", algo);
+
+	tfm = crypto_alloc_comp(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		printk(KERN_ERR "failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	/* Room for pages which do not compress */
+	comp = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	if (!comp)
+		goto out;
+
+	for (i = 0; i < COMP_PAGE_KINDS; i++) {
+		comp_page_fill(tvmem[0], i);
+
+		clen = 2 * PAGE_SIZE;
+		ret = crypto_comp_compress(tfm, tvmem[0], PAGE_SIZE,
+					   comp, &clen);
+		if (ret) {
+			printk(KERN_ERR "compression failed ret=%d\n", ret);
+			break;
+		}
+
+		dlen = PAGE_SIZE;
+		ret = crypto_comp_decompress(tfm, comp, clen, tvmem[1], &dlen);
+		if (ret || dlen != PAGE_SIZE ||
+		    memcmp(tvmem[0], tvmem[1], PAGE_SIZE)) {
+			printk(KERN_ERR "%s page does not decompress to "
+			       "its content ret=%d\n", comp_page_names[i], ret);
+			break;
+		}
+
+		printk(KERN_INFO "test%3u (%6s page, %4lu -> %4u bytes) "
+		       "compress:   ", i, comp_page_names[i], PAGE_SIZE, clen);
+		if (sec)
+			ret = test_comp_jiffies(tfm, ENCRYPT, tvmem[0],
+						PAGE_SIZE, comp,
+						2 * PAGE_SIZE, sec);
+		else
+			ret = test_comp_cycles(tfm, ENCRYPT, tvmem[0],
+					       PAGE_SIZE, comp,
+					       2 * PAGE_SIZE);
+		if (ret) {
+			printk(KERN_ERR "compression failed ret=%d\n", ret);
+			break;
+		}
+
+		printk(KERN_INFO "test%3u (%6s page, %4lu -> %4u bytes) "
+		       "decompress: ", i, comp_page_names[i], PAGE_SIZE, clen);
+		if (sec)
+			ret = test_comp_jiffies(tfm, DECRYPT, comp, clen,
+						tvmem[1], PAGE_SIZE, sec);
+		else
+			ret = test_comp_cycles(tfm, DECRYPT, comp, clen,
+					       tvmem[1], PAGE_SIZE);
+		if (ret) {
+			printk(KERN_ERR "decompression failed ret=%d\n", ret);
+			break;
+		}
+	}
+
+	kfree(comp);
+out:
+	crypto_free_comp(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1215,6 +1431,20 @@ static int do_test(int m)
 	case 499:
 		break;
 
+	case 600:
+		/* fall through */
+
+	case 601:
+		test_comp_speed("lzo", sec);
+		if (mode > 600 && mode < 700) break;
+
+	case 602:
+		test_comp_speed("deflate", sec);
+		if (mode > 600 && mode < 700) break;
+
+	case 699:
+		break;
+
 	case 1000:
 		test_available();
 		break;
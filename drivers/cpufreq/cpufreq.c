@@ -28,6 +28,7 @@
 #include <linux/cpu.h>
 #include <linux/completion.h>
 #include <linux/mutex.h>
+#include <linux/pm_qos_params.h>
 
 #define dprintk(msg...) cpufreq_debug_printk(CPUFREQ_DEBUG_CORE, \
 						"cpufreq-core", msg)
@@ -1986,6 +1987,48 @@ int cpufreq_unregister_driver(struct cpufreq_driver *driver)
 }
 EXPORT_SYMBOL_GPL(cpufreq_unregister_driver);
 
+/*
+ * PM QoS cpu frequency limits are applied on top of the user limits of
+ * every policy. On a conflict the ceiling wins.
+ */
+static int cpufreq_qos_policy_notifier(struct notifier_block *nb,
+				       unsigned long event, void *data)
+{
+	struct cpufreq_policy *policy = data;
+
+	if (event != CPUFREQ_ADJUST)
+		return 0;
+
+	cpufreq_verify_within_limits(policy,
+				     pm_qos_request(PM_QOS_CPU_FREQ_MIN),
+				     pm_qos_request(PM_QOS_CPU_FREQ_MAX));
+	return 0;
+}
+
+static struct notifier_block cpufreq_qos_policy_nb = {
+	.notifier_call = cpufreq_qos_policy_notifier,
+};
+
+static int cpufreq_qos_notifier(struct notifier_block *nb,
+				unsigned long value, void *data)
+{
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu) {
+		if (per_cpu(cpufreq_policy_cpu, cpu) == cpu)
+			cpufreq_update_policy(cpu);
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_qos_min_nb = {
+	.notifier_call = cpufreq_qos_notifier,
+};
+
+static struct notifier_block cpufreq_qos_max_nb = {
+	.notifier_call = cpufreq_qos_notifier,
+};
+
 static int __init cpufreq_core_init(void)
 {
 	int cpu;
@@ -1999,6 +2042,11 @@ static int __init cpufreq_core_init(void)
 						&cpu_sysdev_class.kset.kobj);
 	BUG_ON(!cpufreq_global_kobject);
 
+	cpufreq_register_notifier(&cpufreq_qos_policy_nb,
+				  CPUFREQ_POLICY_NOTIFIER);
+	pm_qos_add_notifier(PM_QOS_CPU_FREQ_MIN, &cpufreq_qos_min_nb);
+	pm_qos_add_notifier(PM_QOS_CPU_FREQ_MAX, &cpufreq_qos_max_nb);
+
 	return 0;
 }
 core_initcall(cpufreq_core_init);
@@ -0,0 +1,866 @@
+/*
+ *  drivers/cpufreq/cpufreq_interactive.c
+ *
+ *  Copyright (c) 2010 Samsung Electronics Co., Ltd.
+ *		http://www.samsung.com/
+ *
+ * 'interactive' samples the load with a per cpu hrtimer which is armed
+ * when the cpu leaves idle, instead of a deferrable work timer, so the
+ * first sample is taken timer_rate after the cpu got busy rather than
+ * whenever the next jiffy based poll happens to run.
+ *
+ * When the load of a sample reaches go_hispeed_load the cpu jumps straight
+ * to hispeed_freq and only goes above it from the next sample on. A speed
+ * is kept until it has not been needed for min_sample_time. Input events
+ * boost the cpu to hispeed_freq for boostpulse_duration.
+ *
+ * Idle time is accounted from the idle notifier, so the load is exact
+ * without NO_HZ. Frequency changes are made from a SCHED_FIFO thread, the
+ * ramp up latency and the time in state are reported through the
+ * cpufreq_interactive trace events.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/input.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <asm/idle.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq_interactive.h>
+
+/* for cpufreq_interactive_loadgen */
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpufreq_interactive_ramp);
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpufreq_interactive_time_in_state);
+
+#define DEF_TIMER_RATE			(20 * USEC_PER_MSEC)
+#define DEF_MIN_SAMPLE_TIME		(80 * USEC_PER_MSEC)
+#define DEF_GO_HISPEED_LOAD		(85)
+#define DEF_BOOSTPULSE_DURATION		(80 * USEC_PER_MSEC)
+#define MIN_TIMER_RATE			(1 * USEC_PER_MSEC)
+
+struct cpufreq_interactive_cpuinfo {
+	struct hrtimer timer;
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	int cpu;
+
+	/* protects all below against the timer and the idle notifier */
+	spinlock_t lock;
+	int enabled;
+
+	/* idle accounting, us */
+	u64 idle_total;
+	u64 idle_enter;			/* 0 while not idle */
+	u64 idle_exit;
+	u64 window_start;
+	u64 window_idle;
+
+	unsigned int target_freq;
+	u64 target_set_time;
+	u64 ramp_start;			/* 0 when no ramp up is pending */
+	int ramp_boost;
+
+	unsigned int state_freq;
+	u64 state_enter;
+};
+static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
+
+static struct task_struct *speedchange_task;
+static cpumask_t speedchange_cpumask;
+static DEFINE_SPINLOCK(speedchange_cpumask_lock);
+
+/* serializes speed changes with governor stop and limits */
+static DEFINE_MUTEX(set_speed_mutex);
+
+/* protects active_count and the sysfs group */
+static DEFINE_MUTEX(gov_mutex);
+static unsigned int active_count;
+
+static DEFINE_SPINLOCK(boost_lock);
+static u64 boost_until;
+
+static struct interactive_tuners {
+	unsigned int hispeed_freq;
+	unsigned int go_hispeed_load;
+	unsigned int min_sample_time;	/* us */
+	unsigned int timer_rate;	/* us */
+	unsigned int input_boost;
+	unsigned int boostpulse_duration;	/* us */
+} tuners_ins = {
+	.go_hispeed_load = DEF_GO_HISPEED_LOAD,
+	.min_sample_time = DEF_MIN_SAMPLE_TIME,
+	.timer_rate = DEF_TIMER_RATE,
+	.input_boost = 1,
+	.boostpulse_duration = DEF_BOOSTPULSE_DURATION,
+};
+
+static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
+static
+#endif
+struct cpufreq_governor cpufreq_gov_interactive = {
+	.name			= "interactive",
+	.governor		= cpufreq_governor_interactive,
+	.max_transition_latency	= 10000000,
+	.owner			= THIS_MODULE,
+};
+
+static inline u64 interactive_now(void)
+{
+	return ktime_to_us(ktime_get());
+}
+
+static inline ktime_t interactive_timer_rate(void)
+{
+	return ns_to_ktime((u64)tuners_ins.timer_rate * NSEC_PER_USEC);
+}
+
+static int interactive_boosted(u64 now)
+{
+	unsigned long flags;
+	int boosted;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	boosted = now < boost_until;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	return boosted;
+}
+
+static void interactive_queue_speedchange(int cpu)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	cpumask_set_cpu(cpu, &speedchange_cpumask);
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+}
+
+static enum hrtimer_restart cpufreq_interactive_timer(struct hrtimer *timer)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		container_of(timer, struct cpufreq_interactive_cpuinfo, timer);
+	struct cpufreq_policy *policy = pcpu->policy;
+	enum hrtimer_restart restart = HRTIMER_RESTART;
+	unsigned int load, new_freq, index;
+	unsigned long flags;
+	u64 now, idle, delta_time, delta_idle;
+	int boosted, changed = 0;
+
+	now = interactive_now();
+	boosted = interactive_boosted(now);
+
+	spin_lock_irqsave(&pcpu->lock, flags);
+
+	if (!pcpu->enabled) {
+		spin_unlock_irqrestore(&pcpu->lock, flags);
+		return HRTIMER_NORESTART;
+	}
+
+	idle = pcpu->idle_total;
+	if (pcpu->idle_enter)
+		idle += now - pcpu->idle_enter;
+
+	delta_time = now - pcpu->window_start;
+	delta_idle = idle - pcpu->window_idle;
+	if (!delta_time || delta_idle >= delta_time)
+		load = 0;
+	else
+		load = div64_u64(100 * (delta_time - delta_idle), delta_time);
+
+	if (load >= tuners_ins.go_hispeed_load || boosted) {
+		if (pcpu->target_freq < tuners_ins.hispeed_freq)
+			new_freq = tuners_ins.hispeed_freq;
+		else
+			new_freq = max(policy->max * load / 100,
+				       tuners_ins.hispeed_freq);
+	} else {
+		new_freq = policy->max * load / 100;
+	}
+
+	if (cpufreq_frequency_table_target(policy, pcpu->freq_table,
+					   new_freq, CPUFREQ_RELATION_H,
+					   &index))
+		goto rearm;
+	new_freq = pcpu->freq_table[index].frequency;
+
+	/* keep a speed until it has not been needed for min_sample_time */
+	if (new_freq < pcpu->target_freq &&
+	    now - pcpu->target_set_time < tuners_ins.min_sample_time) {
+		trace_cpufreq_interactive_target(pcpu->cpu, load,
+				pcpu->target_freq, pcpu->target_freq);
+		goto rearm;
+	}
+
+	trace_cpufreq_interactive_target(pcpu->cpu, load, pcpu->target_freq,
+					 new_freq);
+
+	if (new_freq > pcpu->target_freq) {
+		/* the demand started at the start of this window at the latest */
+		if (!pcpu->ramp_start) {
+			pcpu->ramp_start = max(pcpu->window_start,
+					       pcpu->idle_exit);
+			pcpu->ramp_boost = boosted;
+		}
+	} else if (new_freq < pcpu->target_freq) {
+		pcpu->ramp_start = 0;
+	}
+
+	if (new_freq >= pcpu->target_freq)
+		pcpu->target_set_time = now;
+
+	if (new_freq != pcpu->target_freq) {
+		pcpu->target_freq = new_freq;
+		changed = 1;
+	}
+
+rearm:
+	pcpu->window_start = now;
+	pcpu->window_idle = idle;
+
+	/* idle at the lowest speed, wait for the next idle exit */
+	if (pcpu->idle_enter && pcpu->target_freq <= policy->min)
+		restart = HRTIMER_NORESTART;
+	else
+		hrtimer_forward_now(timer, interactive_timer_rate());
+
+	spin_unlock_irqrestore(&pcpu->lock, flags);
+
+	if (changed) {
+		interactive_queue_speedchange(pcpu->cpu);
+		wake_up_process(speedchange_task);
+	}
+
+	return restart;
+}
+
+static void cpufreq_interactive_timer_start(void *data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pcpu->lock, flags);
+	pcpu->window_start = interactive_now();
+	pcpu->window_idle = pcpu->idle_total;
+	hrtimer_start(&pcpu->timer, interactive_timer_rate(),
+		      HRTIMER_MODE_REL_PINNED);
+	spin_unlock_irqrestore(&pcpu->lock, flags);
+}
+
+static int cpufreq_interactive_idle_notifier(struct notifier_block *nb,
+					     unsigned long val, void *data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		&per_cpu(cpuinfo, smp_processor_id());
+	unsigned long flags;
+	u64 now = interactive_now();
+
+	spin_lock_irqsave(&pcpu->lock, flags);
+
+	if (!pcpu->enabled)
+		goto out;
+
+	switch (val) {
+	case IDLE_START:
+		pcpu->idle_enter = now;
+		/* nothing left to ramp down, do not wake the cpu up for it */
+		if (pcpu->target_freq <= pcpu->policy->min)
+			hrtimer_try_to_cancel(&pcpu->timer);
+		break;
+
+	case IDLE_END:
+		if (pcpu->idle_enter) {
+			pcpu->idle_total += now - pcpu->idle_enter;
+			pcpu->idle_enter = 0;
+		}
+		pcpu->idle_exit = now;
+
+		/* sampling was stopped while idle, start from the idle exit */
+		if (!hrtimer_active(&pcpu->timer)) {
+			pcpu->window_start = now;
+			pcpu->window_idle = pcpu->idle_total;
+			hrtimer_start(&pcpu->timer, interactive_timer_rate(),
+				      HRTIMER_MODE_REL_PINNED);
+		}
+		break;
+	}
+
+out:
+	spin_unlock_irqrestore(&pcpu->lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_interactive_idle_nb = {
+	.notifier_call = cpufreq_interactive_idle_notifier,
+};
+
+static int cpufreq_interactive_speedchange_thread(void *data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu, *pjcpu;
+	struct cpufreq_policy *policy;
+	cpumask_t tmp_mask;
+	unsigned long flags;
+	unsigned int cpu, j, max_freq;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+
+		if (cpumask_empty(&speedchange_cpumask)) {
+			spin_unlock_irqrestore(&speedchange_cpumask_lock,
+					       flags);
+			schedule();
+
+			if (kthread_should_stop())
+				break;
+
+			spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		}
+
+		set_current_state(TASK_RUNNING);
+		tmp_mask = speedchange_cpumask;
+		cpumask_clear(&speedchange_cpumask);
+		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+
+		for_each_cpu(cpu, &tmp_mask) {
+			pcpu = &per_cpu(cpuinfo, cpu);
+
+			mutex_lock(&set_speed_mutex);
+			if (!pcpu->enabled) {
+				mutex_unlock(&set_speed_mutex);
+				continue;
+			}
+
+			/* cpus sharing a policy run at the highest target */
+			policy = pcpu->policy;
+			max_freq = 0;
+			for_each_cpu(j, policy->cpus) {
+				pjcpu = &per_cpu(cpuinfo, j);
+				if (pjcpu->enabled &&
+				    pjcpu->target_freq > max_freq)
+					max_freq = pjcpu->target_freq;
+			}
+
+			if (max_freq != policy->cur)
+				__cpufreq_driver_target(policy, max_freq,
+							CPUFREQ_RELATION_H);
+			mutex_unlock(&set_speed_mutex);
+		}
+	}
+
+	return 0;
+}
+
+static int cpufreq_interactive_transition(struct notifier_block *nb,
+					  unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, freqs->cpu);
+	unsigned long flags;
+	u64 now;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return 0;
+
+	now = interactive_now();
+
+	spin_lock_irqsave(&pcpu->lock, flags);
+
+	if (!pcpu->enabled)
+		goto out;
+
+	trace_cpufreq_interactive_time_in_state(freqs->cpu, pcpu->state_freq,
+						now - pcpu->state_enter);
+	pcpu->state_freq = freqs->new;
+	pcpu->state_enter = now;
+
+	if (pcpu->ramp_start && freqs->new > freqs->old) {
+		trace_cpufreq_interactive_ramp(freqs->cpu, freqs->old,
+				freqs->new, now - pcpu->ramp_start,
+				pcpu->ramp_boost);
+		if (freqs->new >= pcpu->target_freq)
+			pcpu->ramp_start = 0;
+	}
+
+out:
+	spin_unlock_irqrestore(&pcpu->lock, flags);
+
+	return 0;
+}
+
+static struct notifier_block cpufreq_interactive_transition_nb = {
+	.notifier_call = cpufreq_interactive_transition,
+};
+
+static void cpufreq_interactive_boost(const char *source)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned long flags;
+	int cpu, wake = 0;
+	u64 now = interactive_now();
+
+	spin_lock_irqsave(&boost_lock, flags);
+	boost_until = now + tuners_ins.boostpulse_duration;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	trace_cpufreq_interactive_boost(source);
+
+	for_each_online_cpu(cpu) {
+		pcpu = &per_cpu(cpuinfo, cpu);
+
+		spin_lock_irqsave(&pcpu->lock, flags);
+		if (pcpu->enabled &&
+		    pcpu->target_freq < tuners_ins.hispeed_freq) {
+			pcpu->target_freq = tuners_ins.hispeed_freq;
+			pcpu->target_set_time = now;
+			if (!pcpu->ramp_start) {
+				pcpu->ramp_start = now;
+				pcpu->ramp_boost = 1;
+			}
+			interactive_queue_speedchange(cpu);
+			wake = 1;
+		}
+		spin_unlock_irqrestore(&pcpu->lock, flags);
+	}
+
+	if (wake)
+		wake_up_process(speedchange_task);
+}
+
+static void cpufreq_interactive_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	unsigned long flags;
+	int renew;
+
+	if (!tuners_ins.input_boost)
+		return;
+
+	if (type != EV_ABS && !(type == EV_KEY && value))
+		return;
+
+	/* a touch reports many events, only renew a boost half way through */
+	spin_lock_irqsave(&boost_lock, flags);
+	renew = interactive_now() + tuners_ins.boostpulse_duration / 2 >=
+		boost_until;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	if (renew)
+		cpufreq_interactive_boost("input");
+}
+
+static int cpufreq_interactive_input_connect(struct input_handler *handler,
+					     struct input_dev *dev,
+					     const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_interactive";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id cpufreq_interactive_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	},
+	{ },
+};
+
+static struct input_handler cpufreq_interactive_input_handler = {
+	.event		= cpufreq_interactive_input_event,
+	.connect	= cpufreq_interactive_input_connect,
+	.disconnect	= cpufreq_interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= cpufreq_interactive_ids,
+};
+
+/* cpufreq_interactive Governor Tunables */
+#define show_one(file_name, object)					\
+static ssize_t show_##file_name						\
+(struct kobject *kobj, struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%u\n", tuners_ins.object);		\
+}
+show_one(hispeed_freq, hispeed_freq);
+show_one(go_hispeed_load, go_hispeed_load);
+show_one(min_sample_time, min_sample_time);
+show_one(timer_rate, timer_rate);
+show_one(input_boost, input_boost);
+show_one(boostpulse_duration, boostpulse_duration);
+
+/* A frequency from the table of any online cpu */
+static int cpufreq_interactive_valid_freq(unsigned int freq)
+{
+	struct cpufreq_frequency_table *table;
+	unsigned int cpu, i;
+
+	for_each_online_cpu(cpu) {
+		table = cpufreq_frequency_get_table(cpu);
+		if (!table)
+			continue;
+
+		for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+			if (table[i].frequency != CPUFREQ_ENTRY_INVALID &&
+			    table[i].frequency == freq)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+static ssize_t store_hispeed_freq(struct kobject *a, struct attribute *b,
+				  const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1 || !cpufreq_interactive_valid_freq(input))
+		return -EINVAL;
+
+	tuners_ins.hispeed_freq = input;
+	return count;
+}
+
+static ssize_t store_go_hispeed_load(struct kobject *a, struct attribute *b,
+				     const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1 || input > 100)
+		return -EINVAL;
+
+	tuners_ins.go_hispeed_load = input;
+	return count;
+}
+
+static ssize_t store_min_sample_time(struct kobject *a, struct attribute *b,
+				     const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	tuners_ins.min_sample_time = input;
+	return count;
+}
+
+static ssize_t store_timer_rate(struct kobject *a, struct attribute *b,
+				const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	tuners_ins.timer_rate = max(input, (unsigned int)MIN_TIMER_RATE);
+	return count;
+}
+
+static ssize_t store_input_boost(struct kobject *a, struct attribute *b,
+				 const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	tuners_ins.input_boost = !!input;
+	return count;
+}
+
+static ssize_t store_boostpulse_duration(struct kobject *a,
+		struct attribute *b, const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	tuners_ins.boostpulse_duration = input;
+	return count;
+}
+
+/* lets userspace boost ahead of a known burst, e.g. an app launch */
+static ssize_t store_boostpulse(struct kobject *a, struct attribute *b,
+				const char *buf, size_t count)
+{
+	cpufreq_interactive_boost("boostpulse");
+	return count;
+}
+
+define_one_global_rw(hispeed_freq);
+define_one_global_rw(go_hispeed_load);
+define_one_global_rw(min_sample_time);
+define_one_global_rw(timer_rate);
+define_one_global_rw(input_boost);
+define_one_global_rw(boostpulse_duration);
+
+static struct global_attr boostpulse =
+__ATTR(boostpulse, 0200, NULL, store_boostpulse);
+
+static struct attribute *interactive_attributes[] = {
+	&hispeed_freq.attr,
+	&go_hispeed_load.attr,
+	&min_sample_time.attr,
+	&timer_rate.attr,
+	&input_boost.attr,
+	&boostpulse_duration.attr,
+	&boostpulse.attr,
+	NULL
+};
+
+static struct attribute_group interactive_attr_group = {
+	.attrs = interactive_attributes,
+	.name = "interactive",
+};
+
+/************************** sysfs end ************************/
+
+static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned long flags;
+	unsigned int j;
+	u64 now;
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(policy->cpu) || !policy->cur)
+			return -EINVAL;
+
+		freq_table = cpufreq_frequency_get_table(policy->cpu);
+		if (!freq_table)
+			return -EINVAL;
+
+		mutex_lock(&gov_mutex);
+
+		if (!active_count) {
+			rc = sysfs_create_group(cpufreq_global_kobject,
+						&interactive_attr_group);
+			if (rc) {
+				mutex_unlock(&gov_mutex);
+				return rc;
+			}
+
+			rc = input_register_handler(
+					&cpufreq_interactive_input_handler);
+			if (rc)
+				printk(KERN_WARNING "cpufreq_interactive: "
+				       "no input boost, error %d\n", rc);
+		}
+		active_count++;
+
+		if (!tuners_ins.hispeed_freq)
+			tuners_ins.hispeed_freq = policy->max;
+
+		mutex_unlock(&gov_mutex);
+
+		now = interactive_now();
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+
+			spin_lock_irqsave(&pcpu->lock, flags);
+			pcpu->policy = policy;
+			pcpu->freq_table = freq_table;
+			pcpu->idle_total = 0;
+			pcpu->idle_enter = 0;
+			pcpu->idle_exit = now;
+			pcpu->target_freq = policy->cur;
+			pcpu->target_set_time = now;
+			pcpu->ramp_start = 0;
+			pcpu->state_freq = policy->cur;
+			pcpu->state_enter = now;
+			pcpu->enabled = 1;
+			spin_unlock_irqrestore(&pcpu->lock, flags);
+
+			/* the timer is pinned, start it on its own cpu */
+			smp_call_function_single(j,
+					cpufreq_interactive_timer_start,
+					pcpu, 1);
+		}
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+
+			spin_lock_irqsave(&pcpu->lock, flags);
+			pcpu->enabled = 0;
+			spin_unlock_irqrestore(&pcpu->lock, flags);
+
+			hrtimer_cancel(&pcpu->timer);
+		}
+
+		/* wait for a speed change in progress */
+		mutex_lock(&set_speed_mutex);
+		mutex_unlock(&set_speed_mutex);
+
+		mutex_lock(&gov_mutex);
+		if (!--active_count) {
+			input_unregister_handler(
+					&cpufreq_interactive_input_handler);
+			sysfs_remove_group(cpufreq_global_kobject,
+					   &interactive_attr_group);
+		}
+		mutex_unlock(&gov_mutex);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&set_speed_mutex);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy,
+				policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy,
+				policy->min, CPUFREQ_RELATION_L);
+
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+
+			spin_lock_irqsave(&pcpu->lock, flags);
+			pcpu->target_freq = clamp(pcpu->target_freq,
+						  policy->min, policy->max);
+			spin_unlock_irqrestore(&pcpu->lock, flags);
+		}
+		mutex_unlock(&set_speed_mutex);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_gov_interactive_init(void)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned int i;
+	int err;
+
+	for_each_possible_cpu(i) {
+		pcpu = &per_cpu(cpuinfo, i);
+		pcpu->cpu = i;
+		spin_lock_init(&pcpu->lock);
+		hrtimer_init(&pcpu->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		pcpu->timer.function = cpufreq_interactive_timer;
+	}
+
+	speedchange_task = kthread_create(cpufreq_interactive_speedchange_thread,
+					  NULL, "cfinteractive");
+	if (IS_ERR(speedchange_task))
+		return PTR_ERR(speedchange_task);
+
+	sched_setscheduler(speedchange_task, SCHED_FIFO, &param);
+	get_task_struct(speedchange_task);
+
+	/* the thread sleeps until the first speed change */
+	wake_up_process(speedchange_task);
+
+	idle_notifier_register(&cpufreq_interactive_idle_nb);
+	cpufreq_register_notifier(&cpufreq_interactive_transition_nb,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+
+	err = cpufreq_register_governor(&cpufreq_gov_interactive);
+	if (err) {
+		cpufreq_unregister_notifier(&cpufreq_interactive_transition_nb,
+					    CPUFREQ_TRANSITION_NOTIFIER);
+		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
+		kthread_stop(speedchange_task);
+		put_task_struct(speedchange_task);
+	}
+
+	return err;
+}
+
+static void __exit cpufreq_gov_interactive_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_interactive);
+	cpufreq_unregister_notifier(&cpufreq_interactive_transition_nb,
+				    CPUFREQ_TRANSITION_NOTIFIER);
+	idle_notifier_unregister(&cpufreq_interactive_idle_nb);
+	kthread_stop(speedchange_task);
+	put_task_struct(speedchange_task);
+}
+
+MODULE_DESCRIPTION("'cpufreq_interactive' - A cpufreq governor for "
+	"latency sensitive workloads");
+MODULE_LICENSE("GPL");
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
+fs_initcall(cpufreq_gov_interactive_init);
+#else
+module_init(cpufreq_gov_interactive_init);
+#endif
+module_exit(cpufreq_gov_interactive_exit);
@@ -0,0 +1,197 @@
+/*
+ *  drivers/cpufreq/cpufreq_interactive_loadgen.c
+ *
+ *  Copyright (c) 2010 Samsung Electronics Co., Ltd.
+ *		http://www.samsung.com/
+ *
+ * Simulated load for the 'interactive' governor. One thread per cpu is
+ * busy for busy_ms out of every period_ms, for the given time, while the
+ * ramp up and time in state trace events of the governor are collected.
+ * Works on any cpufreq driver, including acpi-cpufreq on x86.
+ *
+ * Like tcrypt, the module reports its results in the kernel log and then
+ * fails to load on purpose, so it can simply be loaded again.
+ *
+ *	echo interactive > /sys/devices/system/cpu/cpu0/cpufreq/scaling_governor
+ *	modprobe cpufreq_interactive_loadgen busy_ms=30 period_ms=100 seconds=10
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define KMSG_COMPONENT "cpufreq_interactive_loadgen"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpumask.h>
+#include <linux/delay.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <asm/div64.h>
+
+#include <trace/events/cpufreq_interactive.h>
+
+#define LOADGEN_MAX_STATES	32
+
+static unsigned int busy_ms = 30;
+static unsigned int period_ms = 100;
+static unsigned int seconds = 10;
+
+struct loadgen_state {
+	unsigned long freq;
+	u64 time_us;
+};
+
+static DEFINE_SPINLOCK(loadgen_lock);
+static struct loadgen_state loadgen_states[LOADGEN_MAX_STATES];
+static unsigned int loadgen_nr_states;
+static unsigned int loadgen_ramps;
+static unsigned int loadgen_boost_ramps;
+static u64 loadgen_ramp_total_us;
+static u64 loadgen_ramp_max_us;
+
+static void loadgen_ramp(void *data, u32 cpu_id, unsigned long from,
+			 unsigned long to, u64 latency_us, int boost)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&loadgen_lock, flags);
+	loadgen_ramps++;
+	if (boost)
+		loadgen_boost_ramps++;
+	loadgen_ramp_total_us += latency_us;
+	if (latency_us > loadgen_ramp_max_us)
+		loadgen_ramp_max_us = latency_us;
+	spin_unlock_irqrestore(&loadgen_lock, flags);
+}
+
+static void loadgen_time_in_state(void *data, u32 cpu_id, unsigned long freq,
+				  u64 time_us)
+{
+	unsigned long flags;
+	unsigned int i;
+
+	spin_lock_irqsave(&loadgen_lock, flags);
+	for (i = 0; i < loadgen_nr_states; i++) {
+		if (loadgen_states[i].freq == freq)
+			break;
+	}
+	if (i == loadgen_nr_states && i < LOADGEN_MAX_STATES)
+		loadgen_states[loadgen_nr_states++].freq = freq;
+	if (i < LOADGEN_MAX_STATES)
+		loadgen_states[i].time_us += time_us;
+	spin_unlock_irqrestore(&loadgen_lock, flags);
+}
+
+static int loadgen_thread(void *data)
+{
+	ktime_t end;
+
+	while (!kthread_should_stop()) {
+		end = ktime_add_ns(ktime_get(), (u64)busy_ms * NSEC_PER_MSEC);
+		while (ktime_to_ns(ktime_sub(end, ktime_get())) > 0 &&
+		       !kthread_should_stop()) {
+			cpu_relax();
+			cond_resched();
+		}
+
+		if (period_ms > busy_ms)
+			msleep(period_ms - busy_ms);
+	}
+
+	return 0;
+}
+
+static int __init cpufreq_interactive_loadgen_init(void)
+{
+	struct task_struct **tasks;
+	unsigned int cpu, i;
+	u64 avg;
+	int ret;
+
+	if (!period_ms || busy_ms > period_ms) {
+		pr_err("busy_ms must not exceed period_ms\n");
+		return -EINVAL;
+	}
+
+	tasks = kcalloc(nr_cpu_ids, sizeof(*tasks), GFP_KERNEL);
+	if (!tasks)
+		return -ENOMEM;
+
+	ret = register_trace_cpufreq_interactive_ramp(loadgen_ramp, NULL);
+	if (ret)
+		goto out_free;
+	ret = register_trace_cpufreq_interactive_time_in_state(
+			loadgen_time_in_state, NULL);
+	if (ret)
+		goto out_ramp;
+
+	for_each_online_cpu(cpu) {
+		tasks[cpu] = kthread_create(loadgen_thread, NULL,
+					    "cpufreq_loadgen/%u", cpu);
+		if (IS_ERR(tasks[cpu])) {
+			ret = PTR_ERR(tasks[cpu]);
+			tasks[cpu] = NULL;
+			break;
+		}
+		kthread_bind(tasks[cpu], cpu);
+		wake_up_process(tasks[cpu]);
+	}
+
+	if (!ret)
+		ssleep(seconds);
+
+	for_each_possible_cpu(cpu) {
+		if (tasks[cpu])
+			kthread_stop(tasks[cpu]);
+	}
+
+	unregister_trace_cpufreq_interactive_time_in_state(
+			loadgen_time_in_state, NULL);
+out_ramp:
+	unregister_trace_cpufreq_interactive_ramp(loadgen_ramp, NULL);
+	tracepoint_synchronize_unregister();
+
+	if (!ret) {
+		avg = loadgen_ramp_total_us;
+		if (loadgen_ramps)
+			do_div(avg, loadgen_ramps);
+
+		pr_info("%u ms busy every %u ms for %u s on %u cpus\n",
+			busy_ms, period_ms, seconds, num_online_cpus());
+		pr_info("%u ramps (%u boosted), latency avg %llu us, "
+			"max %llu us\n", loadgen_ramps, loadgen_boost_ramps,
+			avg, loadgen_ramp_max_us);
+		for (i = 0; i < loadgen_nr_states; i++)
+			pr_info("%8lu kHz: %llu us\n", loadgen_states[i].freq,
+				loadgen_states[i].time_us);
+	}
+
+out_free:
+	kfree(tasks);
+
+	/* Results are in the log, do not stay loaded */
+	return ret ? ret : -EAGAIN;
+}
+
+static void __exit cpufreq_interactive_loadgen_exit(void)
+{
+}
+
+module_param(busy_ms, uint, 0);
+MODULE_PARM_DESC(busy_ms, "Busy time per period in ms (default: 30)");
+module_param(period_ms, uint, 0);
+MODULE_PARM_DESC(period_ms, "Period of the load in ms (default: 100)");
+module_param(seconds, uint, 0);
+MODULE_PARM_DESC(seconds, "Duration of the load (default: 10)");
+
+module_init(cpufreq_interactive_loadgen_init);
+module_exit(cpufreq_interactive_loadgen_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Simulated load for the 'interactive' cpufreq governor");
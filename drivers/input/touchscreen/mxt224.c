@@ -25,6 +25,8 @@
 #include <linux/input/mxt224.h>
 #include <asm/unaligned.h>
 
+#include "ts_latency.h"
+
 #define OBJECT_TABLE_START_ADDRESS	7
 #define OBJECT_TABLE_ELEMENT_SIZE	6
 
@@ -39,6 +41,9 @@
 
 #define ID_BLOCK_SIZE			7
 
+#define MSG_BURST			4	/* messages per i2c transfer */
+#define MAX_MSG_SIZE			10
+
 struct object_t {
 	u8 object_type;
 	u16 i2c_address;
@@ -72,6 +77,7 @@ struct mxt224_data {
 	u32 y_dropbits:2;
 	void (*power_on)(void);
 	void (*power_off)(void);
+	struct ts_latency latency;
 	int num_fingers;
 	struct finger_info fingers[];
 };
@@ -102,6 +108,39 @@ static int read_mem(struct mxt224_data *data, u16 reg, u8 len, u8 *buf)
 	return ret == 2 ? 0 : -EIO;
 }
 
+/*
+ * Pop up to count messages in one transfer. After a complete message the
+ * chip points back at the message processor, so every read segment returns
+ * the next fifo entry, or report id 0xff once the fifo is empty.
+ */
+static int read_messages(struct mxt224_data *data, int count, u8 *buf)
+{
+	int ret;
+	int i;
+	u16 le_reg = cpu_to_le16(data->msg_proc);
+	struct i2c_msg msg[1 + MSG_BURST] = {
+		{
+			.addr = data->client->addr,
+			.flags = 0,
+			.len = 2,
+			.buf = (u8 *)&le_reg,
+		},
+	};
+
+	for (i = 1; i <= count; i++) {
+		msg[i].addr = data->client->addr;
+		msg[i].flags = I2C_M_RD;
+		msg[i].len = data->msg_object_size;
+		msg[i].buf = buf + (i - 1) * data->msg_object_size;
+	}
+
+	ret = i2c_transfer(data->client->adapter, msg, 1 + count);
+	if (ret < 0)
+		return ret;
+
+	return ret == 1 + count ? 0 : -EIO;
+}
+
 static int write_mem(struct mxt224_data *data, u16 reg, u8 len, const u8 *buf)
 {
 	int ret;
@@ -248,7 +287,8 @@ static int __devinit mxt224_init_touch_driver(struct mxt224_data *data)
 						data->finger_type);
 			break;
 		case GEN_MESSAGEPROCESSOR_T5:
-			data->msg_object_size = object_table[i].size + 1;
+			data->msg_object_size = min(object_table[i].size + 1,
+						    MAX_MSG_SIZE);
 			dev_dbg(&data->client->dev, "Message object size = "
 						"%d\n", data->msg_object_size);
 			break;
@@ -322,17 +362,42 @@ static void report_input_data(struct mxt224_data *data)
 	data->finger_mask = 0;
 
 	input_sync(data->input_dev);
+
+	ts_latency_frame(&data->latency);
+}
+
+static irqreturn_t mxt224_irq(int irq, void *ptr)
+{
+	struct mxt224_data *data = ptr;
+
+	ts_latency_irq(&data->latency);
+
+	return IRQ_WAKE_THREAD;
 }
 
 static irqreturn_t mxt224_irq_thread(int irq, void *ptr)
 {
 	struct mxt224_data *data = ptr;
+	int transfers = 0, messages = 0;
 	int id;
-	u8 msg[data->msg_object_size];
+	int n = MSG_BURST;
+	u8 buf[MSG_BURST * MAX_MSG_SIZE];
+	u8 *msg;
 
 	do {
-		if (read_mem(data, data->msg_proc, sizeof(msg), msg))
-			return IRQ_HANDLED;
+		if (n == MSG_BURST) {
+			if (read_messages(data, MSG_BURST, buf))
+				return IRQ_HANDLED;
+			transfers++;
+			n = 0;
+		}
+
+		msg = buf + n++ * data->msg_object_size;
+		if (msg[0] == 0xff) {
+			/* fifo empty */
+			break;
+		}
+		messages++;
 
 		id = msg[0] - data->finger_type;
 
@@ -366,14 +431,37 @@ static irqreturn_t mxt224_irq_thread(int irq, void *ptr)
 						"\n", msg[0], msg[1]);
 			continue;
 		}
-	} while (!gpio_get_value(data->gpio_read_done));
+	} while (n < MSG_BURST || !gpio_get_value(data->gpio_read_done));
 
 	if (data->finger_mask)
 		report_input_data(data);
 
+	ts_latency_read(&data->latency, transfers, messages);
+
 	return IRQ_HANDLED;
 }
 
+static ssize_t mxt224_latency_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct mxt224_data *data = dev_get_drvdata(dev);
+
+	return ts_latency_show(&data->latency, buf);
+}
+
+static ssize_t mxt224_latency_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct mxt224_data *data = dev_get_drvdata(dev);
+
+	ts_latency_reset(&data->latency);
+
+	return count;
+}
+
+static DEVICE_ATTR(latency, S_IRUGO | S_IWUSR, mxt224_latency_show,
+		mxt224_latency_store);
+
 static int mxt224_internal_suspend(struct mxt224_data *data)
 {
 	static const u8 sleep_power_cfg[3];
@@ -479,6 +567,7 @@ static int __devinit mxt224_probe(struct i2c_client *client,
 
 	data->client = client;
 	i2c_set_clientdata(client, data);
+	ts_latency_init(&data->latency);
 
 	input_dev = input_allocate_device();
 	if (!input_dev) {
@@ -561,11 +650,14 @@ static int __devinit mxt224_probe(struct i2c_client *client,
 	for (i = 0; i < data->num_fingers; i++)
 		data->fingers[i].z = -1;
 
-	ret = request_threaded_irq(client->irq, NULL, mxt224_irq_thread,
+	ret = request_threaded_irq(client->irq, mxt224_irq, mxt224_irq_thread,
 		IRQF_TRIGGER_LOW | IRQF_ONESHOT, "mxt224_ts", data);
 	if (ret < 0)
 		goto err_irq;
 
+	if (device_create_file(&client->dev, &dev_attr_latency) < 0)
+		dev_err(&client->dev, "failed to create latency attribute\n");
+
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	data->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
 	data->early_suspend.suspend = mxt224_early_suspend;
@@ -598,6 +690,7 @@ static int __devexit mxt224_remove(struct i2c_client *client)
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	unregister_early_suspend(&data->early_suspend);
 #endif
+	device_remove_file(&client->dev, &dev_attr_latency);
 	free_irq(client->irq, data);
 	kfree(data->objects);
 	gpio_free(data->gpio_read_done);
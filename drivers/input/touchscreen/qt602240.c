@@ -797,12 +797,20 @@ static int qt602240_read_object_table(struct i2c_client *client, u16 reg,
 	return 0;
 }
 
-static int qt602240_read_message(struct qt602240_data *data)
+/*
+ * Read up to count messages in one i2c transfer. The chip moves its
+ * address pointer back to the message processor after every complete
+ * message, so each read segment pops the next entry of the message fifo;
+ * entries past the last pending one come back with report id 0xff.
+ */
+static int qt602240_read_messages(struct qt602240_data *data, int count)
 {
 	struct i2c_client *client = data->client;
 	struct qt602240_object *object;
+	struct i2c_msg msg[1 + QT602240_MSG_BURST];
 	u16 reg;
 	u8 buf[2];
+	int i;
 
 	object = qt602240_get_object(data, QT602240_GEN_MESSAGE);
 	if (!object)
@@ -813,13 +821,20 @@ static int qt602240_read_message(struct qt602240_data *data)
 	buf[0] = reg & 0xff;
 	buf[1] = (reg >> 8) & 0xff;
 
-	if (i2c_master_send(client, buf, 2) != 2) {
-		dev_err(&client->dev, "i2c send failed\n");
-		return -EIO;
+	msg[0].addr = client->addr;
+	msg[0].flags = 0;
+	msg[0].len = 2;
+	msg[0].buf = buf;
+
+	for (i = 0; i < count; i++) {
+		msg[1 + i].addr = client->addr;
+		msg[1 + i].flags = I2C_M_RD;
+		msg[1 + i].len = sizeof(struct qt602240_message);
+		msg[1 + i].buf = (u8 *)&data->object_message[i];
 	}
 
-	if (i2c_master_recv(client, (u8 *)data->object_message, 9) != 9) {
-		dev_err(&client->dev, "i2c recv failed\n");
+	if (i2c_transfer(client->adapter, msg, 1 + count) != 1 + count) {
+		dev_err(&client->dev, "i2c transfer failed\n");
 		return -EIO;
 	}
 
@@ -1132,9 +1147,54 @@ static void check_chip_calibration(struct qt602240_data *data)
 }
 
 
-static void qt602240_input_read(struct qt602240_data *data)
+/* Emit one multitouch frame holding every finger still tracked */
+static void qt602240_report_fingers(struct qt602240_data *data)
+{
+	struct input_dev *input_dev = data->input_dev;
+	int i;
+
+	for (i= 0; i<MAX_USING_FINGER_NUM; ++i ) {
+		if (fingerInfo[i].pressure == -1 )
+			continue;
+
+		input_report_abs(input_dev, ABS_MT_POSITION_X, fingerInfo[i].x);
+		input_report_abs(input_dev, ABS_MT_POSITION_Y, fingerInfo[i].y);
+		input_report_abs(input_dev, ABS_MT_TOUCH_MAJOR, fingerInfo[i].pressure);
+		input_report_abs(input_dev, ABS_MT_WIDTH_MAJOR, fingerInfo[i].size);
+		input_report_abs(input_dev, ABS_MT_TRACKING_ID, fingerInfo[i].id);
+		input_mt_sync(input_dev);
+
+		if (fingerInfo[i].pressure == 0 )
+			fingerInfo[i].pressure= -1;
+	}
+	input_sync(input_dev);
+
+	data->finger_mask = 0;
+
+	ts_latency_frame(&data->latency);
+}
+
+static void qt602240_soft_reset(struct qt602240_data *data)
+{
+	release_all_fingers(data->input_dev);
+	release_all_keys(data->input_dev);
+	data->finger_mask = 0;
+
+	/* try to soft reset */
+	qt602240_write_object(data, QT602240_GEN_COMMAND,
+		QT602240_COMMAND_RESET, 1);
+
+	/* wait for soft reset */
+	msleep(150);
+
+	/* calibrate again */
+	calibrate_chip(data);
+}
+
+/* returns -EIO when the chip had to be reset */
+static int qt602240_handle_message(struct qt602240_data *data,
+		struct qt602240_message *message)
 {
-	struct qt602240_message *message = data->object_message;
 	struct qt602240_object *object;
 	struct input_dev *input_dev = data->input_dev;
 	bool touch_message_flag;
@@ -1142,17 +1202,9 @@ static void qt602240_input_read(struct qt602240_data *data)
 	u8 touch_status = 0;
 	u8 id, size;
 	int i;
-	int bChangeUpDn= 0;
 	int x = 0, y = 0;
-	static int nPrevID= -1;
 
 	touch_message_flag = false;
-	if (qt602240_read_message(data)) {
-#ifdef FEATURE_KERNEL_INPUT_DEBUG_MSG        
-		printk(KERN_ERR "[TSP] Couldn't read message\n");
-#endif
-		goto soft_reset;
-	}
 
 	reportid = message->reportid;
 
@@ -1178,10 +1230,16 @@ static void qt602240_input_read(struct qt602240_data *data)
 
 		size = message->message[4];
 
+		/*
+		 * A finger reported twice before the frame is sent: flush the
+		 * frame so a press followed by a release is not lost.
+		 */
+		if (data->finger_mask & (1U << id))
+			qt602240_report_fingers(data);
+
 		if ( touch_status & 0x20 ) {                                         // Release : 0x20
 			s5pv210_unlock_dvfs_high_level(DVFS_LOCK_TOKEN_7);
 			fingerInfo[id].pressure= 0;
-			bChangeUpDn= 1;
 #ifdef FEATURE_KERNEL_INPUT_DEBUG_MSG
 			printk(KERN_DEBUG "[TSP] Finger[%d] Up    (%d,%d) size : %d\n", id, fingerInfo[id].x, fingerInfo[id].y, size);
 #endif
@@ -1191,7 +1249,6 @@ static void qt602240_input_read(struct qt602240_data *data)
 			fingerInfo[id].pressure= 40;
 			fingerInfo[id].x= (int16_t)x;
 			fingerInfo[id].y= (int16_t)y;
-			bChangeUpDn= 1;
 #if defined(DRIVER_FILTER)
 			equalize_coordinate(1, id, &fingerInfo[id].x, &fingerInfo[id].y);
 #endif
@@ -1214,27 +1271,7 @@ static void qt602240_input_read(struct qt602240_data *data)
 
 		fingerInfo[id].id = id;
 		fingerInfo[id].size = size;
-
-		if (nPrevID >= id || bChangeUpDn ) {
-
-			for (i= 0; i<MAX_USING_FINGER_NUM; ++i ) {
-				if (fingerInfo[i].pressure == -1 )
-					continue;
-
-				input_report_abs(input_dev, ABS_MT_POSITION_X, fingerInfo[i].x);
-				input_report_abs(input_dev, ABS_MT_POSITION_Y, fingerInfo[i].y);
-				input_report_abs(input_dev, ABS_MT_TOUCH_MAJOR, fingerInfo[i].pressure);
-				input_report_abs(input_dev, ABS_MT_WIDTH_MAJOR, fingerInfo[i].size);
-				input_report_abs(input_dev, ABS_MT_TRACKING_ID, fingerInfo[i].id);
-				input_mt_sync(input_dev);
-
-				if (fingerInfo[i].pressure == 0 )
-					fingerInfo[i].pressure= -1;
-			}
-			input_sync(input_dev);
-		}
-
-		nPrevID= id;
+		data->finger_mask |= 1U << id;
 
 		}
 	else if (( reportid >= REPORTID_TSPKEY_MIN )&& ( reportid <= REPORTID_TSPKEY_MAX )) {
@@ -1319,22 +1356,54 @@ static void qt602240_input_read(struct qt602240_data *data)
 
 	if(cal_check_flag && touch_message_flag)
 		check_chip_calibration(data);
-	return ;
+	return 0;
 
 soft_reset:
-	release_all_fingers(input_dev);
-	release_all_keys(data->input_dev);
+	qt602240_soft_reset(data);
+	return -EIO;
+}
 
-	/* try to soft reset */
-	qt602240_write_object(data, QT602240_GEN_COMMAND,
-		QT602240_COMMAND_RESET, 1);
+/*
+ * Drain the message fifo QT602240_MSG_BURST entries per transfer while the
+ * CHG line stays low, then send the fingers as a single frame.
+ */
+static void qt602240_input_read(struct qt602240_data *data)
+{
+	int transfers = 0, messages = 0;
+	int i;
 
-	/* wait for soft reset */
-	msleep(150);
+	do {
+		if (qt602240_read_messages(data, QT602240_MSG_BURST)) {
+#ifdef FEATURE_KERNEL_INPUT_DEBUG_MSG        
+			printk(KERN_ERR "[TSP] Couldn't read message\n");
+#endif
+			qt602240_soft_reset(data);
+			return;
+		}
+		transfers++;
+
+		for (i = 0; i < QT602240_MSG_BURST; i++) {
+			if (data->object_message[i].reportid == 0xff)
+				break;
+			messages++;
+			if (qt602240_handle_message(data, &data->object_message[i]))
+				return;
+		}
+	} while (i == QT602240_MSG_BURST && !gpio_get_value(GPIO_TOUCH_INT));
 
-	/* calibrate again */
-	calibrate_chip(data);
+	if (data->finger_mask)
+		qt602240_report_fingers(data);
 
+	ts_latency_read(&data->latency, transfers, messages);
+}
+
+static irqreturn_t qt602240_hardirq(int irq, void *dev_id)
+{
+    struct qt602240_data *data = dev_id;
+
+    ts_latency_irq(&data->latency);
+
+    return IRQ_WAKE_THREAD;
 }
 
 static irqreturn_t qt602240_interrupt(int irq, void *dev_id)
@@ -1474,7 +1543,8 @@ static int qt602240_initialize(struct qt602240_data *data)
 		kzalloc(sizeof(struct qt602240_object) * data->info->object_num,
 				GFP_KERNEL);
 	data->object_message =
-		kzalloc(sizeof(struct qt602240_message), GFP_KERNEL);
+		kzalloc(sizeof(struct qt602240_message) * QT602240_MSG_BURST,
+				GFP_KERNEL);
 	if (!data->object_table || !data->object_message) {
 		dev_err(&data->client->dev, "Failed to allocate memory\n");
 		return -ENOMEM;
@@ -1860,11 +1930,30 @@ void qt602240_inform_first_brightness(void)
 }
 EXPORT_SYMBOL(qt602240_inform_first_brightness);
 
+static ssize_t qt602240_latency_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct qt602240_data *data = dev_get_drvdata(dev);
+
+	return ts_latency_show(&data->latency, buf);
+}
+
+static ssize_t qt602240_latency_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct qt602240_data *data = dev_get_drvdata(dev);
+
+	ts_latency_reset(&data->latency);
+
+	return count;
+}
+
 static DEVICE_ATTR(info, 0444, qt602240_info_show, NULL);
 static DEVICE_ATTR(object_table, 0444, qt602240_object_table_show, NULL);
 static DEVICE_ATTR(object, 0664, qt602240_object_show, qt602240_object_store);
 static DEVICE_ATTR(update_fw, 0664, NULL, qt602240_update_fw_store);
 static DEVICE_ATTR(update_status, 0664, qt602240_update_status_show, NULL);
+static DEVICE_ATTR(latency, 0664, qt602240_latency_show, qt602240_latency_store);
 
 static struct attribute *qt602240_attrs[] = {
 	&dev_attr_info.attr,
@@ -1872,6 +1961,7 @@ static struct attribute *qt602240_attrs[] = {
 	&dev_attr_object.attr,
 	&dev_attr_update_fw.attr,
 	&dev_attr_update_status.attr,
+	&dev_attr_latency.attr,
 //	&dev_attr_config_mode.attr,
 	NULL
 };
@@ -2234,6 +2324,7 @@ static int __devinit qt602240_probe(struct i2c_client *client,
     data->client = client;
     data->input_dev = input_dev;
     data->irq = client->irq;
+    ts_latency_init(&data->latency);
 
     input_dev->name = "AT42QT602240 Touchscreen";
     input_dev->id.bustype = BUS_I2C;
@@ -2290,7 +2381,7 @@ static int __devinit qt602240_probe(struct i2c_client *client,
 	goto err_free_object;
     }
 
-    ret = request_threaded_irq(data->irq, NULL, qt602240_interrupt,
+    ret = request_threaded_irq(data->irq, qt602240_hardirq, qt602240_interrupt,
             IRQF_ONESHOT|IRQF_TRIGGER_LOW, client->dev.driver->name, data);
 
     if (ret < 0)
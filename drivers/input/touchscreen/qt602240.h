@@ -9,9 +9,11 @@
 #include <linux/i2c.h>
 #include <linux/input.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/syscalls.h>
+#include "ts_latency.h"
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/fcntl.h>
@@ -532,6 +534,9 @@ static bool tsp_keystatus[NUMOFKEYS];
  } report_finger_info_t;
 
   /* Each client has this additional data */
+/* messages read per i2c transfer */
+#define QT602240_MSG_BURST		(MAX_USING_FINGER_NUM + 1)
+
 struct qt602240_data
 {
     unsigned int irq;
@@ -541,8 +546,10 @@ struct qt602240_data
     struct qt602240_platform_data *pdata;
     struct qt602240_info *info;
     struct qt602240_object *object_table;
-    struct qt602240_message *object_message;
+    struct qt602240_message *object_message;	/* QT602240_MSG_BURST entries */
     struct early_suspend	early_suspend;
+    u32 finger_mask;				/* fingers updated in this frame */
+    struct ts_latency latency;
 };
 
 enum Touch_Update_Statue{
@@ -0,0 +1,115 @@
+/*
+ * Touchscreen irq to input_sync latency statistics
+ *
+ * Copyright (C) 2010, Samsung Electronics Co. Ltd. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Shared by the touchscreen drivers which export a "latency" attribute.
+ * The primary irq handler stamps the interrupt with ts_latency_irq(), the
+ * threaded handler calls ts_latency_frame() after each input_sync() and
+ * ts_latency_read() once the message fifo is drained.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <asm/div64.h>
+
+#include "ts_latency.h"
+
+void ts_latency_init(struct ts_latency *lat)
+{
+	spin_lock_init(&lat->lock);
+	memset(&lat->stats, 0, sizeof(lat->stats));
+}
+EXPORT_SYMBOL_GPL(ts_latency_init);
+
+static int ts_latency_bucket(u32 us)
+{
+	int i;
+
+	for (i = 0; i < TS_LAT_BUCKETS - 1; i++) {
+		if (us < (128U << i))
+			break;
+	}
+
+	return i;
+}
+
+/* A frame was reported for the last interrupt */
+void ts_latency_frame(struct ts_latency *lat)
+{
+	unsigned long flags;
+	u32 us;
+
+	us = ktime_us_delta(ktime_get(), lat->irq_time);
+
+	spin_lock_irqsave(&lat->lock, flags);
+	lat->stats.frames++;
+	lat->stats.hist[ts_latency_bucket(us)]++;
+	lat->stats.total_us += us;
+	if (us > lat->stats.max_us)
+		lat->stats.max_us = us;
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+EXPORT_SYMBOL_GPL(ts_latency_frame);
+
+/* An interrupt was handled with that many i2c transfers and messages */
+void ts_latency_read(struct ts_latency *lat, int transfers, int messages)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	lat->stats.irqs++;
+	lat->stats.transfers += transfers;
+	lat->stats.messages += messages;
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+EXPORT_SYMBOL_GPL(ts_latency_read);
+
+/* Formats the statistics for a sysfs show() */
+ssize_t ts_latency_show(struct ts_latency *lat, char *buf)
+{
+	struct ts_latency_stats stats;
+	unsigned long flags;
+	u64 avg;
+	int i, count;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	stats = lat->stats;
+	spin_unlock_irqrestore(&lat->lock, flags);
+
+	avg = stats.total_us;
+	if (stats.frames)
+		do_div(avg, stats.frames);
+
+	count = sprintf(buf, "irqs: %u\nframes: %u\nmessages: %u\n"
+			"transfers: %u\nlatency avg: %llu us, max: %u us\n",
+			stats.irqs, stats.frames, stats.messages,
+			stats.transfers, avg, stats.max_us);
+
+	for (i = 0; i < TS_LAT_BUCKETS - 1; i++)
+		count += sprintf(buf + count, "  <%-5u %u\n", 128U << i,
+				stats.hist[i]);
+	count += sprintf(buf + count, "  >=%-4u %u\n", 128U << (i - 1),
+			stats.hist[i]);
+
+	return count;
+}
+EXPORT_SYMBOL_GPL(ts_latency_show);
+
+void ts_latency_reset(struct ts_latency *lat)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	memset(&lat->stats, 0, sizeof(lat->stats));
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+EXPORT_SYMBOL_GPL(ts_latency_reset);
+
+MODULE_DESCRIPTION("Touchscreen latency statistics");
+MODULE_LICENSE("GPL");
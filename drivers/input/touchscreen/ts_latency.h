@@ -0,0 +1,49 @@
+/*
+ * Touchscreen irq to input_sync latency statistics
+ *
+ * Copyright (C) 2010, Samsung Electronics Co. Ltd. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _TS_LATENCY_H_
+#define _TS_LATENCY_H_
+
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+/* irq to input_sync latency, <128us, <256us ... <8ms, >=8ms */
+#define TS_LAT_BUCKETS		8
+
+struct ts_latency_stats {
+	u32 irqs;
+	u32 frames;
+	u32 messages;
+	u32 transfers;
+	u32 hist[TS_LAT_BUCKETS];
+	u64 total_us;
+	u32 max_us;
+};
+
+struct ts_latency {
+	ktime_t irq_time;		/* set by the primary irq handler */
+	spinlock_t lock;
+	struct ts_latency_stats stats;
+};
+
+/* Called from the primary irq handler */
+static inline void ts_latency_irq(struct ts_latency *lat)
+{
+	lat->irq_time = ktime_get();
+}
+
+void ts_latency_init(struct ts_latency *lat);
+void ts_latency_frame(struct ts_latency *lat);
+void ts_latency_read(struct ts_latency *lat, int transfers, int messages);
+ssize_t ts_latency_show(struct ts_latency *lat, char *buf);
+void ts_latency_reset(struct ts_latency *lat);
+
+#endif /* _TS_LATENCY_H_ */
@@ -193,6 +193,10 @@ struct fimc_capinfo {
 	int			irq;
 	int			lastirq;
 
+	/* V4L2_MEMORY_USERPTR: user address each buffer was resolved for */
+	enum v4l2_memory	memory;
+	unsigned long		userptr[FIMC_CAPBUFS];
+
 	/* flip: V4L2_CID_xFLIP, rotate: 90, 180, 270 */
 	u32			flip;
 	u32			rotate;
@@ -693,6 +697,29 @@ extern void fimc_save_regs(struct fimc_control *ctrl);
 extern void fimc_load_regs(struct fimc_control *ctrl);
 extern void fimc_dump_regs(struct fimc_control *ctrl);
 
+/* frame trace: fimc_trace.c */
+enum fimc_trace_type {
+	FIMC_TRACE_DONE,
+	FIMC_TRACE_OVERFLOW,
+	FIMC_TRACE_MISSED,
+	FIMC_TRACE_QBUF,
+	FIMC_TRACE_DQBUF,
+	FIMC_TRACE_STARVE,
+};
+
+#ifdef CONFIG_VIDEO_FIMC_TRACE
+extern void fimc_trace_init(struct fimc_control *ctrl);
+extern void fimc_trace_exit(struct fimc_control *ctrl);
+extern void fimc_trace_reset(struct fimc_control *ctrl);
+extern void fimc_trace_event(struct fimc_control *ctrl, int type, int index);
+#else
+static inline void fimc_trace_init(struct fimc_control *ctrl) {}
+static inline void fimc_trace_exit(struct fimc_control *ctrl) {}
+static inline void fimc_trace_reset(struct fimc_control *ctrl) {}
+static inline void fimc_trace_event(struct fimc_control *ctrl,
+					int type, int index) {}
+#endif
+
 /*
  * D R I V E R  H E L P E R S
  *
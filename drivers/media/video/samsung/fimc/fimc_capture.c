@@ -1081,6 +1081,135 @@ err_alloc:
 	return -ENOMEM;
 }
 
+/*
+ * USERPTR buffers take no reserved memory, only the plane sizes are set
+ * here. The addresses are resolved when a buffer is queued.
+ */
+static void fimc_init_userptr_buffers(struct fimc_control *ctrl, int size[])
+{
+	struct fimc_capinfo *cap = ctrl->cap;
+	int i, plane;
+
+	for (i = 0; i < cap->nr_bufs; i++) {
+		for (plane = 0; plane < 4; plane++)
+			cap->bufs[i].length[plane] = size[plane];
+
+		cap->bufs[i].state = VIDEOBUF_PREPARED;
+		cap->bufs[i].id = i;
+	}
+}
+
+/*
+ * Resolve a user address to the physical address of the memory behind
+ * it. Only mappings of physically contiguous memory such as pmem or
+ * other media reserved memory are accepted: the whole range has to be
+ * in one VM_PFNMAP mapping on consecutive page frames.
+ */
+static int fimc_get_userptr_paddr(unsigned long uaddr, size_t len,
+					dma_addr_t *paddr)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	unsigned long start = uaddr & PAGE_MASK;
+	unsigned long addr, pfn, first_pfn = 0;
+	int ret = 0;
+
+	if (!len || (uaddr + len < uaddr))
+		return -EINVAL;
+
+	down_read(&mm->mmap_sem);
+
+	vma = find_vma(mm, uaddr);
+	if (!vma || (uaddr < vma->vm_start) || (uaddr + len > vma->vm_end)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	for (addr = start; addr < uaddr + len; addr += PAGE_SIZE) {
+		ret = follow_pfn(vma, addr, &pfn);
+		if (ret)
+			goto out;
+
+		if (addr == start) {
+			first_pfn = pfn;
+		} else if (pfn != first_pfn + ((addr - start) >> PAGE_SHIFT)) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	*paddr = (first_pfn << PAGE_SHIFT) + (uaddr & ~PAGE_MASK);
+
+out:
+	up_read(&mm->mmap_sem);
+
+	return ret;
+}
+
+static int fimc_qbuf_userptr_capture(struct fimc_control *ctrl,
+					struct v4l2_buffer *b)
+{
+	struct fimc_capinfo *cap = ctrl->cap;
+	struct fimc_buf_set *buf;
+	dma_addr_t paddr;
+	size_t len = 0;
+	int i, plane, ret;
+
+	if (b->index >= cap->nr_bufs)
+		return -EINVAL;
+
+	buf = &cap->bufs[b->index];
+
+	/*
+	 * Resolved again on every queueing, even for the same user address:
+	 * the memory behind it may have been unmapped and mapped again, and
+	 * VM_PFNMAP memory cannot be pinned.
+	 */
+	for (plane = 0; plane < 4; plane++)
+		len += buf->length[plane];
+
+	if (b->length < len) {
+		fimc_err("%s: buffer %d is too small (%u < %zu)\n", __func__,
+				b->index, b->length, len);
+		return -EINVAL;
+	}
+
+	ret = fimc_get_userptr_paddr(b->m.userptr, len, &paddr);
+	if (ret) {
+		fimc_err("%s: buffer %d is not physically contiguous\n",
+				__func__, b->index);
+		return ret;
+	}
+
+	if ((cap->fmt.pixelformat == V4L2_PIX_FMT_NV12T) &&
+			(paddr & (SZ_8K - 1))) {
+		fimc_err("%s: NV12T buffer must be 8KB aligned\n", __func__);
+		return -EINVAL;
+	}
+
+	/* planes follow each other in the buffer */
+	for (plane = 0; plane < 4; plane++) {
+		buf->base[plane] = buf->length[plane] ? paddr : 0;
+		paddr += buf->length[plane];
+	}
+
+	cap->userptr[b->index] = b->m.userptr;
+
+	if (cap->nr_bufs > FIMC_PHYBUFS)
+		return 0;
+
+	/* few buffers repeat over the hardware slots, see reqbufs */
+	for (i = b->index; i < FIMC_PHYBUFS; i += cap->nr_bufs) {
+		if (i != b->index)
+			memcpy(cap->bufs[i].base, buf->base, sizeof(buf->base));
+
+		if (ctrl->status == FIMC_STREAMON)
+			fimc_hwset_output_address(ctrl, &cap->bufs[i], i);
+	}
+
+	return 0;
+}
+
 static void fimc_free_buffers(struct fimc_control *ctrl)
 {
 	struct fimc_capinfo *cap;
@@ -1108,7 +1237,8 @@ int fimc_reqbufs_capture(void *fh, struct v4l2_requestbuffers *b)
 	int size[4] = { 0, 0, 0, 0};
 	int align = 0;
 
-	if (b->memory != V4L2_MEMORY_MMAP) {
+	if ((b->memory != V4L2_MEMORY_MMAP) &&
+			(b->memory != V4L2_MEMORY_USERPTR)) {
 		fimc_err("%s: invalid memory type\n", __func__);
 		return -EINVAL;
 	}
@@ -1210,7 +1340,13 @@ int fimc_reqbufs_capture(void *fh, struct v4l2_requestbuffers *b)
 		break;
 	}
 
-	ret = fimc_alloc_buffers(ctrl, size, align);
+	cap->memory = b->memory;
+	memset(cap->userptr, 0, sizeof(cap->userptr));
+
+	if (b->memory == V4L2_MEMORY_USERPTR)
+		fimc_init_userptr_buffers(ctrl, size);
+	else
+		ret = fimc_alloc_buffers(ctrl, size, align);
 	if (ret) {
 		fimc_err("%s: no memory for "
 				"capture buffer\n", __func__);
@@ -1695,7 +1831,7 @@ int fimc_streamon_capture(void *fh)
 	struct fimc_global *fimc = get_fimc_dev();
 
 	int rot;
-	int ret;
+	int ret, i;
 
 	fimc_dbg("%s\n", __func__);
 
@@ -1709,6 +1845,18 @@ int fimc_streamon_capture(void *fh)
 		return -EBUSY;
 	}
 
+	/* every hardware slot needs a queued user buffer */
+	if ((cap->memory == V4L2_MEMORY_USERPTR) &&
+			(cap->nr_bufs <= FIMC_PHYBUFS)) {
+		for (i = 0; i < cap->nr_bufs; i++) {
+			if (!cap->userptr[i]) {
+				fimc_err("%s: buffer %d is not queued\n",
+						__func__, i);
+				return -EINVAL;
+			}
+		}
+	}
+
 	mutex_lock(&ctrl->v4l2_lock);
 
 	if (0 != ctrl->id)
@@ -1716,6 +1864,7 @@ int fimc_streamon_capture(void *fh)
 
 	ctrl->status = FIMC_READY_ON;
 	cap->irq = 0;
+	fimc_trace_reset(ctrl);
 
 	fimc_hwset_enable_irq(ctrl, 0, 1);
 
@@ -1828,19 +1977,27 @@ int fimc_streamoff_capture(void *fh)
 int fimc_qbuf_capture(void *fh, struct v4l2_buffer *b)
 {
 	struct fimc_control *ctrl = ((struct fimc_prv_data *)fh)->ctrl;
+	int ret = 0;
 
-	if (b->memory != V4L2_MEMORY_MMAP) {
+	if (b->memory != ctrl->cap->memory) {
 		fimc_err("%s: invalid memory type\n", __func__);
 		return -EINVAL;
 	}
 
-	if (ctrl->cap->nr_bufs > FIMC_PHYBUFS) {
-		mutex_lock(&ctrl->v4l2_lock);
+	mutex_lock(&ctrl->v4l2_lock);
+
+	if (b->memory == V4L2_MEMORY_USERPTR)
+		ret = fimc_qbuf_userptr_capture(ctrl, b);
+
+	if (!ret && (ctrl->cap->nr_bufs > FIMC_PHYBUFS))
 		fimc_add_inqueue(ctrl, b->index);
-		mutex_unlock(&ctrl->v4l2_lock);
-	}
 
-	return 0;
+	if (!ret)
+		fimc_trace_event(ctrl, FIMC_TRACE_QBUF, b->index);
+
+	mutex_unlock(&ctrl->v4l2_lock);
+
+	return ret;
 }
 
 int fimc_dqbuf_capture(void *fh, struct v4l2_buffer *b)
@@ -1854,7 +2011,7 @@ int fimc_dqbuf_capture(void *fh, struct v4l2_buffer *b)
 		return -EINVAL;
 	}
 
-	if (b->memory != V4L2_MEMORY_MMAP) {
+	if (b->memory != ctrl->cap->memory) {
 		fimc_err("%s: invalid memory type\n", __func__);
 		return -EINVAL;
 	}
@@ -1881,10 +2038,13 @@ int fimc_dqbuf_capture(void *fh, struct v4l2_buffer *b)
 	if (cap->fmt.field == V4L2_FIELD_INTERLACED_TB)
 		pp &= ~0x1;
 
+	fimc_trace_event(ctrl, FIMC_TRACE_DQBUF, pp);
+
 	if (cap->nr_bufs > FIMC_PHYBUFS) {
 		b->index = cap->outq[pp];
 		ret = fimc_add_outqueue(ctrl, pp);
 		if (ret) {
+			fimc_trace_event(ctrl, FIMC_TRACE_STARVE, pp);
 			b->index = -1;
 			fimc_err("%s: no inqueue buffer\n", __func__);
 		}
@@ -1892,6 +2052,9 @@ int fimc_dqbuf_capture(void *fh, struct v4l2_buffer *b)
 		b->index = pp;
 	}
 
+	if ((b->memory == V4L2_MEMORY_USERPTR) && (b->index < cap->nr_bufs))
+		b->m.userptr = cap->userptr[b->index];
+
 	mutex_unlock(&ctrl->v4l2_lock);
 
 	/* fimc_dbg("%s: buf_index = %d\n", __func__, b->index); */
@@ -390,6 +390,20 @@ static inline void fimc_irq_out(struct fimc_control *ctrl)
 		wake_up(&ctrl->wq);
 }
 
+/* pp is the output slot fimc_dqbuf_capture() will hand out for this frame */
+static inline void fimc_irq_cap_trace(struct fimc_control *ctrl, int pp)
+{
+	struct fimc_capinfo *cap = ctrl->cap;
+
+	/* the previous frame was not picked up before this one completed */
+	if (cap->irq)
+		fimc_trace_event(ctrl, FIMC_TRACE_MISSED, -1);
+
+	if (cap->nr_bufs)
+		pp %= cap->nr_bufs;
+	fimc_trace_event(ctrl, FIMC_TRACE_DONE, pp);
+}
+
 static inline void fimc_irq_cap(struct fimc_control *ctrl)
 {
 	struct fimc_capinfo *cap = ctrl->cap;
@@ -398,6 +412,8 @@ static inline void fimc_irq_cap(struct fimc_control *ctrl)
 
 	fimc_hwset_clear_irq(ctrl);
 	if (fimc_hwget_overflow_state(ctrl)) {
+		fimc_trace_event(ctrl, FIMC_TRACE_OVERFLOW, -1);
+
 		/* s/w reset -- added for recovering module in ESD state*/
 		cfg = readl(ctrl->regs + S3C_CIGCTRL);
 		cfg |= (S3C_CIGCTRL_SWRST);
@@ -412,10 +428,12 @@ static inline void fimc_irq_cap(struct fimc_control *ctrl)
 	if (cap->fmt.field == V4L2_FIELD_INTERLACED_TB) {
 		/* odd value of pp means one frame is made with top/bottom */
 		if (pp & 0x1) {
+			fimc_irq_cap_trace(ctrl, pp & ~0x1);
 			cap->irq = 1;
 			wake_up(&ctrl->wq);
 		}
 	} else {
+		fimc_irq_cap_trace(ctrl, pp);
 		cap->irq = 1;
 		wake_up(&ctrl->wq);
 	}
@@ -509,6 +527,7 @@ struct fimc_control *fimc_register_controller(struct platform_device *pdev)
 		fimc_err("%s: request_irq failed\n", __func__);
 
 	fimc_hwset_reset(ctrl);
+	fimc_trace_init(ctrl);
 
 	return ctrl;
 }
@@ -522,6 +541,7 @@ static int fimc_unregister_controller(struct platform_device *pdev)
 	pdata = to_fimc_plat(&pdev->dev);
 	ctrl = get_fimc_ctrl(id);
 
+	fimc_trace_exit(ctrl);
 	free_irq(ctrl->irq, ctrl);
 	mutex_destroy(&ctrl->lock);
 	mutex_destroy(&ctrl->alloc_lock);
@@ -1065,10 +1085,13 @@ static int fimc_release(struct file *filp)
 		kfree(filp->private_data);
 		filp->private_data = NULL;
 
-		for (i = 0; i < FIMC_CAPBUFS; i++) {
-			fimc_dma_free(ctrl, &ctrl->cap->bufs[i], 0);
-			fimc_dma_free(ctrl, &ctrl->cap->bufs[i], 1);
-			fimc_dma_free(ctrl, &ctrl->cap->bufs[i], 2);
+		/* USERPTR buffers are not from the reserved memory */
+		if (ctrl->cap->memory != V4L2_MEMORY_USERPTR) {
+			for (i = 0; i < FIMC_CAPBUFS; i++) {
+				fimc_dma_free(ctrl, &ctrl->cap->bufs[i], 0);
+				fimc_dma_free(ctrl, &ctrl->cap->bufs[i], 1);
+				fimc_dma_free(ctrl, &ctrl->cap->bufs[i], 2);
+			}
 		}
 
 		fimc_clk_en(ctrl, false);
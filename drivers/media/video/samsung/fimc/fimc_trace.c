@@ -0,0 +1,339 @@
+/* linux/drivers/media/video/samsung/fimc/fimc_trace.c
+ *
+ * Copyright (c) 2010 Samsung Electronics Co., Ltd.
+ *		http://www.samsung.com/
+ *
+ * Capture frame trace for Samsung Camera Interface (FIMC) driver
+ *
+ * Every capture interrupt, qbuf and dqbuf is logged in a small ring per
+ * controller together with the inqueue depth, and the frame interval and
+ * DMA done to dqbuf latency are accumulated in log2 histograms. Both are
+ * exported in debugfs under fimc/:
+ *
+ *   fimcN_trace	last FIMC_TRACE_ENTRIES events, oldest first
+ *   fimcN_stats	counters and histograms, writing to it resets them
+ *
+ * The sensor does not timestamp its frames, so the frame interval is
+ * measured between two consecutive frame end interrupts.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+*/
+
+#include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <plat/fimc.h>
+
+#include "fimc.h"
+
+#define FIMC_TRACE_ENTRIES	512
+#define FIMC_TRACE_BUCKETS	8	/* <1, <2, <4 ... <64, >=64 ms */
+
+struct fimc_trace_entry {
+	s64	time;		/* ns */
+	u16	type;
+	s16	index;
+	u16	depth;
+	u16	frame;
+};
+
+struct fimc_trace_stats {
+	u32	frames;
+	u32	dequeued;
+	u32	overflows;
+	u32	missed;
+	u32	starved;
+
+	u32	interval_hist[FIMC_TRACE_BUCKETS];
+	u32	latency_hist[FIMC_TRACE_BUCKETS];
+	s64	interval_max;	/* us */
+	s64	latency_max;	/* us */
+};
+
+struct fimc_trace {
+	spinlock_t		lock;
+	struct fimc_trace_entry	ring[FIMC_TRACE_ENTRIES];
+	unsigned int		head;
+	unsigned int		count;
+
+	ktime_t			last_frame;
+	ktime_t			done_time[FIMC_PHYBUFS];
+	struct fimc_trace_stats	stats;
+
+	struct dentry		*trace_file;
+	struct dentry		*stats_file;
+};
+
+static struct fimc_trace fimc_traces[FIMC_DEVICES];
+static struct dentry *fimc_trace_dir;
+static int fimc_trace_users;
+
+static const char *fimc_trace_names[] = {
+	[FIMC_TRACE_DONE]	= "done",
+	[FIMC_TRACE_OVERFLOW]	= "overflow",
+	[FIMC_TRACE_MISSED]	= "missed",
+	[FIMC_TRACE_QBUF]	= "qbuf",
+	[FIMC_TRACE_DQBUF]	= "dqbuf",
+	[FIMC_TRACE_STARVE]	= "starve",
+};
+
+static int fimc_trace_bucket(s64 us)
+{
+	int i;
+
+	for (i = 0; i < FIMC_TRACE_BUCKETS - 1; i++) {
+		if (us < (1000LL << i))
+			break;
+	}
+
+	return i;
+}
+
+static void fimc_trace_log(struct fimc_trace *trace, ktime_t now,
+			   int type, int index, int depth)
+{
+	struct fimc_trace_entry *entry = &trace->ring[trace->head];
+
+	entry->time = ktime_to_ns(now);
+	entry->type = type;
+	entry->index = index;
+	entry->depth = depth;
+	entry->frame = trace->stats.frames;
+
+	trace->head = (trace->head + 1) % FIMC_TRACE_ENTRIES;
+	if (trace->count < FIMC_TRACE_ENTRIES)
+		trace->count++;
+}
+
+void fimc_trace_event(struct fimc_control *ctrl, int type, int index)
+{
+	struct fimc_trace *trace = &fimc_traces[ctrl->id];
+	struct fimc_trace_stats *stats = &trace->stats;
+	struct fimc_capinfo *cap = ctrl->cap;
+	struct fimc_buf_set *buf;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+	int depth = 0;
+	s64 us;
+
+	/* inq is only touched under v4l2_lock, the depth is a hint anyway */
+	if (cap && cap->nr_bufs > FIMC_PHYBUFS && type != FIMC_TRACE_DONE) {
+		list_for_each_entry(buf, &cap->inq, list)
+			depth++;
+	}
+
+	spin_lock_irqsave(&trace->lock, flags);
+
+	switch (type) {
+	case FIMC_TRACE_DONE:
+		if (stats->frames) {
+			us = ktime_us_delta(now, trace->last_frame);
+			stats->interval_hist[fimc_trace_bucket(us)]++;
+			if (us > stats->interval_max)
+				stats->interval_max = us;
+		}
+		trace->last_frame = now;
+		stats->frames++;
+		if (index >= 0 && index < FIMC_PHYBUFS)
+			trace->done_time[index] = now;
+		break;
+
+	case FIMC_TRACE_DQBUF:
+		stats->dequeued++;
+		if (index >= 0 && index < FIMC_PHYBUFS &&
+		    ktime_to_ns(trace->done_time[index])) {
+			us = ktime_us_delta(now, trace->done_time[index]);
+			stats->latency_hist[fimc_trace_bucket(us)]++;
+			if (us > stats->latency_max)
+				stats->latency_max = us;
+		}
+		break;
+
+	case FIMC_TRACE_OVERFLOW:
+		stats->overflows++;
+		break;
+
+	case FIMC_TRACE_MISSED:
+		stats->missed++;
+		break;
+
+	case FIMC_TRACE_STARVE:
+		stats->starved++;
+		break;
+	}
+
+	fimc_trace_log(trace, now, type, index, depth);
+
+	spin_unlock_irqrestore(&trace->lock, flags);
+}
+
+void fimc_trace_reset(struct fimc_control *ctrl)
+{
+	struct fimc_trace *trace = &fimc_traces[ctrl->id];
+	unsigned long flags;
+
+	spin_lock_irqsave(&trace->lock, flags);
+	trace->head = 0;
+	trace->count = 0;
+	memset(trace->done_time, 0, sizeof(trace->done_time));
+	memset(&trace->stats, 0, sizeof(trace->stats));
+	spin_unlock_irqrestore(&trace->lock, flags);
+}
+
+static int fimc_trace_show(struct seq_file *s, void *unused)
+{
+	struct fimc_trace *trace = s->private;
+	struct fimc_trace_entry *ring, *entry;
+	unsigned int i, start, count;
+	unsigned long flags;
+
+	ring = kmalloc(sizeof(trace->ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&trace->lock, flags);
+	memcpy(ring, trace->ring, sizeof(trace->ring));
+	count = trace->count;
+	start = (trace->head + FIMC_TRACE_ENTRIES - count) % FIMC_TRACE_ENTRIES;
+	spin_unlock_irqrestore(&trace->lock, flags);
+
+	seq_printf(s, "%-16s %-8s %5s %5s %6s\n",
+			"time(ns)", "event", "index", "inq", "frame");
+
+	for (i = 0; i < count; i++) {
+		entry = &ring[(start + i) % FIMC_TRACE_ENTRIES];
+		seq_printf(s, "%-16lld %-8s %5d %5u %6u\n", entry->time,
+				fimc_trace_names[entry->type], entry->index,
+				entry->depth, entry->frame);
+	}
+
+	kfree(ring);
+
+	return 0;
+}
+
+static int fimc_trace_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fimc_trace_show, inode->i_private);
+}
+
+static const struct file_operations fimc_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fimc_trace_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void fimc_trace_show_hist(struct seq_file *s, const char *name,
+				 u32 *hist, s64 max)
+{
+	int i;
+
+	seq_printf(s, "%s (ms), max %lld us\n", name, max);
+	for (i = 0; i < FIMC_TRACE_BUCKETS - 1; i++)
+		seq_printf(s, "  <%-4d %u\n", 1 << i, hist[i]);
+	seq_printf(s, "  >=%-3d %u\n", 1 << (i - 1), hist[i]);
+}
+
+static int fimc_stats_show(struct seq_file *s, void *unused)
+{
+	struct fimc_trace *trace = s->private;
+	struct fimc_trace_stats copy;
+	unsigned long flags;
+
+	spin_lock_irqsave(&trace->lock, flags);
+	copy = trace->stats;
+	spin_unlock_irqrestore(&trace->lock, flags);
+
+	seq_printf(s, "frames:    %u\n", copy.frames);
+	seq_printf(s, "dequeued:  %u\n", copy.dequeued);
+	seq_printf(s, "missed:    %u\n", copy.missed);
+	seq_printf(s, "overflows: %u\n", copy.overflows);
+	seq_printf(s, "starved:   %u\n", copy.starved);
+
+	fimc_trace_show_hist(s, "frame interval", copy.interval_hist,
+			copy.interval_max);
+	fimc_trace_show_hist(s, "done to dqbuf", copy.latency_hist,
+			copy.latency_max);
+
+	return 0;
+}
+
+static int fimc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fimc_stats_show, inode->i_private);
+}
+
+static ssize_t fimc_stats_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct fimc_trace *trace = s->private;
+
+	fimc_trace_reset(get_fimc_ctrl(trace - fimc_traces));
+
+	return count;
+}
+
+static const struct file_operations fimc_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fimc_stats_open,
+	.read		= seq_read,
+	.write		= fimc_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void fimc_trace_init(struct fimc_control *ctrl)
+{
+	struct fimc_trace *trace = &fimc_traces[ctrl->id];
+	char name[16];
+
+	spin_lock_init(&trace->lock);
+	fimc_trace_reset(ctrl);
+
+	if (!fimc_trace_dir) {
+		fimc_trace_dir = debugfs_create_dir("fimc", NULL);
+		if (IS_ERR_OR_NULL(fimc_trace_dir)) {
+			fimc_trace_dir = NULL;
+			fimc_warn("%s: failed to create debugfs dir\n",
+					__func__);
+			return;
+		}
+	}
+	fimc_trace_users++;
+
+	sprintf(name, "fimc%d_trace", ctrl->id);
+	trace->trace_file = debugfs_create_file(name, S_IRUGO,
+				fimc_trace_dir, trace, &fimc_trace_fops);
+
+	sprintf(name, "fimc%d_stats", ctrl->id);
+	trace->stats_file = debugfs_create_file(name, S_IRUGO | S_IWUSR,
+				fimc_trace_dir, trace, &fimc_stats_fops);
+}
+
+void fimc_trace_exit(struct fimc_control *ctrl)
+{
+	struct fimc_trace *trace = &fimc_traces[ctrl->id];
+
+	if (!fimc_trace_dir)
+		return;
+
+	debugfs_remove(trace->trace_file);
+	debugfs_remove(trace->stats_file);
+	trace->trace_file = NULL;
+	trace->stats_file = NULL;
+
+	if (--fimc_trace_users == 0) {
+		debugfs_remove(fimc_trace_dir);
+		fimc_trace_dir = NULL;
+	}
+}
@@ -44,6 +44,10 @@
 #include <linux/semaphore.h>
 #include <linux/regulator/consumer.h>
 #include <linux/io.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 
 #include <asm/page.h>
 #include <asm/irq.h>
@@ -58,6 +62,7 @@
 #include <mach/media.h>
 #include <plat/media.h>
 #include <plat/cpu.h>
+#include "../sec_job_sched.h"
 #include "fimg2d_regs.h"
 #include "fimg2d_3x.h"
 
@@ -87,6 +92,37 @@ static u32 g_g2d_dst_phys_addr;
 static u32 g_g2d_dst_virt_addr;
 static u32 g_g2d_dst_size;
 
+static ktime_t           g_g2d_irq_time;
+
+/*
+ * G2D_BLIT_ASYNC batches are run by g_g2d_wq in submission order, each
+ * batch back to back on the engine under g_g2d_rot_mutex.
+ */
+struct g2d_ctx {
+	unsigned int      submit_fence;
+	unsigned int      done_fence;
+	unsigned int      seen_fence;	/* last collected by G2D_WAIT_FENCE */
+	wait_queue_head_t fence_waitq;
+};
+
+struct g2d_job {
+	struct list_head  list;
+	struct g2d_ctx   *ctx;
+	unsigned int      fence;
+	unsigned int      num;
+	ktime_t           submit_time;
+	struct g2d_blit   blits[0];
+};
+
+static struct workqueue_struct *g_g2d_wq;
+static struct work_struct g_g2d_work;
+static LIST_HEAD(g_g2d_queue);
+static DEFINE_SEC_JOB_SCHED(g_g2d_sched);
+
+static struct g2d_stats  g_g2d_stats;
+static u64               g_g2d_blit_total;
+static u64               g_g2d_queue_total;
+
 static u32 sec_g2d_check_fifo_stat_wait(void)
 {
 	int cnt = 50;
@@ -651,6 +687,7 @@ static irqreturn_t sec_g2d_irq(int irq, void *dev_id)
 {
 	__raw_writel(G2D_INTC_PEND_R_INTP_CMD_FIN, g_g2d_base + INTC_PEND_REG);
 
+	g_g2d_irq_time = ktime_get();
 	g_in_use = 0;
 
 	wake_up_interruptible(&g_g2d_waitq);
@@ -684,8 +721,217 @@ static void sec_g2d_domain_timer(unsigned long arg)
 	sec_g2d_clk_disable();
 }
 
+static int sec_g2d_wait_idle(void)
+{
+	if (g_in_use == 0)
+		return 0;
+
+	if (wait_event_timeout(g_g2d_waitq, (g_in_use == 0),
+			msecs_to_jiffies(G2D_TIMEOUT)) == 0) {
+		__raw_writel(G2D_SWRESET_R_RESET, g_g2d_base + SOFT_RESET_REG);
+		pr_err("g2d:%s: waiting for interrupt is timeout\n", __func__);
+		g_in_use = 0;
+		return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+static void sec_g2d_run_job(struct g2d_job *job)
+{
+	struct g2d_params  params;
+	struct g2d_blit   *blit;
+	ktime_t            start;
+	u32                queue_us, blit_us;
+	int                i, ret;
+
+	mutex_lock(&g_g2d_rot_mutex);
+
+	sec_g2d_clk_enable();
+
+	/* a non-blocking G2D_BLIT may still be running */
+	sec_g2d_wait_idle();
+
+	queue_us = (u32)ktime_us_delta(ktime_get(), job->submit_time);
+
+	spin_lock(&g_g2d_sched.lock);
+	g_g2d_stats.batches++;
+	g_g2d_queue_total += queue_us;
+	if (queue_us > g_g2d_stats.queue_max)
+		g_g2d_stats.queue_max = queue_us;
+	spin_unlock(&g_g2d_sched.lock);
+
+	for (i = 0; i < job->num; i++) {
+		blit = &job->blits[i];
+
+		params.src_rect = blit->use_src ? &blit->src_rect : NULL;
+		params.dst_rect = &blit->dst_rect;
+		params.flag     = &blit->flag;
+
+		g_in_use = 1;
+		start = ktime_get();
+
+		sec_g2d_init_regs(&params);
+		sec_g2d_rotate_with_bitblt(&params);
+
+		ret = sec_g2d_wait_idle();
+		blit_us = (u32)ktime_us_delta(ret ? ktime_get() : g_g2d_irq_time,
+						start);
+
+		spin_lock(&g_g2d_sched.lock);
+		g_g2d_stats.blits++;
+		if (ret)
+			g_g2d_stats.timeouts++;
+		g_g2d_stats.blit_last = blit_us;
+		g_g2d_blit_total += blit_us;
+		if (blit_us > g_g2d_stats.blit_max)
+			g_g2d_stats.blit_max = blit_us;
+		spin_unlock(&g_g2d_sched.lock);
+	}
+
+	sec_g2d_clk_disable();
+
+	mutex_unlock(&g_g2d_rot_mutex);
+}
+
+static void sec_g2d_work(struct work_struct *work)
+{
+	struct g2d_job *job;
+
+	spin_lock(&g_g2d_sched.lock);
+	while (!list_empty(&g_g2d_queue)) {
+		job = list_first_entry(&g_g2d_queue, struct g2d_job, list);
+		list_del(&job->list);
+		sec_job_sched_start(&g_g2d_sched, job->ctx);
+
+		sec_g2d_run_job(job);
+
+		/* the context may go away once it is not running anymore */
+		spin_lock(&g_g2d_sched.lock);
+		job->ctx->done_fence = job->fence;
+		wake_up_interruptible(&job->ctx->fence_waitq);
+		sec_job_sched_finish(&g_g2d_sched);
+
+		kfree(job);
+
+		spin_lock(&g_g2d_sched.lock);
+	}
+	spin_unlock(&g_g2d_sched.lock);
+}
+
+static bool sec_g2d_fence_done(struct g2d_ctx *ctx, unsigned int fence)
+{
+	bool done;
+
+	spin_lock(&g_g2d_sched.lock);
+	done = ((int)(ctx->done_fence - fence) >= 0);
+	spin_unlock(&g_g2d_sched.lock);
+
+	return done;
+}
+
+static int sec_g2d_blit_async(struct g2d_ctx *ctx, struct g2d_batch __user *arg)
+{
+	struct g2d_batch  batch;
+	struct g2d_job   *job;
+
+	if (copy_from_user(&batch, arg, sizeof(batch)))
+		return -EFAULT;
+
+	if ((batch.num == 0) || (batch.num > G2D_MAX_BATCH))
+		return -EINVAL;
+
+	job = kmalloc(sizeof(*job) + batch.num * sizeof(struct g2d_blit),
+			GFP_KERNEL);
+	if (job == NULL)
+		return -ENOMEM;
+
+	if (copy_from_user(job->blits, (void __user *)batch.blits,
+				batch.num * sizeof(struct g2d_blit))) {
+		kfree(job);
+		return -EFAULT;
+	}
+
+	job->ctx = ctx;
+	job->num = batch.num;
+	job->submit_time = ktime_get();
+
+	spin_lock(&g_g2d_sched.lock);
+	job->fence = ++ctx->submit_fence;
+	list_add_tail(&job->list, &g_g2d_queue);
+	spin_unlock(&g_g2d_sched.lock);
+
+	queue_work(g_g2d_wq, &g_g2d_work);
+
+	batch.fence = job->fence;
+	if (copy_to_user(&arg->fence, &batch.fence, sizeof(batch.fence)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int sec_g2d_wait_fence(struct g2d_ctx *ctx, unsigned int fence)
+{
+	if (wait_event_interruptible(ctx->fence_waitq,
+				sec_g2d_fence_done(ctx, fence)))
+		return -ERESTARTSYS;
+
+	spin_lock(&g_g2d_sched.lock);
+	if ((int)(fence - ctx->seen_fence) > 0)
+		ctx->seen_fence = fence;
+	spin_unlock(&g_g2d_sched.lock);
+
+	return 0;
+}
+
+/* a batch is done whose fence was not waited for yet */
+static bool sec_g2d_fence_pending(struct g2d_ctx *ctx)
+{
+	bool pending;
+
+	spin_lock(&g_g2d_sched.lock);
+	pending = ((int)(ctx->done_fence - ctx->seen_fence) > 0);
+	spin_unlock(&g_g2d_sched.lock);
+
+	return pending;
+}
+
+static int sec_g2d_get_stats(struct g2d_stats __user *arg)
+{
+	struct g2d_stats stats;
+	u64 avg;
+
+	spin_lock(&g_g2d_sched.lock);
+	stats = g_g2d_stats;
+	if (stats.blits) {
+		avg = g_g2d_blit_total;
+		do_div(avg, stats.blits);
+		stats.blit_avg = (u32)avg;
+	}
+	if (stats.batches) {
+		avg = g_g2d_queue_total;
+		do_div(avg, stats.batches);
+		stats.queue_avg = (u32)avg;
+	}
+	spin_unlock(&g_g2d_sched.lock);
+
+	if (copy_to_user(arg, &stats, sizeof(stats)))
+		return -EFAULT;
+
+	return 0;
+}
+
 static int sec_g2d_open(struct inode *inode, struct file *file)
 {
+	struct g2d_ctx *ctx;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (ctx == NULL)
+		return -ENOMEM;
+
+	init_waitqueue_head(&ctx->fence_waitq);
+	file->private_data = ctx;
+
 	g_num_of_g2d_object++;
 
 	pr_debug("g2d: open ok!\n");
@@ -695,6 +941,23 @@ static int sec_g2d_open(struct inode *inode, struct file *file)
 
 static int sec_g2d_release(struct inode *inode, struct file *file)
 {
+	struct g2d_ctx *ctx = file->private_data;
+	struct g2d_job *job, *tmp;
+
+	/* drop batches not started yet, wait for the running one */
+	spin_lock(&g_g2d_sched.lock);
+	list_for_each_entry_safe(job, tmp, &g_g2d_queue, list) {
+		if (job->ctx == ctx) {
+			list_del(&job->list);
+			kfree(job);
+		}
+	}
+	spin_unlock(&g_g2d_sched.lock);
+
+	sec_job_sched_wait_owner(&g_g2d_sched, ctx);
+
+	kfree(ctx);
+
 	g_num_of_g2d_object--;
 
 	if (g_num_of_g2d_object == 0)
@@ -735,8 +998,18 @@ static int sec_g2d_ioctl(struct inode *inode,
 	struct g2d_params   *params = NULL;
 	struct g2d_dma_info  dma_info;
 	void                *vaddr;
+	unsigned int         fence;
 
 	switch (cmd) {
+	case G2D_BLIT_ASYNC:
+		return sec_g2d_blit_async(file->private_data,
+					(struct g2d_batch __user *)arg);
+	case G2D_WAIT_FENCE:
+		if (copy_from_user(&fence, (unsigned int *)arg, sizeof(fence)))
+			return -EFAULT;
+		return sec_g2d_wait_fence(file->private_data, fence);
+	case G2D_GET_STATS:
+		return sec_g2d_get_stats((struct g2d_stats __user *)arg);
 	case G2D_GET_MEMORY:
 		ret = copy_to_user((unsigned int *)arg, &g_g2d_reserved_phys_addr,
 						sizeof(unsigned int));
@@ -865,15 +1138,21 @@ sec_g2d_ioctl_done:
 
 static u32 sec_g2d_poll(struct file *file, poll_table *wait)
 {
+	struct g2d_ctx *ctx = file->private_data;
 	unsigned int mask = 0;
 
+	poll_wait(file, &ctx->fence_waitq, wait);
+
+	if (sec_g2d_fence_pending(ctx))
+		mask |= POLLIN | POLLRDNORM;
+
 	if (g_in_use == 0) {
-		mask = POLLOUT | POLLWRNORM;
+		mask |= POLLOUT | POLLWRNORM;
 	} else {
 		poll_wait(file, &g_g2d_waitq, wait);
 
 		if (g_in_use == 0)
-			mask = POLLOUT | POLLWRNORM;
+			mask |= POLLOUT | POLLWRNORM;
 	}
 
 	return mask;
@@ -964,6 +1243,15 @@ static int sec_g2d_probe(struct platform_device *pdev)
 	/* atomic init */
 	g_in_use = 0;
 
+	/* queued blits */
+	g_g2d_wq = create_singlethread_workqueue("g2d");
+	if (g_g2d_wq == NULL) {
+		pr_err("g2d: failed to create workqueue\n");
+		ret = -ENOMEM;
+		goto err_wq;
+	}
+	INIT_WORK(&g_g2d_work, sec_g2d_work);
+
 	/* misc register */
 	ret = misc_register(&sec_g2d_dev);
 	if (ret) {
@@ -1000,6 +1288,8 @@ static int sec_g2d_probe(struct platform_device *pdev)
 err_req_fw:
 	misc_deregister(&sec_g2d_dev);
 err_misc_reg:
+	destroy_workqueue(g_g2d_wq);
+err_wq:
 	clk_put(g_g2d_clk);
 	g_g2d_clk = NULL;
 err_clk_get:
@@ -1021,6 +1311,8 @@ static int sec_g2d_remove(struct platform_device *dev)
 {
 	pr_debug("g2d: sec_g2d_remove called !\n");
 
+	destroy_workqueue(g_g2d_wq);
+
 	del_timer(&g_g2d_domain_timer);
 
 	iounmap(g_g2d_base);
@@ -22,6 +22,9 @@
 #define G2D_DMA_CACHE_CLEAN  _IOWR(G2D_IOCTL_MAGIC, 5, struct g2d_dma_info)
 #define G2D_DMA_CACHE_FLUSH  _IOWR(G2D_IOCTL_MAGIC, 6, struct g2d_dma_info)
 #define G2D_SET_MEMORY       _IOWR(G2D_IOCTL_MAGIC, 7, struct g2d_dma_info)
+#define G2D_BLIT_ASYNC       _IOWR(G2D_IOCTL_MAGIC, 8, struct g2d_batch)
+#define G2D_WAIT_FENCE       _IOW(G2D_IOCTL_MAGIC, 9, unsigned int)
+#define G2D_GET_STATS        _IOR(G2D_IOCTL_MAGIC, 10, struct g2d_stats)
 
 #define G2D_SFR_SIZE        (0x1000)
 
@@ -33,6 +36,9 @@
 
 #define G2D_ALPHA_VALUE_MAX (255)
 
+/* blits per G2D_BLIT_ASYNC call */
+#define G2D_MAX_BATCH       (32)
+
 enum G2D_ROT_DEG {
 	G2D_ROT_0 = 0,
 	G2D_ROT_90,
@@ -171,6 +177,38 @@ struct g2d_dma_info {
 	unsigned int  size;
 };
 
+/* one blit of a G2D_BLIT_ASYNC batch, src_rect is ignored if !use_src */
+struct g2d_blit {
+	struct g2d_rect src_rect;
+	struct g2d_rect dst_rect;
+	struct g2d_flag flag;
+	unsigned int    use_src;
+};
+
+/*
+ * The blits of a batch run back to back in the given order. The returned
+ * fence signals when the last one is done, see G2D_WAIT_FENCE and poll()
+ * (POLLIN: a batch of the file is done whose fence, or a later one, was
+ * not yet passed to G2D_WAIT_FENCE).
+ */
+struct g2d_batch {
+	struct g2d_blit *blits;
+	unsigned int     num;
+	unsigned int     fence;
+};
+
+/* times in usec */
+struct g2d_stats {
+	unsigned int  blits;
+	unsigned int  batches;
+	unsigned int  timeouts;
+	unsigned int  blit_last;
+	unsigned int  blit_avg;
+	unsigned int  blit_max;
+	unsigned int  queue_avg;   /* submit to start of a batch */
+	unsigned int  queue_max;
+};
+
 /**** function declearation***************************/
 static void sec_g2d_init_regs(struct g2d_params *params);
 static void sec_g2d_rotate_with_bitblt(struct g2d_params *params);
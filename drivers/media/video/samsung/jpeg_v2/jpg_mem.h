@@ -16,6 +16,8 @@
 #include "jpg_misc.h"
 
 #include <linux/version.h>
+#include <linux/list.h>
+#include <linux/wait.h>
 #include <plat/media.h>
 #include <mach/media.h>
 
@@ -102,6 +104,9 @@ struct s5pc110_jpg_ctx {
 	int			caller_process;
 	struct jpegv2_limits	*limits;
 	struct jpegv2_buf	*bufinfo;
+	struct list_head	done_list;	/* finished queued jobs */
+	unsigned int		job_cnt;	/* queued, not dequeued */
+	wait_queue_head_t	done_wait;
 };
 
 void *phy_to_vir_addr(unsigned int phy_addr, int mem_size);
@@ -144,6 +144,35 @@ struct jpg_args {
 	struct jpg_enc_proc_param	*thumb_enc_param;
 };
 
+/*
+ * Queued job. The buffers are given as offsets into the reserved memory
+ * returned by mmap(), so several images can be in flight in one region.
+ * Results come back with IOCTL_JPG_DEQUEUE_JOB in queueing order.
+ */
+struct jpg_job_args {
+	unsigned int		id;		/* cookie, returned as is */
+	unsigned int		cmd;		/* IOCTL_JPG_[DECODE|ENCODE] */
+	unsigned int		jpg_offset;	/* jpeg stream */
+	unsigned int		jpg_size;
+	unsigned int		img_offset;	/* YCbCr/RGB frame */
+	unsigned int		img_size;
+	struct jpg_dec_proc_param	dec_param;
+	struct jpg_enc_proc_param	enc_param;
+	int			result;		/* out: JPG_SUCCESS/JPG_FAIL */
+	unsigned int		latency_us;	/* out: queue to done */
+	unsigned int		hw_us;		/* out: codec time */
+};
+
+/* times in usec */
+struct jpg_stats {
+	unsigned int		jobs;
+	unsigned int		errors;
+	unsigned int		latency_avg;
+	unsigned int		latency_max;
+	unsigned int		hw_avg;
+	unsigned int		hw_max;
+};
+
 void reset_jpg(struct s5pc110_jpg_ctx *jpg_ctx);
 enum jpg_return_status decode_jpg(struct s5pc110_jpg_ctx *jpg_ctx, \
 		struct jpg_dec_proc_param *dec_param);
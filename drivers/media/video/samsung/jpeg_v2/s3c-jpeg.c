@@ -38,6 +38,11 @@
 #include <linux/mm.h>
 #include <linux/platform_device.h>
 #include <linux/regulator/consumer.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
+#include <asm/div64.h>
 
 #include <linux/version.h>
 #include <plat/media.h>
@@ -49,6 +54,7 @@
 
 #include <plat/clock.h>
 
+#include "../sec_job_sched.h"
 #include "s3c-jpeg.h"
 #include "jpg_mem.h"
 #include "jpg_misc.h"
@@ -71,6 +77,35 @@ wait_queue_head_t	wait_queue_jpeg;
 
 DECLARE_WAIT_QUEUE_HEAD(WaitQueue_JPEG);
 
+/*
+ * Queued jobs of all open files, run one by one by s3c_jpeg_wq in
+ * queueing order. Finished jobs move to the done_list of their file.
+ */
+struct jpg_job {
+	struct list_head	list;
+	struct s5pc110_jpg_ctx	*owner;
+	ktime_t			queue_time;
+	unsigned int		width;		/* decode: frame size parsed */
+	unsigned int		height;		/* when the job was queued */
+	struct jpg_job_args	args;
+};
+
+static LIST_HEAD(jpg_job_list);
+static DEFINE_SEC_JOB_SCHED(jpg_job_sched);
+static struct workqueue_struct	*s3c_jpeg_wq;
+static struct work_struct	s3c_jpeg_work;
+
+static struct jpg_stats		jpg_job_stats;
+static u64			jpg_latency_total;
+static u64			jpg_hw_total;
+
+/* encoder input is YCbCr 4:2:2 interleaved or RGB565 */
+#define JPG_ENC_IN_BPP		2
+/* the reserved stream buffers are sized for 1 byte per pixel */
+#define JPG_ENC_STREAM_BPP	1
+/* leading stream bytes searched for the frame header of a decode job */
+#define JPG_HDR_SEARCH_SIZE	(128 * 1024)
+
 static void jpeg_clock_enable(void)
 {
 	/* power domain enable */
@@ -89,6 +124,334 @@ static void jpeg_clock_disable(void)
 	regulator_disable(jpeg_pd_regulator);
 }
 
+/*
+ * Reads the frame size from the SOFn marker of the stream at phy_addr.
+ * The stream stays writable from user space, so the result is only
+ * trusted as the copy kept in the job.
+ */
+static int s3c_jpeg_get_frame_size(unsigned int phy_addr, unsigned int size,
+				   unsigned int *width, unsigned int *height)
+{
+	void __iomem	*hdr;
+	unsigned int	pos, len;
+	u8		marker;
+	int		ret = -EINVAL;
+
+	size = min_t(unsigned int, size, JPG_HDR_SEARCH_SIZE);
+	if (size < 4)
+		return -EINVAL;
+
+	hdr = ioremap(phy_addr, size);
+	if (hdr == NULL)
+		return -ENOMEM;
+
+	/* SOI */
+	if ((readb(hdr) != 0xFF) || (readb(hdr + 1) != 0xD8))
+		goto out;
+
+	pos = 2;
+	while (pos + 4 <= size) {
+		if (readb(hdr + pos) != 0xFF)
+			break;
+
+		marker = readb(hdr + pos + 1);
+		if (marker == 0xFF) {		/* fill byte */
+			pos++;
+			continue;
+		}
+
+		/* SOF0-SOF15, except DHT, JPG and DAC */
+		if ((marker >= 0xC0) && (marker <= 0xCF) && (marker != 0xC4) &&
+		    (marker != 0xC8) && (marker != 0xCC)) {
+			if (pos + 9 > size)
+				break;
+			*height = (readb(hdr + pos + 5) << 8) |
+				  readb(hdr + pos + 6);
+			*width = (readb(hdr + pos + 7) << 8) |
+				 readb(hdr + pos + 8);
+			ret = 0;
+			break;
+		}
+
+		/* no frame header before the scan */
+		if (marker == 0xDA)
+			break;
+
+		len = (readb(hdr + pos + 2) << 8) | readb(hdr + pos + 3);
+		if (len < 2)
+			break;
+		pos += 2 + len;
+	}
+
+out:
+	iounmap(hdr);
+
+	return ret;
+}
+
+/*
+ * The decoded frame must fit the image buffer of the job. Keeps the frame
+ * size in the job, the codec result is checked against it.
+ */
+static int s3c_jpeg_check_dec_job(struct jpg_job *job)
+{
+	struct jpg_job_args	*args = &job->args;
+	unsigned int	width, height, frame_size;
+
+	if (s3c_jpeg_get_frame_size(jpg_data_base_addr + args->jpg_offset,
+				    args->jpg_size, &width, &height))
+		return -EINVAL;
+
+	if ((width == 0) || (width > s3c_jpeg_limits.max_main_width) ||
+	    (height == 0) || (height > s3c_jpeg_limits.max_main_height))
+		return -EINVAL;
+
+	frame_size = get_yuv_size(args->dec_param.out_format, width, height);
+	if ((frame_size == 0) || (frame_size > args->img_size))
+		return -EINVAL;
+
+	job->width = width;
+	job->height = height;
+
+	return 0;
+}
+
+/*
+ * The source frame must fit the image buffer and the worst case stream
+ * the stream buffer of the job.
+ */
+static int s3c_jpeg_check_enc_job(struct jpg_job_args *args)
+{
+	struct jpg_enc_proc_param *enc_param = &args->enc_param;
+	unsigned int	max_width, max_height, pixels;
+
+	if (enc_param->enc_type == JPG_MAIN) {
+		max_width = s3c_jpeg_limits.max_main_width;
+		max_height = s3c_jpeg_limits.max_main_height;
+	} else {
+		max_width = s3c_jpeg_limits.max_thumb_width;
+		max_height = s3c_jpeg_limits.max_thumb_height;
+	}
+
+	if ((enc_param->width == 0) || (enc_param->width > max_width) ||
+	    (enc_param->height == 0) || (enc_param->height > max_height))
+		return -EINVAL;
+
+	pixels = enc_param->width * enc_param->height;
+	if ((args->img_size < pixels * JPG_ENC_IN_BPP) ||
+	    (args->jpg_size < pixels * JPG_ENC_STREAM_BPP))
+		return -EINVAL;
+
+	return 0;
+}
+
+static void s3c_jpeg_run_job(struct jpg_job *job)
+{
+	struct jpg_job_args	*args = &job->args;
+	struct s5pc110_jpg_ctx	hw_ctx;
+	enum jpg_return_status	result;
+	ktime_t			start;
+
+	memset(&hw_ctx, 0x00, sizeof(struct s5pc110_jpg_ctx));
+	hw_ctx.limits = &s3c_jpeg_limits;
+	hw_ctx.bufinfo = &s3c_jpeg_bufinfo;
+	hw_ctx.jpg_data_addr = jpg_data_base_addr + args->jpg_offset;
+	hw_ctx.img_data_addr = jpg_data_base_addr + args->img_offset;
+	hw_ctx.jpg_thumb_data_addr = hw_ctx.jpg_data_addr;
+	hw_ctx.img_thumb_data_addr = hw_ctx.img_data_addr;
+
+	args->hw_us = 0;
+
+	lock_jpg_mutex();
+	jpeg_clock_enable();
+
+	start = ktime_get();
+	if (args->cmd == IOCTL_JPG_DECODE)
+		result = decode_jpg(&hw_ctx, &args->dec_param);
+	else
+		result = encode_jpg(&hw_ctx, &args->enc_param);
+	args->hw_us = (unsigned int)ktime_us_delta(ktime_get(), start);
+
+	jpeg_clock_disable();
+	unlock_jpg_mutex();
+
+	/* the header was rewritten after the job was queued */
+	if ((args->cmd == IOCTL_JPG_DECODE) && (result == JPG_SUCCESS) &&
+	    ((args->dec_param.width != job->width) ||
+	     (args->dec_param.height != job->height))) {
+		jpg_err("job %u: frame size changed since queued\n", args->id);
+		result = JPG_FAIL;
+	}
+
+	args->result = result;
+	args->latency_us = (unsigned int)ktime_us_delta(ktime_get(),
+							job->queue_time);
+
+	spin_lock(&jpg_job_sched.lock);
+	jpg_job_stats.jobs++;
+	if (result != JPG_SUCCESS)
+		jpg_job_stats.errors++;
+	jpg_latency_total += args->latency_us;
+	if (args->latency_us > jpg_job_stats.latency_max)
+		jpg_job_stats.latency_max = args->latency_us;
+	jpg_hw_total += args->hw_us;
+	if (args->hw_us > jpg_job_stats.hw_max)
+		jpg_job_stats.hw_max = args->hw_us;
+	spin_unlock(&jpg_job_sched.lock);
+}
+
+static void s3c_jpeg_job_work(struct work_struct *work)
+{
+	struct jpg_job		*job;
+	struct s5pc110_jpg_ctx	*owner;
+
+	spin_lock(&jpg_job_sched.lock);
+	while (!list_empty(&jpg_job_list)) {
+		job = list_first_entry(&jpg_job_list, struct jpg_job, list);
+		list_del(&job->list);
+		owner = job->owner;
+		sec_job_sched_start(&jpg_job_sched, owner);
+
+		s3c_jpeg_run_job(job);
+
+		/* the owner may go away once it is not running anymore */
+		spin_lock(&jpg_job_sched.lock);
+		list_add_tail(&job->list, &owner->done_list);
+		wake_up_interruptible(&owner->done_wait);
+		sec_job_sched_finish(&jpg_job_sched);
+
+		spin_lock(&jpg_job_sched.lock);
+	}
+	spin_unlock(&jpg_job_sched.lock);
+}
+
+static int s3c_jpeg_check_buf(unsigned int offset, unsigned int size)
+{
+	if ((size == 0) || (offset >= jpg_reserved_mem_size) ||
+	    (size > jpg_reserved_mem_size - offset))
+		return -EINVAL;
+
+	return 0;
+}
+
+static int s3c_jpeg_queue_job(struct s5pc110_jpg_ctx *jpg_reg_ctx,
+			      struct jpg_job_args __user *arg)
+{
+	struct jpg_job	*job;
+
+	job = kmalloc(sizeof(struct jpg_job), GFP_KERNEL);
+	if (job == NULL)
+		return -ENOMEM;
+
+	if (copy_from_user(&job->args, arg, sizeof(struct jpg_job_args))) {
+		kfree(job);
+		return -EFAULT;
+	}
+
+	if (((job->args.cmd != IOCTL_JPG_DECODE) &&
+	     (job->args.cmd != IOCTL_JPG_ENCODE)) ||
+	    s3c_jpeg_check_buf(job->args.jpg_offset, job->args.jpg_size) ||
+	    s3c_jpeg_check_buf(job->args.img_offset, job->args.img_size) ||
+	    ((job->args.cmd == IOCTL_JPG_DECODE) &&
+	     s3c_jpeg_check_dec_job(job)) ||
+	    ((job->args.cmd == IOCTL_JPG_ENCODE) &&
+	     s3c_jpeg_check_enc_job(&job->args))) {
+		jpg_err("invalid job\n");
+		kfree(job);
+		return -EINVAL;
+	}
+
+	job->owner = jpg_reg_ctx;
+	job->queue_time = ktime_get();
+
+	spin_lock(&jpg_job_sched.lock);
+	if (jpg_reg_ctx->job_cnt >= MAX_QUEUED_JOBS) {
+		spin_unlock(&jpg_job_sched.lock);
+		kfree(job);
+		return -EBUSY;
+	}
+	jpg_reg_ctx->job_cnt++;
+	list_add_tail(&job->list, &jpg_job_list);
+	spin_unlock(&jpg_job_sched.lock);
+
+	queue_work(s3c_jpeg_wq, &s3c_jpeg_work);
+
+	return 0;
+}
+
+static int s3c_jpeg_dequeue_job(struct s5pc110_jpg_ctx *jpg_reg_ctx,
+				struct jpg_job_args __user *arg)
+{
+	struct jpg_job	*job;
+	int		ret = 0;
+
+	spin_lock(&jpg_job_sched.lock);
+	if (list_empty(&jpg_reg_ctx->done_list)) {
+		spin_unlock(&jpg_job_sched.lock);
+		return -EAGAIN;
+	}
+	job = list_first_entry(&jpg_reg_ctx->done_list, struct jpg_job, list);
+	list_del(&job->list);
+	jpg_reg_ctx->job_cnt--;
+	spin_unlock(&jpg_job_sched.lock);
+
+	if (copy_to_user(arg, &job->args, sizeof(struct jpg_job_args)))
+		ret = -EFAULT;
+
+	kfree(job);
+
+	return ret;
+}
+
+static int s3c_jpeg_get_stats(struct jpg_stats __user *arg)
+{
+	struct jpg_stats	stats;
+	u64			avg;
+
+	spin_lock(&jpg_job_sched.lock);
+	stats = jpg_job_stats;
+	if (stats.jobs) {
+		avg = jpg_latency_total;
+		do_div(avg, stats.jobs);
+		stats.latency_avg = (unsigned int)avg;
+		avg = jpg_hw_total;
+		do_div(avg, stats.jobs);
+		stats.hw_avg = (unsigned int)avg;
+	}
+	spin_unlock(&jpg_job_sched.lock);
+
+	if (copy_to_user(arg, &stats, sizeof(struct jpg_stats)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/* drop the queued and finished jobs of a file being released */
+static void s3c_jpeg_flush_jobs(struct s5pc110_jpg_ctx *jpg_reg_ctx)
+{
+	struct jpg_job	*job, *tmp;
+	LIST_HEAD(jobs);
+
+	spin_lock(&jpg_job_sched.lock);
+	list_for_each_entry_safe(job, tmp, &jpg_job_list, list) {
+		if (job->owner == jpg_reg_ctx)
+			list_move_tail(&job->list, &jobs);
+	}
+	spin_unlock(&jpg_job_sched.lock);
+
+	sec_job_sched_wait_owner(&jpg_job_sched, jpg_reg_ctx);
+
+	spin_lock(&jpg_job_sched.lock);
+	list_splice_init(&jpg_reg_ctx->done_list, &jobs);
+	jpg_reg_ctx->job_cnt = 0;
+	spin_unlock(&jpg_job_sched.lock);
+
+	list_for_each_entry_safe(job, tmp, &jobs, list) {
+		list_del(&job->list);
+		kfree(job);
+	}
+}
+
 irqreturn_t s3c_jpeg_irq(int irq, void *dev_id, struct pt_regs *regs)
 {
 	unsigned int	int_status;
@@ -136,6 +499,9 @@ static int s3c_jpeg_open(struct inode *inode, struct file *file)
 		       mem_alloc(sizeof(struct s5pc110_jpg_ctx));
 	memset(jpg_reg_ctx, 0x00, sizeof(struct s5pc110_jpg_ctx));
 
+	INIT_LIST_HEAD(&jpg_reg_ctx->done_list);
+	init_waitqueue_head(&jpg_reg_ctx->done_wait);
+
 	ret = lock_jpg_mutex();
 
 	if (!ret) {
@@ -181,6 +547,8 @@ static int s3c_jpeg_release(struct inode *inode, struct file *file)
 		return FALSE;
 	}
 
+	s3c_jpeg_flush_jobs(jpg_reg_ctx);
+
 	ret = lock_jpg_mutex();
 
 	if (!ret) {
@@ -226,6 +594,20 @@ static int s3c_jpeg_ioctl(struct inode *inode, struct file *file,
 		return FALSE;
 	}
 
+	/* queued jobs take the mutex from the worker */
+	switch (cmd) {
+	case IOCTL_JPG_QUEUE_JOB:
+		return s3c_jpeg_queue_job(jpg_reg_ctx,
+					  (struct jpg_job_args __user *)arg);
+
+	case IOCTL_JPG_DEQUEUE_JOB:
+		return s3c_jpeg_dequeue_job(jpg_reg_ctx,
+					    (struct jpg_job_args __user *)arg);
+
+	case IOCTL_JPG_GET_STATS:
+		return s3c_jpeg_get_stats((struct jpg_stats __user *)arg);
+	}
+
 	ret = lock_jpg_mutex();
 
 	if (!ret) {
@@ -334,11 +716,19 @@ static int s3c_jpeg_ioctl(struct inode *inode, struct file *file,
 
 static unsigned int s3c_jpeg_poll(struct file *file, poll_table *wait)
 {
+	struct s5pc110_jpg_ctx *jpg_reg_ctx = file->private_data;
 	unsigned int mask = 0;
 
 	jpg_dbg("enter poll\n");
 	poll_wait(file, &wait_queue_jpeg, wait);
+	poll_wait(file, &jpg_reg_ctx->done_wait, wait);
 	mask = POLLOUT | POLLWRNORM;
+
+	spin_lock(&jpg_job_sched.lock);
+	if (!list_empty(&jpg_reg_ctx->done_list))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock(&jpg_job_sched.lock);
+
 	return mask;
 }
 
@@ -484,14 +874,16 @@ static int s3c_jpeg_probe(struct platform_device *pdev)
 
 	if (IS_ERR(s3c_jpeg_clk)) {
 		jpg_err("failed to find jpeg clock source\n");
-		return -ENOENT;
+		ret = -ENOENT;
+		goto err_clk;
 	}
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 
 	if (res == NULL) {
 		jpg_err("failed to get memory region resouce\n");
-		return -ENOENT;
+		ret = -ENOENT;
+		goto err_res;
 	}
 
 	size = (res->end - res->start) + 1;
@@ -499,14 +891,16 @@ static int s3c_jpeg_probe(struct platform_device *pdev)
 
 	if (s3c_jpeg_mem == NULL) {
 		jpg_err("failed to get memory region\n");
-		return -ENOENT;
+		ret = -ENOENT;
+		goto err_res;
 	}
 
 	res = platform_get_resource(pdev, IORESOURCE_IRQ, 0);
 
 	if (res == NULL) {
 		jpg_err("failed to get irq resource\n");
-		return -ENOENT;
+		ret = -ENOENT;
+		goto err_irq;
 	}
 
 	irq_no = res->start;
@@ -515,14 +909,15 @@ static int s3c_jpeg_probe(struct platform_device *pdev)
 
 	if (ret != 0) {
 		jpg_err("failed to install irq (%d)\n", ret);
-		return ret;
+		goto err_irq;
 	}
 
 	s3c_jpeg_base = ioremap(s3c_jpeg_mem->start, size);
 
 	if (s3c_jpeg_base == 0) {
 		jpg_err("failed to ioremap() region\n");
-		return -EINVAL;
+		ret = -EINVAL;
+		goto err_map;
 	}
 
 	init_waitqueue_head(&wait_queue_jpeg);
@@ -534,25 +929,57 @@ static int s3c_jpeg_probe(struct platform_device *pdev)
 
 	if (h_mutex == NULL) {
 		jpg_err("JPG Mutex Initialize error\r\n");
-		return FALSE;
+		ret = -ENOMEM;
+		goto err_mutex;
 	}
 
 	ret = lock_jpg_mutex();
 
 	if (!ret) {
 		jpg_err("JPG Mutex Lock Fail\n");
-		return FALSE;
+		ret = -EINVAL;
+		goto err_wq;
 	}
 
 	instanceNo = 0;
 
 	unlock_jpg_mutex();
 
+	s3c_jpeg_wq = create_singlethread_workqueue("s3c-jpeg");
+	if (s3c_jpeg_wq == NULL) {
+		jpg_err("failed to create workqueue\n");
+		ret = -ENOMEM;
+		goto err_wq;
+	}
+	INIT_WORK(&s3c_jpeg_work, s3c_jpeg_job_work);
+
 	ret = misc_register(&s3c_jpeg_miscdev);
+	if (ret) {
+		jpg_err("failed to register misc device (%d)\n", ret);
+		goto err_misc;
+	}
 
 	return 0;
-}
 
+err_misc:
+	destroy_workqueue(s3c_jpeg_wq);
+err_wq:
+	delete_jpg_mutex();
+err_mutex:
+	iounmap(s3c_jpeg_base);
+err_map:
+	free_irq(irq_no, pdev);
+err_irq:
+	release_resource(s3c_jpeg_mem);
+	kfree(s3c_jpeg_mem);
+	s3c_jpeg_mem = NULL;
+err_res:
+	clk_put(s3c_jpeg_clk);
+err_clk:
+	regulator_put(jpeg_pd_regulator);
+
+	return ret;
+}
 static int s3c_jpeg_remove(struct platform_device *dev)
 {
 	if (s3c_jpeg_mem != NULL) {
@@ -563,6 +990,7 @@ static int s3c_jpeg_remove(struct platform_device *dev)
 
 	free_irq(irq_no, dev);
 	misc_deregister(&s3c_jpeg_miscdev);
+	destroy_workqueue(s3c_jpeg_wq);
 	return 0;
 }
 
@@ -28,6 +28,12 @@
 #define IOCTL_JPG_GET_THUMB_FRMBUF		_IO(JPEG_IOCTL_MAGIC, 6)
 #define IOCTL_JPG_GET_PHY_FRMBUF		_IO(JPEG_IOCTL_MAGIC, 7)
 #define IOCTL_JPG_GET_PHY_THUMB_FRMBUF		_IO(JPEG_IOCTL_MAGIC, 8)
+#define IOCTL_JPG_QUEUE_JOB			_IO(JPEG_IOCTL_MAGIC, 9)
+#define IOCTL_JPG_DEQUEUE_JOB			_IO(JPEG_IOCTL_MAGIC, 10)
+#define IOCTL_JPG_GET_STATS			_IO(JPEG_IOCTL_MAGIC, 11)
+
+/* queued jobs (not yet dequeued) per open file */
+#define MAX_QUEUED_JOBS		4
 #define JPG_CLOCK_DIVIDER_RATIO_QUARTER	4
 
 /* Driver Helper function */
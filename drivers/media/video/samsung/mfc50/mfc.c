@@ -59,6 +59,7 @@
 #include "mfc_memory.h"
 #include "mfc_buffer_manager.h"
 #include "mfc_intr.h"
+#include "mfc_sched.h"
 
 #define MFC_FW_NAME	"samsung_mfc_fw.bin"
 
@@ -107,6 +108,7 @@ static int mfc_open(struct inode *inode, struct file *file)
 	}
 
 	memset(mfc_ctx, 0, sizeof(struct mfc_inst_ctx));
+	mfc_sched_init_ctx(mfc_ctx);
 
 	/* get the inst no allocating some part of memory among reserved memory */
 	mfc_ctx->mem_inst_no = mfc_get_mem_inst_no();
@@ -158,9 +160,12 @@ static int mfc_release(struct inode *inode, struct file *file)
 	struct mfc_inst_ctx *mfc_ctx;
 	int ret;
 
+	mfc_ctx = (struct mfc_inst_ctx *)file->private_data;
+	if (mfc_ctx != NULL)
+		mfc_sched_flush_ctx(mfc_ctx);
+
 	mutex_lock(&mfc_mutex);
 
-	mfc_ctx = (struct mfc_inst_ctx *)file->private_data;
 	if (mfc_ctx == NULL) {
 		mfc_err("MFCINST_ERR_INVALID_PARAM\n");
 		ret = -EIO;
@@ -168,7 +173,6 @@ static int mfc_release(struct inode *inode, struct file *file)
 	}
 
 	mfc_release_all_buffer(mfc_ctx->mem_inst_no);
-	mfc_merge_fragment(mfc_ctx->mem_inst_no);
 
 	mfc_return_mem_inst_no(mfc_ctx->mem_inst_no);
 
@@ -199,6 +203,28 @@ out_release:
 	return ret;
 }
 
+/*
+ * Take mfc_mutex for a synchronous ioctl once the queued jobs of the
+ * instance have run, so the ioctl does not overtake them.
+ */
+static int mfc_lock_idle(struct mfc_inst_ctx *mfc_ctx)
+{
+	int ret;
+
+	ret = mfc_sched_wait_ctx(mfc_ctx);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&mfc_mutex);
+	/* another thread queued a job meanwhile */
+	if (mfc_sched_busy(mfc_ctx)) {
+		mutex_unlock(&mfc_mutex);
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
 static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsigned long arg)
 {
 	int ret, ex_ret;
@@ -221,7 +247,11 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 
 	switch (cmd) {
 	case IOCTL_MFC_ENC_INIT:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 
 		if (mfc_set_state(mfc_ctx, MFCINST_STATE_ENC_INITIALIZE) < 0) {
 			mfc_err("MFCINST_ERR_STATE_INVALID\n");
@@ -238,7 +268,11 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 		break;
 
 	case IOCTL_MFC_ENC_EXE:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		if (mfc_ctx->MfcState < MFCINST_STATE_ENC_INITIALIZE) {
 			mfc_err("MFCINST_ERR_STATE_INVALID\n");
 			in_param.ret_code = MFCINST_ERR_STATE_INVALID;
@@ -260,8 +294,51 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 		mutex_unlock(&mfc_mutex);
 		break;
 
-	case IOCTL_MFC_DEC_INIT:
+	case IOCTL_MFC_DEC_EXE_ASYNC:
+		mutex_lock(&mfc_mutex);
+		if (mfc_ctx->MfcState < MFCINST_STATE_DEC_INITIALIZE) {
+			mfc_err("MFCINST_ERR_STATE_INVALID\n");
+			in_param.ret_code = MFCINST_ERR_STATE_INVALID;
+			ret = -EINVAL;
+			mutex_unlock(&mfc_mutex);
+			break;
+		}
+
+		ret = mfc_sched_queue(mfc_ctx, IOCTL_MFC_DEC_EXE, &in_param);
+		in_param.ret_code = (ret < 0) ? MFCAPI_RET_FAIL : MFCINST_RET_OK;
+		mutex_unlock(&mfc_mutex);
+		break;
+
+	case IOCTL_MFC_ENC_EXE_ASYNC:
 		mutex_lock(&mfc_mutex);
+		if (mfc_ctx->MfcState < MFCINST_STATE_ENC_INITIALIZE) {
+			mfc_err("MFCINST_ERR_STATE_INVALID\n");
+			in_param.ret_code = MFCINST_ERR_STATE_INVALID;
+			ret = -EINVAL;
+			mutex_unlock(&mfc_mutex);
+			break;
+		}
+
+		ret = mfc_sched_queue(mfc_ctx, IOCTL_MFC_ENC_EXE, &in_param);
+		in_param.ret_code = (ret < 0) ? MFCAPI_RET_FAIL : MFCINST_RET_OK;
+		mutex_unlock(&mfc_mutex);
+		break;
+
+	case IOCTL_MFC_GET_DONE:
+		/* returns the args of the oldest completed job, see poll() */
+		ret = mfc_sched_dequeue(mfc_ctx, &in_param);
+		if (ret < 0)
+			in_param.ret_code = MFCAPI_RET_FAIL;
+		else
+			ret = in_param.ret_code;
+		break;
+
+	case IOCTL_MFC_DEC_INIT:
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		if (mfc_set_state(mfc_ctx, MFCINST_STATE_DEC_INITIALIZE) < 0) {
 			mfc_err("MFCINST_ERR_STATE_INVALID\n");
 			in_param.ret_code = MFCINST_ERR_STATE_INVALID;
@@ -288,7 +365,11 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 		break;
 
 	case IOCTL_MFC_DEC_EXE:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		if (mfc_ctx->MfcState < MFCINST_STATE_DEC_INITIALIZE) {
 			mfc_err("MFCINST_ERR_STATE_INVALID\n");
 			in_param.ret_code = MFCINST_ERR_STATE_INVALID;
@@ -311,7 +392,11 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 		break;
 
 	case IOCTL_MFC_GET_CONFIG:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		if (mfc_ctx->MfcState < MFCINST_STATE_DEC_INITIALIZE) {
 			mfc_err("MFCINST_ERR_STATE_INVALID\n");
 			in_param.ret_code = MFCINST_ERR_STATE_INVALID;
@@ -326,14 +411,22 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 		break;
 
 	case IOCTL_MFC_SET_CONFIG:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		in_param.ret_code = mfc_set_config(mfc_ctx, &(in_param.args));
 		ret = in_param.ret_code;
 		mutex_unlock(&mfc_mutex);
 		break;
 
 	case IOCTL_MFC_GET_IN_BUF:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		if (mfc_ctx->MfcState < MFCINST_STATE_OPENED) {
 			mfc_err("MFCINST_ERR_STATE_INVALID\n");
 			in_param.ret_code = MFCINST_ERR_STATE_INVALID;
@@ -360,16 +453,20 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 
 		/* allocate stream buf for decoder & current YC buf for encoder */
 		if (is_dec_codec(in_param.args.mem_alloc.codec_type))
-			in_param.ret_code = mfc_allocate_buffer(mfc_ctx, &in_param.args, 0);
+			in_param.ret_code = mfc_allocate_buffer(mfc_ctx, &in_param.args, 0, MFC_ALIGN_STRM);
 		else
-			in_param.ret_code = mfc_allocate_buffer(mfc_ctx, &in_param.args, 1);
+			in_param.ret_code = mfc_allocate_buffer(mfc_ctx, &in_param.args, 1, MFC_ALIGN_DPB);
 
 		ret = in_param.ret_code;
 		mutex_unlock(&mfc_mutex);
 		break;
 
 	case IOCTL_MFC_FREE_BUF:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		if (mfc_ctx->MfcState < MFCINST_STATE_OPENED) {
 			mfc_err("MFCINST_ERR_STATE_INVALID\n");
 			in_param.ret_code = MFCINST_ERR_STATE_INVALID;
@@ -384,7 +481,11 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 		break;
 
 	case IOCTL_MFC_GET_PHYS_ADDR:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		mfc_debug("IOCTL_MFC_GET_PHYS_ADDR\n");
 
 		if (mfc_ctx->MfcState < MFCINST_STATE_OPENED) {
@@ -416,7 +517,11 @@ static int mfc_ioctl(struct inode *inode, struct file *file, unsigned int cmd, u
 		break;
 
        case IOCTL_MFC_BUF_CACHE:
-		mutex_lock(&mfc_mutex);
+		ret = mfc_lock_idle(mfc_ctx);
+		if (ret < 0) {
+			in_param.ret_code = MFCAPI_RET_FAIL;
+			break;
+		}
 		
 		mfc_ctx->buf_type = in_param.args.buf_type;
 
@@ -443,6 +548,44 @@ out_ioctl:
 	return ret;
 }
 
+/*
+ * Run one queued frame job. Called from the scheduler worker with the
+ * same state checks as the synchronous IOCTL_MFC_[DEC|ENC]_EXE.
+ */
+static void mfc_run_job(struct mfc_inst_ctx *mfc_ctx, struct mfc_job *job)
+{
+	struct mfc_common_args *param = &job->args;
+
+	mutex_lock(&mfc_mutex);
+	clk_enable(mfc_sclk);
+
+	if (job->cmd == IOCTL_MFC_DEC_EXE) {
+		if (mfc_set_state(mfc_ctx, MFCINST_STATE_DEC_EXE) < 0) {
+			mfc_err("MFCINST_ERR_STATE_INVALID\n");
+			param->ret_code = MFCINST_ERR_STATE_INVALID;
+		} else {
+			param->ret_code = mfc_exe_decode(mfc_ctx, &param->args);
+		}
+	} else {
+		if (mfc_set_state(mfc_ctx, MFCINST_STATE_ENC_EXE) < 0) {
+			mfc_err("MFCINST_ERR_STATE_INVALID\n");
+			param->ret_code = MFCINST_ERR_STATE_INVALID;
+		} else {
+			param->ret_code = mfc_exe_encode(mfc_ctx, &param->args);
+		}
+	}
+
+	clk_disable(mfc_sclk);
+	mutex_unlock(&mfc_mutex);
+}
+
+static unsigned int mfc_poll(struct file *file, poll_table *wait)
+{
+	struct mfc_inst_ctx *mfc_ctx = (struct mfc_inst_ctx *)file->private_data;
+
+	return mfc_sched_poll(mfc_ctx, file, wait);
+}
+
 static int mfc_mmap(struct file *filp, struct vm_area_struct *vma)
 {
 	unsigned long vir_size = vma->vm_end - vma->vm_start;
@@ -527,6 +670,7 @@ static const struct file_operations mfc_fops = {
 	.open       = mfc_open,
 	.release    = mfc_release,
 	.ioctl      = mfc_ioctl,
+	.poll       = mfc_poll,
 	.mmap       = mfc_mmap
 };
 
@@ -660,6 +804,10 @@ static int mfc_probe(struct platform_device *pdev)
 	mfc_init_mem_inst_no();
 	mfc_init_buffer();
 
+	ret = mfc_sched_init(mfc_run_job);
+	if (ret)
+		goto err_sched_init;
+
 	ret = misc_register(&mfc_miscdev);
 	if (ret) {
 		mfc_err("MFC can't misc register on minor\n");
@@ -687,6 +835,8 @@ static int mfc_probe(struct platform_device *pdev)
 err_req_fw:
 	misc_deregister(&mfc_miscdev);
 err_misc_reg:
+	mfc_sched_exit();
+err_sched_init:
 	clk_put(mfc_sclk);
 err_clk_get:
 	regulator_put(mfc_pd_regulator);
@@ -725,6 +875,8 @@ static int mfc_remove(struct platform_device *pdev)
 
 	misc_deregister(&mfc_miscdev);
 
+	mfc_sched_exit();
+
 	if (mfc_fw_info)
 		release_firmware(mfc_fw_info);
 
@@ -10,6 +10,7 @@
  *   2009.09.14 - use struct list_head for duble linked list
  *   2009.11.04 - get physical address via mfc_allocate_buffer (Key Young, Park)
  *   2009.11.13 - fix free buffer fragmentation (Key Young, Park)
+ *   2010.10.20 - index free mem by address and size, coalesce on free
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 as
@@ -42,14 +43,76 @@
 #include "mfc_memory.h"
 
 static struct list_head mfc_alloc_mem_head[MFC_MAX_PORT_NUM];
-static struct list_head mfc_free_mem_head[MFC_MAX_PORT_NUM];
+
+/*
+ * Free memory of each port is kept in two trees: ordered by address to find
+ * the neighbours of a chunk being freed, and ordered by (size, address) to
+ * find the best fit in O(log n). Freed chunks are merged with their
+ * neighbours immediately, so the free trees never hold adjacent chunks.
+ */
+static struct rb_root mfc_free_addr_root[MFC_MAX_PORT_NUM];
+static struct rb_root mfc_free_size_root[MFC_MAX_PORT_NUM];
+
+/* bytes in use by each instance, per port */
+static unsigned int mfc_inst_mem_size[MFC_MAX_PORT_NUM][MFC_MAX_INSTANCE_NUM];
+
+static void mfc_insert_free_size(struct mfc_free_mem *free_node, int port_no)
+{
+	struct rb_node **p = &mfc_free_size_root[port_no].rb_node;
+	struct rb_node *parent = NULL;
+	struct mfc_free_mem *node;
+
+	while (*p) {
+		parent = *p;
+		node = rb_entry(parent, struct mfc_free_mem, size_node);
+
+		if ((free_node->size < node->size) ||
+			((free_node->size == node->size) &&
+			 (free_node->start_addr < node->start_addr)))
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	rb_link_node(&free_node->size_node, parent, p);
+	rb_insert_color(&free_node->size_node, &mfc_free_size_root[port_no]);
+}
+
+static void mfc_insert_free_mem(struct mfc_free_mem *free_node, int port_no)
+{
+	struct rb_node **p = &mfc_free_addr_root[port_no].rb_node;
+	struct rb_node *parent = NULL;
+	struct mfc_free_mem *node;
+
+	while (*p) {
+		parent = *p;
+		node = rb_entry(parent, struct mfc_free_mem, addr_node);
+
+		if (free_node->start_addr < node->start_addr)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	rb_link_node(&free_node->addr_node, parent, p);
+	rb_insert_color(&free_node->addr_node, &mfc_free_addr_root[port_no]);
+
+	mfc_insert_free_size(free_node, port_no);
+}
+
+static void mfc_erase_free_mem(struct mfc_free_mem *free_node, int port_no)
+{
+	rb_erase(&free_node->addr_node, &mfc_free_addr_root[port_no]);
+	rb_erase(&free_node->size_node, &mfc_free_size_root[port_no]);
+}
 
 void mfc_print_mem_list(void)
 {
 	struct list_head *pos;
+	struct rb_node *rb;
 	struct mfc_alloc_mem *alloc_node;
 	struct mfc_free_mem *free_node;
-	int port_no;
+	int port_no, inst_no;
 
 	for (port_no = 0; port_no < MFC_MAX_PORT_NUM; port_no++) {
 		mfc_info("===== %s port%d list =====\n", __func__,  port_no);
@@ -64,82 +127,100 @@ void mfc_print_mem_list(void)
 					alloc_node->size);
 		}
 
-		list_for_each(pos, &mfc_free_mem_head[port_no])
-		{
-			free_node = list_entry(pos, struct mfc_free_mem, list);
+		for (rb = rb_first(&mfc_free_addr_root[port_no]); rb; rb = rb_next(rb)) {
+			free_node = rb_entry(rb, struct mfc_free_mem, addr_node);
 			mfc_info("[free_list] start_addr: 0x%08x size:%d\n",
 					free_node->start_addr , free_node->size);
 		}
+
+		for (inst_no = 0; inst_no < MFC_MAX_INSTANCE_NUM; inst_no++) {
+			if (mfc_inst_mem_size[port_no][inst_no])
+				mfc_info("[inst_usage] inst_no: %d, size: %d\n",
+					inst_no, mfc_inst_mem_size[port_no][inst_no]);
+		}
 	}
 }
 
-void mfc_merge_fragment(int inst_no)
+/*
+ * Find the smallest free chunk which still holds alloc_size bytes once its
+ * start is aligned. Chunks of equal size are ordered by address, so the
+ * lowest one wins and the upper part of the port is kept in one piece.
+ */
+static struct mfc_free_mem *mfc_find_best_fit(unsigned int alloc_size, unsigned int align, int port_no)
 {
-	struct list_head *pos, *n;
-	struct mfc_free_mem *node1, *node2;
-	int port_no;
+	struct rb_node *rb = mfc_free_size_root[port_no].rb_node;
+	struct rb_node *best = NULL;
+	struct mfc_free_mem *free_node;
+	unsigned int pad;
 
-	for (port_no = 0; port_no < MFC_MAX_PORT_NUM; port_no++) {
-		list_for_each_safe(pos, n, &mfc_free_mem_head[port_no])
-		{
-			node1 = list_entry(pos, struct mfc_free_mem, list);
-			node2 = list_entry(n, struct mfc_free_mem, list);
-			if ((node1->start_addr + node1->size) == node2->start_addr) {
-				node2->start_addr = node1->start_addr;
-				node2->size += node1->size;
-				list_del(&(node1->list));
-				kfree(node1);
-			}
+	while (rb) {
+		free_node = rb_entry(rb, struct mfc_free_mem, size_node);
+
+		if (free_node->size >= alloc_size) {
+			best = rb;
+			rb = rb->rb_left;
+		} else {
+			rb = rb->rb_right;
 		}
 	}
 
-#if defined(DEBUG)
-	mfc_print_mem_list();
-#endif
-}
-
+	for (; best; best = rb_next(best)) {
+		free_node = rb_entry(best, struct mfc_free_mem, size_node);
+		pad = ALIGN(free_node->start_addr, align) - free_node->start_addr;
+		if (free_node->size >= alloc_size + pad)
+			return free_node;
+	}
 
+	return NULL;
+}
 
-static unsigned int mfc_get_free_mem(int alloc_size, int inst_no, int port_no)
+static unsigned int mfc_get_free_mem(unsigned int alloc_size, unsigned int align, int port_no)
 {
-	struct list_head *pos;
-	struct mfc_free_mem *free_node, *match_node = NULL;
-	unsigned int alloc_addr = 0;
+	struct mfc_free_mem *match_node, *tail_node = NULL;
+	unsigned int alloc_addr, pad, tail;
 
-	mfc_debug("request Size : %d\n", alloc_size);
+	mfc_debug("request Size : %d, align : %d\n", alloc_size, align);
 
-	if (list_empty(&mfc_free_mem_head[port_no])) {
+	if (RB_EMPTY_ROOT(&mfc_free_addr_root[port_no])) {
 		mfc_err("all memory is gone\n");
-		return alloc_addr;
+		return 0;
 	}
-	/* find best chunk of memory */
-	list_for_each(pos, &mfc_free_mem_head[port_no])
-	{
-		free_node = list_entry(pos, struct mfc_free_mem, list);
-
-		if (match_node != NULL) {
-			if ((free_node->size >= alloc_size) &&
-				(free_node->size < match_node->size))
-				match_node = free_node;
-		} else {
-			if (free_node->size >= alloc_size)
-				match_node = free_node;
-		}
+
+	match_node = mfc_find_best_fit(alloc_size, align, port_no);
+	if (match_node == NULL) {
+		mfc_err("there is no suitable chunk\n");
+		return 0;
 	}
 
+	mfc_debug("match : startAddr(0x%08x) size(%d)\n", match_node->start_addr, match_node->size);
 
-	if (match_node != NULL) {
-		mfc_debug("match : startAddr(0x%08x) size(%d)\n", match_node->start_addr, match_node->size);
+	alloc_addr = ALIGN(match_node->start_addr, align);
+	pad = alloc_addr - match_node->start_addr;
+	tail = match_node->size - pad - alloc_size;
 
-		alloc_addr = match_node->start_addr;
-		match_node->start_addr += alloc_size;
-		match_node->size -= alloc_size;
+	/* the alignment pad and the tail may both stay free */
+	if (pad && tail) {
+		tail_node = kmalloc(sizeof(struct mfc_free_mem), GFP_KERNEL);
+		if (tail_node == NULL) {
+			mfc_err("There is no more kernel memory\n");
+			return 0;
+		}
+	}
 
-		if (match_node->size < 0x1)	/* delete match_node. */
-			mfc_err("there is no suitable chunk...[case 0]\n");
-	} else {
-		mfc_err("there is no suitable chunk....[case 1]\n");
-		return 0;
+	mfc_erase_free_mem(match_node, port_no);
+
+	if (pad) {
+		match_node->size = pad;
+		mfc_insert_free_mem(match_node, port_no);
+		match_node = tail_node;
+	}
+
+	if (tail) {
+		match_node->start_addr = alloc_addr + alloc_size;
+		match_node->size = tail;
+		mfc_insert_free_mem(match_node, port_no);
+	} else if (!pad) {
+		kfree(match_node);
 	}
 
 	return alloc_addr;
@@ -151,12 +232,19 @@ int mfc_init_buffer(void)
 	struct mfc_free_mem *free_node;
 	int	port_no;
 
+	memset(mfc_inst_mem_size, 0x00, sizeof(mfc_inst_mem_size));
+
 	for (port_no = 0; port_no < MFC_MAX_PORT_NUM; port_no++) {
 		INIT_LIST_HEAD(&mfc_alloc_mem_head[port_no]);
-		INIT_LIST_HEAD(&mfc_free_mem_head[port_no]);
+		mfc_free_addr_root[port_no] = RB_ROOT;
+		mfc_free_size_root[port_no] = RB_ROOT;
 		/* init free head node */
 		free_node =
 			(struct mfc_free_mem *)kmalloc(sizeof(struct mfc_free_mem), GFP_KERNEL);
+		if (!free_node) {
+			mfc_err("There is no more kernel memory");
+			return -ENOMEM;
+		}
 		memset(free_node, 0x00, sizeof(struct mfc_free_mem));
 
 		if (port_no) {
@@ -164,11 +252,11 @@ int mfc_init_buffer(void)
 			free_node->size = mfc_port1_memsize;
 		} else {
 			free_node->start_addr = mfc_get_port0_buff_paddr();
-			free_node->size = mfc_port1_memsize -
+			free_node->size = mfc_port0_memsize -
 				(mfc_get_port0_buff_paddr() - mfc_get_fw_buff_paddr());
 		}
 
-		list_add_tail(&(free_node->list), &mfc_free_mem_head[port_no]);
+		mfc_insert_free_mem(free_node, port_no);
 	}
 
 #if defined(DEBUG)
@@ -228,25 +316,57 @@ void mfc_release_all_buffer(int inst_no)
 
 void mfc_free_alloc_mem(struct mfc_alloc_mem *alloc_node, int port_no)
 {
-	struct list_head *pos;
-	struct mfc_free_mem *free_node;
-	struct mfc_free_mem *target_node;
-
-	free_node = (struct mfc_free_mem *)kmalloc(sizeof(struct mfc_free_mem), GFP_KERNEL);
-	free_node->start_addr = alloc_node->p_addr;
-	free_node->size = alloc_node->size;
+	struct rb_node *rb = mfc_free_addr_root[port_no].rb_node;
+	struct mfc_free_mem *node, *prev = NULL, *next = NULL;
+	unsigned int start_addr = alloc_node->p_addr;
+	unsigned int size = alloc_node->size;
+
+	/* find the free neighbours of the chunk */
+	while (rb) {
+		node = rb_entry(rb, struct mfc_free_mem, addr_node);
+
+		if (start_addr < node->start_addr) {
+			next = node;
+			rb = rb->rb_left;
+		} else {
+			prev = node;
+			rb = rb->rb_right;
+		}
+	}
 
-	list_for_each(pos, &mfc_free_mem_head[port_no])
-	{
-		target_node = list_entry(pos, struct mfc_free_mem, list);
-		if (alloc_node->p_addr < target_node->start_addr)
-			break;
+	if (prev && (prev->start_addr + prev->size != start_addr))
+		prev = NULL;
+	if (next && (start_addr + size != next->start_addr))
+		next = NULL;
+
+	if (prev && next) {
+		mfc_erase_free_mem(next, port_no);
+		rb_erase(&prev->size_node, &mfc_free_size_root[port_no]);
+		prev->size += size + next->size;
+		mfc_insert_free_size(prev, port_no);
+		kfree(next);
+	} else if (prev) {
+		rb_erase(&prev->size_node, &mfc_free_size_root[port_no]);
+		prev->size += size;
+		mfc_insert_free_size(prev, port_no);
+	} else if (next) {
+		/* address order is kept, only the size key changes */
+		rb_erase(&next->size_node, &mfc_free_size_root[port_no]);
+		next->start_addr = start_addr;
+		next->size += size;
+		mfc_insert_free_size(next, port_no);
+	} else {
+		node = (struct mfc_free_mem *)kmalloc(sizeof(struct mfc_free_mem), GFP_KERNEL);
+		if (node) {
+			node->start_addr = start_addr;
+			node->size = size;
+			mfc_insert_free_mem(node, port_no);
+		} else {
+			mfc_err("lost free chunk 0x%08x(%d)\n", start_addr, size);
+		}
 	}
 
-	if (pos == &mfc_free_mem_head[port_no])
-		list_add_tail(&(free_node->list), &(mfc_free_mem_head[port_no]));
-	else
-		list_add_tail(&(free_node->list), pos);
+	mfc_inst_mem_size[port_no][alloc_node->inst_no] -= size;
 
 	list_del(&(alloc_node->list));
 	kfree(alloc_node);
@@ -284,11 +404,11 @@ out_getphysaddr:
 	return ret;
 }
 
-enum mfc_error_code mfc_allocate_buffer(struct mfc_inst_ctx *mfc_ctx, union mfc_args *args, int port_no)
+enum mfc_error_code mfc_allocate_buffer(struct mfc_inst_ctx *mfc_ctx, union mfc_args *args, int port_no, unsigned int align)
 {
 	int ret;
 	int inst_no = mfc_ctx->mem_inst_no;
-	unsigned int start_paddr;
+	unsigned int start_paddr, size;
 	struct mfc_mem_alloc_arg *in_param;
 	struct mfc_alloc_mem *alloc_node;
 
@@ -302,8 +422,11 @@ enum mfc_error_code mfc_allocate_buffer(struct mfc_inst_ctx *mfc_ctx, union mfc_
 	}
 	memset(alloc_node, 0x00, sizeof(struct mfc_alloc_mem));
 
+	/* keep every free chunk on the 2KB MFC address granularity */
+	size = ALIGN(in_param->buff_size, MFC_ALIGN_STRM);
+
 	/* if user request area, allocate from reserved area */
-	start_paddr = mfc_get_free_mem((int)in_param->buff_size, inst_no, port_no);
+	start_paddr = mfc_get_free_mem(size, align, port_no);
 	mfc_debug("start_paddr = 0x%X\n\r", start_paddr);
 
 	if (!start_paddr) {
@@ -335,8 +458,9 @@ enum mfc_error_code mfc_allocate_buffer(struct mfc_inst_ctx *mfc_ctx, union mfc_
 			(unsigned int)alloc_node->v_addr,
 			alloc_node->p_addr);
 
-	alloc_node->size = (int)in_param->buff_size;
+	alloc_node->size = size;
 	alloc_node->inst_no = inst_no;
+	mfc_inst_mem_size[port_no][inst_no] += size;
 
 	list_add(&(alloc_node->list), &mfc_alloc_mem_head[port_no]);
 	ret = MFCINST_RET_OK;
@@ -20,11 +20,19 @@
 #define _MFC_BUFFER_MANAGER_H_
 
 #include <linux/list.h>
+#include <linux/rbtree.h>
 #include "mfc_interface.h"
 #include "mfc_opr.h"
 
 #define MFC_MAX_PORT_NUM 2
 
+/*
+ * Alignment classes. MFC takes buffer addresses in 2KB units, frame (DPB)
+ * and reference buffers are laid out in 8KB aligned planes.
+ */
+#define MFC_ALIGN_STRM		(2 * 1024)	/* stream, context, codec buf */
+#define MFC_ALIGN_DPB		(8 * 1024)	/* frame and reference buf */
+
 /*  Struct Definition */
 struct mfc_alloc_mem  {
 	struct list_head list;     /* strcut list_head for alloc mem        */
@@ -37,7 +45,8 @@ struct mfc_alloc_mem  {
 
 
 struct mfc_free_mem  {
-	struct list_head list;     /* struct list_head for free mem         */
+	struct rb_node addr_node;  /* free mem ordered by address           */
+	struct rb_node size_node;  /* free mem ordered by size, address     */
 	unsigned int start_addr;   /* start address of free mem             */
 	unsigned int size;         /* size of free mem                      */
 };
@@ -46,11 +55,10 @@ struct mfc_free_mem  {
 /* Function Prototype */
 void mfc_print_mem_list(void);
 int mfc_init_buffer(void);
-void mfc_merge_fragment(int inst_no);
 void mfc_release_all_buffer(int inst_no);
 void mfc_free_alloc_mem(struct mfc_alloc_mem *alloc_node, int port_no);
 enum mfc_error_code mfc_release_buffer(unsigned char *u_addr);
 enum mfc_error_code mfc_get_phys_addr(struct mfc_inst_ctx *mfc_ctx, union mfc_args *args);
-enum mfc_error_code mfc_allocate_buffer(struct mfc_inst_ctx *mfc_ctx, union mfc_args *args, int port_no);
+enum mfc_error_code mfc_allocate_buffer(struct mfc_inst_ctx *mfc_ctx, union mfc_args *args, int port_no, unsigned int align);
 
 #endif /* _MFC_BUFFER_MANAGER_H_ */
@@ -26,6 +26,9 @@
 #define IOCTL_MFC_ENC_INIT			0x00800002
 #define IOCTL_MFC_DEC_EXE			0x00800003
 #define IOCTL_MFC_ENC_EXE			0x00800004
+#define IOCTL_MFC_DEC_EXE_ASYNC			0x00800005
+#define IOCTL_MFC_ENC_EXE_ASYNC			0x00800006
+#define IOCTL_MFC_GET_DONE			0x00800007
 
 #define IOCTL_MFC_GET_IN_BUF			0x00800010
 #define IOCTL_MFC_FREE_BUF			0x00800011
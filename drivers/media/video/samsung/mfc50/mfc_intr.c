@@ -49,10 +49,26 @@ struct timeval mfc_wakeup_before;
 struct timeval mfc_wakeup_after;
 #endif
 
+/*
+ * Completion of the command in flight. Only one command is outstanding on
+ * the RISC at a time (callers hold mfc_mutex). mfc_expect_irq() drops any
+ * completion still pending when the next command is issued, so a late
+ * interrupt of a timed out command can no longer complete it. Channel
+ * commands are issued on behalf of an instance, the channel id returned
+ * with their interrupt must match it.
+ */
+struct mfc_irq_ret {
+	bool done;
+	int owner;			/* instance no, -1 for system commands */
+	unsigned int int_type;
+	unsigned int chid;		/* MFC_SI_RTN_CHID of the interrupt */
+};
+
+static struct mfc_irq_ret mfc_irq_ret = { .owner = -1 };
+static int mfc_irq_owner = -1;
 static unsigned int mfc_int_type;
 static unsigned int mfc_disp_err_status;
 static unsigned int mfc_dec_err_status;
-static bool irq_sync;
 static DECLARE_WAIT_QUEUE_HEAD(mfc_wait_queue);
 static DEFINE_SPINLOCK(mfc_irq_lock);
 
@@ -61,9 +77,11 @@ irqreturn_t mfc_irq(int irq, void *dev_id)
 {
 	unsigned int int_reason;
 	unsigned int err_status;
+	unsigned int chid;
 
 	int_reason = READL(MFC_RISC2HOST_COMMAND) & 0x1FFFF;
 	err_status = READL(MFC_RISC2HOST_ARG2);
+	chid = READL(MFC_SI_RTN_CHID);
 
 	mfc_disp_err_status = err_status >> 16;
 	mfc_dec_err_status = err_status & 0xFFFF;
@@ -79,11 +97,14 @@ irqreturn_t mfc_irq(int irq, void *dev_id)
 		((int_reason & R2H_CMD_DECODE_ERR_RET)   == R2H_CMD_DECODE_ERR_RET)        ||
 		((int_reason & R2H_CMD_SLICE_DONE_RET)   == R2H_CMD_SLICE_DONE_RET)        ||
 		((int_reason & R2H_CMD_ERROR_RET) == R2H_CMD_ERROR_RET)) {
-		mfc_int_type = int_reason;
-		irq_sync = true;
+		spin_lock(&mfc_irq_lock);
+		mfc_irq_ret.int_type = int_reason;
+		mfc_irq_ret.chid = chid;
+		mfc_irq_ret.owner = mfc_irq_owner;
+		mfc_irq_ret.done = true;
+		spin_unlock(&mfc_irq_lock);
 		wake_up(&mfc_wait_queue);
 	} else {
-		irq_sync = false;
 		mfc_info("Strange Interrupt !! : %d\n", int_reason);
 	}
 
@@ -105,6 +126,23 @@ void mfc_interrupt_debug(int nCnt)
 	}
 }
 
+/*
+ * Called right before a command is written to the RISC. Drops a stale
+ * completion and records which instance the next interrupt belongs to.
+ */
+void mfc_expect_irq(int inst_no)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mfc_irq_lock, flags);
+	if (mfc_irq_ret.done)
+		mfc_info("Drop stale interrupt (%d) of instance %d\n",
+			mfc_irq_ret.int_type, mfc_irq_ret.owner);
+	mfc_irq_ret.done = false;
+	mfc_irq_owner = inst_no;
+	spin_unlock_irqrestore(&mfc_irq_lock, flags);
+}
+
 int mfc_wait_for_done(enum mfc_wait_done_type command)
 {
 	unsigned int nwait_time = 100;
@@ -156,7 +194,7 @@ int mfc_wait_for_done(enum mfc_wait_done_type command)
 	if (ret_val == 0)
 		printk(KERN_INFO "MFC timeouted!\n");
 #else
-	if (wait_event_timeout(mfc_wait_queue, irq_sync, nwait_time) == 0) {
+	if (wait_event_timeout(mfc_wait_queue, mfc_irq_ret.done, nwait_time) == 0) {
 		ret_val = 0;
 		mfc_err("Interrupt Time Out(Cmd: %d)	(Ver: 0x%08x) (0x64: 0x%08x) (0xF4: 0x%08x) (0x80: 0x%08x)\n", command, READL(0x58), READL(0x64), READL(0xF4), READL(0x80));
 
@@ -166,6 +204,13 @@ int mfc_wait_for_done(enum mfc_wait_done_type command)
 
 		mfc_int_type = 0;
 		return ret_val;
+	}
+
+	mfc_int_type = mfc_irq_ret.int_type;
+	if (mfc_irq_owner >= 0 && (int)mfc_irq_ret.chid != mfc_irq_owner) {
+		mfc_err("Interrupt of channel %d while waiting for instance %d\n",
+			mfc_irq_ret.chid, mfc_irq_owner);
+		mfc_int_type = 0;
 	} else if (mfc_int_type == R2H_CMD_DECODE_ERR_RET) {
 		mfc_err("Decode Error Returned Disp Error Status(%d), Dec Error Status(%d)\n", mfc_disp_err_status, mfc_dec_err_status);
 	} else if (command != mfc_int_type) {
@@ -173,7 +218,7 @@ int mfc_wait_for_done(enum mfc_wait_done_type command)
 	}
 #endif
 	spin_lock_irqsave(&mfc_irq_lock, flags);
-	irq_sync = false;
+	mfc_irq_ret.done = false;
 	spin_unlock_irqrestore(&mfc_irq_lock, flags);
 
 #if defined(MFC_REQUEST_TIME)
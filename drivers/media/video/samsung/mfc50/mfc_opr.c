@@ -223,6 +223,7 @@ static bool mfc_cmd_host2risc(enum mfc_facade_cmd cmd, int arg1, int arg2, int a
 	WRITEL(arg2, MFC_HOST2RISC_ARG2);
 	WRITEL(arg3, MFC_HOST2RISC_ARG3);
 	WRITEL(arg4, MFC_HOST2RISC_ARG4);
+	mfc_expect_irq(-1);
 	WRITEL(cmd, MFC_HOST2RISC_COMMAND);
 
 	return true;
@@ -307,7 +308,7 @@ static enum mfc_error_code mfc_alloc_dec_frame_buffer(struct mfc_inst_ctx *mfc_c
 	local_param.mem_alloc.buff_size = chroma_size;
 	local_param.mem_alloc.mapped_addr = init_arg->in_mapped_addr;
 
-	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 0);
+	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 0, MFC_ALIGN_DPB);
 	if (ret_code < 0)
 		return ret_code;
 
@@ -323,7 +324,7 @@ static enum mfc_error_code mfc_alloc_dec_frame_buffer(struct mfc_inst_ctx *mfc_c
 	local_param.mem_alloc.buff_size = luma_size;
 	local_param.mem_alloc.mapped_addr = init_arg->in_mapped_addr;
 
-	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 1);
+	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 1, MFC_ALIGN_DPB);
 	if (ret_code < 0)
 		return ret_code;
 
@@ -417,7 +418,7 @@ static enum mfc_error_code mfc_alloc_stream_ref_buffer(struct mfc_inst_ctx *mfc_
 	local_param.mem_alloc.buff_size = init_arg->out_buf_size.strm_ref_y;
 	local_param.mem_alloc.mapped_addr = init_arg->in_mapped_addr;
 
-	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 0);
+	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 0, MFC_ALIGN_DPB);
 	if (ret_code < 0)
 		return ret_code;
 
@@ -433,7 +434,7 @@ static enum mfc_error_code mfc_alloc_stream_ref_buffer(struct mfc_inst_ctx *mfc_
 	local_param.mem_alloc.buff_size = init_arg->out_buf_size.mv_ref_yc;
 	local_param.mem_alloc.mapped_addr = init_arg->in_mapped_addr;
 
-	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 1);
+	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 1, MFC_ALIGN_DPB);
 	if (ret_code < 0)
 		return ret_code;
 
@@ -508,7 +509,7 @@ static enum mfc_error_code mfc_alloc_codec_buffer(struct mfc_inst_ctx *mfc_ctx,
 		local_param.mem_alloc.buff_size = ENC_CODEC_BUF_SIZE + SHARED_BUF_SIZE;
 
 	local_param.mem_alloc.mapped_addr = init_arg->in_mapped_addr;
-	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 0);
+	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 0, MFC_ALIGN_STRM);
 	if (ret_code < 0)
 		return ret_code;
 
@@ -525,7 +526,7 @@ static enum mfc_error_code mfc_alloc_codec_buffer(struct mfc_inst_ctx *mfc_ctx,
 		memset(&local_param, 0, sizeof(local_param));
 		local_param.mem_alloc.buff_size = PRED_BUF_SIZE;
 		local_param.mem_alloc.mapped_addr = init_arg->in_mapped_addr;
-		ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 1);
+		ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 1, MFC_ALIGN_STRM);
 		if (ret_code < 0)
 			return ret_code;
 
@@ -837,6 +838,7 @@ enum mfc_error_code mfc_init_hw()
 	/*
 	 * 4. Release reset signal to the RISC.
 	 */
+	mfc_expect_irq(-1);
 	WRITEL(0x3ff, MFC_SW_RESET);
 	nIntrRet = mfc_wait_for_done(R2H_CMD_FW_STATUS_RET);
 	if (nIntrRet != R2H_CMD_FW_STATUS_RET) {
@@ -1135,6 +1137,7 @@ static enum mfc_error_code mfc_encode_header(struct mfc_inst_ctx *mfc_ctx, union
 	/* buf reset command if stream buffer is frame mode */
 	WRITEL(0x1 << 1, MFC_EDFU_SF_BUF_CTRL);
 
+	mfc_expect_irq(mfc_ctx->InstNo);
 	WRITEL((SEQ_HEADER << 16) | (mfc_ctx->InstNo), MFC_SI_CH0_INST_ID);
 	nIntrRet = mfc_wait_for_done(R2H_CMD_SEQ_DONE_RET);
 	nReturnErrCode = mfc_return_code();
@@ -1252,6 +1255,7 @@ static enum mfc_error_code mfc_encode_one_frame(struct mfc_inst_ctx *mfc_ctx, un
 	}
 
 	/* Try frame encoding */
+	mfc_expect_irq(mfc_ctx->InstNo);
 	WRITEL((FRAME << 16) | (mfc_ctx->InstNo), MFC_SI_CH0_INST_ID);
 	interrupt_flag = mfc_wait_for_done(R2H_CMD_FRAME_DONE_RET);
 	nReturnErrCode = mfc_return_code();
@@ -1397,6 +1401,7 @@ enum mfc_error_code mfc_init_decode(struct mfc_inst_ctx *mfc_ctx, union mfc_args
 			MFC_SI_CH0_DPB_CONFIG_CTRL);
 
 	/* Codec Command : Decode a sequence header */
+	mfc_expect_irq(mfc_ctx->InstNo);
 	WRITEL((SEQ_HEADER << 16) | (mfc_ctx->InstNo), MFC_SI_CH0_INST_ID);
 
 	nIntrRet = mfc_wait_for_done(R2H_CMD_SEQ_DONE_RET);
@@ -1513,6 +1518,7 @@ enum mfc_error_code mfc_init_decode(struct mfc_inst_ctx *mfc_ctx, union mfc_args
 
 	mfc_write_shared_mem(mfc_ctx->shared_mem_vaddr, &(mfc_ctx->shared_mem));
 	WRITEL((mfc_ctx->shared_mem_paddr - mfc_port0_base_paddr), MFC_SI_CH0_HOST_WR_ADR);
+	mfc_expect_irq(mfc_ctx->InstNo);
 	WRITEL((INIT_BUFFER << 16) | (mfc_ctx->InstNo), MFC_SI_CH0_INST_ID);
 
 	nIntrRet = mfc_wait_for_done(R2H_CMD_INIT_BUFFERS_RET);
@@ -1616,9 +1622,11 @@ static enum mfc_error_code mfc_decode_one_frame(struct mfc_inst_ctx *mfc_ctx, st
 	mfc_set_dec_stream_buffer(mfc_ctx, dec_arg->in_strm_buf, dec_arg->in_strm_size);
 
 	if (mfc_ctx->endOfFrame) {
+		mfc_expect_irq(mfc_ctx->InstNo);
 		WRITEL((LAST_FRAME<<16) | (mfc_ctx->InstNo), MFC_SI_CH0_INST_ID);
 		mfc_ctx->endOfFrame = 0;
 	} else {
+		mfc_expect_irq(mfc_ctx->InstNo);
 		WRITEL((FRAME<<16) | (mfc_ctx->InstNo), MFC_SI_CH0_INST_ID);
 	}
 
@@ -2083,7 +2091,7 @@ mfc_error_code mfc_alloc_context_buffer(struct mfc_inst_ctx *mfc_ctx, unsigned i
 	local_param.mem_alloc.buff_size = *size;
 	local_param.mem_alloc.mapped_addr = mapped_addr;
 
-	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 0);
+	ret_code = mfc_allocate_buffer(mfc_ctx, &(local_param), 0, MFC_ALIGN_STRM);
 	if (ret_code < 0)
 		return ret_code;
 
@@ -21,6 +21,8 @@
 #ifndef _MFC_OPR_H_
 #define _MFC_OPR_H_
 
+#include <linux/list.h>
+#include <linux/wait.h>
 #include <plat/regs-mfc.h>
 #include "mfc_errorno.h"
 #include "mfc_interface.h"
@@ -178,6 +180,13 @@ struct mfc_inst_ctx {
 	unsigned int IsStartedIFrame;
 	struct mfc_shared_mem shared_mem;
 	mfc_buffer_type buf_type;
+
+	/* asynchronous frame jobs, see mfc_sched.c */
+	struct list_head sched_list;
+	struct list_head job_queue;
+	struct list_head done_queue;
+	unsigned int job_cnt;
+	wait_queue_head_t done_wait;
 };
 
 int mfc_load_firmware(const unsigned char *data, size_t size);
@@ -0,0 +1,215 @@
+/*
+ * drivers/media/video/samsung/mfc50/mfc_sched.c
+ *
+ * C file for Samsung MFC (Multi Function Codec - FIMV) driver
+ *
+ * Copyright (c) 2010 Samsung Electronics
+ * http://www.samsungsemi.com/
+ *
+ * Asynchronous frame job scheduler. Each instance queues decode/encode
+ * jobs with IOCTL_MFC_[DEC|ENC]_EXE_ASYNC and collects results with
+ * IOCTL_MFC_GET_DONE once poll() reports them. A single worker feeds the
+ * codec from all instances in round robin order, so a decode and an
+ * encode session no longer wait for a userspace round trip between their
+ * commands.
+ *
+ * Jobs of one instance run in the order they were queued. The synchronous
+ * ioctls of an instance (init, config, buffers, the blocking EXE) wait
+ * with mfc_sched_wait_ctx() until its queued jobs have run, so they never
+ * overtake a frame submitted before them.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/errno.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+
+#include "../sec_job_sched.h"
+#include "mfc_logmsg.h"
+#include "mfc_sched.h"
+
+/* instances with queued jobs, in service order */
+static LIST_HEAD(mfc_sched_ready);
+static DEFINE_SEC_JOB_SCHED(mfc_sched);
+
+static struct workqueue_struct *mfc_sched_wq;
+static struct work_struct mfc_sched_work;
+static mfc_sched_run_t mfc_sched_run;
+
+static void mfc_sched_worker(struct work_struct *work)
+{
+	struct mfc_inst_ctx *mfc_ctx;
+	struct mfc_job *job;
+
+	spin_lock(&mfc_sched.lock);
+	while (!list_empty(&mfc_sched_ready)) {
+		mfc_ctx = list_first_entry(&mfc_sched_ready, struct mfc_inst_ctx, sched_list);
+		job = list_first_entry(&mfc_ctx->job_queue, struct mfc_job, list);
+		list_del(&job->list);
+
+		/* round robin: move the instance behind the others */
+		list_del_init(&mfc_ctx->sched_list);
+		if (!list_empty(&mfc_ctx->job_queue))
+			list_add_tail(&mfc_ctx->sched_list, &mfc_sched_ready);
+
+		sec_job_sched_start(&mfc_sched, mfc_ctx);
+
+		mfc_sched_run(mfc_ctx, job);
+
+		/* the context may go away once it is not running anymore */
+		spin_lock(&mfc_sched.lock);
+		list_add_tail(&job->list, &mfc_ctx->done_queue);
+		wake_up_interruptible(&mfc_ctx->done_wait);
+		sec_job_sched_finish(&mfc_sched);
+
+		spin_lock(&mfc_sched.lock);
+	}
+	spin_unlock(&mfc_sched.lock);
+}
+
+/* Nonzero while jobs of the instance are queued or running */
+int mfc_sched_busy(struct mfc_inst_ctx *mfc_ctx)
+{
+	int busy;
+
+	spin_lock(&mfc_sched.lock);
+	busy = !list_empty(&mfc_ctx->job_queue) || mfc_sched.running == mfc_ctx;
+	spin_unlock(&mfc_sched.lock);
+
+	return busy;
+}
+
+/*
+ * Wait until the queued jobs of an instance have run. Must be called
+ * without mfc_mutex, as the jobs take it.
+ */
+int mfc_sched_wait_ctx(struct mfc_inst_ctx *mfc_ctx)
+{
+	return wait_event_interruptible(mfc_sched.idle, !mfc_sched_busy(mfc_ctx));
+}
+
+void mfc_sched_init_ctx(struct mfc_inst_ctx *mfc_ctx)
+{
+	INIT_LIST_HEAD(&mfc_ctx->sched_list);
+	INIT_LIST_HEAD(&mfc_ctx->job_queue);
+	INIT_LIST_HEAD(&mfc_ctx->done_queue);
+	mfc_ctx->job_cnt = 0;
+	init_waitqueue_head(&mfc_ctx->done_wait);
+}
+
+/*
+ * Drop all jobs of an instance which is being released. Must be called
+ * without mfc_mutex, as the job in progress may be waiting for it.
+ */
+void mfc_sched_flush_ctx(struct mfc_inst_ctx *mfc_ctx)
+{
+	struct mfc_job *job, *tmp;
+	LIST_HEAD(jobs);
+
+	spin_lock(&mfc_sched.lock);
+	list_del_init(&mfc_ctx->sched_list);
+	list_splice_init(&mfc_ctx->job_queue, &jobs);
+	spin_unlock(&mfc_sched.lock);
+
+	sec_job_sched_wait_owner(&mfc_sched, mfc_ctx);
+
+	spin_lock(&mfc_sched.lock);
+	list_splice_init(&mfc_ctx->done_queue, &jobs);
+	mfc_ctx->job_cnt = 0;
+	spin_unlock(&mfc_sched.lock);
+
+	list_for_each_entry_safe(job, tmp, &jobs, list) {
+		list_del(&job->list);
+		kfree(job);
+	}
+}
+
+int mfc_sched_queue(struct mfc_inst_ctx *mfc_ctx, unsigned int cmd, struct mfc_common_args *args)
+{
+	struct mfc_job *job;
+
+	job = kmalloc(sizeof(struct mfc_job), GFP_KERNEL);
+	if (job == NULL)
+		return -ENOMEM;
+
+	job->cmd = cmd;
+	job->args = *args;
+
+	spin_lock(&mfc_sched.lock);
+	if (mfc_ctx->job_cnt >= MFC_MAX_QUEUED_JOBS) {
+		spin_unlock(&mfc_sched.lock);
+		kfree(job);
+		return -EBUSY;
+	}
+
+	mfc_ctx->job_cnt++;
+	list_add_tail(&job->list, &mfc_ctx->job_queue);
+	if (list_empty(&mfc_ctx->sched_list))
+		list_add_tail(&mfc_ctx->sched_list, &mfc_sched_ready);
+	spin_unlock(&mfc_sched.lock);
+
+	queue_work(mfc_sched_wq, &mfc_sched_work);
+
+	return 0;
+}
+
+/* Results are returned in the order the jobs were queued */
+int mfc_sched_dequeue(struct mfc_inst_ctx *mfc_ctx, struct mfc_common_args *args)
+{
+	struct mfc_job *job;
+
+	spin_lock(&mfc_sched.lock);
+	if (list_empty(&mfc_ctx->done_queue)) {
+		spin_unlock(&mfc_sched.lock);
+		return -EAGAIN;
+	}
+
+	job = list_first_entry(&mfc_ctx->done_queue, struct mfc_job, list);
+	list_del(&job->list);
+	mfc_ctx->job_cnt--;
+	spin_unlock(&mfc_sched.lock);
+
+	*args = job->args;
+	kfree(job);
+
+	return 0;
+}
+
+unsigned int mfc_sched_poll(struct mfc_inst_ctx *mfc_ctx, struct file *file, poll_table *wait)
+{
+	unsigned int mask = 0;
+
+	poll_wait(file, &mfc_ctx->done_wait, wait);
+
+	spin_lock(&mfc_sched.lock);
+	if (!list_empty(&mfc_ctx->done_queue))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock(&mfc_sched.lock);
+
+	return mask;
+}
+
+int mfc_sched_init(mfc_sched_run_t run)
+{
+	mfc_sched_wq = create_singlethread_workqueue("mfc_sched");
+	if (mfc_sched_wq == NULL) {
+		mfc_err("failed to create workqueue\n");
+		return -ENOMEM;
+	}
+
+	INIT_WORK(&mfc_sched_work, mfc_sched_worker);
+	mfc_sched_run = run;
+
+	return 0;
+}
+
+void mfc_sched_exit(void)
+{
+	destroy_workqueue(mfc_sched_wq);
+}
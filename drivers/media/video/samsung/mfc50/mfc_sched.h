@@ -0,0 +1,43 @@
+/*
+ * drivers/media/video/samsung/mfc50/mfc_sched.h
+ *
+ * Header file for Samsung MFC (Multi Function Codec - FIMV) driver
+ *
+ * Copyright (c) 2010 Samsung Electronics
+ * http://www.samsungsemi.com/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _MFC_SCHED_H_
+#define _MFC_SCHED_H_
+
+#include <linux/list.h>
+#include <linux/poll.h>
+#include "mfc_interface.h"
+#include "mfc_opr.h"
+
+/* Maximum number of queued and not yet dequeued jobs per instance */
+#define MFC_MAX_QUEUED_JOBS	8
+
+struct mfc_job {
+	struct list_head list;
+	unsigned int cmd;		/* IOCTL_MFC_DEC_EXE or IOCTL_MFC_ENC_EXE */
+	struct mfc_common_args args;
+};
+
+typedef void (*mfc_sched_run_t)(struct mfc_inst_ctx *mfc_ctx, struct mfc_job *job);
+
+int mfc_sched_init(mfc_sched_run_t run);
+void mfc_sched_exit(void);
+void mfc_sched_init_ctx(struct mfc_inst_ctx *mfc_ctx);
+void mfc_sched_flush_ctx(struct mfc_inst_ctx *mfc_ctx);
+int mfc_sched_busy(struct mfc_inst_ctx *mfc_ctx);
+int mfc_sched_wait_ctx(struct mfc_inst_ctx *mfc_ctx);
+int mfc_sched_queue(struct mfc_inst_ctx *mfc_ctx, unsigned int cmd, struct mfc_common_args *args);
+int mfc_sched_dequeue(struct mfc_inst_ctx *mfc_ctx, struct mfc_common_args *args);
+unsigned int mfc_sched_poll(struct mfc_inst_ctx *mfc_ctx, struct file *file, poll_table *wait);
+
+#endif /* _MFC_SCHED_H_ */
@@ -0,0 +1,91 @@
+/* linux/drivers/media/video/samsung/sec_job_sched.h
+ *
+ * Job bookkeeping shared by the MFC, G2D and JPEG drivers
+ *
+ * Copyright (c) 2010 Samsung Electronics
+ * 	http://www.samsungsemi.com/
+ *
+ * Each of these drivers feeds its hardware from a single worker, which
+ * takes jobs off a queue protected by the lock below and runs them one
+ * at a time. The owner of the job in progress is kept here, so that a
+ * file being released can drop its queued jobs and then wait with
+ * sec_job_sched_wait_owner() until the worker no longer uses it.
+ *
+ * The worker loop looks like:
+ *
+ *	spin_lock(&sched->lock);
+ *	while (job = next queued job) {
+ *		sec_job_sched_start(sched, job->owner);	(drops the lock)
+ *		run the job;
+ *		spin_lock(&sched->lock);
+ *		hand the result to the owner and wake it;
+ *		sec_job_sched_finish(sched);		(drops the lock)
+ *		spin_lock(&sched->lock);
+ *	}
+ *	spin_unlock(&sched->lock);
+ *
+ * The owner must be woken before sec_job_sched_finish(), after which it
+ * may be freed.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+*/
+
+#ifndef __SEC_JOB_SCHED_H
+#define __SEC_JOB_SCHED_H
+
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+struct sec_job_sched {
+	spinlock_t		lock;		/* queues of the driver */
+	void			*running;	/* owner of the job in progress */
+	wait_queue_head_t	idle;		/* woken when a job is done */
+};
+
+#define DEFINE_SEC_JOB_SCHED(name)					\
+	struct sec_job_sched name = {					\
+		.lock		= __SPIN_LOCK_UNLOCKED(name.lock),	\
+		.running	= NULL,					\
+		.idle		= __WAIT_QUEUE_HEAD_INITIALIZER(name.idle), \
+	}
+
+/* Called with sched->lock held, returns with it released */
+static inline void sec_job_sched_start(struct sec_job_sched *sched,
+				       void *owner)
+{
+	sched->running = owner;
+	spin_unlock(&sched->lock);
+}
+
+/* Called with sched->lock held, returns with it released */
+static inline void sec_job_sched_finish(struct sec_job_sched *sched)
+{
+	sched->running = NULL;
+	spin_unlock(&sched->lock);
+
+	wake_up(&sched->idle);
+}
+
+static inline bool sec_job_sched_running(struct sec_job_sched *sched,
+					 void *owner)
+{
+	bool running;
+
+	spin_lock(&sched->lock);
+	running = (sched->running == owner);
+	spin_unlock(&sched->lock);
+
+	return running;
+}
+
+/* Waits until no job of the owner is in progress */
+static inline void sec_job_sched_wait_owner(struct sec_job_sched *sched,
+					    void *owner)
+{
+	wait_event(sched->idle, !sec_job_sched_running(sched, owner));
+}
+
+#endif /* __SEC_JOB_SCHED_H */
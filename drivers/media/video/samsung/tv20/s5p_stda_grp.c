@@ -134,6 +134,29 @@ bool _s5p_grp_stop(enum s5p_tv_vmx_layer vm_layer)
 	return true;
 }
 
+#ifdef CONFIG_CPU_S5PV210
+/*
+ * register values for the current overlay parameters, written by the
+ * atomic layer update at the next mixer vsync
+ */
+void _s5p_grp_get_regs(enum s5p_tv_vmx_layer vm_layer,
+			struct s5p_layer_regs *regs)
+{
+	struct s5p_tv_vo *vo = &s5ptv_overlay[vm_layer];
+
+	regs->dirty = s5ptv_status.grp_layer_enable[vm_layer];
+	regs->alpha = vo->win.global_alpha;
+	regs->base_addr = vo->base_addr;
+	regs->span = vo->fb.fmt.bytesperline;
+	regs->width = vo->win.w.width;
+	regs->height = vo->win.w.height;
+	regs->src_offset_x = vo->win.w.left;
+	regs->src_offset_y = vo->win.w.top;
+	regs->dest_offset_x = vo->dst_rect.left;
+	regs->dest_offset_y = vo->dst_rect.top;
+}
+#endif
+
 int s5ptvfb_set_output(struct s5p_tv_status *ctrl) { return 0; }
 
 int s5ptvfb_set_display_mode(struct s5p_tv_status *ctrl)
@@ -0,0 +1,450 @@
+/* linux/drivers/media/video/samsung/tv20/s5p_stda_layers.c
+ *
+ * Atomic layer update ftn. file for Samsung TVOut driver
+ *
+ * Copyright (c) 2010 Samsung Electronics
+ * 	http://www.samsungsemi.com/
+ *
+ * VIDIOC_S_TV_LAYERS changes the buffer, window and alpha of several
+ * layers in one call. The mixer shadow registers are held while the new
+ * values are written and released right after the VP shadow update is
+ * requested, so the video and graphic layers latch at the same vsync.
+ *
+ * The mixer vsync interrupt is only enabled while an update is in flight.
+ * It marks the programmed update as applied, stamps it, and programs the
+ * update queued behind it. Updates queued while another one is waiting
+ * for its vsync are merged, the newest parameters of each layer win.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+*/
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+
+#include "s5p_tv.h"
+
+#ifdef COFIG_TVOUT_DBG
+#define S5P_LAYERS_DEBUG 1
+#endif
+
+#ifdef S5P_LAYERS_DEBUG
+#define LAYERSPRINTK(fmt, args...) \
+	printk(KERN_INFO "\t[LAYERS] %s: " fmt, __func__ , ## args)
+#else
+#define LAYERSPRINTK(fmt, args...)
+#endif
+
+/* a few frames even at 24Hz */
+#define S5P_LAYERS_WAIT_MS	200
+
+struct s5p_layers_update {
+	u32			sequence;
+	ktime_t			queued;
+	struct s5p_layer_regs	regs[V4L2_TV_LAYERS_MAX];
+};
+
+struct s5p_layers_ctx {
+	spinlock_t		lock;
+	wait_queue_head_t	wait;
+	bool			vsync_on;
+
+	u32			sequence;	/* last queued */
+	u32			applied;	/* last latched */
+
+	bool			has_pending;
+	bool			has_programmed;
+	bool			skip_vsync;
+	struct s5p_layers_update pending;
+	struct s5p_layers_update programmed;
+
+	struct v4l2_tv_layers_stamp stamp[V4L2_TV_LAYERS_STAMPS];
+	unsigned int		stamp_head;
+	unsigned int		stamp_count;
+	u32			vsyncs;
+	u32			merged;
+};
+
+static struct s5p_layers_ctx s5p_layers;
+
+static void _s5p_layers_write(struct s5p_layers_update *up)
+{
+	struct s5p_layer_regs *regs;
+	int i;
+
+	__s5p_vm_set_shadow_update(false);
+
+	for (i = VM_GPR0_LAYER; i <= VM_GPR1_LAYER; i++) {
+		regs = &up->regs[i];
+
+		if (!regs->dirty)
+			continue;
+
+		__s5p_vm_set_grp_base_address(i, regs->base_addr);
+		__s5p_vm_set_grp_layer_window(i, regs->span,
+			regs->width, regs->height,
+			regs->src_offset_x, regs->src_offset_y);
+		__s5p_vm_set_grp_layer_position(i, regs->dest_offset_x,
+			regs->dest_offset_y);
+		__s5p_vm_set_layer_alpha(i, regs->alpha);
+	}
+
+	regs = &up->regs[VM_VIDEO_LAYER];
+
+	if (regs->dirty) {
+		__s5p_vp_set_top_field_address(regs->top_y_address,
+			regs->top_c_address);
+
+		if (regs->interlaced)
+			__s5p_vp_set_bottom_field_address(
+				regs->bottom_y_address,
+				regs->bottom_c_address);
+
+		__s5p_vp_set_src_position(regs->src_offset_x,
+			regs->src_x_fact_step, regs->src_offset_y);
+		__s5p_vp_set_dest_position(regs->dest_offset_x,
+			regs->dest_offset_y);
+		__s5p_vp_set_src_dest_size(regs->src_width, regs->src_height,
+			regs->dest_width, regs->dest_height, regs->ipc);
+		__s5p_vm_set_layer_alpha(VM_VIDEO_LAYER, regs->alpha);
+
+		__s5p_vp_update();
+	}
+
+	__s5p_vm_set_shadow_update(true);
+}
+
+/* called with s5p_layers.lock held */
+static void _s5p_layers_program(struct s5p_layers_ctx *ctx)
+{
+	ctx->programmed = ctx->pending;
+	ctx->has_programmed = true;
+	ctx->has_pending = false;
+	memset(ctx->pending.regs, 0, sizeof(ctx->pending.regs));
+
+	_s5p_layers_write(&ctx->programmed);
+}
+
+/* called with s5p_layers.lock held */
+static void _s5p_layers_complete(struct s5p_layers_ctx *ctx,
+				 struct s5p_layers_update *up, ktime_t now)
+{
+	struct v4l2_tv_layers_stamp *stamp = &ctx->stamp[ctx->stamp_head];
+
+	stamp->sequence = up->sequence;
+	stamp->queued = ktime_to_timeval(up->queued);
+	stamp->applied = ktime_to_timeval(now);
+
+	ctx->stamp_head = (ctx->stamp_head + 1) % V4L2_TV_LAYERS_STAMPS;
+	if (ctx->stamp_count < V4L2_TV_LAYERS_STAMPS)
+		ctx->stamp_count++;
+
+	ctx->applied = up->sequence;
+
+	wake_up_interruptible(&ctx->wait);
+}
+
+static void _s5p_layers_vsync(void)
+{
+	struct s5p_layers_ctx *ctx = &s5p_layers;
+
+	spin_lock(&ctx->lock);
+
+	ctx->vsyncs++;
+
+	if (ctx->has_programmed) {
+		if (ctx->skip_vsync) {
+			ctx->skip_vsync = false;
+		} else {
+			_s5p_layers_complete(ctx, &ctx->programmed,
+					     ktime_get());
+			ctx->has_programmed = false;
+		}
+	}
+
+	if (!ctx->has_programmed && ctx->has_pending)
+		_s5p_layers_program(ctx);
+
+	if (!ctx->has_programmed && ctx->vsync_on) {
+		__s5p_vm_set_vsync_interrupt_enable(false);
+		ctx->vsync_on = false;
+	}
+
+	spin_unlock(&ctx->lock);
+}
+
+static int _s5p_layers_check(struct v4l2_tv_layer *layer)
+{
+	switch (layer->layer) {
+
+	case V4L2_TV_LAYER_GRP0:
+	case V4L2_TV_LAYER_GRP1:
+		if ((layer->flags & V4L2_TV_LAYER_ADDR) &&
+		    (layer->y_addr & 0x3))
+			return -EINVAL;
+		break;
+
+	case V4L2_TV_LAYER_VIDEO:
+		if ((layer->flags & V4L2_TV_LAYER_ADDR) &&
+		    ((layer->y_addr | layer->c_addr) & 0x7))
+			return -EINVAL;
+
+		/* halved for interlaced output, then divides the ratio */
+		if ((layer->flags & V4L2_TV_LAYER_DST) &&
+		    (layer->dst.width < 2 || layer->dst.height < 2))
+			return -EINVAL;
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	if (layer->flags & V4L2_TV_LAYER_SRC) {
+		if (layer->src.left < 0 || layer->src.top < 0 ||
+		    layer->src.width == 0 || layer->src.height == 0)
+			return -EINVAL;
+	}
+
+	if (layer->flags & V4L2_TV_LAYER_DST) {
+		if (layer->dst.left < 0 || layer->dst.top < 0)
+			return -EINVAL;
+	}
+
+	if ((layer->flags & V4L2_TV_LAYER_ALPHA) && layer->alpha > 0xff)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void _s5p_layers_set_grp(struct v4l2_tv_layer *layer)
+{
+	struct s5p_tv_vo *vo = &s5ptv_overlay[layer->layer];
+
+	if (layer->flags & V4L2_TV_LAYER_ADDR)
+		vo->base_addr = layer->y_addr;
+
+	if (layer->flags & V4L2_TV_LAYER_SRC) {
+		vo->win.w.left = layer->src.left;
+		vo->win.w.top = layer->src.top;
+		vo->win.w.width = layer->src.width;
+		vo->win.w.height = layer->src.height;
+	}
+
+	if (layer->flags & V4L2_TV_LAYER_DST) {
+		vo->dst_rect.left = layer->dst.left;
+		vo->dst_rect.top = layer->dst.top;
+	}
+
+	if (layer->flags & V4L2_TV_LAYER_ALPHA)
+		vo->win.global_alpha = layer->alpha;
+}
+
+static void _s5p_layers_set_video(struct v4l2_tv_layer *layer)
+{
+	struct s5p_vl_param *video = &s5ptv_status.vl_basic_param;
+
+	if (layer->flags & V4L2_TV_LAYER_ADDR) {
+		video->top_y_address = layer->y_addr;
+		video->top_c_address = layer->c_addr;
+	}
+
+	if (layer->flags & V4L2_TV_LAYER_SRC) {
+		video->src_offset_x = layer->src.left;
+		video->src_offset_y = layer->src.top;
+		video->src_width = layer->src.width;
+		video->src_height = layer->src.height;
+	}
+
+	if (layer->flags & V4L2_TV_LAYER_DST) {
+		video->dest_offset_x = layer->dst.left;
+		video->dest_offset_y = layer->dst.top;
+		video->dest_width = layer->dst.width;
+		video->dest_height = layer->dst.height;
+	}
+
+	if (layer->flags & V4L2_TV_LAYER_ALPHA)
+		video->alpha = layer->alpha;
+}
+
+int _s5p_layers_update(struct v4l2_tv_layers *layers)
+{
+	struct s5p_layers_ctx *ctx = &s5p_layers;
+	struct s5p_layer_regs regs[V4L2_TV_LAYERS_MAX];
+	struct s5p_layers_update now_up;
+	bool touched[V4L2_TV_LAYERS_MAX];
+	unsigned long flags;
+	ktime_t now;
+	u32 seq;
+	long ret;
+	int i;
+
+	if (layers->count > V4L2_TV_LAYERS_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < layers->count; i++) {
+		ret = _s5p_layers_check(&layers->layer[i]);
+
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * Keep the software state in step, so a later stream on or one of
+	 * the single parameter ioctls starts from the new values.
+	 */
+	memset(touched, 0, sizeof(touched));
+
+	for (i = 0; i < layers->count; i++) {
+		if (layers->layer[i].layer == V4L2_TV_LAYER_VIDEO)
+			_s5p_layers_set_video(&layers->layer[i]);
+		else
+			_s5p_layers_set_grp(&layers->layer[i]);
+
+		touched[layers->layer[i].layer] = true;
+	}
+
+	memset(regs, 0, sizeof(regs));
+
+	for (i = VM_GPR0_LAYER; i <= VM_GPR1_LAYER; i++) {
+		if (touched[i])
+			_s5p_grp_get_regs(i, &regs[i]);
+	}
+
+	if (touched[VM_VIDEO_LAYER])
+		_s5p_vlayer_get_regs(&regs[VM_VIDEO_LAYER]);
+
+	now = ktime_get();
+
+	spin_lock_irqsave(&ctx->lock, flags);
+
+	seq = ++ctx->sequence;
+	layers->sequence = seq;
+
+	if (!s5ptv_status.tvout_output_enable) {
+		/* nothing on screen, the next start programs the new values */
+		now_up.sequence = seq;
+		now_up.queued = now;
+		_s5p_layers_complete(ctx, &now_up, now);
+		spin_unlock_irqrestore(&ctx->lock, flags);
+
+		return 0;
+	}
+
+	if (ctx->has_pending)
+		ctx->merged++;
+
+	for (i = 0; i < V4L2_TV_LAYERS_MAX; i++) {
+		if (regs[i].dirty)
+			ctx->pending.regs[i] = regs[i];
+	}
+
+	ctx->pending.sequence = seq;
+	ctx->pending.queued = now;
+	ctx->has_pending = true;
+
+	if (!ctx->vsync_on) {
+		__s5p_vm_set_vsync_interrupt_enable(true);
+		ctx->vsync_on = true;
+	}
+
+	/*
+	 * Program it right away unless the previous update still waits for
+	 * its vsync, or a vsync is about to be handled and would take this
+	 * one for the previous.
+	 */
+	if (!ctx->has_programmed && !__s5p_vm_get_vsync_status()) {
+		_s5p_layers_program(ctx);
+
+		/* a vsync hit while the shadow registers were held */
+		ctx->skip_vsync = __s5p_vm_get_vsync_status();
+	}
+
+	spin_unlock_irqrestore(&ctx->lock, flags);
+
+	LAYERSPRINTK("update %u queued\n\r", seq);
+
+	if (!(layers->flags & V4L2_TV_LAYERS_WAIT))
+		return 0;
+
+	ret = wait_event_interruptible_timeout(ctx->wait,
+			(s32)(ctx->applied - seq) >= 0,
+			msecs_to_jiffies(S5P_LAYERS_WAIT_MS));
+
+	if (ret == 0)
+		return -ETIMEDOUT;
+
+	return (ret < 0) ? ret : 0;
+}
+
+void _s5p_layers_get_status(struct v4l2_tv_layers_status *status)
+{
+	struct s5p_layers_ctx *ctx = &s5p_layers;
+	unsigned long flags;
+	unsigned int i, idx;
+
+	memset(status, 0, sizeof(*status));
+
+	spin_lock_irqsave(&ctx->lock, flags);
+
+	status->sequence = ctx->sequence;
+	status->applied = ctx->applied;
+	status->vsyncs = ctx->vsyncs;
+	status->merged = ctx->merged;
+	status->count = ctx->stamp_count;
+
+	for (i = 0; i < ctx->stamp_count; i++) {
+		idx = (ctx->stamp_head + V4L2_TV_LAYERS_STAMPS - 1 - i) %
+			V4L2_TV_LAYERS_STAMPS;
+		status->stamp[i] = ctx->stamp[idx];
+	}
+
+	spin_unlock_irqrestore(&ctx->lock, flags);
+}
+
+/*
+ * The output is about to stop: the mixer will not raise another vsync,
+ * so whatever is in flight is done. The software state already holds it
+ * for the next start.
+ */
+void _s5p_layers_stop(void)
+{
+	struct s5p_layers_ctx *ctx = &s5p_layers;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+
+	spin_lock_irqsave(&ctx->lock, flags);
+
+	if (ctx->vsync_on) {
+		__s5p_vm_set_vsync_interrupt_enable(false);
+		ctx->vsync_on = false;
+	}
+
+	if (ctx->has_pending)
+		_s5p_layers_complete(ctx, &ctx->pending, now);
+	else if (ctx->has_programmed)
+		_s5p_layers_complete(ctx, &ctx->programmed, now);
+
+	ctx->has_pending = false;
+	ctx->has_programmed = false;
+	ctx->skip_vsync = false;
+	memset(ctx->pending.regs, 0, sizeof(ctx->pending.regs));
+
+	spin_unlock_irqrestore(&ctx->lock, flags);
+}
+
+void _s5p_layers_init(void)
+{
+	struct s5p_layers_ctx *ctx = &s5p_layers;
+
+	spin_lock_init(&ctx->lock);
+	init_waitqueue_head(&ctx->wait);
+
+	__s5p_vm_register_vsync_isr(_s5p_layers_vsync);
+}
@@ -1068,6 +1068,9 @@ bool _s5p_tv_if_stop(void)
 
 	TVOUTIFPRINTK("tvout sub sys. stopped!!\n");
 
+#ifdef CONFIG_CPU_S5PV210
+	_s5p_layers_stop();
+#endif
 	__s5p_vm_stop();
 
 	switch (out_mode) {
@@ -316,6 +316,37 @@ bool _s5p_vlayer_stop(void)
 	return true;
 }
 
+#ifdef CONFIG_CPU_S5PV210
+/*
+ * register values for the current video layer parameters, written by the
+ * atomic layer update at the next mixer vsync
+ */
+void _s5p_vlayer_get_regs(struct s5p_layer_regs *regs)
+{
+	struct s5p_tv_status *st = &s5ptv_status;
+
+	_s5p_vlayer_calc_inner_values();
+
+	regs->dirty = st->vp_layer_enable;
+	regs->alpha = st->vl_basic_param.alpha;
+	regs->interlaced = (check_input_mode(st->src_color) == INTERLACED);
+	regs->top_y_address = st->vl_top_y_address;
+	regs->top_c_address = st->vl_top_c_address;
+	regs->bottom_y_address = st->vl_bottom_y_address;
+	regs->bottom_c_address = st->vl_bottom_c_address;
+	regs->src_offset_x = st->vl_src_offset_x;
+	regs->src_x_fact_step = st->vl_src_x_fact_step;
+	regs->src_offset_y = st->vl_src_offset_y;
+	regs->src_width = st->vl_src_width;
+	regs->src_height = st->vl_src_height;
+	regs->dest_offset_x = st->vl_dest_offset_x;
+	regs->dest_offset_y = st->vl_dest_offset_y;
+	regs->dest_width = st->vl_dest_width;
+	regs->dest_height = st->vl_dest_height;
+	regs->ipc = st->vl2d_ipc;
+}
+#endif
+
 
 bool _s5p_vlayer_set_priority(unsigned long buf_in)
 {
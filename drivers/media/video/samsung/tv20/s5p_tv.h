@@ -448,6 +448,35 @@ struct s5ptvfb_lcd {
 	void 	(*init_ldi)(void);
 };
 
+/* register values of one layer, for VIDIOC_S_TV_LAYERS */
+struct s5p_layer_regs {
+	bool dirty;
+	u32 alpha;
+
+	/* graphic layer */
+	u32 base_addr;
+	u32 span;
+	u32 width;
+	u32 height;
+	u32 src_offset_x;
+	u32 src_offset_y;
+	u32 dest_offset_x;
+	u32 dest_offset_y;
+
+	/* video layer */
+	bool interlaced;
+	u32 top_y_address;
+	u32 top_c_address;
+	u32 bottom_y_address;
+	u32 bottom_c_address;
+	u32 src_x_fact_step;
+	u32 src_width;
+	u32 src_height;
+	u32 dest_width;
+	u32 dest_height;
+	bool ipc;
+};
+
 struct s5p_tv_status {
 	/* TVOUT_SET_INTERFACE_PARAM */
 	bool tvout_param_available;
@@ -730,6 +759,17 @@ extern	bool _s5p_vlayer_set_csc_coef(unsigned long p_buf_in);
 extern	bool _s5p_vlayer_start(void);
 extern	bool _s5p_vlayer_stop(void);
 
+#ifdef CONFIG_CPU_S5PV210
+extern	void _s5p_grp_get_regs(enum s5p_tv_vmx_layer vm_layer,
+		struct s5p_layer_regs *regs);
+extern	void _s5p_vlayer_get_regs(struct s5p_layer_regs *regs);
+
+extern	void _s5p_layers_init(void);
+extern	void _s5p_layers_stop(void);
+extern	int _s5p_layers_update(struct v4l2_tv_layers *layers);
+extern	void _s5p_layers_get_status(struct v4l2_tv_layers_status *status);
+#endif
+
 void __s5p_read_hdcp_data(u8 reg_addr, u8 count, u8 *data);
 void __s5p_write_hdcp_data(u8 reg_addr, u8 count, u8 *data);
 void __s5p_write_ainfo(void);
@@ -935,6 +975,14 @@ enum s5p_tv_vmx_err __s5p_vm_set_underflow_interrupt_enable(
 	bool en);
 void __s5p_vm_clear_pend_all(void);
 irqreturn_t __s5p_mixer_irq(int irq, void *dev_id);
+#ifdef CONFIG_CPU_S5PV210
+void __s5p_vm_register_vsync_isr(vmixer_isr isr);
+void __s5p_vm_set_shadow_update(bool en);
+void __s5p_vm_set_vsync_interrupt_enable(bool en);
+bool __s5p_vm_get_vsync_status(void);
+enum s5p_tv_vmx_err __s5p_vm_set_grp_layer_window(enum s5p_tv_vmx_layer layer,
+	u32 span, u32 width, u32 height, u32 src_offs_x, u32 src_offs_y);
+#endif
 
 void __s5p_vp_set_field_id(enum s5p_vp_field mode);
 enum s5p_tv_vp_err __s5p_vp_set_top_field_address(u32 top_y_addr,
@@ -1149,6 +1149,9 @@ static int __devinit s5p_tv_probe(struct platform_device *pdev)
 		s5ptv_status.hpd_status ? "inserted":"removed/not connected");
 
 	/* Interrupt */
+#ifdef CONFIG_CPU_S5PV210
+	_s5p_layers_init();
+#endif
 	TVOUT_IRQ_INIT(irq_num, ret, pdev, 0, out, __s5p_mixer_irq, "mixer");
 	TVOUT_IRQ_INIT(irq_num, ret, pdev, 1, out_hdmi_irq, __s5p_hdmi_irq , \
 								"hdmi");
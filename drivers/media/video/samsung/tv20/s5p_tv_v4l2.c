@@ -1521,6 +1521,37 @@ static int s5p_tv_v4l2_s_parm_vo(struct file *file, void *fh,
 #define VIDIOC_AV_MUTE _IOR('V', 104, unsigned int)
 #define VIDIOC_G_AVMUTE _IOR('V', 105, unsigned int)
 
+#ifdef CONFIG_CPU_S5PV210
+static long s5p_tv_v4l2_s_layers(unsigned long arg)
+{
+	struct v4l2_tv_layers layers;
+	long ret;
+
+	if (copy_from_user(&layers, (void __user *)arg, sizeof(layers)))
+		return -EFAULT;
+
+	ret = _s5p_layers_update(&layers);
+
+	/* the sequence is valid even if waiting for it failed */
+	if (copy_to_user((void __user *)arg, &layers, sizeof(layers)))
+		return -EFAULT;
+
+	return ret;
+}
+
+static long s5p_tv_v4l2_g_layers_status(unsigned long arg)
+{
+	struct v4l2_tv_layers_status status;
+
+	_s5p_layers_get_status(&status);
+
+	if (copy_to_user((void __user *)arg, &status, sizeof(status)))
+		return -EFAULT;
+
+	return 0;
+}
+#endif
+
 long s5p_tv_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	switch (cmd) {
@@ -1651,6 +1682,14 @@ long s5p_tv_v_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case VIDIOC_G_AVMUTE:
 		return s5p_hdmi_get_mute();
 
+#ifdef CONFIG_CPU_S5PV210
+	case VIDIOC_S_TV_LAYERS:
+		return s5p_tv_v4l2_s_layers(arg);
+
+	case VIDIOC_G_TV_LAYERS_STATUS:
+		return s5p_tv_v4l2_g_layers_status(arg);
+#endif
+
 	case VIDIOC_S_FMT: {
 		struct v4l2_format *f = (struct v4l2_format *)arg;
 		void *fh = file->private_data;
@@ -1751,6 +1790,14 @@ long s5p_tv_vo_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 
 	break;
 
+#ifdef CONFIG_CPU_S5PV210
+	case VIDIOC_S_TV_LAYERS:
+		return s5p_tv_v4l2_s_layers(arg);
+
+	case VIDIOC_G_TV_LAYERS_STATUS:
+		return s5p_tv_v4l2_g_layers_status(arg);
+#endif
+
 	default:
 		break;
 	}
@@ -575,6 +575,7 @@ enum s5p_tv_hdmi_interrrupt {
 };
 
 typedef int (*hdmi_isr)(int irq);
+typedef void (*vmixer_isr)(void);
 
 
 extern int s5p_hdmi_register_isr(hdmi_isr isr, u8 irq_num);
@@ -1156,42 +1156,138 @@ void __s5p_vm_clear_pend_all(void)
 	       mixer_base + S5P_MXR_INT_STATUS);
 }
 
-irqreturn_t __s5p_mixer_irq(int irq, void *dev_id)
+/*
+* vsync - shadow register latch for atomic layer updates
+*/
+
+static vmixer_isr vmixer_vsync_isr;
+
+void __s5p_vm_register_vsync_isr(vmixer_isr isr)
 {
-	bool v_i_f;
-	bool g0_i_f;
-	bool g1_i_f;
-	bool mxr_i_f;
-	u32 temp_reg = 0;
+	vmixer_vsync_isr = isr;
+}
+
+/*
+ * While the update is disabled the shadow registers keep their values, so
+ * everything written in between is latched together at the next vsync.
+ */
+void __s5p_vm_set_shadow_update(bool en)
+{
+	u32 reg = readl(mixer_base + S5P_MXR_STATUS);
+
+	if (en)
+		reg |= S5P_MXR_STATUS_SYNC_ENABLE;
+	else
+		reg &= ~S5P_MXR_STATUS_SYNC_ENABLE;
+
+	writel(reg, mixer_base + S5P_MXR_STATUS);
+}
 
-	v_i_f = (readl(mixer_base + S5P_MXR_INT_STATUS)
-			& S5P_MXR_VP_INT_FIRED) ? true : false;
-	g0_i_f = (readl(mixer_base + S5P_MXR_INT_STATUS)
-			& S5P_MXR_GRP0_INT_FIRED) ? true : false;
-	g1_i_f = (readl(mixer_base + S5P_MXR_INT_STATUS)
-			& S5P_MXR_GRP1_INT_FIRED) ? true : false;
-	mxr_i_f = (readl(mixer_base + S5P_MXR_INT_STATUS)
-			& S5P_MXR_INT_FIRED) ? true : false;
+void __s5p_vm_set_vsync_interrupt_enable(bool en)
+{
+	u32 reg = readl(mixer_base + S5P_MXR_INT_EN);
+
+	if (en) {
+		/* drop the status of a vsync from while it was disabled */
+		writel(S5P_MXR_VSYNC_INT_CLEAR,
+			mixer_base + S5P_MXR_INT_STATUS);
+		reg |= S5P_MXR_VSYNC_INT_ENABLE;
+	} else
+		reg &= ~S5P_MXR_VSYNC_INT_ENABLE;
+
+	writel(reg, mixer_base + S5P_MXR_INT_EN);
+}
+
+/*
+ * INT_FIRED is set by the fifo underrun interrupts too, it only stands for
+ * a vsync while none of them is pending.
+ */
+bool __s5p_vm_get_vsync_status(void)
+{
+	u32 status = readl(mixer_base + S5P_MXR_INT_STATUS);
+
+	return ((status & S5P_MXR_INT_FIRED) &&
+		!(status & S5P_MXR_UNDERRUN_INT_FIRED)) ? true : false;
+}
 
-	if (mxr_i_f) {
-		temp_reg |= S5P_MXR_INT_FIRED;
+/*
+ * Same as __s5p_vm_set_grp_layer_size() but keeps the scaling factors set
+ * up by __s5p_vm_init_layer()
+ */
+enum s5p_tv_vmx_err __s5p_vm_set_grp_layer_window(enum s5p_tv_vmx_layer layer,
+					u32 span,
+					u32 width,
+					u32 height,
+					u32 src_offs_x,
+					u32 src_offs_y)
+{
+	enum s5p_tv_vmx_err merr;
+	u32 wh_reg;
+	u32 scale;
 
-		if (v_i_f) {
-			temp_reg |= S5P_MXR_VP_INT_FIRED;
+	switch (layer) {
+
+	case VM_GPR0_LAYER:
+		wh_reg = S5P_MXR_GRAPHIC0_WH;
+		break;
+
+	case VM_GPR1_LAYER:
+		wh_reg = S5P_MXR_GRAPHIC1_WH;
+		break;
+
+	default:
+		VMPRINTK(" invalid layer parameter = %d\n\r", layer);
+		return S5P_TV_VMX_ERR_INVALID_PARAM;
+		break;
+	}
+
+	scale = readl(mixer_base + wh_reg) & ((0x3<<28)|(0x3<<12));
+
+	merr = __s5p_vm_set_grp_layer_size(layer, span, width, height,
+					   src_offs_x, src_offs_y);
+
+	if (merr != VMIXER_NO_ERROR)
+		return merr;
+
+	writel(readl(mixer_base + wh_reg) | scale, mixer_base + wh_reg);
+
+	return VMIXER_NO_ERROR;
+}
+
+irqreturn_t __s5p_mixer_irq(int irq, void *dev_id)
+{
+	u32 status;
+
+	status = readl(mixer_base + S5P_MXR_INT_STATUS);
+
+	if (status & S5P_MXR_UNDERRUN_INT_FIRED) {
+		if (status & S5P_MXR_VP_INT_FIRED)
 			printk("VP fifo under run!!\n\r");
-		}
 
-		if (g0_i_f) {
-			temp_reg |= S5P_MXR_GRP0_INT_FIRED;
+		if (status & S5P_MXR_GRP0_INT_FIRED)
 			printk("GRP0 fifo under run!!\n\r");
-		}
 
-		if (g1_i_f) {
-			temp_reg |= S5P_MXR_GRP1_INT_FIRED;
+		if (status & S5P_MXR_GRP1_INT_FIRED)
 			printk("GRP1 fifo under run!!\n\r");
-		}
 
-		writel(temp_reg, mixer_base + S5P_MXR_INT_STATUS);
+		writel((status & S5P_MXR_UNDERRUN_INT_FIRED) | S5P_MXR_INT_FIRED,
+			mixer_base + S5P_MXR_INT_STATUS);
+
+		/* INT_FIRED is set again if a vsync is pending as well */
+		status = readl(mixer_base + S5P_MXR_INT_STATUS);
+	}
+
+	if ((readl(mixer_base + S5P_MXR_INT_EN) & S5P_MXR_VSYNC_INT_ENABLE) &&
+	    (status & S5P_MXR_INT_FIRED) &&
+	    !(status & S5P_MXR_UNDERRUN_INT_FIRED)) {
+		/* vsync is cleared through a different bit than it is read */
+		writel(S5P_MXR_VSYNC_INT_CLEAR,
+			mixer_base + S5P_MXR_INT_STATUS);
+
+		if (vmixer_vsync_isr)
+			vmixer_vsync_isr();
+	} else if (status & S5P_MXR_INT_FIRED) {
+		writel(S5P_MXR_INT_FIRED, mixer_base + S5P_MXR_INT_STATUS);
 	}
 
 	return IRQ_HANDLED;
@@ -37,29 +37,80 @@
 #include <linux/mutex.h>
 #include <linux/workqueue.h>
 #include <linux/preempt.h>
+#include <linux/vmalloc.h>
+#include <linux/crc32.h>
+#include <linux/lzo.h>
 
 extern void ram_console_enable_console(int);
 
+/*
+ * The console and thread dumps are stored as a sequence of frames, each
+ * starting on a flash page and holding up to APANIC_FRAME_RAW bytes of
+ * text, LZO compressed when that helps. While the system is up the log is
+ * checkpointed in full frames by a background work, so the panic notifier
+ * only has to write the tail, the thread dump and the header in page 0.
+ */
 struct panic_header {
 	u32 magic;
 #define PANIC_MAGIC 0xdeadf00d
 
 	u32 version;
-#define PHDR_VERSION   0x01
+#define PHDR_VERSION   0x02
 
 	u32 console_offset;
-	u32 console_length;
+	u32 console_length;	/* uncompressed */
 
 	u32 threads_offset;
-	u32 threads_length;
+	u32 threads_length;	/* uncompressed */
+
+	u32 frames_end;		/* end of the last frame on flash */
+	u32 crc;		/* of the header up to here */
+};
+
+struct apanic_frame {
+	u32 magic;
+#define APANIC_FRAME_MAGIC 0x41504652	/* "APFR" */
+
+	u16 type;
+#define APANIC_FRAME_CONSOLE	1
+#define APANIC_FRAME_THREADS	2
+
+	u16 flags;
+#define APANIC_FRAME_LZO	0x1
+
+	u32 seq;
+	u32 raw_length;
+	u32 length;		/* payload following the frame header */
+	u32 crc;		/* of the frame header with crc 0, and payload */
 };
 
+#define APANIC_FRAME_RAW	(16 * 1024)
+#define APANIC_FRAME_MAX	\
+	(sizeof(struct apanic_frame) + lzo1x_worst_compress(APANIC_FRAME_RAW))
+
 struct apanic_data {
 	struct mtd_info		*mtd;
 	struct panic_header	curr;
 	void			*bounce;
 	struct proc_dir_entry	*apanic_console;
 	struct proc_dir_entry	*apanic_threads;
+
+	/* frame buffers, shared by the checkpoint work and the panic path */
+	void			*raw;
+	void			*frame;
+	void			*wrkmem;
+	u32			seq;
+
+	/* decoded dumps of the previous panic */
+	char			*console_buf;
+	char			*threads_buf;
+
+	/* log checkpoint */
+	struct delayed_work	checkpoint_work;
+	int			checkpoint;	/* partition clean, frames appended */
+	unsigned int		ckpt_pos;	/* log position written up to */
+	unsigned int		ckpt_off;	/* next free flash offset */
+	unsigned int		ckpt_length;	/* console bytes in frames */
 };
 
 static struct apanic_data drv_ctx;
@@ -143,11 +194,7 @@ static int apanic_proc_read(char *buffer, char **start, off_t offset,
 {
 	struct apanic_data *ctx = &drv_ctx;
 	size_t file_length;
-	off_t file_offset;
-	unsigned int page_no;
-	off_t page_offset;
-	int rc;
-	size_t len;
+	char *file_buf;
 
 	if (!count)
 		return 0;
@@ -157,11 +204,11 @@ static int apanic_proc_read(char *buffer, char **start, off_t offset,
 	switch ((int) dat) {
 	case 1:	/* apanic_console */
 		file_length = ctx->curr.console_length;
-		file_offset = ctx->curr.console_offset;
+		file_buf = ctx->console_buf;
 		break;
 	case 2:	/* apanic_threads */
 		file_length = ctx->curr.threads_length;
-		file_offset = ctx->curr.threads_offset;
+		file_buf = ctx->threads_buf;
 		break;
 	default:
 		pr_err("Bad dat (%d)\n", (int) dat);
@@ -169,35 +216,17 @@ static int apanic_proc_read(char *buffer, char **start, off_t offset,
 		return -EINVAL;
 	}
 
-	if ((offset + count) > file_length) {
+	if (!file_buf || offset >= file_length) {
 		mutex_unlock(&drv_mutex);
+		*peof = 1;
 		return 0;
 	}
 
-	/* We only support reading a maximum of a flash page */
-	if (count > ctx->mtd->writesize)
-		count = ctx->mtd->writesize;
-
-	page_no = (file_offset + offset) / ctx->mtd->writesize;
-	page_offset = (file_offset + offset) % ctx->mtd->writesize;
+	if (count > file_length - offset)
+		count = file_length - offset;
+	memcpy(buffer, file_buf + offset, count);
 
-
-	if (phy_offset(ctx->mtd, (page_no * ctx->mtd->writesize))
-		== APANIC_INVALID_OFFSET) {
-		pr_err("apanic: reading an invalid address\n");
-		mutex_unlock(&drv_mutex);
-		return -EINVAL;
-	}
-	rc = ctx->mtd->read(ctx->mtd,
-		phy_offset(ctx->mtd, (page_no * ctx->mtd->writesize)),
-		ctx->mtd->writesize,
-		&len, ctx->bounce);
-
-	if (page_offset)
-		count -= page_offset;
-	memcpy(buffer, ctx->bounce + page_offset, count);
-
-	*start = count;
+	*start = (char *) count;
 
 	if ((offset + count) == file_length)
 		*peof = 1;
@@ -266,6 +295,8 @@ out:
 	return;
 }
 
+static void apanic_checkpoint_start(struct apanic_data *ctx);
+
 static void apanic_remove_proc_work(struct work_struct *work)
 {
 	struct apanic_data *ctx = &drv_ctx;
@@ -273,6 +304,10 @@ static void apanic_remove_proc_work(struct work_struct *work)
 	mutex_lock(&drv_mutex);
 	mtd_panic_erase();
 	memset(&ctx->curr, 0, sizeof(struct panic_header));
+	vfree(ctx->console_buf);
+	vfree(ctx->threads_buf);
+	ctx->console_buf = NULL;
+	ctx->threads_buf = NULL;
 	if (ctx->apanic_console) {
 		remove_proc_entry("apanic_console", NULL);
 		ctx->apanic_console = NULL;
@@ -281,6 +316,7 @@ static void apanic_remove_proc_work(struct work_struct *work)
 		remove_proc_entry("apanic_threads", NULL);
 		ctx->apanic_threads = NULL;
 	}
+	apanic_checkpoint_start(ctx);
 	mutex_unlock(&drv_mutex);
 }
 
@@ -291,6 +327,140 @@ static int apanic_proc_write(struct file *file, const char __user *buffer,
 	return count;
 }
 
+static u32 apanic_header_crc(struct panic_header *hdr)
+{
+	return ~crc32_le(~0, (void *) hdr, offsetof(struct panic_header, crc));
+}
+
+static u32 apanic_frame_crc(struct apanic_frame *frame)
+{
+	u32 crc, saved = frame->crc;
+
+	frame->crc = 0;
+	crc = crc32_le(~0, (void *) frame, sizeof(*frame) + frame->length);
+	frame->crc = saved;
+
+	return ~crc;
+}
+
+/* Reads len bytes starting at the page aligned offset off */
+static int apanic_read(struct mtd_info *mtd, unsigned int off, void *buf,
+		       size_t len)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	unsigned int to;
+	size_t rlen, chunk;
+	int rc;
+
+	while (len) {
+		to = phy_offset(mtd, off);
+		if (to == APANIC_INVALID_OFFSET)
+			return -EINVAL;
+
+		/* ECC errors are left to the frame checksum */
+		rc = mtd->read(mtd, to, mtd->writesize, &rlen, ctx->bounce);
+		if (rc && rc != -EUCLEAN && rc != -EBADMSG)
+			return rc;
+
+		chunk = min_t(size_t, len, mtd->writesize);
+		memcpy(buf, ctx->bounce, chunk);
+		buf += chunk;
+		off += mtd->writesize;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+/*
+ * Decodes the frames of the previous panic into console_buf and
+ * threads_buf. Corrupted frames are skipped and reported.
+ */
+static void apanic_decode_frames(struct apanic_data *ctx)
+{
+	struct mtd_info *mtd = ctx->mtd;
+	struct apanic_frame *frame = ctx->frame;
+	unsigned int off = ctx->curr.console_offset;
+	size_t console_len = 0, threads_len = 0;
+	size_t size, len, limit, *done;
+	unsigned int missing = 0;
+	char *dest;
+	u32 seq = 0;
+	int rc;
+
+	if (ctx->curr.console_length)
+		ctx->console_buf = vmalloc(ctx->curr.console_length);
+	if (ctx->curr.threads_length)
+		ctx->threads_buf = vmalloc(ctx->curr.threads_length);
+
+	while (off < ctx->curr.frames_end) {
+		if (apanic_read(mtd, off, frame, mtd->writesize) ||
+		    frame->magic != APANIC_FRAME_MAGIC ||
+		    frame->length > APANIC_FRAME_MAX - sizeof(*frame) ||
+		    frame->raw_length > APANIC_FRAME_RAW) {
+			off += mtd->writesize;
+			continue;
+		}
+
+		size = sizeof(*frame) + frame->length;
+		if (size > mtd->writesize &&
+		    apanic_read(mtd, off + mtd->writesize,
+				ctx->frame + mtd->writesize,
+				size - mtd->writesize)) {
+			off += mtd->writesize;
+			continue;
+		}
+
+		if (apanic_frame_crc(frame) != frame->crc) {
+			off += mtd->writesize;
+			continue;
+		}
+		off += ALIGN(size, mtd->writesize);
+
+		if (frame->type == APANIC_FRAME_CONSOLE) {
+			dest = ctx->console_buf;
+			limit = ctx->curr.console_length;
+			done = &console_len;
+		} else if (frame->type == APANIC_FRAME_THREADS) {
+			dest = ctx->threads_buf;
+			limit = ctx->curr.threads_length;
+			done = &threads_len;
+		} else
+			continue;
+
+		missing += frame->seq - seq;
+		seq = frame->seq + 1;
+
+		if (!dest || *done + frame->raw_length > limit)
+			continue;
+
+		if (frame->flags & APANIC_FRAME_LZO) {
+			len = limit - *done;
+			rc = lzo1x_decompress_safe(ctx->frame + sizeof(*frame),
+					frame->length, dest + *done, &len);
+			if (rc != LZO_E_OK || len != frame->raw_length) {
+				missing++;
+				continue;
+			}
+		} else {
+			/* stored as is, only raw_length was checked above */
+			if (frame->length != frame->raw_length) {
+				missing++;
+				continue;
+			}
+			len = frame->length;
+			memcpy(dest + *done, ctx->frame + sizeof(*frame), len);
+		}
+		*done += len;
+	}
+
+	if (missing)
+		printk(KERN_WARNING "apanic: %u frames lost\n", missing);
+
+	ctx->curr.console_length = console_len;
+	ctx->curr.threads_length = threads_len;
+}
+
 static void mtd_panic_notify_add(struct mtd_info *mtd)
 {
 	struct apanic_data *ctx = &drv_ctx;
@@ -331,22 +501,30 @@ static void mtd_panic_notify_add(struct mtd_info *mtd)
 
 	if (hdr->magic != PANIC_MAGIC) {
 		printk(KERN_INFO "apanic: No panic data available\n");
-		mtd_panic_erase();
-		return;
+		goto out_erase;
 	}
 
 	if (hdr->version != PHDR_VERSION) {
 		printk(KERN_INFO "apanic: Version mismatch (%d != %d)\n",
 		       hdr->version, PHDR_VERSION);
-		mtd_panic_erase();
-		return;
+		goto out_erase;
+	}
+
+	if (hdr->crc != apanic_header_crc(hdr)) {
+		printk(KERN_INFO "apanic: Bad header checksum\n");
+		goto out_erase;
 	}
 
 	memcpy(&ctx->curr, hdr, sizeof(struct panic_header));
 
-	printk(KERN_INFO "apanic: c(%u, %u) t(%u, %u)\n",
+	printk(KERN_INFO "apanic: c(%u, %u) t(%u, %u) end %u\n",
 	       hdr->console_offset, hdr->console_length,
-	       hdr->threads_offset, hdr->threads_length);
+	       hdr->threads_offset, hdr->threads_length, hdr->frames_end);
+
+	mutex_lock(&drv_mutex);
+	apanic_decode_frames(ctx);
+	mutex_unlock(&drv_mutex);
+	hdr = &ctx->curr;
 
 	if (hdr->console_length) {
 		ctx->apanic_console = create_proc_entry("apanic_console",
@@ -378,9 +556,19 @@ static void mtd_panic_notify_add(struct mtd_info *mtd)
 		}
 	}
 
-	if (!proc_entry_created)
-		mtd_panic_erase();
+	if (proc_entry_created)
+		return;
 
+	memset(&ctx->curr, 0, sizeof(struct panic_header));
+	vfree(ctx->console_buf);
+	vfree(ctx->threads_buf);
+	ctx->console_buf = NULL;
+	ctx->threads_buf = NULL;
+out_erase:
+	mutex_lock(&drv_mutex);
+	mtd_panic_erase();
+	apanic_checkpoint_start(ctx);
+	mutex_unlock(&drv_mutex);
 	return;
 out_err:
 	ctx->mtd = NULL;
@@ -390,6 +578,7 @@ static void mtd_panic_notify_remove(struct mtd_info *mtd)
 {
 	struct apanic_data *ctx = &drv_ctx;
 	if (mtd == ctx->mtd) {
+		cancel_delayed_work_sync(&ctx->checkpoint_work);
 		ctx->mtd = NULL;
 		printk(KERN_INFO "apanic: Unbound from %s\n", mtd->name);
 	}
@@ -441,47 +630,145 @@ static int apanic_writeflashpage(struct mtd_info *mtd, loff_t to,
 extern int log_buf_copy(char *dest, int idx, int len);
 extern void log_buf_clear(void);
 
+extern int log_buf_copy_from(char *dest, unsigned int *pos, int len);
+
 /*
- * Writes the contents of the console to the specified offset in flash.
- * Returns number of bytes written
+ * Writes the ctx->raw text as one frame at *off. The offset is advanced
+ * before any page is programmed, so a panic which interrupts a checkpoint
+ * never writes into its partially programmed pages.
  */
-static int apanic_write_console(struct mtd_info *mtd, unsigned int off)
+static int apanic_write_frame(struct apanic_data *ctx, unsigned int *off,
+			      int type, size_t raw_length)
 {
-	struct apanic_data *ctx = &drv_ctx;
-	int saved_oip;
-	int idx = 0;
-	int rc, rc2;
-	unsigned int last_chunk = 0;
-
-	while (!last_chunk) {
-		saved_oip = oops_in_progress;
-		oops_in_progress = 1;
-		rc = log_buf_copy(ctx->bounce, idx, mtd->writesize);
-		if (rc < 0)
-			break;
-
-		if (rc != mtd->writesize)
-			last_chunk = rc;
+	struct mtd_info *mtd = ctx->mtd;
+	struct apanic_frame *frame = ctx->frame;
+	size_t length, size, done, chunk;
+	unsigned int to;
+	int rc;
 
-		oops_in_progress = saved_oip;
-		if (rc <= 0)
-			break;
-		if (rc != mtd->writesize)
-			memset(ctx->bounce + rc, 0, mtd->writesize - rc);
+	length = APANIC_FRAME_MAX - sizeof(*frame);
+	rc = lzo1x_1_compress(ctx->raw, raw_length,
+			      ctx->frame + sizeof(*frame), &length, ctx->wrkmem);
+	frame->flags = APANIC_FRAME_LZO;
+	if (rc != LZO_E_OK || length >= raw_length) {
+		memcpy(ctx->frame + sizeof(*frame), ctx->raw, raw_length);
+		length = raw_length;
+		frame->flags = 0;
+	}
 
-		rc2 = apanic_writeflashpage(mtd, off, ctx->bounce);
-		if (rc2 <= 0) {
+	frame->magic = APANIC_FRAME_MAGIC;
+	frame->type = type;
+	frame->seq = ctx->seq++;
+	frame->raw_length = raw_length;
+	frame->length = length;
+	frame->crc = apanic_frame_crc(frame);
+
+	size = sizeof(*frame) + length;
+	if (*off + ALIGN(size, mtd->writesize) >
+	    (apanic_good_blocks << mtd->erasesize_shift))
+		return -ENOSPC;
+
+	to = *off;
+	*off += ALIGN(size, mtd->writesize);
+	barrier();
+
+	for (done = 0; done < size; done += mtd->writesize) {
+		chunk = min_t(size_t, size - done, mtd->writesize);
+		memcpy(ctx->bounce, ctx->frame + done, chunk);
+		if (chunk != mtd->writesize)
+			memset(ctx->bounce + chunk, 0, mtd->writesize - chunk);
+
+		rc = apanic_writeflashpage(mtd, to + done, ctx->bounce);
+		if (rc <= 0) {
 			printk(KERN_EMERG
-			       "apanic: Flash write failed (%d)\n", rc2);
-			return idx;
+			       "apanic: Flash write failed (%d)\n", rc);
+			return rc ? rc : -EIO;
 		}
-		if (!last_chunk)
-			idx += rc2;
-		else
-			idx += last_chunk;
-		off += rc2;
 	}
-	return idx;
+
+	return 0;
+}
+
+/*
+ * Writes the log from *pos on as frames at *off, adding the text written
+ * to *length. Unless tail is set only full frames are written and the
+ * rest is left for the next call.
+ */
+static int apanic_write_log(struct apanic_data *ctx, unsigned int *off,
+			    int type, unsigned int *pos, unsigned int *length,
+			    int tail)
+{
+	unsigned int next;
+	int len, rc;
+
+	for (;;) {
+		next = *pos;
+		len = log_buf_copy_from(ctx->raw, &next, APANIC_FRAME_RAW);
+		if (len <= 0 || (!tail && len < APANIC_FRAME_RAW))
+			return 0;
+
+		rc = apanic_write_frame(ctx, off, type, len);
+		if (rc)
+			return rc;
+
+		*pos = next;
+		*length += len;
+	}
+}
+
+/*
+ * The checkpoint may use half of the partition, the rest is kept for the
+ * log tail and the thread dump written at panic time.
+ */
+static unsigned int checkpoint_interval = 10000;	/* ms */
+module_param(checkpoint_interval, uint, S_IRUGO);
+MODULE_PARM_DESC(checkpoint_interval, "Log checkpoint interval (ms), 0 disables");
+
+static void apanic_checkpoint_start(struct apanic_data *ctx)
+{
+	if (!ctx->mtd)
+		return;
+
+	/* whatever the erased frames held is rewritten from the log buffer */
+	ctx->ckpt_pos -= ctx->ckpt_length;
+	ctx->ckpt_length = 0;
+	ctx->ckpt_off = ctx->mtd->writesize;
+	ctx->seq = 0;
+
+	if (checkpoint_interval)
+		schedule_delayed_work(&ctx->checkpoint_work,
+				msecs_to_jiffies(checkpoint_interval));
+}
+
+static void apanic_checkpoint(struct work_struct *work)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	struct mtd_info *mtd;
+	int rc;
+
+	mutex_lock(&drv_mutex);
+	mtd = ctx->mtd;
+	if (!mtd || ctx->curr.magic)
+		goto out;
+
+	rc = apanic_write_log(ctx, &ctx->ckpt_off, APANIC_FRAME_CONSOLE,
+			      &ctx->ckpt_pos, &ctx->ckpt_length, 0);
+	if (rc && rc != -ENOSPC) {
+		printk(KERN_ERR "apanic: Checkpoint failed (%d)\n", rc);
+		goto out;
+	}
+
+	if (rc || ctx->ckpt_off >
+	    (apanic_good_blocks << mtd->erasesize_shift) / 2) {
+		mtd_panic_erase();
+		apanic_checkpoint_start(ctx);
+		goto out;
+	}
+
+	schedule_delayed_work(&ctx->checkpoint_work,
+			msecs_to_jiffies(checkpoint_interval));
+out:
+	mutex_unlock(&drv_mutex);
 }
 
 static int apanic(struct notifier_block *this, unsigned long event,
@@ -489,10 +776,10 @@ static int apanic(struct notifier_block *this, unsigned long event,
 {
 	struct apanic_data *ctx = &drv_ctx;
 	struct panic_header *hdr = (struct panic_header *) ctx->bounce;
-	int console_offset = 0;
-	int console_len = 0;
-	int threads_offset = 0;
-	int threads_len = 0;
+	unsigned int threads_offset;
+	unsigned int threads_pos;
+	unsigned int threads_len = 0;
+	int saved_oip;
 	int rc;
 
 	if (in_panic)
@@ -511,36 +798,37 @@ static int apanic(struct notifier_block *this, unsigned long event,
 		printk(KERN_EMERG "Crash partition in use!\n");
 		goto out;
 	}
-	console_offset = ctx->mtd->writesize;
+	saved_oip = oops_in_progress;
+	oops_in_progress = 1;
 
 	/*
-	 * Write out the console
+	 * Write out what the checkpoint has not written yet of the console
 	 */
-	console_len = apanic_write_console(ctx->mtd, console_offset);
-	if (console_len < 0) {
+	rc = apanic_write_log(ctx, &ctx->ckpt_off, APANIC_FRAME_CONSOLE,
+			      &ctx->ckpt_pos, &ctx->ckpt_length, 1);
+	if (rc)
 		printk(KERN_EMERG "Error writing console to panic log! (%d)\n",
-		       console_len);
-		console_len = 0;
-	}
+		       rc);
 
 	/*
 	 * Write out all threads
 	 */
-	threads_offset = ALIGN(console_offset + console_len,
-			       ctx->mtd->writesize);
-	if (!threads_offset)
-		threads_offset = ctx->mtd->writesize;
+	threads_offset = ctx->ckpt_off;
 
 	ram_console_enable_console(0);
 
 	log_buf_clear();
 	show_state_filter(0);
-	threads_len = apanic_write_console(ctx->mtd, threads_offset);
-	if (threads_len < 0) {
+
+	/* the cleared log restarts at ckpt_pos, or right after it */
+	threads_pos = ctx->ckpt_pos;
+	rc = apanic_write_log(ctx, &ctx->ckpt_off, APANIC_FRAME_THREADS,
+			      &threads_pos, &threads_len, 1);
+	if (rc)
 		printk(KERN_EMERG "Error writing threads to panic log! (%d)\n",
-		       threads_len);
-		threads_len = 0;
-	}
+		       rc);
+
+	oops_in_progress = saved_oip;
 
 	/*
 	 * Finally write the panic header
@@ -549,12 +837,15 @@ static int apanic(struct notifier_block *this, unsigned long event,
 	hdr->magic = PANIC_MAGIC;
 	hdr->version = PHDR_VERSION;
 
-	hdr->console_offset = console_offset;
-	hdr->console_length = console_len;
+	hdr->console_offset = ctx->mtd->writesize;
+	hdr->console_length = ctx->ckpt_length;
 
 	hdr->threads_offset = threads_offset;
 	hdr->threads_length = threads_len;
 
+	hdr->frames_end = ctx->ckpt_off;
+	hdr->crc = apanic_header_crc(hdr);
+
 	rc = apanic_writeflashpage(ctx->mtd, 0, ctx->bounce);
 	if (rc <= 0) {
 		printk(KERN_EMERG "apanic: Header write failed (%d)\n",
@@ -578,7 +869,9 @@ static struct notifier_block panic_blk = {
 
 static int panic_dbg_get(void *data, u64 *val)
 {
+	mutex_lock(&drv_mutex);
 	apanic(NULL, 0, NULL);
+	mutex_unlock(&drv_mutex);
 	return 0;
 }
 
@@ -592,12 +885,27 @@ DEFINE_SIMPLE_ATTRIBUTE(panic_dbg_fops, panic_dbg_get, panic_dbg_set, "%llu\n");
 
 int __init apanic_init(void)
 {
-	register_mtd_user(&mtd_panic_notifier);
-	atomic_notifier_chain_register(&panic_notifier_list, &panic_blk);
-	debugfs_create_file("apanic", 0644, NULL, NULL, &panic_dbg_fops);
 	memset(&drv_ctx, 0, sizeof(drv_ctx));
 	drv_ctx.bounce = (void *) __get_free_page(GFP_KERNEL);
+	drv_ctx.raw = vmalloc(APANIC_FRAME_RAW);
+	drv_ctx.frame = vmalloc(APANIC_FRAME_MAX);
+	drv_ctx.wrkmem = vmalloc(LZO1X_1_MEM_COMPRESS);
+	if (!drv_ctx.bounce || !drv_ctx.raw || !drv_ctx.frame ||
+	    !drv_ctx.wrkmem) {
+		printk(KERN_ERR "apanic: Out of memory\n");
+		free_page((unsigned long) drv_ctx.bounce);
+		vfree(drv_ctx.raw);
+		vfree(drv_ctx.frame);
+		vfree(drv_ctx.wrkmem);
+		return -ENOMEM;
+	}
 	INIT_WORK(&proc_removal_work, apanic_remove_proc_work);
+	/* the checkpoint can wait until the cpu wakes up anyway */
+	INIT_DELAYED_WORK_DEFERRABLE(&drv_ctx.checkpoint_work, apanic_checkpoint);
+
+	register_mtd_user(&mtd_panic_notifier);
+	atomic_notifier_chain_register(&panic_notifier_list, &panic_blk);
+	debugfs_create_file("apanic", 0644, NULL, NULL, &panic_dbg_fops);
 	printk(KERN_INFO "Android kernel panic handler initialized (bind=%s)\n",
 	       CONFIG_APANIC_PLABEL);
 	return 0;
@@ -1847,7 +1847,7 @@ static int onenand_write_ops_nolock(struct mtd_info *mtd, loff_t to,
 	const u_char *buf = ops->datbuf;
 	const u_char *oob = ops->oobbuf;
 	u_char *oobbuf;
-	int ret = 0;
+	int ret = 0, cmd, cached = 0;
 
 	DEBUG(MTD_DEBUG_LEVEL3, "%s: to = 0x%08x, len = %i\n",
 		__func__, (unsigned int) to, (int) len);
@@ -1956,7 +1956,23 @@ static int onenand_write_ops_nolock(struct mtd_info *mtd, loff_t to,
 			ONENAND_SET_NEXT_BUFFERRAM(this);
 		}
 
-		this->command(mtd, ONENAND_CMD_PROG, to, mtd->writesize);
+		cmd = ONENAND_CMD_PROG;
+
+		/*
+		 * Use cache program while more pages follow. The chip moves
+		 * the page into its cache and raises the interrupt as soon as
+		 * the DataRAM is free again, so loading the next page overlaps
+		 * with programming this one. The last page of the request is
+		 * sent with the normal program command, which completes only
+		 * after the whole chain is in the array.
+		 * Exclude the 1st block (OTP/boot block) as the spec requires.
+		 */
+		if (ONENAND_IS_CACHE_PROGRAM(this) &&
+		    likely(onenand_block(this, to) != 0) &&
+		    (written + thislen) < len)
+			cmd = ONENAND_CMD_2X_CACHE_PROG;
+
+		this->command(mtd, cmd, to, mtd->writesize);
 
 		/*
 		 * 2 PLANE, MLC, and Flex-OneNAND wait here
@@ -1967,17 +1983,30 @@ static int onenand_write_ops_nolock(struct mtd_info *mtd, loff_t to,
 			/* In partial page write we don't update bufferram */
 			onenand_update_bufferram(mtd, to, !ret && !subpage);
 			if (ret) {
+				/* Program status of cached pages is not known */
+				written -= cached;
 				printk(KERN_ERR "%s: write failed %d\n",
 					__func__, ret);
 				break;
 			}
 
-			/* Only check verify write turn on */
-			ret = onenand_verify(mtd, buf, to, thislen);
-			if (ret) {
-				printk(KERN_ERR "%s: verify failed %d\n",
-					__func__, ret);
-				break;
+			/*
+			 * Cached pages may still be programming,
+			 * so verify them together with the last page
+			 */
+			if (cmd == ONENAND_CMD_2X_CACHE_PROG)
+				cached += thislen;
+			else {
+				/* Only check verify write turn on */
+				ret = onenand_verify(mtd, buf - cached,
+						to - cached, cached + thislen);
+				if (ret) {
+					written -= cached;
+					printk(KERN_ERR "%s: verify failed %d\n",
+						__func__, ret);
+					break;
+				}
+				cached = 0;
 			}
 
 			written += thislen;
@@ -3378,8 +3407,10 @@ static void onenand_check_features(struct mtd_info *mtd)
 	case ONENAND_DEVICE_DENSITY_4Gb:
 		if (ONENAND_IS_DDP(this))
 			this->options |= ONENAND_HAS_2PLANE;
-		else
+		else {
 			this->options |= ONENAND_HAS_4KB_PAGE;
+			this->options |= ONENAND_HAS_CACHE_PROGRAM;
+		}
 
 	case ONENAND_DEVICE_DENSITY_2Gb:
 		/* 2Gb DDP does not have 2 plane */
@@ -3403,6 +3434,14 @@ static void onenand_check_features(struct mtd_info *mtd)
 	if (ONENAND_IS_MLC(this) || ONENAND_IS_4KB_PAGE(this))
 		this->options &= ~ONENAND_HAS_2PLANE;
 
+	/*
+	 * Controllers with their own command hook (e.g. samsung.c) only
+	 * know the commands they translate, and would drop cache program
+	 * without programming the page.
+	 */
+	if (this->command != onenand_command)
+		this->options &= ~ONENAND_HAS_CACHE_PROGRAM;
+
 	if (FLEXONENAND(this)) {
 		this->options &= ~ONENAND_HAS_CONT_LOCK;
 		this->options |= ONENAND_HAS_UNLOCK_ALL;
@@ -3416,6 +3455,8 @@ static void onenand_check_features(struct mtd_info *mtd)
 		printk(KERN_DEBUG "Chip has 2 plane\n");
 	if (this->options & ONENAND_HAS_4KB_PAGE)
 		printk(KERN_DEBUG "Chip has 4KiB pagesize\n");
+	if (this->options & ONENAND_HAS_CACHE_PROGRAM)
+		printk(KERN_DEBUG "Chip has cache program feature\n");
 }
 
 /**
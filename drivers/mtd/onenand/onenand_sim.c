@@ -62,6 +62,45 @@ static int boundary[] = {
 	CONFIG_FLEXONENAND_SIM_DIE1_BOUNDARY,
 };
 
+module_param(device_id, int, 0444);
+MODULE_PARM_DESC(device_id, "Simulated device ID (e.g. 0x40 for 4KiB page)");
+
+/*
+ * Timing model, all times in usec. The simulator advances a virtual clock
+ * for each array operation so that access patterns and program modes can
+ * be compared, e.g. with mtd_speedtest or mtd_stresstest. Cache program
+ * releases the DataRAM after t_cbsy while the array keeps programming
+ * until sim_busy_until.
+ */
+static unsigned int t_read = 30;
+static unsigned int t_prog = 220;
+static unsigned int t_cbsy = 5;
+static unsigned int t_erase = 2000;
+static unsigned int t_xfer = 40;
+module_param(t_read, uint, 0644);
+MODULE_PARM_DESC(t_read, "Page load time into DataRAM (usec)");
+module_param(t_prog, uint, 0644);
+MODULE_PARM_DESC(t_prog, "Page program time (usec)");
+module_param(t_cbsy, uint, 0644);
+MODULE_PARM_DESC(t_cbsy, "Cache busy time of cache program (usec)");
+module_param(t_erase, uint, 0644);
+MODULE_PARM_DESC(t_erase, "Block erase time (usec)");
+module_param(t_xfer, uint, 0644);
+MODULE_PARM_DESC(t_xfer, "Page transfer time to/from DataRAM (usec)");
+
+static unsigned long sim_clock;
+static unsigned long sim_busy_until;
+static unsigned long sim_reads;
+static unsigned long sim_programs;
+static unsigned long sim_cache_programs;
+static unsigned long sim_erases;
+module_param(sim_clock, ulong, 0644);
+MODULE_PARM_DESC(sim_clock, "Simulated device time (usec), write 0 to reset");
+module_param(sim_reads, ulong, 0644);
+module_param(sim_programs, ulong, 0644);
+module_param(sim_cache_programs, ulong, 0644);
+module_param(sim_erases, ulong, 0644);
+
 struct onenand_flash {
 	void __iomem *base;
 	void __iomem *data;
@@ -203,6 +242,8 @@ static void onenand_update_interrupt(struct onenand_chip *this, int cmd)
 		break;
 
 	case ONENAND_CMD_PROG:
+	case ONENAND_CMD_2X_PROG:
+	case ONENAND_CMD_2X_CACHE_PROG:
 	case ONENAND_CMD_PROGOOB:
 		interrupt |= ONENAND_INT_WRITE;
 		break;
@@ -222,6 +263,50 @@ static void onenand_update_interrupt(struct onenand_chip *this, int cmd)
 	writew(interrupt, this->base + ONENAND_REG_INTERRUPT);
 }
 
+/**
+ * onenand_update_clock - Advance the simulated device time
+ * @cmd:          The command to be sent
+ *
+ * Every array operation has to wait for the one in progress. Only cache
+ * program lets the host continue before the array becomes ready.
+ */
+static void onenand_update_clock(int cmd)
+{
+	/* Virtual clock is reset from sysfs */
+	if (!sim_clock)
+		sim_busy_until = 0;
+
+	switch (cmd) {
+	case ONENAND_CMD_READ:
+	case ONENAND_CMD_READOOB:
+		sim_clock = max(sim_clock, sim_busy_until) + t_read + t_xfer;
+		sim_reads++;
+		break;
+
+	case ONENAND_CMD_2X_CACHE_PROG:
+		sim_clock = max(sim_clock + t_xfer, sim_busy_until);
+		sim_busy_until = sim_clock + t_prog;
+		sim_clock += t_cbsy;
+		sim_cache_programs++;
+		break;
+
+	case ONENAND_CMD_PROG:
+	case ONENAND_CMD_2X_PROG:
+	case ONENAND_CMD_PROGOOB:
+		sim_clock = max(sim_clock + t_xfer, sim_busy_until) + t_prog;
+		sim_programs++;
+		break;
+
+	case ONENAND_CMD_ERASE:
+		sim_clock = max(sim_clock, sim_busy_until) + t_erase;
+		sim_erases++;
+		break;
+
+	default:
+		break;
+	}
+}
+
 /**
  * onenand_check_overwrite - Check if over-write happened
  * @dest:		The destination pointer
@@ -308,6 +393,8 @@ static void onenand_data_handle(struct onenand_chip *this, int cmd,
 		break;
 
 	case ONENAND_CMD_PROG:
+	case ONENAND_CMD_2X_PROG:
+	case ONENAND_CMD_2X_CACHE_PROG:
 		src = ONENAND_MAIN_AREA(this, main_offset);
 		dest = ONENAND_CORE(flash) + offset;
 		if (pi_operation) {
@@ -412,6 +499,8 @@ static void onenand_command_handle(struct onenand_chip *this, int cmd)
 
 	onenand_data_handle(this, cmd, dataram, offset);
 
+	onenand_update_clock(cmd);
+
 	onenand_update_interrupt(this, cmd);
 }
 
@@ -549,6 +638,11 @@ static void __exit onenand_sim_exit(void)
 	struct onenand_chip *this = info->mtd.priv;
 	struct onenand_flash *flash = this->priv;
 
+	printk(KERN_INFO "OneNAND simulator: %lu reads, %lu programs "
+	       "(%lu cached), %lu erases in %lu usec\n", sim_reads,
+	       sim_programs + sim_cache_programs, sim_cache_programs,
+	       sim_erases, sim_clock);
+
 	onenand_release(&info->mtd);
 	flash_exit(flash);
 	kfree(ffchars);
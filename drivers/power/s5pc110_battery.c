@@ -23,6 +23,8 @@
 #include <linux/io.h>
 #include <linux/irq.h>
 #include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 #include <linux/kernel.h>
 #include <linux/mfd/max8998.h>
 #include <linux/mfd/max8998-private.h>
@@ -47,7 +49,6 @@
 #include "s5pc110_battery.h"
 #include <linux/mfd/max8998.h>
 
-#define POLLING_INTERVAL	1000
 #define ADC_TOTAL_COUNT		10
 #define ADC_DATA_ARR_SIZE	6
 
@@ -66,6 +67,14 @@
 #define FAST_POLL			(1 * 60)
 #define SLOW_POLL			(10 * 60)
 
+/*
+ * While discharging and the readings stay within these deltas of the last
+ * reported ones, the poll interval doubles up to SLOW_POLL. Cable, charger
+ * and low battery changes come in through the pmic interrupt instead.
+ */
+#define STABLE_TEMP_DELTA		10	/* 1 C */
+#define STABLE_VCELL_DELTA		20000	/* 20 mV */
+
 #define DISCONNECT_BAT_FULL		0x1
 #define DISCONNECT_TEMP_OVERHEAT	0x2
 #define DISCONNECT_TEMP_FREEZE		0x4
@@ -90,6 +99,18 @@ struct battery_info {
 	bool batt_is_full;      /* 0 : Not full 1: Full */
 };
 
+struct bat_poll_stats {
+	u32 polls;		/* monitor work runs */
+	u32 alarm_wakeups;
+	u32 irq_updates;
+	u32 stable_polls;	/* nothing changed, no uevent sent */
+	u32 wakeups_saved;	/* compared to polling every FAST_POLL */
+	u32 adc_batches;
+	u32 adc_samples;
+	u64 adc_time_ns;
+	u32 adc_time_max_ns;
+};
+
 struct adc_sample_info {
 	unsigned int cnt;
 	int total_adc;
@@ -122,9 +143,11 @@ struct chg_data {
 	int			timestamp;
 	int			set_batt_full;
 	unsigned long		discharging_time;
-	unsigned int		polling_interval;
+	unsigned int		polling_interval;	/* seconds */
 	int                     slow_poll;
 	ktime_t                 last_poll;
+	struct battery_info	reported;
+	struct bat_poll_stats	stats;
 	struct max8998_charger_callbacks callbacks;
 };
 
@@ -235,16 +258,30 @@ static int s3c_ac_get_property(struct power_supply *ps,
 	return 0;
 }
 
-static int s3c_bat_get_adc_data(enum adc_channel_type adc_ch)
+static int s3c_bat_get_adc_data(struct chg_data *chg,
+		enum adc_channel_type adc_ch)
 {
+	int adc_arr[ADC_DATA_ARR_SIZE];
 	int adc_data;
 	int adc_max = 0;
 	int adc_min = 0;
 	int adc_total = 0;
+	ktime_t start;
+	s64 cost;
 	int i;
 
+	start = ktime_get();
+	s3c_adc_get_adc_data_batch(adc_ch, adc_arr, ADC_DATA_ARR_SIZE);
+	cost = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	chg->stats.adc_batches++;
+	chg->stats.adc_samples += ADC_DATA_ARR_SIZE;
+	chg->stats.adc_time_ns += cost;
+	if (cost > chg->stats.adc_time_max_ns)
+		chg->stats.adc_time_max_ns = cost;
+
 	for (i = 0; i < ADC_DATA_ARR_SIZE; i++) {
-		adc_data = s3c_adc_get_adc_data(adc_ch);
+		adc_data = adc_arr[i];
 
 		if (i != 0) {
 			if (adc_data > adc_max)
@@ -309,7 +346,7 @@ static unsigned long s3c_read_temp(struct chg_data *chg)
 {
 	int adc = 0;
 
-	adc = s3c_bat_get_adc_data(ADC_TEMPERATURE);
+	adc = s3c_bat_get_adc_data(chg, ADC_TEMPERATURE);
 
 	return calculate_average_adc(ADC_TEMPERATURE, adc, chg);
 }
@@ -585,6 +622,51 @@ static void s3c_program_alarm(struct chg_data *chg, int seconds)
 	alarm_start_range(&chg->alarm, next, ktime_add(next, slack));
 }
 
+/*
+ * Compare with the values last sent to userspace and pick the next poll
+ * interval. Returns true if nothing worth a uevent has changed.
+ */
+static bool s3c_bat_update_interval(struct chg_data *chg)
+{
+	struct battery_info *cur = &chg->bat_info;
+	struct battery_info *old = &chg->reported;
+	bool stable;
+
+	stable = cur->charging_status == old->charging_status &&
+		 cur->batt_health == old->batt_health &&
+		 cur->batt_is_full == old->batt_is_full &&
+		 cur->batt_soc == old->batt_soc &&
+		 abs((int)cur->batt_temp - (int)old->batt_temp) <=
+			STABLE_TEMP_DELTA &&
+		 abs((int)cur->batt_vcell - (int)old->batt_vcell) <=
+			STABLE_VCELL_DELTA;
+
+	if (!stable || chg->charging) {
+		/* charging timeouts and full detection need the fast pace */
+		chg->polling_interval = FAST_POLL;
+	} else {
+		chg->polling_interval = min(chg->polling_interval * 2,
+					    (unsigned int)SLOW_POLL);
+	}
+
+	if (!stable)
+		*old = *cur;
+
+	return stable;
+}
+
+static void s3c_bat_account_poll(struct chg_data *chg)
+{
+	ktime_t now = alarm_get_elapsed_realtime();
+	unsigned long elapsed;
+
+	elapsed = ktime_to_timespec(ktime_sub(now, chg->last_poll)).tv_sec;
+
+	chg->stats.polls++;
+	if (elapsed >= 2 * FAST_POLL)
+		chg->stats.wakeups_saved += elapsed / FAST_POLL - 1;
+}
+
 static void s3c_bat_work(struct work_struct *work)
 {
 	struct chg_data *chg =
@@ -592,8 +674,11 @@ static void s3c_bat_work(struct work_struct *work)
 	int ret;
 	struct timespec ts;
 	unsigned long flags;
+	bool stable;
 	mutex_lock(&chg->mutex);
 
+	s3c_bat_account_poll(chg);
+
 	s3c_get_bat_temp(chg);
 	s3c_bat_discharge_reason(chg);
 
@@ -601,9 +686,14 @@ static void s3c_bat_work(struct work_struct *work)
 	if (ret < 0)
 		goto err;
 
+	stable = s3c_bat_update_interval(chg);
+	if (stable)
+		chg->stats.stable_polls++;
+
 	mutex_unlock(&chg->mutex);
 
-	power_supply_changed(&chg->psy_bat);
+	if (!stable)
+		power_supply_changed(&chg->psy_bat);
 
 	chg->last_poll = alarm_get_elapsed_realtime();
 	ts = ktime_to_timespec(chg->last_poll);
@@ -612,7 +702,7 @@ static void s3c_bat_work(struct work_struct *work)
 	/* prevent suspend before starting the alarm */
 	local_irq_save(flags);
 	wake_unlock(&chg->work_wake_lock);
-	s3c_program_alarm(chg, FAST_POLL);
+	s3c_program_alarm(chg, chg->polling_interval);
 	local_irq_restore(flags);
 	return;
 err:
@@ -626,6 +716,7 @@ static void s3c_battery_alarm(struct alarm *alarm)
 	struct chg_data *chg =
 			container_of(alarm, struct chg_data, alarm);
 
+	chg->stats.alarm_wakeups++;
 	wake_lock(&chg->work_wake_lock);
 	queue_work(chg->monitor_wqueue, &chg->bat_work.work);
 }
@@ -633,25 +724,33 @@ static void s3c_battery_alarm(struct alarm *alarm)
 static irqreturn_t max8998_int_work_func(int irq, void *max8998_chg)
 {
 	int ret;
-	u8 data = 0;
+	u8 data[MAX8998_NUM_IRQ_REGS];
 	struct chg_data *chg;
+	int i;
 
 	chg = max8998_chg;
 
-	ret = max8998_read_reg(chg->iodev, MAX8998_REG_IRQ1, &data);
-	if (ret < 0)
-		goto err;
-
-	ret = max8998_read_reg(chg->iodev, MAX8998_REG_IRQ3, &data);
-	if (ret < 0)
-		goto err;
+	/* reading the irq registers clears them */
+	for (i = 0; i < MAX8998_NUM_IRQ_REGS; i++) {
+		ret = max8998_read_reg(chg->iodev, MAX8998_REG_IRQ1 + i,
+				&data[i]);
+		if (ret < 0)
+			goto err;
+	}
 
-	if ((data & 0x4) || (ret != 0)) {
+	if (data[2] & MAX8998_IRQ_TOPOFFR_MASK) {
 		pr_info("%s : pmic interrupt\n", __func__);
 		chg->set_batt_full = 1;
 		chg->bat_info.batt_is_full = true;
 	}
 
+	if (data[3] & (MAX8998_IRQ_LOBAT1_MASK | MAX8998_IRQ_LOBAT2_MASK))
+		pr_info("%s : low battery interrupt\n", __func__);
+
+	/* something changed, go back to the fast pace */
+	chg->polling_interval = FAST_POLL;
+	chg->stats.irq_updates++;
+
 	wake_lock(&chg->work_wake_lock);
 	queue_delayed_work(chg->monitor_wqueue,
 		&chg->bat_work, msecs_to_jiffies(200));
@@ -662,6 +761,55 @@ err:
 	return IRQ_HANDLED;
 }
 
+static ssize_t s3c_bat_show_poll_stats(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct chg_data *chg = dev_get_drvdata(dev);
+	struct bat_poll_stats stats;
+	unsigned int interval;
+	u64 avg_ns;
+
+	mutex_lock(&chg->mutex);
+	stats = chg->stats;
+	interval = chg->polling_interval;
+	mutex_unlock(&chg->mutex);
+
+	avg_ns = stats.adc_time_ns;
+	if (stats.adc_batches)
+		do_div(avg_ns, stats.adc_batches);
+
+	return sprintf(buf, "interval: %u s\n"
+			"polls: %u\n"
+			"alarm_wakeups: %u\n"
+			"irq_updates: %u\n"
+			"stable_polls: %u\n"
+			"wakeups_saved: %u\n"
+			"adc_batches: %u\n"
+			"adc_samples: %u\n"
+			"adc_time_avg: %llu us\n"
+			"adc_time_max: %u us\n",
+			interval, stats.polls, stats.alarm_wakeups,
+			stats.irq_updates, stats.stable_polls,
+			stats.wakeups_saved, stats.adc_batches,
+			stats.adc_samples, div_u64(avg_ns, NSEC_PER_USEC),
+			stats.adc_time_max_ns / NSEC_PER_USEC);
+}
+
+static ssize_t s3c_bat_reset_poll_stats(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct chg_data *chg = dev_get_drvdata(dev);
+
+	mutex_lock(&chg->mutex);
+	memset(&chg->stats, 0, sizeof(chg->stats));
+	mutex_unlock(&chg->mutex);
+
+	return count;
+}
+
+static DEVICE_ATTR(poll_stats, S_IRUGO | S_IWUSR, s3c_bat_show_poll_stats,
+		s3c_bat_reset_poll_stats);
+
 static __devinit int max8998_charger_probe(struct platform_device *pdev)
 {
 	struct max8998_dev *iodev = dev_get_drvdata(pdev->dev.parent);
@@ -707,7 +855,7 @@ static __devinit int max8998_charger_probe(struct platform_device *pdev)
 	chg->psy_ac.get_property = s3c_ac_get_property,
 
 	chg->present = 1;
-	chg->polling_interval = POLLING_INTERVAL;
+	chg->polling_interval = FAST_POLL;
 	chg->bat_info.batt_health = POWER_SUPPLY_HEALTH_GOOD;
 	chg->bat_info.batt_is_full = false;
 	chg->set_charge_timeout = false;
@@ -748,11 +896,15 @@ static __devinit int max8998_charger_probe(struct platform_device *pdev)
 	if (ret < 0)
 		goto err_kfree;
 
-	ret = max8998_write_reg(iodev, MAX8998_REG_IRQM3, ~0x4);
+	ret = max8998_write_reg(iodev, MAX8998_REG_IRQM3,
+		~(MAX8998_IRQ_TOPOFFR_MASK | MAX8998_IRQ_CHGRSTF_MASK |
+		  MAX8998_IRQ_DONER_MASK));
 	if (ret < 0)
 		goto err_kfree;
 
-	ret = max8998_write_reg(iodev, MAX8998_REG_IRQM4, 0xFF);
+	/* low battery comparators keep their boot loader thresholds */
+	ret = max8998_write_reg(iodev, MAX8998_REG_IRQM4,
+		~(MAX8998_IRQ_LOBAT1_MASK | MAX8998_IRQ_LOBAT2_MASK));
 	if (ret < 0)
 		goto err_kfree;
 
@@ -808,6 +960,9 @@ static __devinit int max8998_charger_probe(struct platform_device *pdev)
 		goto err_irq;
 	}
 
+	if (device_create_file(&pdev->dev, &dev_attr_poll_stats) < 0)
+		pr_err("%s : Failed to create poll_stats\n", __func__);
+
 	chg->callbacks.set_cable = max8998_set_cable;
 	if (chg->pdata->register_callbacks)
 		chg->pdata->register_callbacks(&chg->callbacks);
@@ -842,6 +997,7 @@ static int __devexit max8998_charger_remove(struct platform_device *pdev)
 {
 	struct chg_data *chg = platform_get_drvdata(pdev);
 
+	device_remove_file(&pdev->dev, &dev_attr_poll_stats);
 	alarm_cancel(&chg->alarm);
 	free_irq(chg->iodev->i2c_client->irq, NULL);
 	flush_workqueue(chg->monitor_wqueue);
@@ -876,11 +1032,11 @@ static int max8998_charger_resume(struct device *dev)
 	/* We might be on a slow sample cycle.  If we're
 	 * resuming we should resample the battery state
 	 * if it's been over a minute since we last did
-	 * so, and move back to sampling every minute until
+	 * so, and move back to the adaptive interval until
 	 * we suspend again.
 	 */
 	if (chg->slow_poll) {
-		s3c_program_alarm(chg, FAST_POLL);
+		s3c_program_alarm(chg, chg->polling_interval);
 		chg->slow_poll = 0;
 	}
 
@@ -47,9 +47,26 @@
 #define BMA020_SET_MODE             	_IOWR(BMA020_IOC_MAGIC,6, unsigned char)
 #define BMA020_SET_BANDWIDTH            _IOWR(BMA020_IOC_MAGIC,8, unsigned char)
 #define BMA020_READ_ACCEL_XYZ           _IOWR(BMA020_IOC_MAGIC,46,short)
+#define BMA020_SET_BATCH                _IOW(BMA020_IOC_MAGIC,48,struct bma020_batch)
 
 #define BMA020_IOC_MAXNR            	48
 
+/*
+ * Batched sampling: the driver samples every period_ns and read() on the
+ * device returns struct bma020_sample records once watermark of them are
+ * queued. A watermark of 0 stops sampling.
+ */
+struct bma020_batch {
+	unsigned int period_ns;
+	unsigned int watermark;
+};
+
+struct bma020_sample {
+	short x, y, z;
+	short reserved;
+	long long timestamp;	/* CLOCK_MONOTONIC, ns */
+};
+
 #define DEBUG							0
 
 /* BMA020 I2C Address */
@@ -21,6 +21,11 @@
 #include <linux/platform_device.h>
 #include <linux/gpio.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/mutex.h>
 
 
 #include "bma020_acc.h"
@@ -41,6 +46,110 @@ bma020_t bma020;
 /* create bma020 registers object */
 bma020regs_t bma020regs;
 
+/*
+ * The BMA020 has no fifo and no data ready interrupt is wired up, so
+ * batching is done on the host side: samples are taken from an hrtimer
+ * and queued with their acquisition time. The CPU still wakes up for
+ * every sample; only the reader is woken once per watermark instead of
+ * once per sample.
+ */
+#define BMA020_BATCH_SIZE	64
+#define BMA020_MIN_PERIOD	(NSEC_PER_SEC / 1500)	/* BMA020_BW_1500HZ */
+
+static struct {
+	spinlock_t lock;
+	struct bma020_sample ring[BMA020_BATCH_SIZE];
+	struct mutex read_lock;		/* serializes readers on out[] */
+	struct bma020_sample out[BMA020_BATCH_SIZE];
+	unsigned int head;
+	unsigned int count;
+	unsigned int dropped;
+
+	unsigned int watermark;
+	ktime_t period;
+	struct hrtimer timer;
+	struct workqueue_struct *wq;
+	struct work_struct work;
+	wait_queue_head_t wait;
+} acc_batch;
+
+static enum hrtimer_restart bma020_batch_timer(struct hrtimer *timer)
+{
+	queue_work(acc_batch.wq, &acc_batch.work);
+	hrtimer_forward_now(&acc_batch.timer, acc_batch.period);
+	return HRTIMER_RESTART;
+}
+
+static void bma020_batch_work(struct work_struct *work)
+{
+	struct bma020_sample *sample;
+	bma020acc_t accels;
+	ktime_t now;
+
+	if (bma020_read_accel_xyz(&accels))
+		return;
+	now = ktime_get();
+
+	spin_lock_irq(&acc_batch.lock);
+	sample = &acc_batch.ring[(acc_batch.head + acc_batch.count) % BMA020_BATCH_SIZE];
+	sample->x = accels.x;
+	sample->y = accels.y;
+	sample->z = accels.z;
+	sample->reserved = 0;
+	sample->timestamp = ktime_to_ns(now);
+
+	if (acc_batch.count < BMA020_BATCH_SIZE) {
+		acc_batch.count++;
+	} else {
+		/* reader is too slow, the oldest sample was overwritten */
+		acc_batch.head = (acc_batch.head + 1) % BMA020_BATCH_SIZE;
+		acc_batch.dropped++;
+	}
+	spin_unlock_irq(&acc_batch.lock);
+
+	if (acc_batch.count >= acc_batch.watermark)
+		wake_up_interruptible(&acc_batch.wait);
+}
+
+static void bma020_batch_stop(void)
+{
+	hrtimer_cancel(&acc_batch.timer);
+	cancel_work_sync(&acc_batch.work);
+}
+
+static int bma020_batch_set(struct bma020_batch *batch)
+{
+	if (batch->watermark > BMA020_BATCH_SIZE)
+		return -EINVAL;
+	if (batch->watermark && batch->period_ns < BMA020_MIN_PERIOD)
+		return -EINVAL;
+
+	bma020_batch_stop();
+
+	spin_lock_irq(&acc_batch.lock);
+	acc_batch.head = 0;
+	acc_batch.count = 0;
+	acc_batch.dropped = 0;
+	acc_batch.watermark = batch->watermark;
+	acc_batch.period = ns_to_ktime(batch->period_ns);
+	spin_unlock_irq(&acc_batch.lock);
+
+	if (acc_batch.watermark) {
+		bma020_set_mode(BMA020_MODE_NORMAL);
+		hrtimer_start(&acc_batch.timer, acc_batch.period, HRTIMER_MODE_REL);
+	}
+
+	/* let a blocked reader notice the change */
+	wake_up_interruptible(&acc_batch.wait);
+
+	return 0;
+}
+
+static bool bma020_batch_ready(void)
+{
+	return acc_batch.watermark && acc_batch.count >= acc_batch.watermark;
+}
+
 /*************************************************************************/
 /*		BMA020 Sysfs	  				         */
 /*************************************************************************/
@@ -124,8 +233,16 @@ static ssize_t bma020_calibration(struct device *dev, struct device_attribute *a
 	return size;
 }
 
+static ssize_t bma020_batch_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "period %lld ns, watermark %u, queued %u, dropped %u\n",
+			ktime_to_ns(acc_batch.period), acc_batch.watermark,
+			acc_batch.count, acc_batch.dropped);
+}
+
 static DEVICE_ATTR(calibration, S_IRUGO | S_IWUSR | S_IWGRP , NULL, bma020_calibration);
 static DEVICE_ATTR(acc_file, S_IRUGO | S_IWUSR | S_IWGRP, bma020_fs_read, bma020_fs_write);
+static DEVICE_ATTR(batch, S_IRUGO, bma020_batch_show, NULL);
 
 
 #if 0
@@ -146,9 +263,50 @@ int bma020_open (struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/* returns as many queued samples as fit in buf, see BMA020_SET_BATCH */
 ssize_t bma020_read(struct file *filp, char *buf, size_t count, loff_t *f_pos)
 {
-	return 0;
+	unsigned int n, i;
+	ssize_t ret;
+	int err;
+
+	n = min_t(size_t, count / sizeof(struct bma020_sample), BMA020_BATCH_SIZE);
+	if (n == 0 || acc_batch.watermark == 0)
+		return 0;
+
+	if (!bma020_batch_ready()) {
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		err = wait_event_interruptible(acc_batch.wait,
+				bma020_batch_ready() || acc_batch.watermark == 0);
+		if (err)
+			return err;
+	}
+
+	mutex_lock(&acc_batch.read_lock);
+
+	spin_lock_irq(&acc_batch.lock);
+	n = min(n, acc_batch.count);
+	for (i = 0; i < n; i++)
+		acc_batch.out[i] = acc_batch.ring[(acc_batch.head + i) % BMA020_BATCH_SIZE];
+	acc_batch.head = (acc_batch.head + n) % BMA020_BATCH_SIZE;
+	acc_batch.count -= n;
+	spin_unlock_irq(&acc_batch.lock);
+
+	ret = n * sizeof(struct bma020_sample);
+	if (copy_to_user(buf, acc_batch.out, ret))
+		ret = -EFAULT;
+
+	mutex_unlock(&acc_batch.read_lock);
+
+	return ret;
+}
+
+static unsigned int bma020_poll(struct file *filp, poll_table *wait)
+{
+	poll_wait(filp, &acc_batch.wait, wait);
+
+	return bma020_batch_ready() ? POLLIN | POLLRDNORM : 0;
 }
 
 ssize_t bma020_write (struct file *filp, const char *buf, size_t count, loff_t *f_pos)
@@ -160,6 +318,12 @@ ssize_t bma020_write (struct file *filp, const char *buf, size_t count, loff_t *
 int bma020_release (struct inode *inode, struct file *filp)
 {
 	printk("%s \n",__func__); 
+
+	if (acc_batch.watermark) {
+		struct bma020_batch off = { 0, 0 };
+
+		bma020_batch_set(&off);
+	}
 	
 	return 0;
 }
@@ -221,6 +385,7 @@ int bma020_ioctl(struct inode *inode, struct file *filp, unsigned int cmd,  unsi
 	unsigned char data[6];	
 	int temp;
 	bma020acc_t accels;
+	struct bma020_batch batch;
 	
 	/* check cmd */
 	if(_IOC_TYPE(cmd) != BMA020_IOC_MAGIC)
@@ -305,6 +470,17 @@ int bma020_ioctl(struct inode *inode, struct file *filp, unsigned int cmd,  unsi
 			}
 			err = bma020_set_bandwidth(*data);
 			return err;
+
+		case BMA020_SET_BATCH:
+			if(copy_from_user(&batch,(struct bma020_batch*)arg,sizeof(batch))!=0)
+			{
+#if DEBUG
+				printk("[BMA020] copy_from_user error\n");
+#endif
+				return -EFAULT;
+			}
+			err = bma020_batch_set(&batch);
+			return err;
 			
 		/* offset calibration routine */			
 		case BMA020_CALIBRATION:
@@ -330,6 +506,7 @@ struct file_operations acc_fops =
 	.read    = bma020_read,
 	.write   = bma020_write,
 	.open    = bma020_open,
+	.poll    = bma020_poll,
 	.ioctl   = bma020_ioctl,
 	.release = bma020_release,
 };
@@ -422,7 +599,8 @@ int bma020_acc_start(void)
 	if (IS_ERR(dev_t)) 
 	{
 		printk("[BMA020] device_create error");
-		return PTR_ERR(dev_t);
+		result = PTR_ERR(dev_t);
+		goto err_device;
 	}
 	
 	if (device_create_file(dev_t, &dev_attr_acc_file) < 0)
@@ -430,13 +608,30 @@ int bma020_acc_start(void)
 		
 	if (device_create_file(dev_t, &dev_attr_calibration) < 0)
 		printk("Failed to create device file(%s)!\n", dev_attr_calibration.attr.name);
+
+	if (device_create_file(dev_t, &dev_attr_batch) < 0)
+		printk("Failed to create device file(%s)!\n", dev_attr_batch.attr.name);
+
+	spin_lock_init(&acc_batch.lock);
+	mutex_init(&acc_batch.read_lock);
+	init_waitqueue_head(&acc_batch.wait);
+	hrtimer_init(&acc_batch.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	acc_batch.timer.function = bma020_batch_timer;
+	INIT_WORK(&acc_batch.work, bma020_batch_work);
+	acc_batch.wq = create_singlethread_workqueue("bma020_wq");
+	if (!acc_batch.wq)
+	{
+		printk("[BMA020] create_singlethread_workqueue error");
+		result = -ENOMEM;
+		goto err_wq;
+	}
 	
 	result = i2c_acc_bma020_init();
 
 	if(result)
 	{
 		printk("[BMA020] i2c_acc_bma020_init error");
-		return result;
+		goto err_i2c;
 	}
 
 	bma020_chip_init();
@@ -468,10 +663,22 @@ int bma020_acc_start(void)
 	gprintk("[BMA020] set_mode BMA020_MODE_SLEEP\n");
 	
 	return 0;
+
+err_i2c:
+	destroy_workqueue(acc_batch.wq);
+err_wq:
+	device_destroy( acc_class, MKDEV(BMA150_MAJOR, 0) );
+err_device:
+	class_destroy( acc_class );
+	unregister_chrdev( BMA150_MAJOR, ACC_DEV_NAME);
+	return result;
 }
 
 void bma020_acc_end(void)
 {
+	bma020_batch_stop();
+	destroy_workqueue(acc_batch.wq);
+
 	unregister_chrdev( BMA150_MAJOR, "accelerometer" );
 	
 	i2c_acc_bma020_exit();
@@ -528,6 +735,8 @@ static int bma020_accelerometer_probe( struct platform_device* pdev )
 static int bma020_accelerometer_suspend( struct platform_device* pdev, pm_message_t state )
 {
 	printk(" %s \n",__func__); 
+	if (acc_batch.watermark)
+		bma020_batch_stop();
 	bma020_set_mode( BMA020_MODE_SLEEP );
 	return 0;
 }
@@ -537,6 +746,8 @@ static int bma020_accelerometer_resume( struct platform_device* pdev )
 {
 	printk(" %s \n",__func__); 
 	bma020_set_mode( BMA020_MODE_NORMAL );
+	if (acc_batch.watermark)
+		hrtimer_start(&acc_batch.timer, acc_batch.period, HRTIMER_MODE_REL);
 	return 0;
 }
 
@@ -56,6 +56,19 @@
 #define AXISDATA_REG    0x28
 
 #define STATUS_REG		0x27	
+#define FIFO_CTRL_REG		0x2E	/* fifo mode and watermark */
+#define FIFO_SRC_REG		0x2F	/* fifo status */
+
+#define AUTO_INCREMENT		0x80	/* sub address auto increment */
+#define FIFO_ENABLE		0x40	/* CTRL_REG5 */
+
+#define FIFO_MODE_BYPASS	0x00
+#define FIFO_MODE_STREAM	0x40
+#define FIFO_WTM_MASK		0x1f
+
+#define FIFO_SRC_OVRN		0x40
+#define FIFO_SRC_EMPTY		0x20
+#define FIFO_SRC_FSS		0x1f
 
 #define PM_OFF			0x00
 #define PM_NORMAL		0x08
@@ -75,7 +88,7 @@
 #define MIN_ST			175
 #define MAX_ST			875
 
-#define MAX_ENTRY	1
+#define MAX_ENTRY	32	/* fifo depth */
 #define MAX_DELAY	(MAX_ENTRY * 9523809LL)
 
 
@@ -129,6 +142,9 @@ struct l3g4200d_data {
 	u8 ctrl_regs[5];	/* saving register settings */
 	u32 time_to_read;	/* time needed to read one entry */
 	ktime_t polling_delay;	/* polling time for timer */
+	ktime_t last_sample;	/* timestamp of the last reported entry */
+	u32 fifo_overruns;
+	u8 fifo_buf[MAX_ENTRY * 6];
 	/* u8 shift_adj; */
 };
 
@@ -147,6 +163,12 @@ static char l3g4200d_i2c_read(unsigned char reg_addr,
 				   unsigned char *data,
 				   unsigned char len);
 
+static int l3g4200d_i2c_burst_read(unsigned char reg_addr,
+				   unsigned char *data,
+				   int len);
+
+static void l3g4200d_convert(unsigned char *gyro_data, struct l3g4200d_t *data);
+
 static void l3g_report_gyro_values(void)
 {
 	struct l3g4200d_t data;	
@@ -160,16 +182,141 @@ static void l3g_report_gyro_values(void)
 
 }
 
+/* output data period selected by the DR bits of CTRL_REG1 */
+static u32 l3g_sample_period(void)
+{
+	return odr_delay_table[3 - (gyro->ctrl_regs[0] >> 6)].delay_ns;
+}
+
+/*
+ * In batch mode the fifo runs in stream mode and the timer only fires once
+ * per watermark, so one wakeup and one i2c transfer fetch every entry
+ * accumulated since the last poll.
+ */
+static ktime_t l3g_timer_delay(void)
+{
+	if (gyro->entries > 1)
+		return ns_to_ktime((u64)gyro->entries * l3g_sample_period());
+
+	return gyro->polling_delay;
+}
+
+static int l3g_fifo_config(void)
+{
+	unsigned char ctrl5, fifo_ctrl;
+	int res;
+
+	if (gyro->entries > 1) {
+		ctrl5 = gyro->ctrl_regs[4] | FIFO_ENABLE;
+		fifo_ctrl = FIFO_MODE_STREAM |
+			    ((gyro->entries - 1) & FIFO_WTM_MASK);
+	} else {
+		ctrl5 = gyro->ctrl_regs[4] & ~FIFO_ENABLE;
+		fifo_ctrl = FIFO_MODE_BYPASS;
+	}
+
+	/* going through bypass mode empties the fifo */
+	res = i2c_smbus_write_byte_data(gyro->client, FIFO_CTRL_REG,
+					FIFO_MODE_BYPASS);
+	if (!res)
+		res = i2c_smbus_write_byte_data(gyro->client, CTRL_REG5, ctrl5);
+	if (!res)
+		res = i2c_smbus_write_byte_data(gyro->client, FIFO_CTRL_REG,
+						fifo_ctrl);
+	if (res)
+		return res;
+
+	gyro->ctrl_regs[4] = ctrl5;
+	gyro->last_sample = ktime_get();
+
+	return 0;
+}
+
+/*
+ * Configure the fifo for the current batch size. If batching cannot be
+ * set up the sensor falls back to reading one sample every poll_delay.
+ * Fails only if not even that could be configured.
+ */
+static int l3g_fifo_start(void)
+{
+	int res;
+
+	res = l3g_fifo_config();
+	if (res && gyro->entries > 1) {
+		dev_err(&gyro->client->dev,
+			"fifo setup failed (%d), batching disabled\n", res);
+		gyro->entries = 1;
+		res = l3g_fifo_config();
+	}
+
+	return res;
+}
+
+/*
+ * Drain the fifo in one burst. The chip does not timestamp the entries, so
+ * they are spread evenly between the previous batch and now; the interval
+ * is bounded around the nominal output data period to ride over a late
+ * work or a restarted timer.
+ */
+static void l3g_report_gyro_fifo(void)
+{
+	struct l3g4200d_t data;
+	ktime_t now;
+	u64 step, nominal;
+	int src, count, i;
+
+	src = i2c_smbus_read_byte_data(gyro->client, FIFO_SRC_REG);
+	now = ktime_get();
+	if (src < 0 || (src & FIFO_SRC_EMPTY))
+		return;
+
+	count = src & FIFO_SRC_FSS;
+	if (src & FIFO_SRC_OVRN) {
+		count = MAX_ENTRY;
+		gyro->fifo_overruns++;
+	}
+	if (count == 0)
+		return;
+
+	if (l3g4200d_i2c_burst_read(AXISDATA_REG, gyro->fifo_buf,
+				    count * 6) < 0)
+		return;
+
+	nominal = l3g_sample_period();
+	step = ktime_to_ns(ktime_sub(now, gyro->last_sample));
+	do_div(step, count);
+	if (step < nominal / 2 || step > nominal * 2)
+		step = nominal;
+
+	for (i = 0; i < count; i++) {
+		ktime_t stamp = ktime_sub_ns(now, (count - 1 - i) * step);
+
+		l3g4200d_convert(&gyro->fifo_buf[i * 6], &data);
+
+		input_event(gyro->input_dev, EV_MSC, MSC_TIMESTAMP,
+			    (u32)ktime_to_us(stamp));
+		input_report_rel(gyro->input_dev, REL_RX, data.y);
+		input_report_rel(gyro->input_dev, REL_RY, data.p);
+		input_report_rel(gyro->input_dev, REL_RZ, data.r);
+		input_sync(gyro->input_dev);
+	}
+
+	gyro->last_sample = now;
+}
+
 static enum hrtimer_restart l3g_timer_func(struct hrtimer *timer)
 {
 	queue_work(gyro->l3g_wq, &gyro->work);
-	hrtimer_forward_now(&gyro->timer, gyro->polling_delay);
+	hrtimer_forward_now(&gyro->timer, l3g_timer_delay());
 	return HRTIMER_RESTART;
 }
 
 static void l3g_work_func(struct work_struct *work)
 {
-	l3g_report_gyro_values();
+	if (gyro->entries > 1)
+		l3g_report_gyro_fifo();
+	else
+		l3g_report_gyro_values();
 }
 
 	
@@ -205,9 +352,18 @@ static ssize_t l3g_set_enable(struct device *dev,
 
 		mdelay(300);
 
+		err = l3g_fifo_start();
+		if (err) {
+			dev_err(&gyro->client->dev,
+				"%s: failed to configure (%d)\n", __func__, err);
+			l3g4200d_set_mode(PM_OFF);
+			mutex_unlock(&gyro->lock);
+			return err;
+		}
+
 		printk("%s: Gyro_sensor Turn on \n", __func__);
 	
-		hrtimer_start(&gyro->timer, gyro->polling_delay, HRTIMER_MODE_REL);
+		hrtimer_start(&gyro->timer, l3g_timer_delay(), HRTIMER_MODE_REL);
 		printk("%s: Timer on \n", __func__);
 	} 
 	else {
@@ -248,17 +404,66 @@ static ssize_t l3g_set_delay(struct device *dev,
 
 		gyro->polling_delay = ns_to_ktime(delay_ns);
 		if (gyro->enable)
-			hrtimer_start(&gyro->timer, gyro->polling_delay, HRTIMER_MODE_REL);
+			hrtimer_start(&gyro->timer, l3g_timer_delay(), HRTIMER_MODE_REL);
 	}
 	mutex_unlock(&gyro->lock);
 
 	return size;
 }
 
+static ssize_t l3g_show_batch(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d %u\n", gyro->entries, gyro->fifo_overruns);
+}
+
+/*
+ * Number of fifo entries read per wakeup, 0 or 1 returns to polling one
+ * sample every poll_delay. In batch mode every sample is preceded by a
+ * MSC_TIMESTAMP event holding its interpolated time in microseconds.
+ */
+static ssize_t l3g_set_batch(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t size)
+{
+	unsigned long entries;
+	int res;
+
+	res = strict_strtoul(buf, 10, &entries);
+	if (res < 0)
+		return res;
+
+	if (entries > MAX_ENTRY)
+		return -EINVAL;
+
+	mutex_lock(&gyro->lock);
+
+	if (gyro->enable) {
+		hrtimer_cancel(&gyro->timer);
+		cancel_work_sync(&gyro->work);
+	}
+
+	gyro->entries = entries;
+	gyro->fifo_overruns = 0;
+
+	if (gyro->enable) {
+		res = l3g_fifo_start();
+		/* polling in place of the requested batch */
+		if (!res && gyro->entries != entries)
+			res = -EIO;
+		hrtimer_start(&gyro->timer, l3g_timer_delay(), HRTIMER_MODE_REL);
+	}
+
+	mutex_unlock(&gyro->lock);
+
+	return res ? res : size;
+}
+
 static DEVICE_ATTR(enable, S_IRUGO | S_IWUSR | S_IWGRP,
 			l3g_show_enable, l3g_set_enable);
 static DEVICE_ATTR(poll_delay, S_IRUGO | S_IWUSR | S_IWGRP,
 			l3g_show_delay, l3g_set_delay);
+static DEVICE_ATTR(batch, S_IRUGO | S_IWUSR | S_IWGRP,
+			l3g_show_batch, l3g_set_batch);
 
 /* set l3g4200d digital gyroscope bandwidth */
 int l3g4200d_set_bandwidth(char bw)
@@ -273,6 +478,9 @@ int l3g4200d_set_bandwidth(char bw)
 
 	data = data + bw;
 	res = l3g4200d_i2c_write(CTRL_REG1, &data, 1);
+	/* the batch timer takes the output data rate from here */
+	if (!res)
+		gyro->ctrl_regs[0] = data;
 	}
 	return res;
 }
@@ -298,6 +506,8 @@ int l3g4200d_set_mode(char mode)
 	data = mode + data;
 	/* printk(KERN_INFO "set mode CTRL_REG1=%x\n",data); */
 	res = l3g4200d_i2c_write(CTRL_REG1, &data, 1);
+	if (!res)
+		gyro->ctrl_regs[0] = data;
 	}
 	return res;
 }
@@ -314,6 +524,8 @@ int l3g4200d_set_range(char range)
 		
 	data = range + data;	
 	res = l3g4200d_i2c_write(CTRL_REG4, &data, 1);
+	if (!res)
+		gyro->ctrl_regs[3] = data;
 	}
 	return res;
 }
@@ -323,11 +535,21 @@ int l3g4200d_read_gyro_values(struct l3g4200d_t *data)
 {
 	int res;
 	unsigned char gyro_data[6];
+
+	res = l3g4200d_i2c_burst_read(AXISDATA_REG, &gyro_data[0], 6);
+	if (res < 0)
+		return res;
+
+	l3g4200d_convert(gyro_data, data);
+
+	return 0;
+}
+
+static void l3g4200d_convert(unsigned char *gyro_data, struct l3g4200d_t *data)
+{
 	/* x,y,z hardware data */
 	int hw_d[3] = { 0 };
 
-	res = l3g4200d_i2c_read(AXISDATA_REG, &gyro_data[0], 6);
-
 	hw_d[0] = (short) (((gyro_data[1]) << 8) | gyro_data[0]);
 	hw_d[1] = (short) (((gyro_data[3]) << 8) | gyro_data[2]);
 	hw_d[2] = (short) (((gyro_data[5]) << 8) | gyro_data[4]);
@@ -355,7 +577,6 @@ int l3g4200d_read_gyro_values(struct l3g4200d_t *data)
 #endif
 
 //	printk(KERN_INFO "read x=%d, y=%d, z=%d\n", data->y, data->p, data->r); 
-	return res;
 }
 
 
@@ -370,6 +591,8 @@ static int device_init(void)
 	buf[3] = 0x10;
 	buf[4] = 0x00;
 	res = l3g4200d_i2c_write(CTRL_REG1, &buf[0], 5);
+	if (!res)
+		memcpy(gyro->ctrl_regs, buf, sizeof(gyro->ctrl_regs));
 	return res;
 }
 
@@ -419,6 +642,41 @@ static char l3g4200d_i2c_read(unsigned char reg_addr,
 	return dummy;
 }
 
+/*
+ * Multi byte read in a single transfer. With the fifo enabled the sub
+ * address wraps from OUT_Z_H back to OUT_X_L, so this drains several
+ * entries at once.
+ */
+static int l3g4200d_i2c_burst_read(unsigned char reg_addr,
+				   unsigned char *data,
+				   int len)
+{
+	unsigned char addr = reg_addr | AUTO_INCREMENT;
+	struct i2c_msg msg[2];
+	int res;
+
+	if (gyro->client == NULL)  /*  No global client pointer? */
+		return -1;
+
+	msg[0].addr = gyro->client->addr;
+	msg[0].flags = 0;
+	msg[0].len = 1;
+	msg[0].buf = &addr;
+
+	msg[1].addr = gyro->client->addr;
+	msg[1].flags = I2C_M_RD;
+	msg[1].len = len;
+	msg[1].buf = data;
+
+	res = i2c_transfer(gyro->client->adapter, msg, 2);
+	if (res != 2) {
+		printk(KERN_INFO" i2c burst read error\n ");
+		return res < 0 ? res : -EIO;
+	}
+
+	return len;
+}
+
 /*  read command for l3g4200d device file  */
 static ssize_t l3g4200d_read(struct file *file, char __user *buf,
 				  size_t count, loff_t *offset)
@@ -984,6 +1242,8 @@ static int l3g4200d_probe(struct i2c_client *client,
 	/* Z */
 	input_set_capability(input_dev, EV_REL, REL_RZ);
 	input_set_abs_params(input_dev, REL_RZ, -32768, 32768, 0, 0);
+	/* batch mode sample time */
+	input_set_capability(input_dev, EV_MSC, MSC_TIMESTAMP);
 
 	err = input_register_device(input_dev);
 	if (err < 0) {
@@ -1000,6 +1260,11 @@ static int l3g4200d_probe(struct i2c_client *client,
 		pr_err("Failed to create device file(%s)!\n", dev_attr_poll_delay.attr.name);
 		goto err_device_create_file2;
 	}
+
+	if (device_create_file(&input_dev->dev, &dev_attr_batch) < 0) {
+		pr_err("Failed to create device file(%s)!\n", dev_attr_batch.attr.name);
+		goto err_device_create_file3;
+	}
 	dev_set_drvdata(&input_dev->dev, data);
 
 	/* create l3g-dev device class */
@@ -1042,6 +1307,9 @@ error_destroy:
 	class_destroy(l3g_gyro_dev_class);
 out_unreg_chrdev:
 	unregister_chrdev(L3G4200D_MAJOR, "l3g4200d");
+	device_remove_file(&input_dev->dev, &dev_attr_batch);
+err_device_create_file3:
+	device_remove_file(&input_dev->dev, &dev_attr_poll_delay);
 err_device_create_file2:	
 	device_remove_file(&input_dev->dev, &dev_attr_enable);
 err_device_create_file:
@@ -1072,6 +1340,7 @@ static int l3g4200d_remove(struct i2c_client *client)
 
 	device_remove_file(&lis->input_dev->dev, &dev_attr_enable);
 	device_remove_file(&lis->input_dev->dev, &dev_attr_poll_delay);
+	device_remove_file(&lis->input_dev->dev, &dev_attr_batch);
 
 	printk(KERN_INFO "Sono in out\n");
 	device_destroy(l3g_gyro_dev_class, MKDEV(L3G4200D_MAJOR, 0));
@@ -1139,7 +1408,12 @@ static int l3g4200d_resume(struct i2c_client *client)
 	if (gyro->enable) {
 		mutex_lock(&gyro->lock);
 
-		hrtimer_start(&gyro->timer,gyro->polling_delay, HRTIMER_MODE_REL);
+		if (!l3g_fifo_start())
+			hrtimer_start(&gyro->timer, l3g_timer_delay(),
+				      HRTIMER_MODE_REL);
+		else
+			dev_err(&gyro->client->dev,
+				"failed to configure on resume\n");
 
 		mutex_unlock(&gyro->lock);
 	}
@@ -21,29 +21,55 @@
 #include <linux/string.h>
 #include <linux/uaccess.h>
 #include <linux/io.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/mutex.h>
+#include <linux/vmalloc.h>
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 #include <linux/rslib.h>
 #endif
 
+/*
+ * The buffer holds one write area per possible CPU, each a ring of fixed
+ * size records. A record carries a sequence number within its area, a
+ * global one, the time it was opened and up to RAM_CONSOLE_TEXT_SIZE bytes
+ * of console text, followed by its own parity when error correction is
+ * enabled. Writes append to the open record of the current CPU and only
+ * re-encode that record, and nothing but the records needs to be updated:
+ * the write position is recovered from the sequence numbers.
+ *
+ * Console writes are serialized by the console semaphore, so the global
+ * sequence needs no locking. A record is closed as soon as another area
+ * has been written, so that ordering by the global sequence gives the
+ * order the text was written in.
+ *
+ * The previous buffer is only copied at boot. It is corrected, ordered
+ * and turned back into text on the first read of /proc/last_kmsg.
+ */
 struct ram_console_buffer {
 	uint32_t    sig;
-	uint32_t    start;
-	uint32_t    size;
+	uint16_t    areas;
+	uint16_t    slot_size;
+	uint32_t    records;	/* per area */
 	uint8_t     data[0];
 };
 
-#define RAM_CONSOLE_SIG (0x43474244) /* DBGC */
+#define RAM_CONSOLE_SIG (0x52474244) /* DBGR */
 
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_EARLY_INIT
-static char __initdata
-	ram_console_old_log_init_buffer[CONFIG_ANDROID_RAM_CONSOLE_EARLY_SIZE];
-#endif
-static char *ram_console_old_log;
-static size_t ram_console_old_log_size;
+struct ram_console_record {
+	uint16_t    magic;
+	uint16_t    len;
+	uint32_t    seq;	/* within the area */
+	uint32_t    gseq;	/* across all areas */
+	uint32_t    sec;
+	uint32_t    nsec;
+	char        text[0];
+};
+
+#define RAM_CONSOLE_RECORD_MAGIC (0x5243) /* RC */
 
-static struct ram_console_buffer *ram_console_buffer;
-static size_t ram_console_buffer_size;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 static char *ram_console_par_buffer;
 static struct rs_control *ram_console_rs_decoder;
@@ -53,8 +79,46 @@ static int ram_console_bad_blocks;
 #define ECC_SIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_ECC_SIZE
 #define ECC_SYMSIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_SYMBOL_SIZE
 #define ECC_POLY CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_POLYNOMIAL
+#define RAM_CONSOLE_RECORD_SIZE ECC_BLOCK_SIZE
+#else
+#define ECC_SIZE 0
+#define RAM_CONSOLE_RECORD_SIZE 128
 #endif
 
+#define RAM_CONSOLE_TEXT_SIZE \
+	(RAM_CONSOLE_RECORD_SIZE - sizeof(struct ram_console_record))
+#define RAM_CONSOLE_SLOT_SIZE ALIGN(RAM_CONSOLE_RECORD_SIZE + ECC_SIZE, 4)
+#define RAM_CONSOLE_HEADER_SIZE \
+	ALIGN(sizeof(struct ram_console_buffer) + ECC_SIZE, 4)
+
+struct ram_console_area {
+	uint8_t				*slots;
+	struct ram_console_record	*rec;	/* record being filled */
+	unsigned int			slot;
+	unsigned int			len;
+	uint32_t			seq;
+};
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_EARLY_INIT
+static char __initdata
+	ram_console_old_log_init_buffer[CONFIG_ANDROID_RAM_CONSOLE_EARLY_SIZE];
+#endif
+static char *ram_console_old_log;
+static size_t ram_console_old_log_size;
+
+/* raw copy of the previous buffer, decoded on first read */
+static uint8_t *ram_console_old_slots;
+static unsigned int ram_console_old_areas;
+static unsigned int ram_console_old_records;
+static DEFINE_MUTEX(ram_console_old_lock);
+
+static struct ram_console_buffer *ram_console_buffer;
+static size_t ram_console_buffer_size;
+static struct ram_console_area ram_console_areas[NR_CPUS];
+static struct ram_console_area *ram_console_last_area;
+static uint32_t ram_console_gseq;
+static unsigned int ram_console_records;
+
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 static void ram_console_encode_rs8(uint8_t *data, size_t len, uint8_t *ecc)
 {
@@ -78,27 +142,11 @@ static int ram_console_decode_rs8(void *data, size_t len, uint8_t *ecc)
 }
 #endif
 
-static void ram_console_update(const char *s, unsigned int count)
+static void ram_console_update(struct ram_console_record *rec)
 {
-	struct ram_console_buffer *buffer = ram_console_buffer;
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	uint8_t *buffer_end = buffer->data + ram_console_buffer_size;
-	uint8_t *block;
-	uint8_t *par;
-	int size = ECC_BLOCK_SIZE;
-#endif
-	memcpy(buffer->data + buffer->start, s, count);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	block = buffer->data + (buffer->start & ~(ECC_BLOCK_SIZE - 1));
-	par = ram_console_par_buffer +
-	      (buffer->start / ECC_BLOCK_SIZE) * ECC_SIZE;
-	do {
-		if (block + ECC_BLOCK_SIZE > buffer_end)
-			size = buffer_end - block;
-		ram_console_encode_rs8(block, size, par);
-		block += ECC_BLOCK_SIZE;
-		par += ECC_SIZE;
-	} while (block < buffer->data + buffer->start + count);
+	ram_console_encode_rs8((uint8_t *)rec, RAM_CONSOLE_RECORD_SIZE,
+			       (uint8_t *)rec + RAM_CONSOLE_RECORD_SIZE);
 #endif
 }
 
@@ -106,37 +154,62 @@ static void ram_console_update_header(void)
 {
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	struct ram_console_buffer *buffer = ram_console_buffer;
-	uint8_t *par;
-	par = ram_console_par_buffer +
-	      DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE) * ECC_SIZE;
-	ram_console_encode_rs8((uint8_t *)buffer, sizeof(*buffer), par);
+	ram_console_encode_rs8((uint8_t *)buffer, sizeof(*buffer),
+			       ram_console_par_buffer);
 #endif
 }
 
+static struct ram_console_record *
+ram_console_open_record(struct ram_console_area *area, int cpu)
+{
+	struct ram_console_record *rec;
+	unsigned long long t;
+	unsigned long nsec;
+
+	if (area->rec)
+		area->slot = (area->slot + 1) % ram_console_records;
+	rec = (struct ram_console_record *)
+		(area->slots + area->slot * RAM_CONSOLE_SLOT_SIZE);
+
+	t = cpu_clock(cpu);
+	nsec = do_div(t, NSEC_PER_SEC);
+
+	rec->magic = RAM_CONSOLE_RECORD_MAGIC;
+	rec->len = 0;
+	rec->seq = ++area->seq;
+	rec->gseq = ++ram_console_gseq;
+	rec->sec = t;
+	rec->nsec = nsec;
+
+	area->rec = rec;
+	area->len = 0;
+	return rec;
+}
+
 static void
 ram_console_write(struct console *console, const char *s, unsigned int count)
 {
-	int rem;
-	struct ram_console_buffer *buffer = ram_console_buffer;
-
-	if (count > ram_console_buffer_size) {
-		s += count - ram_console_buffer_size;
-		count = ram_console_buffer_size;
-	}
-	rem = ram_console_buffer_size - buffer->start;
-	if (rem < count) {
-		ram_console_update(s, rem);
-		s += rem;
-		count -= rem;
-		buffer->start = 0;
-		buffer->size = ram_console_buffer_size;
+	int cpu = smp_processor_id();
+	struct ram_console_area *area = &ram_console_areas[cpu];
+	struct ram_console_record *rec = area->rec;
+	unsigned int len;
+
+	while (count) {
+		if (!rec || area->len == RAM_CONSOLE_TEXT_SIZE ||
+		    ram_console_last_area != area)
+			rec = ram_console_open_record(area, cpu);
+		ram_console_last_area = area;
+
+		len = min_t(unsigned int, count,
+			    RAM_CONSOLE_TEXT_SIZE - area->len);
+		memcpy(rec->text + area->len, s, len);
+		area->len += len;
+		rec->len = area->len;
+		ram_console_update(rec);
+
+		s += len;
+		count -= len;
 	}
-	ram_console_update(s, count);
-
-	buffer->start += count;
-	if (buffer->size < ram_console_buffer_size)
-		buffer->size += count;
-	ram_console_update_header();
 }
 
 static struct console ram_console = {
@@ -154,71 +227,140 @@ void ram_console_enable_console(int enabled)
 		ram_console.flags &= ~CON_ENABLED;
 }
 
+/* Copies the records of the previous boot, decoding is left to the reader */
 static void __init
 ram_console_save_old(struct ram_console_buffer *buffer, char *dest)
 {
-	size_t old_log_size = buffer->size;
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	uint8_t *block;
-	uint8_t *par;
+	size_t size = buffer->areas * buffer->records * RAM_CONSOLE_SLOT_SIZE;
+
+	if (dest == NULL) {
+		dest = vmalloc(size);
+		if (dest == NULL) {
+			printk(KERN_ERR
+			       "ram_console: failed to allocate buffer\n");
+			return;
+		}
+	}
+
+	memcpy(dest, (uint8_t *)buffer + RAM_CONSOLE_HEADER_SIZE, size);
+	ram_console_old_slots = dest;
+	ram_console_old_areas = buffer->areas;
+	ram_console_old_records = buffer->records;
+}
+
+struct ram_console_old_record {
+	struct ram_console_record	*rec;
+	unsigned int			area;
+};
+
+static int ram_console_cmp(const void *a, const void *b)
+{
+	const struct ram_console_record *ra =
+		((const struct ram_console_old_record *)a)->rec;
+	const struct ram_console_record *rb =
+		((const struct ram_console_old_record *)b)->rec;
+
+	return (int)(ra->gseq - rb->gseq);
+}
+
+/*
+ * Corrects the saved records, orders them as written and concatenates their
+ * text into ram_console_old_log. Called with ram_console_old_lock held.
+ */
+static void ram_console_decode_old(void)
+{
+	struct ram_console_old_record *old;
+	struct ram_console_record *rec;
+	unsigned int nr_slots = ram_console_old_areas * ram_console_old_records;
+	unsigned int nr = 0, lost = 0, i;
+	uint32_t *last_seq;
+	uint8_t *slot;
 	char strbuf[80];
 	int strbuf_len;
+	char *dest;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	int numerr;
+#endif
 
-	block = buffer->data;
-	par = ram_console_par_buffer;
-	while (block < buffer->data + buffer->size) {
-		int numerr;
-		int size = ECC_BLOCK_SIZE;
-		if (block + size > buffer->data + ram_console_buffer_size)
-			size = buffer->data + ram_console_buffer_size - block;
-		numerr = ram_console_decode_rs8(block, size, par);
+	old = vmalloc(nr_slots * sizeof(*old));
+	last_seq = kcalloc(ram_console_old_areas, sizeof(*last_seq),
+			   GFP_KERNEL);
+	if (old == NULL || last_seq == NULL) {
+		printk(KERN_ERR "ram_console: failed to allocate buffer\n");
+		goto out;
+	}
+
+	for (i = 0; i < nr_slots; i++) {
+		slot = ram_console_old_slots + i * RAM_CONSOLE_SLOT_SIZE;
+		rec = (struct ram_console_record *)slot;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+		/* unused slots are zero, which is a valid codeword */
+		numerr = ram_console_decode_rs8(slot, RAM_CONSOLE_RECORD_SIZE,
+						slot + RAM_CONSOLE_RECORD_SIZE);
 		if (numerr > 0) {
-#if 0
-			printk(KERN_INFO "ram_console: error in block %p, %d\n",
-			       block, numerr);
-#endif
 			ram_console_corrected_bytes += numerr;
 		} else if (numerr < 0) {
-#if 0
-			printk(KERN_INFO "ram_console: uncorrectable error in "
-			       "block %p\n", block);
-#endif
 			ram_console_bad_blocks++;
+			continue;
 		}
-		block += ECC_BLOCK_SIZE;
-		par += ECC_SIZE;
+#endif
+		if (rec->magic != RAM_CONSOLE_RECORD_MAGIC ||
+		    rec->len > RAM_CONSOLE_TEXT_SIZE || !rec->seq)
+			continue;
+		old[nr].rec = rec;
+		old[nr].area = i / ram_console_old_records;
+		nr++;
 	}
-	if (ram_console_corrected_bytes || ram_console_bad_blocks)
+
+	sort(old, nr, sizeof(*old), ram_console_cmp, NULL);
+
+	for (i = 0; i < nr; i++) {
+		rec = old[i].rec;
+		if (last_seq[old[i].area])
+			lost += rec->seq - last_seq[old[i].area] - 1;
+		last_seq[old[i].area] = rec->seq;
+		ram_console_old_log_size += rec->len;
+	}
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	if (ram_console_corrected_bytes || ram_console_bad_blocks || lost)
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
-			"\n%d Corrected bytes, %d unrecoverable blocks\n",
-			ram_console_corrected_bytes, ram_console_bad_blocks);
+			"\n%d Corrected bytes, %d unrecoverable blocks, "
+			"%u records lost\n", ram_console_corrected_bytes,
+			ram_console_bad_blocks, lost);
 	else
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
 				      "\nNo errors detected\n");
+#else
+	if (lost)
+		strbuf_len = snprintf(strbuf, sizeof(strbuf),
+				      "\n%u records lost\n", lost);
+	else
+		strbuf_len = 0;
+#endif
 	if (strbuf_len >= sizeof(strbuf))
 		strbuf_len = sizeof(strbuf) - 1;
-	old_log_size += strbuf_len;
-#endif
+	ram_console_old_log_size += strbuf_len;
 
+	dest = vmalloc(ram_console_old_log_size);
 	if (dest == NULL) {
-		dest = kmalloc(old_log_size, GFP_KERNEL);
-		if (dest == NULL) {
-			printk(KERN_ERR
-			       "ram_console: failed to allocate buffer\n");
-			return;
-		}
+		printk(KERN_ERR "ram_console: failed to allocate buffer\n");
+		ram_console_old_log_size = 0;
+		goto out;
 	}
 
 	ram_console_old_log = dest;
-	ram_console_old_log_size = old_log_size;
-	memcpy(ram_console_old_log,
-	       &buffer->data[buffer->start], buffer->size - buffer->start);
-	memcpy(ram_console_old_log + buffer->size - buffer->start,
-	       &buffer->data[0], buffer->start);
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	memcpy(ram_console_old_log + old_log_size - strbuf_len,
-	       strbuf, strbuf_len);
-#endif
+	for (i = 0; i < nr; i++) {
+		memcpy(dest, old[i].rec->text, old[i].rec->len);
+		dest += old[i].rec->len;
+	}
+	memcpy(dest, strbuf, strbuf_len);
+
+out:
+	kfree(last_seq);
+	vfree(old);
+	vfree(ram_console_old_slots);
+	ram_console_old_slots = NULL;
 }
 
 static int __init ram_console_init(struct ram_console_buffer *buffer,
@@ -226,11 +368,12 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 {
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	int numerr;
-	uint8_t *par;
 #endif
+	unsigned int areas = nr_cpu_ids;
+	int i;
+
 	ram_console_buffer = buffer;
-	ram_console_buffer_size =
-		buffer_size - sizeof(struct ram_console_buffer);
+	ram_console_buffer_size = buffer_size - RAM_CONSOLE_HEADER_SIZE;
 
 	if (ram_console_buffer_size > buffer_size) {
 		pr_err("ram_console: buffer %p, invalid size %zu, "
@@ -239,19 +382,16 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 		return 0;
 	}
 
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	ram_console_buffer_size -= (DIV_ROUND_UP(ram_console_buffer_size,
-						ECC_BLOCK_SIZE) + 1) * ECC_SIZE;
-
-	if (ram_console_buffer_size > buffer_size) {
-		pr_err("ram_console: buffer %p, invalid size %zu, "
-		       "non-ecc datasize %zu\n",
-		       buffer, buffer_size, ram_console_buffer_size);
+	ram_console_records = ram_console_buffer_size /
+			      (areas * RAM_CONSOLE_SLOT_SIZE);
+	if (ram_console_records < 2) {
+		pr_err("ram_console: buffer %p, size %zu too small for %u "
+		       "areas\n", buffer, buffer_size, areas);
 		return 0;
 	}
 
-	ram_console_par_buffer = buffer->data + ram_console_buffer_size;
-
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	ram_console_par_buffer = (char *)buffer + sizeof(*buffer);
 
 	/* first consecutive root is 0
 	 * primitive element to generate roots = 1
@@ -265,10 +405,8 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 	ram_console_corrected_bytes = 0;
 	ram_console_bad_blocks = 0;
 
-	par = ram_console_par_buffer +
-	      DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE) * ECC_SIZE;
-
-	numerr = ram_console_decode_rs8(buffer, sizeof(*buffer), par);
+	numerr = ram_console_decode_rs8(buffer, sizeof(*buffer),
+					ram_console_par_buffer);
 	if (numerr > 0) {
 		printk(KERN_INFO "ram_console: error in header, %d\n", numerr);
 		ram_console_corrected_bytes += numerr;
@@ -280,15 +418,17 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 #endif
 
 	if (buffer->sig == RAM_CONSOLE_SIG) {
-		if (buffer->size > ram_console_buffer_size
-		    || buffer->start > buffer->size)
+		if (buffer->slot_size != RAM_CONSOLE_SLOT_SIZE
+		    || !buffer->areas
+		    || buffer->records > ram_console_buffer_size /
+			(buffer->areas * RAM_CONSOLE_SLOT_SIZE))
 			printk(KERN_INFO "ram_console: found existing invalid "
-			       "buffer, size %d, start %d\n",
-			       buffer->size, buffer->start);
+			       "buffer, %d areas of %d records\n",
+			       buffer->areas, buffer->records);
 		else {
 			printk(KERN_INFO "ram_console: found existing buffer, "
-			       "size %d, start %d\n",
-			       buffer->size, buffer->start);
+			       "%d areas of %d records\n",
+			       buffer->areas, buffer->records);
 			ram_console_save_old(buffer, old_buf);
 		}
 	} else {
@@ -296,9 +436,20 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 		       "(sig = 0x%08x)\n", buffer->sig);
 	}
 
+	/* records of older boots must not show up in the next last_kmsg */
+	memset((uint8_t *)buffer + RAM_CONSOLE_HEADER_SIZE, 0,
+	       ram_console_buffer_size);
+
 	buffer->sig = RAM_CONSOLE_SIG;
-	buffer->start = 0;
-	buffer->size = 0;
+	buffer->areas = areas;
+	buffer->slot_size = RAM_CONSOLE_SLOT_SIZE;
+	buffer->records = ram_console_records;
+	ram_console_update_header();
+
+	for (i = 0; i < areas; i++)
+		ram_console_areas[i].slots = (uint8_t *)buffer +
+			RAM_CONSOLE_HEADER_SIZE +
+			i * ram_console_records * RAM_CONSOLE_SLOT_SIZE;
 
 	register_console(&ram_console);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ENABLE_VERBOSE
@@ -363,6 +514,11 @@ static ssize_t ram_console_read_old(struct file *file, char __user *buf,
 	loff_t pos = *offset;
 	ssize_t count;
 
+	mutex_lock(&ram_console_old_lock);
+	if (ram_console_old_slots)
+		ram_console_decode_old();
+	mutex_unlock(&ram_console_old_lock);
+
 	if (pos >= ram_console_old_log_size)
 		return 0;
 
@@ -382,30 +538,33 @@ static const struct file_operations ram_console_file_ops = {
 static int __init ram_console_late_init(void)
 {
 	struct proc_dir_entry *entry;
+	size_t size;
 
-	if (ram_console_old_log == NULL)
+	if (ram_console_old_slots == NULL)
 		return 0;
+	size = ram_console_old_areas * ram_console_old_records *
+	       RAM_CONSOLE_SLOT_SIZE;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_EARLY_INIT
-	ram_console_old_log = kmalloc(ram_console_old_log_size, GFP_KERNEL);
-	if (ram_console_old_log == NULL) {
+	ram_console_old_slots = vmalloc(size);
+	if (ram_console_old_slots == NULL) {
 		printk(KERN_ERR
 		       "ram_console: failed to allocate buffer for old log\n");
-		ram_console_old_log_size = 0;
 		return 0;
 	}
-	memcpy(ram_console_old_log,
-	       ram_console_old_log_init_buffer, ram_console_old_log_size);
+	memcpy(ram_console_old_slots,
+	       ram_console_old_log_init_buffer, size);
 #endif
 	entry = create_proc_entry("last_kmsg", S_IFREG | S_IRUGO, NULL);
 	if (!entry) {
 		printk(KERN_ERR "ram_console: failed to create proc entry\n");
-		kfree(ram_console_old_log);
-		ram_console_old_log = NULL;
+		vfree(ram_console_old_slots);
+		ram_console_old_slots = NULL;
 		return 0;
 	}
 
+	/* the size of the text is only known once it is decoded */
 	entry->proc_fops = &ram_console_file_ops;
-	entry->size = ram_console_old_log_size;
+	entry->size = size;
 	return 0;
 }
 
@@ -415,4 +574,3 @@ console_initcall(ram_console_early_init);
 postcore_initcall(ram_console_module_init);
 #endif
 late_initcall(ram_console_late_init);
-
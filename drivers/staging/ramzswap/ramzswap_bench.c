@@ -0,0 +1,260 @@
+/*
+ * Throughput benchmark for ramzswap devices
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Drives an initialized (but not swapped on) ramzswap device the way
+ * swap does: single page bios to page aligned slots, from several threads
+ * at once. Each thread first fills its own range of slots and then issues
+ * random reads and writes within it for the given time. Page contents mix
+ * zero, compressible and incompressible data.
+ *
+ * Like tcrypt, the module reports its results in the kernel log and then
+ * fails to load on purpose, so it can simply be loaded again.
+ *
+ *	modprobe ramzswap_bench dev=/dev/ramzswap0 threads=4 seconds=10
+ */
+
+#define KMSG_COMPONENT "ramzswap_bench"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/fs.h>
+#include <linux/highmem.h>
+#include <linux/kthread.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#define SECTORS_PER_PAGE_SHIFT	(PAGE_SHIFT - 9)
+
+static char *dev = "/dev/ramzswap0";
+static unsigned int threads;
+static unsigned int seconds = 10;
+static unsigned int slots = 1024;
+static unsigned int write_pct = 50;
+
+struct bench_thread {
+	struct task_struct *task;
+	struct block_device *bdev;
+	struct page *page;
+	unsigned int first;	/* first slot owned */
+	unsigned int nr;	/* slots owned */
+	u64 reads;
+	u64 writes;
+	u64 errors;
+	s64 usecs;
+};
+
+static void bench_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+static int bench_io(struct bench_thread *t, int rw, unsigned int slot)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bio *bio;
+	int err;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = t->bdev;
+	bio->bi_sector = (sector_t)slot << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_end_io = bench_end_io;
+	bio->bi_private = &done;
+	bio_add_page(bio, t->page, PAGE_SIZE, 0);
+
+	submit_bio(rw, bio);
+	wait_for_completion(&done);
+
+	err = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	bio_put(bio);
+
+	return err;
+}
+
+/*
+ * One page in eight is zero and one in eight random, the others repeat
+ * each random word four times and compress well.
+ */
+static void bench_fill(struct page *page)
+{
+	u32 *p = kmap(page);
+	unsigned int i, kind = random32() & 7;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(*p); i++) {
+		if (kind == 0)
+			p[i] = 0;
+		else if (kind == 1 || (i & 3) == 0)
+			p[i] = random32();
+		else
+			p[i] = p[i & ~3];
+	}
+
+	kunmap(page);
+}
+
+static int bench_thread(void *data)
+{
+	struct bench_thread *t = data;
+	unsigned int i, slot;
+	ktime_t start;
+	int rw;
+
+	for (i = 0; i < t->nr && !kthread_should_stop(); i++) {
+		bench_fill(t->page);
+		if (bench_io(t, WRITE, t->first + i))
+			t->errors++;
+	}
+
+	start = ktime_get();
+	while (!kthread_should_stop()) {
+		slot = t->first + random32() % t->nr;
+		rw = (random32() % 100) < write_pct ? WRITE : READ;
+
+		if (rw == WRITE) {
+			bench_fill(t->page);
+			t->writes++;
+		} else
+			t->reads++;
+
+		if (bench_io(t, rw, slot))
+			t->errors++;
+
+		cond_resched();
+	}
+	t->usecs = ktime_us_delta(ktime_get(), start);
+
+	return 0;
+}
+
+static int __init ramzswap_bench_init(void)
+{
+	struct block_device *bdev;
+	struct bench_thread *t;
+	unsigned int i, nr_slots;
+	u64 reads = 0, writes = 0, errors = 0;
+	s64 usecs = 0;
+	int ret = 0;
+
+	if (!threads)
+		threads = num_online_cpus();
+
+	bdev = open_bdev_exclusive(dev, FMODE_READ | FMODE_WRITE,
+				   ramzswap_bench_init);
+	if (IS_ERR(bdev)) {
+		pr_err("Cannot open %s\n", dev);
+		return PTR_ERR(bdev);
+	}
+
+	/* slot 0 holds the swap header */
+	nr_slots = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	if (nr_slots < 2 || !threads) {
+		pr_err("%s is not initialized\n", dev);
+		ret = -ENODEV;
+		goto out_close;
+	}
+	nr_slots--;
+	if (slots > nr_slots / threads)
+		slots = nr_slots / threads;
+	if (!slots) {
+		pr_err("%s too small for %u threads\n", dev, threads);
+		ret = -EINVAL;
+		goto out_close;
+	}
+
+	t = kcalloc(threads, sizeof(*t), GFP_KERNEL);
+	if (!t) {
+		ret = -ENOMEM;
+		goto out_close;
+	}
+
+	for (i = 0; i < threads; i++) {
+		t[i].bdev = bdev;
+		t[i].first = 1 + i * slots;
+		t[i].nr = slots;
+		t[i].page = alloc_page(GFP_KERNEL);
+		if (!t[i].page) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		t[i].task = kthread_run(bench_thread, &t[i],
+					"rzs_bench/%u", i);
+		if (IS_ERR(t[i].task)) {
+			ret = PTR_ERR(t[i].task);
+			t[i].task = NULL;
+			break;
+		}
+	}
+
+	if (!ret)
+		ssleep(seconds);
+
+	for (i = 0; i < threads; i++) {
+		if (!t[i].task)
+			continue;
+		kthread_stop(t[i].task);
+
+		pr_info("thread %u: %llu reads, %llu writes, %llu errors "
+			"in %lld us\n", i, t[i].reads, t[i].writes,
+			t[i].errors, t[i].usecs);
+		reads += t[i].reads;
+		writes += t[i].writes;
+		errors += t[i].errors;
+		if (t[i].usecs > usecs)
+			usecs = t[i].usecs;
+	}
+
+	if (!ret && usecs) {
+		pr_info("%s: %u threads x %u slots, %u%% writes\n",
+			dev, threads, slots, write_pct);
+		pr_info("%llu ops/s, %llu KB/s, %llu errors\n",
+			div64_u64((reads + writes) * USEC_PER_SEC, usecs),
+			div64_u64((reads + writes) * (PAGE_SIZE >> 10) *
+				  USEC_PER_SEC, usecs), errors);
+	}
+
+out_free:
+	for (i = 0; i < threads; i++) {
+		if (t[i].page)
+			__free_page(t[i].page);
+	}
+	kfree(t);
+out_close:
+	close_bdev_exclusive(bdev, FMODE_READ | FMODE_WRITE);
+
+	/* Results are in the log, do not stay loaded */
+	return ret ? ret : -EAGAIN;
+}
+
+static void __exit ramzswap_bench_exit(void)
+{
+}
+
+module_param(dev, charp, 0);
+MODULE_PARM_DESC(dev, "ramzswap device to benchmark");
+module_param(threads, uint, 0);
+MODULE_PARM_DESC(threads, "Number of I/O threads (default: online CPUs)");
+module_param(seconds, uint, 0);
+MODULE_PARM_DESC(seconds, "Duration of the random I/O phase");
+module_param(slots, uint, 0);
+MODULE_PARM_DESC(slots, "Swap slots used by each thread");
+module_param(write_pct, uint, 0);
+MODULE_PARM_DESC(write_pct, "Percentage of writes in the random I/O phase");
+
+module_init(ramzswap_bench_init);
+module_exit(ramzswap_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("ramzswap throughput benchmark");
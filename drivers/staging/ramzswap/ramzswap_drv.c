@@ -20,9 +20,12 @@
 #include <linux/bitops.h>
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
+#include <linux/completion.h>
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
 #include <linux/string.h>
@@ -35,9 +38,14 @@
 /* Globals */
 static int ramzswap_major;
 static struct ramzswap *devices;
+static struct kmem_cache *dedup_cache;
+static struct workqueue_struct *writeback_wq;
 
 /* Module params (documentation at end) */
 static unsigned int num_devices;
+static int dedup = 1;
+static int zsmalloc;
+static unsigned int compact_interval = 10000;
 
 static int rzs_test_flag(struct ramzswap *rzs, u32 index,
 			enum rzs_pageflags flag)
@@ -57,21 +65,214 @@ static void rzs_clear_flag(struct ramzswap *rzs, u32 index,
 	rzs->table[index].flags &= ~BIT(flag);
 }
 
-static int page_zero_filled(void *ptr)
+static void rzs_table_lock(struct ramzswap *rzs, u32 index)
+{
+	spin_lock(&rzs->table_lock[index & (RZS_TABLE_LOCKS - 1)]);
+}
+
+static void rzs_table_unlock(struct ramzswap *rzs, u32 index)
+{
+	spin_unlock(&rzs->table_lock[index & (RZS_TABLE_LOCKS - 1)]);
+}
+
+/*
+ * Writers take the stream of the CPU they run on. They may sleep while
+ * holding it to allocate memory, so each stream has a mutex for the rare
+ * case another writer starts on the same CPU meanwhile.
+ */
+static struct ramzswap_stream *rzs_stream_get(struct ramzswap *rzs)
+{
+	struct ramzswap_stream *stream;
+
+	stream = per_cpu_ptr(rzs->streams, raw_smp_processor_id());
+	mutex_lock(&stream->lock);
+
+	return stream;
+}
+
+static void rzs_stream_put(struct ramzswap_stream *stream)
+{
+	mutex_unlock(&stream->lock);
+}
+
+/*
+ * Pages filled with a single repeated word (zero being the most common)
+ * are not compressed at all, the word is kept in the table entry.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
+/*
+ * Compressed objects come from the zsmalloc pool of the device if it has
+ * one, from its xvmalloc pool otherwise.
+ */
+static int rzs_obj_alloc(struct ramzswap *rzs, u32 size,
+			unsigned long *handle, u32 *offset)
+{
+	struct page *page;
+
+	if (rzs->zs_pool) {
+		*handle = zs_malloc(rzs->zs_pool, size,
+				    GFP_NOIO | __GFP_HIGHMEM);
+		*offset = 0;
+		return *handle ? 0 : -ENOMEM;
+	}
+
+	if (xv_malloc(rzs->mem_pool, size, &page, offset,
+			GFP_NOIO | __GFP_HIGHMEM))
+		return -ENOMEM;
+
+	*handle = (unsigned long)page;
+	return 0;
+}
+
+/*
+ * Compaction only runs once a free left a zspage worth of unused space,
+ * an idle device does not wake the cpu for it.
+ */
+static void rzs_obj_free(struct ramzswap *rzs, unsigned long handle,
+			u32 offset)
+{
+	if (!rzs->zs_pool) {
+		xv_free(rzs->mem_pool, (struct page *)handle, offset);
+		return;
+	}
+
+	if (zs_free(rzs->zs_pool, handle) && rzs->init_done &&
+			compact_interval)
+		schedule_delayed_work(&rzs->compact_work,
+				      msecs_to_jiffies(compact_interval));
+}
+
+/* Maps the object with the KM_USER1 slot */
+static void *rzs_obj_map(struct ramzswap *rzs, unsigned long handle,
+			u32 offset, enum zs_mapmode mm)
+{
+	if (rzs->zs_pool)
+		return zs_map_object(rzs->zs_pool, handle, mm);
+
+	return kmap_atomic((struct page *)handle, KM_USER1) + offset;
+}
+
+static void rzs_obj_unmap(struct ramzswap *rzs, unsigned long handle,
+			void *cmem)
+{
+	if (rzs->zs_pool)
+		zs_unmap_object(rzs->zs_pool, handle);
+	else
+		kunmap_atomic(cmem, KM_USER1);
+}
+
+/* Size the object was allocated with, uses the KM_USER0 slot */
+static u32 rzs_obj_size(struct ramzswap *rzs, unsigned long handle,
+			u32 offset)
+{
+	void *obj;
+	u32 size;
+
+	if (rzs->zs_pool)
+		return zs_get_object_size(rzs->zs_pool, handle);
+
+	obj = kmap_atomic((struct page *)handle, KM_USER0) + offset;
+	size = xv_get_object_size(obj);
+	kunmap_atomic(obj, KM_USER0);
+
+	return size;
+}
+
+/*
+ * Returns the handle and offset of the object of a slot which is neither
+ * RZS_SAME nor RZS_UNCOMPRESSED. Called with the table entry locked.
+ */
+static unsigned long rzs_object(struct ramzswap *rzs, u32 index,
+			u32 *offset)
+{
+	struct rzs_dedup *node;
+
+	if (rzs_test_flag(rzs, index, RZS_DEDUP)) {
+		node = rzs->table[index].dedup;
+		*offset = node->offset;
+		return node->handle;
+	}
+
+	*offset = rzs->table[index].offset;
+	return rzs->table[index].handle;
+}
+
+/*
+ * Look for a stored object with the same compressed content. Called with
+ * dedup_lock held.
+ */
+static struct rzs_dedup *rzs_dedup_find(struct ramzswap *rzs,
+			const unsigned char *src, size_t clen, u32 hash)
+{
+	struct rzs_dedup *node;
+	struct hlist_node *pos;
+	unsigned char *cmem;
+	int match;
+
+	hlist_for_each_entry(node, pos,
+			&rzs->dedup_table[hash & ((1 << rzs->dedup_bits) - 1)],
+			hash_node) {
+		if (node->hash != hash || node->size != clen)
+			continue;
+
+		cmem = rzs_obj_map(rzs, node->handle, node->offset, ZS_MM_RO);
+		match = !memcmp(cmem + sizeof(struct zobj_header), src, clen);
+		rzs_obj_unmap(rzs, node->handle, cmem);
+
+		if (match)
+			return node;
+	}
+
+	return NULL;
+}
+
+static void rzs_dedup_insert(struct ramzswap *rzs, struct rzs_dedup *node)
+{
+	hlist_add_head(&node->hash_node,
+		&rzs->dedup_table[node->hash & ((1 << rzs->dedup_bits) - 1)]);
+}
+
+/*
+ * Slots stored in memory are kept in LRU order when there is a backing
+ * swap device. Called with the table entry locked. Slot 0 holds the swap
+ * header set up by init, which is not accounted in the stats, so it is
+ * never written back.
+ */
+static void rzs_lru_add(struct ramzswap *rzs, u32 index)
+{
+	if (!rzs->lru_nodes || !index)
+		return;
+
+	spin_lock(&rzs->lru_lock);
+	list_move(&rzs->lru_nodes[index], &rzs->lru);
+	spin_unlock(&rzs->lru_lock);
+}
+
+static void rzs_lru_del(struct ramzswap *rzs, u32 index)
+{
+	if (!rzs->lru_nodes)
+		return;
+
+	spin_lock(&rzs->lru_lock);
+	list_del_init(&rzs->lru_nodes[index]);
+	spin_unlock(&rzs->lru_lock);
+}
+
 static void ramzswap_set_disksize(struct ramzswap *rzs, size_t totalram_bytes)
 {
 	if (!rzs->disksize) {
@@ -126,8 +327,11 @@ static void ramzswap_ioctl_get_stats(struct ramzswap *rzs,
 	size_t succ_writes, mem_used;
 	unsigned int good_compress_perc = 0, no_compress_perc = 0;
 
-	mem_used = xv_get_total_size_bytes(rzs->mem_pool)
-			+ (rs->pages_expand << PAGE_SHIFT);
+	if (rzs->zs_pool)
+		mem_used = zs_get_total_size_bytes(rzs->zs_pool);
+	else
+		mem_used = xv_get_total_size_bytes(rzs->mem_pool);
+	mem_used += rs->pages_expand << PAGE_SHIFT;
 	succ_writes = rzs_stat64_read(rzs, &rs->num_writes) -
 			rzs_stat64_read(rzs, &rs->failed_writes);
 
@@ -145,6 +349,9 @@ static void ramzswap_ioctl_get_stats(struct ramzswap *rzs,
 	s->invalid_io = rzs_stat64_read(rzs, &rs->invalid_io);
 	s->notify_free = rzs_stat64_read(rzs, &rs->notify_free);
 	s->pages_zero = rs->pages_zero;
+	s->pages_same = rs->pages_same;
+	s->pages_dedup = rs->pages_dedup;
+	s->dedup_hits = rzs_stat64_read(rzs, &rs->dedup_hits);
 
 	s->good_compress_pct = good_compress_perc;
 	s->pages_expand_pct = no_compress_perc;
@@ -154,86 +361,116 @@ static void ramzswap_ioctl_get_stats(struct ramzswap *rzs,
 	s->orig_data_size = rs->pages_stored << PAGE_SHIFT;
 	s->compr_data_size = rs->compr_size;
 	s->mem_used_total = mem_used;
+	if (rzs->zs_pool)
+		s->pages_compacted = zs_get_compacted_pages(rzs->zs_pool);
+
+	s->memlimit = rzs->memlimit;
+	s->bdev_num_reads = rzs_stat64_read(rzs, &rs->bdev_num_reads);
+	s->bdev_num_writes = rzs_stat64_read(rzs, &rs->bdev_num_writes);
+	s->pages_backed = rs->pages_backed;
 	}
 #endif /* CONFIG_RAMZSWAP_STATS */
 }
 
+/* Called with the table entry locked */
 static void ramzswap_free_page(struct ramzswap *rzs, size_t index)
 {
-	u32 clen;
-	void *obj;
-
-	struct page *page = rzs->table[index].page;
-	u32 offset = rzs->table[index].offset;
+	u32 clen, offset;
+	unsigned long handle;
+	struct rzs_dedup *node;
+
+	rzs_lru_del(rzs, index);
+	rzs_clear_flag(rzs, index, RZS_WRITEBACK);
+
+	/* Page is only on the backing swap, nothing to free */
+	if (rzs_test_flag(rzs, index, RZS_BACKED)) {
+		rzs_clear_flag(rzs, index, RZS_BACKED);
+		spin_lock(&rzs->stat_lock);
+		rzs_stat_dec(&rzs->stats.pages_backed);
+		spin_unlock(&rzs->stat_lock);
+		return;
+	}
 
-	if (unlikely(!page)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (rzs_test_flag(rzs, index, RZS_ZERO)) {
-			rzs_clear_flag(rzs, index, RZS_ZERO);
+	/*
+	 * No memory is allocated for same filled pages.
+	 * Simply clear the flag.
+	 */
+	if (rzs_test_flag(rzs, index, RZS_SAME)) {
+		rzs_clear_flag(rzs, index, RZS_SAME);
+		spin_lock(&rzs->stat_lock);
+		if (rzs->table[index].element)
+			rzs_stat_dec(&rzs->stats.pages_same);
+		else
 			rzs_stat_dec(&rzs->stats.pages_zero);
-		}
+		spin_unlock(&rzs->stat_lock);
+		rzs->table[index].element = 0;
 		return;
 	}
 
+	if (unlikely(!rzs->table[index].handle))
+		return;
+
+	handle = rzs_object(rzs, index, &offset);
+
+	/* Shared objects are freed with their last reference */
+	if (rzs_test_flag(rzs, index, RZS_DEDUP)) {
+		node = rzs->table[index].dedup;
+		rzs_clear_flag(rzs, index, RZS_DEDUP);
+		rzs->table[index].dedup = NULL;
+
+		spin_lock(&rzs->dedup_lock);
+		if (--node->refcount) {
+			spin_unlock(&rzs->dedup_lock);
+			spin_lock(&rzs->stat_lock);
+			rzs_stat_dec(&rzs->stats.pages_dedup);
+			rzs_stat_dec(&rzs->stats.pages_stored);
+			spin_unlock(&rzs->stat_lock);
+			return;
+		}
+		hlist_del(&node->hash_node);
+		spin_unlock(&rzs->dedup_lock);
+
+		kmem_cache_free(dedup_cache, node);
+	}
+
 	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED))) {
 		clen = PAGE_SIZE;
-		__free_page(page);
+		__free_page(rzs->table[index].page);
 		rzs_clear_flag(rzs, index, RZS_UNCOMPRESSED);
+		spin_lock(&rzs->stat_lock);
 		rzs_stat_dec(&rzs->stats.pages_expand);
 		goto out;
 	}
 
-	obj = kmap_atomic(page, KM_USER0) + offset;
-	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
-	kunmap_atomic(obj, KM_USER0);
-
-	xv_free(rzs->mem_pool, page, offset);
+	clen = rzs_obj_size(rzs, handle, offset) - sizeof(struct zobj_header);
+	rzs_obj_free(rzs, handle, offset);
+	spin_lock(&rzs->stat_lock);
 	if (clen <= PAGE_SIZE / 2)
 		rzs_stat_dec(&rzs->stats.good_compress);
 
 out:
 	rzs->stats.compr_size -= clen;
 	rzs_stat_dec(&rzs->stats.pages_stored);
+	spin_unlock(&rzs->stat_lock);
 
-	rzs->table[index].page = NULL;
+	rzs->table[index].handle = 0;
 	rzs->table[index].offset = 0;
 }
 
-static int handle_zero_page(struct bio *bio)
+static int handle_same_page(struct bio *bio, unsigned long element)
 {
-	void *user_mem;
+	unsigned int pos;
+	unsigned long *user_mem;
 	struct page *page = bio->bi_io_vec[0].bv_page;
 
 	user_mem = kmap_atomic(page, KM_USER0);
-	memset(user_mem, 0, PAGE_SIZE);
-	kunmap_atomic(user_mem, KM_USER0);
-
-	flush_dcache_page(page);
-
-	set_bit(BIO_UPTODATE, &bio->bi_flags);
-	bio_endio(bio, 0);
-	return 0;
-}
-
-static int handle_uncompressed_page(struct ramzswap *rzs, struct bio *bio)
-{
-	u32 index;
-	struct page *page;
-	unsigned char *user_mem, *cmem;
-
-	page = bio->bi_io_vec[0].bv_page;
-	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
-
-	user_mem = kmap_atomic(page, KM_USER0);
-	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
-			rzs->table[index].offset;
-
-	memcpy(user_mem, cmem, PAGE_SIZE);
+	if (!element) {
+		memset(user_mem, 0, PAGE_SIZE);
+	} else {
+		for (pos = 0; pos != PAGE_SIZE / sizeof(*user_mem); pos++)
+			user_mem[pos] = element;
+	}
 	kunmap_atomic(user_mem, KM_USER0);
-	kunmap_atomic(cmem, KM_USER1);
 
 	flush_dcache_page(page);
 
@@ -261,44 +498,86 @@ static int handle_ramzswap_fault(struct ramzswap *rzs, struct bio *bio)
 	return 0;
 }
 
-static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
+/*
+ * Copy the page of a slot stored in memory to the given page.
+ * Called with the table entry locked.
+ */
+static int ramzswap_decompress(struct ramzswap *rzs, u32 index,
+			struct page *page)
 {
 	int ret;
-	u32 index;
+	u32 offset, size;
 	size_t clen;
-	struct page *page;
+	unsigned long handle;
 	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem;
 
+	clen = PAGE_SIZE;
+
+	/* Page is stored uncompressed since it's incompressible */
+	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED))) {
+		user_mem = kmap_atomic(page, KM_USER0);
+		cmem = kmap_atomic(rzs->table[index].page, KM_USER1);
+		memcpy(user_mem, cmem, PAGE_SIZE);
+		kunmap_atomic(cmem, KM_USER1);
+		kunmap_atomic(user_mem, KM_USER0);
+		ret = LZO_E_OK;
+	} else {
+		handle = rzs_object(rzs, index, &offset);
+		size = rzs_obj_size(rzs, handle, offset);
+
+		user_mem = kmap_atomic(page, KM_USER0);
+		cmem = rzs_obj_map(rzs, handle, offset, ZS_MM_RO);
+		ret = lzo1x_decompress_safe(
+			cmem + sizeof(*zheader),
+			size - sizeof(*zheader),
+			user_mem, &clen);
+		rzs_obj_unmap(rzs, handle, cmem);
+		kunmap_atomic(user_mem, KM_USER0);
+	}
+
+	return ret;
+}
+
+static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
+{
+	int ret;
+	u32 index;
+	struct page *page;
+
 	rzs_stat64_inc(rzs, &rzs->stats.num_reads);
 
 	page = bio->bi_io_vec[0].bv_page;
 	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
 
-	if (rzs_test_flag(rzs, index, RZS_ZERO))
-		return handle_zero_page(bio);
+	rzs_table_lock(rzs, index);
 
-	/* Requested page is not present in compressed area */
-	if (!rzs->table[index].page)
-		return handle_ramzswap_fault(rzs, bio);
+	if (rzs_test_flag(rzs, index, RZS_SAME)) {
+		unsigned long element = rzs->table[index].element;
 
-	/* Page is stored uncompressed since it's incompressible */
-	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
-		return handle_uncompressed_page(rzs, bio);
+		rzs_table_unlock(rzs, index);
+		return handle_same_page(bio, element);
+	}
 
-	user_mem = kmap_atomic(page, KM_USER0);
-	clen = PAGE_SIZE;
+	/* Let the backing swap device complete the request */
+	if (rzs_test_flag(rzs, index, RZS_BACKED)) {
+		rzs_table_unlock(rzs, index);
+		rzs_stat64_inc(rzs, &rzs->stats.bdev_num_reads);
+		bio->bi_bdev = rzs->backing_swap;
+		return 1;
+	}
 
-	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
-			rzs->table[index].offset;
+	if (!rzs->table[index].page) {
+		rzs_table_unlock(rzs, index);
 
-	ret = lzo1x_decompress_safe(
-		cmem + sizeof(*zheader),
-		xv_get_object_size(cmem) - sizeof(*zheader),
-		user_mem, &clen);
+		/* Requested page is not present in compressed area */
+		return handle_ramzswap_fault(rzs, bio);
+	}
 
-	kunmap_atomic(user_mem, KM_USER0);
-	kunmap_atomic(cmem, KM_USER1);
+	ret = ramzswap_decompress(rzs, index, page);
+	rzs_lru_add(rzs, index);
+
+	rzs_table_unlock(rzs, index);
 
 	/* should NEVER happen */
 	if (unlikely(ret != LZO_E_OK)) {
@@ -319,13 +598,26 @@ out:
 	return 0;
 }
 
+/*
+ * Pages are compressed into the per-CPU stream buffer and copied to their
+ * final location before the table entry is locked, so only the update of
+ * the entry itself is serialized against other I/O on the same slot.
+ *
+ * Compressed objects are looked up by content first: a slot whose data is
+ * already stored takes a reference on that object instead of a new one.
+ * Two writers of the same new content may both miss and store a copy
+ * each, which only costs the memory dedup would have saved.
+ */
 static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 {
-	int ret;
-	u32 offset, index;
+	int ret, uncompressed = 0, shared = 0;
+	u32 offset, index, hash = 0;
 	size_t clen;
+	unsigned long element, handle = 0;
 	struct zobj_header *zheader;
-	struct page *page, *page_store;
+	struct ramzswap_stream *stream;
+	struct rzs_dedup *node = NULL;
+	struct page *page, *page_store = NULL;
 	unsigned char *user_mem, *cmem, *src;
 
 	rzs_stat64_inc(rzs, &rzs->stats.num_writes);
@@ -333,29 +625,39 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 	page = bio->bi_io_vec[0].bv_page;
 	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
 
-	src = rzs->compress_buffer;
-
-	mutex_lock(&rzs->lock);
-
 	user_mem = kmap_atomic(page, KM_USER0);
-	if (page_zero_filled(user_mem)) {
+	if (page_same_filled(user_mem, &element)) {
 		kunmap_atomic(user_mem, KM_USER0);
-		mutex_unlock(&rzs->lock);
-		rzs_stat_inc(&rzs->stats.pages_zero);
-		rzs_set_flag(rzs, index, RZS_ZERO);
+
+		rzs_table_lock(rzs, index);
+		ramzswap_free_page(rzs, index);
+		rzs->table[index].element = element;
+		rzs_set_flag(rzs, index, RZS_SAME);
+		rzs_table_unlock(rzs, index);
+
+		spin_lock(&rzs->stat_lock);
+		if (element)
+			rzs_stat_inc(&rzs->stats.pages_same);
+		else
+			rzs_stat_inc(&rzs->stats.pages_zero);
+		spin_unlock(&rzs->stat_lock);
 
 		set_bit(BIO_UPTODATE, &bio->bi_flags);
 		bio_endio(bio, 0);
 		return 0;
 	}
+	kunmap_atomic(user_mem, KM_USER0);
 
-	ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
-				rzs->compress_workmem);
+	stream = rzs_stream_get(rzs);
+	src = stream->buffer;
 
+	user_mem = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
+				stream->workmem);
 	kunmap_atomic(user_mem, KM_USER0);
 
 	if (unlikely(ret != LZO_E_OK)) {
-		mutex_unlock(&rzs->lock);
+		rzs_stream_put(stream);
 		pr_err("Compression failed! err=%d\n", ret);
 		rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
 		goto out;
@@ -367,62 +669,137 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 	 * errors which has side effect of hanging the system.
 	 */
 	if (unlikely(clen > max_zpage_size)) {
+		rzs_stream_put(stream);
+
+		/*
+		 * With a backing swap device, send the page there instead,
+		 * unless an older copy is still being written back to it.
+		 */
+		if (rzs->backing_swap) {
+			rzs_table_lock(rzs, index);
+			if (rzs->writeback_index != index) {
+				ramzswap_free_page(rzs, index);
+				rzs_set_flag(rzs, index, RZS_BACKED);
+				rzs_table_unlock(rzs, index);
+
+				spin_lock(&rzs->stat_lock);
+				rzs_stat_inc(&rzs->stats.pages_backed);
+				spin_unlock(&rzs->stat_lock);
+				rzs_stat64_inc(rzs, &rzs->stats.bdev_num_writes);
+
+				bio->bi_bdev = rzs->backing_swap;
+				return 1;
+			}
+			rzs_table_unlock(rzs, index);
+		}
+
 		clen = PAGE_SIZE;
 		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 		if (unlikely(!page_store)) {
-			mutex_unlock(&rzs->lock);
 			pr_info("Error allocating memory for incompressible "
 				"page: %u\n", index);
 			rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
 			goto out;
 		}
 
-		offset = 0;
-		rzs_set_flag(rzs, index, RZS_UNCOMPRESSED);
-		rzs_stat_inc(&rzs->stats.pages_expand);
-		rzs->table[index].page = page_store;
-		src = kmap_atomic(page, KM_USER0);
-		goto memstore;
+		user_mem = kmap_atomic(page, KM_USER0);
+		cmem = kmap_atomic(page_store, KM_USER1);
+		memcpy(cmem, user_mem, PAGE_SIZE);
+		kunmap_atomic(cmem, KM_USER1);
+		kunmap_atomic(user_mem, KM_USER0);
+
+		uncompressed = 1;
+		goto update;
+	}
+
+	if (dedup && rzs->dedup_table) {
+		hash = jhash(src, clen, 0);
+
+		spin_lock(&rzs->dedup_lock);
+		node = rzs_dedup_find(rzs, src, clen, hash);
+		if (node)
+			node->refcount++;
+		spin_unlock(&rzs->dedup_lock);
+
+		if (node) {
+			rzs_stream_put(stream);
+			rzs_stat64_inc(rzs, &rzs->stats.dedup_hits);
+			shared = 1;
+			goto update;
+		}
+
+		/* Without a node the object is simply not shared */
+		node = kmem_cache_alloc(dedup_cache, GFP_NOIO);
 	}
 
-	if (xv_malloc(rzs->mem_pool, clen + sizeof(*zheader),
-			&rzs->table[index].page, &offset,
-			GFP_NOIO | __GFP_HIGHMEM)) {
-		mutex_unlock(&rzs->lock);
+	if (rzs_obj_alloc(rzs, clen + sizeof(*zheader), &handle, &offset)) {
+		rzs_stream_put(stream);
 		pr_info("Error allocating memory for compressed "
 			"page: %u, size=%zu\n", index, clen);
 		rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
+		if (node)
+			kmem_cache_free(dedup_cache, node);
 		goto out;
 	}
 
-memstore:
-	rzs->table[index].offset = offset;
-
-	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
-			rzs->table[index].offset;
+	cmem = rzs_obj_map(rzs, handle, offset, ZS_MM_WO);
 
 #if 0
 	/* Back-reference needed for memory defragmentation */
-	if (!rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
-	}
+	zheader = (struct zobj_header *)cmem;
+	zheader->table_idx = index;
+	cmem += sizeof(*zheader);
 #endif
 
 	memcpy(cmem, src, clen);
 
-	kunmap_atomic(cmem, KM_USER1);
-	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
-		kunmap_atomic(src, KM_USER0);
+	rzs_obj_unmap(rzs, handle, cmem);
+	rzs_stream_put(stream);
+
+	if (node) {
+		node->handle = handle;
+		node->offset = offset;
+		node->size = clen;
+		node->hash = hash;
+		node->refcount = 1;
 
-	/* Update stats */
-	rzs->stats.compr_size += clen;
+		spin_lock(&rzs->dedup_lock);
+		rzs_dedup_insert(rzs, node);
+		spin_unlock(&rzs->dedup_lock);
+	}
+
+update:
+	/* Update stats, a shared object is only accounted once */
+	spin_lock(&rzs->stat_lock);
 	rzs_stat_inc(&rzs->stats.pages_stored);
-	if (clen <= PAGE_SIZE / 2)
-		rzs_stat_inc(&rzs->stats.good_compress);
+	if (shared) {
+		rzs_stat_inc(&rzs->stats.pages_dedup);
+	} else {
+		rzs->stats.compr_size += clen;
+		if (unlikely(uncompressed))
+			rzs_stat_inc(&rzs->stats.pages_expand);
+		if (clen <= PAGE_SIZE / 2)
+			rzs_stat_inc(&rzs->stats.good_compress);
+	}
+	spin_unlock(&rzs->stat_lock);
+
+	rzs_table_lock(rzs, index);
+	ramzswap_free_page(rzs, index);
+	if (node) {
+		rzs->table[index].dedup = node;
+		rzs_set_flag(rzs, index, RZS_DEDUP);
+	} else if (unlikely(uncompressed)) {
+		rzs->table[index].page = page_store;
+		rzs_set_flag(rzs, index, RZS_UNCOMPRESSED);
+	} else {
+		rzs->table[index].handle = handle;
+		rzs->table[index].offset = offset;
+	}
+	rzs_lru_add(rzs, index);
+	rzs_table_unlock(rzs, index);
 
-	mutex_unlock(&rzs->lock);
+	if (rzs->backing_swap && rzs->stats.compr_size > rzs->memlimit)
+		queue_work(writeback_wq, &rzs->writeback_work);
 
 	set_bit(BIO_UPTODATE, &bio->bi_flags);
 	bio_endio(bio, 0);
@@ -484,6 +861,209 @@ static int ramzswap_make_request(struct request_queue *queue, struct bio *bio)
 	return ret;
 }
 
+static void ramzswap_backing_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+static int ramzswap_backing_write(struct ramzswap *rzs, u32 index,
+			struct page *page)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bio *bio;
+	int err;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = rzs->backing_swap;
+	bio->bi_sector = (sector_t)index << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_end_io = ramzswap_backing_end_io;
+	bio->bi_private = &done;
+	bio_add_page(bio, page, PAGE_SIZE, 0);
+
+	submit_bio(WRITE, bio);
+	wait_for_completion(&done);
+
+	err = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	bio_put(bio);
+
+	return err;
+}
+
+/*
+ * Write the least recently used slot stored in memory to the backing
+ * swap device and free its memory. Its memory copy stays valid during
+ * the write, and is dropped afterwards only if the slot was not freed
+ * or rewritten meanwhile. writeback_index keeps incompressible writes
+ * to the same slot away from the backing device until then.
+ */
+static int ramzswap_writeback_page(struct ramzswap *rzs)
+{
+	int ret;
+	u32 index;
+	struct list_head *node;
+
+	spin_lock(&rzs->lru_lock);
+	if (list_empty(&rzs->lru)) {
+		spin_unlock(&rzs->lru_lock);
+		return -ENOENT;
+	}
+	node = rzs->lru.prev;
+	list_del_init(node);
+	spin_unlock(&rzs->lru_lock);
+
+	index = node - rzs->lru_nodes;
+
+	rzs_table_lock(rzs, index);
+	if (!rzs->table[index].handle ||
+			rzs_test_flag(rzs, index, RZS_SAME) ||
+			ramzswap_decompress(rzs, index, rzs->writeback_page)) {
+		rzs_table_unlock(rzs, index);
+		return 0;
+	}
+	rzs_set_flag(rzs, index, RZS_WRITEBACK);
+	rzs->writeback_index = index;
+	rzs_table_unlock(rzs, index);
+
+	ret = ramzswap_backing_write(rzs, index, rzs->writeback_page);
+	rzs_stat64_inc(rzs, &rzs->stats.bdev_num_writes);
+
+	rzs_table_lock(rzs, index);
+	rzs->writeback_index = RZS_NO_WRITEBACK;
+	if (rzs_test_flag(rzs, index, RZS_WRITEBACK)) {
+		rzs_clear_flag(rzs, index, RZS_WRITEBACK);
+		if (!ret) {
+			ramzswap_free_page(rzs, index);
+			rzs_set_flag(rzs, index, RZS_BACKED);
+			spin_lock(&rzs->stat_lock);
+			rzs_stat_inc(&rzs->stats.pages_backed);
+			spin_unlock(&rzs->stat_lock);
+		} else {
+			/* Keep it in memory, it is tried again later */
+			rzs_lru_add(rzs, index);
+		}
+	}
+	rzs_table_unlock(rzs, index);
+
+	if (ret)
+		pr_err("Error writing page %u to backing swap: %d\n",
+			index, ret);
+
+	return ret;
+}
+
+static size_t ramzswap_compr_size(struct ramzswap *rzs)
+{
+	size_t size;
+
+	spin_lock(&rzs->stat_lock);
+	size = rzs->stats.compr_size;
+	spin_unlock(&rzs->stat_lock);
+
+	return size;
+}
+
+/*
+ * Kicked by writes once memlimit is exceeded, writes back pages until
+ * 1/8 of memlimit is free again so it does not run for every page.
+ */
+static void ramzswap_writeback_work(struct work_struct *work)
+{
+	struct ramzswap *rzs = container_of(work, struct ramzswap,
+					    writeback_work);
+	size_t target = rzs->memlimit - rzs->memlimit / 8;
+
+	while (rzs->init_done && ramzswap_compr_size(rzs) > target) {
+		if (ramzswap_writeback_page(rzs))
+			break;
+		cond_resched();
+	}
+}
+
+/*
+ * Objects freed over time leave zspages sparsely used, move them together
+ * so the pages can be released. Kicked by rzs_obj_free().
+ */
+static void ramzswap_compact_work(struct work_struct *work)
+{
+	struct ramzswap *rzs = container_of(to_delayed_work(work),
+					    struct ramzswap, compact_work);
+
+	zs_compact(rzs->zs_pool);
+}
+
+static void free_streams(struct ramzswap *rzs)
+{
+	struct ramzswap_stream *stream;
+	int cpu;
+
+	if (!rzs->streams)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		stream = per_cpu_ptr(rzs->streams, cpu);
+		kfree(stream->workmem);
+		free_pages((unsigned long)stream->buffer, 1);
+	}
+
+	free_percpu(rzs->streams);
+	rzs->streams = NULL;
+}
+
+static int alloc_streams(struct ramzswap *rzs)
+{
+	struct ramzswap_stream *stream;
+	int cpu;
+
+	rzs->streams = alloc_percpu(struct ramzswap_stream);
+	if (!rzs->streams)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		stream = per_cpu_ptr(rzs->streams, cpu);
+		mutex_init(&stream->lock);
+		stream->workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+		stream->buffer = (void *)__get_free_pages(GFP_KERNEL |
+							  __GFP_ZERO, 1);
+		if (!stream->workmem || !stream->buffer)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int setup_backing_swap(struct ramzswap *rzs)
+{
+	size_t disksize;
+	struct block_device *bdev;
+
+	bdev = open_bdev_exclusive(rzs->backing_swap_name,
+				   FMODE_READ | FMODE_WRITE, rzs);
+	if (IS_ERR(bdev)) {
+		pr_err("Error opening backing device: %s\n",
+			rzs->backing_swap_name);
+		return PTR_ERR(bdev);
+	}
+
+	disksize = i_size_read(bdev->bd_inode) & PAGE_MASK;
+	if (disksize < 2 * PAGE_SIZE) {
+		pr_err("Backing device %s is too small\n",
+			rzs->backing_swap_name);
+		close_bdev_exclusive(bdev, FMODE_READ | FMODE_WRITE);
+		return -EINVAL;
+	}
+
+	if (rzs->disksize && rzs->disksize != disksize)
+		pr_info("Ignoring disk size, using the size of %s\n",
+			rzs->backing_swap_name);
+	rzs->disksize = disksize;
+	rzs->backing_swap = bdev;
+
+	return 0;
+}
+
 static void reset_device(struct ramzswap *rzs)
 {
 	size_t index;
@@ -491,35 +1071,51 @@ static void reset_device(struct ramzswap *rzs)
 	/* Do not accept any new I/O request */
 	rzs->init_done = 0;
 
+	cancel_delayed_work_sync(&rzs->compact_work);
+	cancel_work_sync(&rzs->writeback_work);
+
 	/* Free various per-device buffers */
-	kfree(rzs->compress_workmem);
-	free_pages((unsigned long)rzs->compress_buffer, 1);
+	free_streams(rzs);
 
-	rzs->compress_workmem = NULL;
-	rzs->compress_buffer = NULL;
+	/*
+	 * Free all pages that are still in this ramzswap device. Going
+	 * through ramzswap_free_page() drops shared objects only once.
+	 */
+	for (index = 0; rzs->table &&
+			index < rzs->disksize >> PAGE_SHIFT; index++)
+		ramzswap_free_page(rzs, index);
 
-	/* Free all pages that are still in this ramzswap device */
-	for (index = 0; index < rzs->disksize >> PAGE_SHIFT; index++) {
-		struct page *page;
-		u16 offset;
+	vfree(rzs->table);
+	rzs->table = NULL;
 
-		page = rzs->table[index].page;
-		offset = rzs->table[index].offset;
+	vfree(rzs->dedup_table);
+	rzs->dedup_table = NULL;
 
-		if (!page)
-			continue;
+	vfree(rzs->lru_nodes);
+	rzs->lru_nodes = NULL;
+	INIT_LIST_HEAD(&rzs->lru);
 
-		if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
-			__free_page(page);
-		else
-			xv_free(rzs->mem_pool, page, offset);
+	if (rzs->writeback_page) {
+		__free_page(rzs->writeback_page);
+		rzs->writeback_page = NULL;
 	}
 
-	vfree(rzs->table);
-	rzs->table = NULL;
+	if (rzs->backing_swap) {
+		close_bdev_exclusive(rzs->backing_swap,
+				     FMODE_READ | FMODE_WRITE);
+		rzs->backing_swap = NULL;
+	}
+	rzs->backing_swap_name[0] = '\0';
+	rzs->memlimit = 0;
 
-	xv_destroy_pool(rzs->mem_pool);
-	rzs->mem_pool = NULL;
+	if (rzs->zs_pool) {
+		zs_destroy_pool(rzs->zs_pool);
+		rzs->zs_pool = NULL;
+	}
+	if (rzs->mem_pool) {
+		xv_destroy_pool(rzs->mem_pool);
+		rzs->mem_pool = NULL;
+	}
 
 	/* Reset stats */
 	memset(&rzs->stats, 0, sizeof(rzs->stats));
@@ -530,7 +1126,7 @@ static void reset_device(struct ramzswap *rzs)
 static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 {
 	int ret;
-	size_t num_pages;
+	size_t i, num_pages;
 	struct page *page;
 	union swap_header *swap_header;
 
@@ -539,19 +1135,23 @@ static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 		return -EBUSY;
 	}
 
-	ramzswap_set_disksize(rzs, totalram_pages << PAGE_SHIFT);
-
-	rzs->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!rzs->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail;
+	/* Slots map 1:1 to pages of the backing swap device */
+	if (rzs->backing_swap_name[0]) {
+		ret = setup_backing_swap(rzs);
+		if (ret)
+			goto fail;
+	} else {
+		if (rzs->memlimit) {
+			pr_info("No backing swap device, "
+				"ignoring memory limit\n");
+			rzs->memlimit = 0;
+		}
+		ramzswap_set_disksize(rzs, totalram_pages << PAGE_SHIFT);
 	}
 
-	rzs->compress_buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
-	if (!rzs->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	ret = alloc_streams(rzs);
+	if (ret) {
+		pr_err("Error allocating compression streams\n");
 		goto fail;
 	}
 
@@ -566,6 +1166,37 @@ static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 	}
 	memset(rzs->table, 0, num_pages * sizeof(*rzs->table));
 
+	/* One hash bucket for every four slots; no dedup if this fails */
+	if (dedup) {
+		rzs->dedup_bits = max(ilog2(num_pages >> 2), 1);
+		rzs->dedup_table = vmalloc(sizeof(*rzs->dedup_table) <<
+					   rzs->dedup_bits);
+		if (rzs->dedup_table)
+			memset(rzs->dedup_table, 0,
+			       sizeof(*rzs->dedup_table) << rzs->dedup_bits);
+		else
+			pr_warning("Error allocating dedup table\n");
+	}
+
+	if (rzs->backing_swap) {
+		rzs->lru_nodes = vmalloc(num_pages * sizeof(*rzs->lru_nodes));
+		rzs->writeback_page = alloc_page(GFP_KERNEL);
+		if (!rzs->lru_nodes || !rzs->writeback_page) {
+			pr_err("Error allocating writeback buffers\n");
+			ret = -ENOMEM;
+			goto fail;
+		}
+		for (i = 0; i < num_pages; i++)
+			INIT_LIST_HEAD(&rzs->lru_nodes[i]);
+		rzs->writeback_index = RZS_NO_WRITEBACK;
+
+		if (!rzs->memlimit)
+			rzs->memlimit = (default_memlimit_perc_ram *
+					 (totalram_pages << PAGE_SHIFT)) / 100;
+		pr_info("Writing back to %s above %zu kB\n",
+			rzs->backing_swap_name, rzs->memlimit >> 10);
+	}
+
 	page = alloc_page(__GFP_ZERO);
 	if (!page) {
 		pr_err("Error allocating swap header page\n");
@@ -584,8 +1215,11 @@ static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 	/* ramzswap devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, rzs->disk->queue);
 
-	rzs->mem_pool = xv_create_pool();
-	if (!rzs->mem_pool) {
+	if (zsmalloc)
+		rzs->zs_pool = zs_create_pool();
+	else
+		rzs->mem_pool = xv_create_pool();
+	if (!rzs->mem_pool && !rzs->zs_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
 		goto fail;
@@ -615,7 +1249,7 @@ static int ramzswap_ioctl(struct block_device *bdev, fmode_t mode,
 			unsigned int cmd, unsigned long arg)
 {
 	int ret = 0;
-	size_t disksize_kb;
+	size_t disksize_kb, memlimit_kb;
 
 	struct ramzswap *rzs = bdev->bd_disk->private_data;
 
@@ -634,6 +1268,36 @@ static int ramzswap_ioctl(struct block_device *bdev, fmode_t mode,
 		pr_info("Disk size set to %zu kB\n", disksize_kb);
 		break;
 
+	case RZSIO_SET_MEMLIMIT_KB:
+		if (rzs->init_done) {
+			ret = -EBUSY;
+			goto out;
+		}
+		if (copy_from_user(&memlimit_kb, (void *)arg,
+						_IOC_SIZE(cmd))) {
+			ret = -EFAULT;
+			goto out;
+		}
+		rzs->memlimit = memlimit_kb << 10;
+		pr_info("Memory limit set to %zu kB\n", memlimit_kb);
+		break;
+
+	case RZSIO_SET_BACKING_SWAP:
+		if (rzs->init_done) {
+			ret = -EBUSY;
+			goto out;
+		}
+		if (copy_from_user(rzs->backing_swap_name, (void *)arg,
+						_IOC_SIZE(cmd))) {
+			ret = -EFAULT;
+			goto out;
+		}
+		rzs->backing_swap_name[MAX_SWAP_NAME_LEN - 1] = '\0';
+		pr_info("Backing swap device set to %s\n",
+			rzs->backing_swap_name);
+		break;
+
+	case RZSIO_GET_STATS_V1:
 	case RZSIO_GET_STATS:
 	{
 		struct ramzswap_ioctl_stats *stats;
@@ -647,7 +1311,7 @@ static int ramzswap_ioctl(struct block_device *bdev, fmode_t mode,
 			goto out;
 		}
 		ramzswap_ioctl_get_stats(rzs, stats);
-		if (copy_to_user((void *)arg, stats, sizeof(*stats))) {
+		if (copy_to_user((void *)arg, stats, _IOC_SIZE(cmd))) {
 			kfree(stats);
 			ret = -EFAULT;
 			goto out;
@@ -687,7 +1351,9 @@ void ramzswap_slot_free_notify(struct block_device *bdev, unsigned long index)
 	struct ramzswap *rzs;
 
 	rzs = bdev->bd_disk->private_data;
+	rzs_table_lock(rzs, index);
 	ramzswap_free_page(rzs, index);
+	rzs_table_unlock(rzs, index);
 	rzs_stat64_inc(rzs, &rzs->stats.notify_free);
 
 	return;
@@ -701,10 +1367,17 @@ static struct block_device_operations ramzswap_devops = {
 
 static int create_device(struct ramzswap *rzs, int device_id)
 {
-	int ret = 0;
-
-	mutex_init(&rzs->lock);
-	spin_lock_init(&rzs->stat64_lock);
+	int i, ret = 0;
+
+	for (i = 0; i < RZS_TABLE_LOCKS; i++)
+		spin_lock_init(&rzs->table_lock[i]);
+	spin_lock_init(&rzs->dedup_lock);
+	spin_lock_init(&rzs->stat_lock);
+	spin_lock_init(&rzs->lru_lock);
+	INIT_LIST_HEAD(&rzs->lru);
+	INIT_DELAYED_WORK_DEFERRABLE(&rzs->compact_work,
+				     ramzswap_compact_work);
+	INIT_WORK(&rzs->writeback_work, ramzswap_writeback_work);
 
 	rzs->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!rzs->queue) {
@@ -770,11 +1443,23 @@ static int __init ramzswap_init(void)
 		goto out;
 	}
 
+	dedup_cache = KMEM_CACHE(rzs_dedup, 0);
+	if (!dedup_cache) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	writeback_wq = create_singlethread_workqueue("ramzswap_wb");
+	if (!writeback_wq) {
+		ret = -ENOMEM;
+		goto destroy_cache;
+	}
+
 	ramzswap_major = register_blkdev(0, "ramzswap");
 	if (ramzswap_major <= 0) {
 		pr_warning("Unable to get major number\n");
 		ret = -EBUSY;
-		goto out;
+		goto destroy_wq;
 	}
 
 	if (!num_devices) {
@@ -803,6 +1488,10 @@ free_devices:
 		destroy_device(&devices[--dev_id]);
 unregister:
 	unregister_blkdev(ramzswap_major, "ramzswap");
+destroy_wq:
+	destroy_workqueue(writeback_wq);
+destroy_cache:
+	kmem_cache_destroy(dedup_cache);
 out:
 	return ret;
 }
@@ -823,11 +1512,21 @@ static void __exit ramzswap_exit(void)
 	unregister_blkdev(ramzswap_major, "ramzswap");
 
 	kfree(devices);
+	destroy_workqueue(writeback_wq);
+	kmem_cache_destroy(dedup_cache);
 	pr_debug("Cleanup done!\n");
 }
 
 module_param(num_devices, uint, 0);
 MODULE_PARM_DESC(num_devices, "Number of ramzswap devices");
+module_param(dedup, bool, 0644);
+MODULE_PARM_DESC(dedup, "Share identical compressed pages (default: 1)");
+module_param(zsmalloc, bool, 0644);
+MODULE_PARM_DESC(zsmalloc, "Store pages with the compacting zsmalloc "
+		"allocator instead of xvmalloc");
+module_param(compact_interval, uint, 0644);
+MODULE_PARM_DESC(compact_interval, "Delay of zsmalloc compaction after "
+		"frees in ms, 0 to disable (default: 10000)");
 
 module_init(ramzswap_init);
 module_exit(ramzswap_exit);
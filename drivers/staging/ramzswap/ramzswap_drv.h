@@ -17,9 +17,12 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
 
 #include "ramzswap_ioctl.h"
 #include "xvmalloc.h"
+#include "zsmalloc.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -44,6 +47,9 @@ struct zobj_header {
 /* Default ramzswap disk size: 25% of total RAM */
 static const unsigned default_disksize_perc_ram = 25;
 
+/* Default memory limit with a backing swap device: 15% of total RAM */
+static const unsigned default_memlimit_perc_ram = 15;
+
 /*
  * Pages that compress to size greater than this are stored
  * uncompressed in memory.
@@ -54,6 +60,7 @@ static const unsigned max_zpage_size = PAGE_SIZE / 4 * 3;
  * NOTE: max_zpage_size must be less than or equal to:
  *   XV_MAX_ALLOC_SIZE - sizeof(struct zobj_header)
  * otherwise, xv_malloc() would always return failure.
+ * The same holds for ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE.
  */
 
 /*-- End of configurable params */
@@ -63,30 +70,76 @@ static const unsigned max_zpage_size = PAGE_SIZE / 4 * 3;
 #define SECTORS_PER_PAGE_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
 #define SECTORS_PER_PAGE	(1 << SECTORS_PER_PAGE_SHIFT)
 
+/* Table entries are protected by this many hashed locks (power of 2) */
+#define RZS_TABLE_LOCKS		64
+
+/* writeback_index while no slot is being written back */
+#define RZS_NO_WRITEBACK	((u32)-1)
+
 /* Flags for ramzswap pages (table[page_no].flags) */
 enum rzs_pageflags {
 	/* Page is stored uncompressed */
 	RZS_UNCOMPRESSED,
 
-	/* Page consists entirely of zeros */
-	RZS_ZERO,
+	/* Page is filled with a single word, kept in table[].element */
+	RZS_SAME,
+
+	/* Object is shared through table[].dedup */
+	RZS_DEDUP,
+
+	/* Page is stored on the backing swap device only */
+	RZS_BACKED,
+
+	/* Page is being copied to the backing swap device */
+	RZS_WRITEBACK,
 
 	__NR_RZS_PAGEFLAGS,
 };
 
 /*-- Data structures */
 
+/*
+ * Compressed object which may be shared by several swap slots with the
+ * same content. Objects are hashed on their compressed data.
+ */
+struct rzs_dedup {
+	struct hlist_node hash_node;
+	unsigned long handle;
+	u16 offset;
+	u16 size;
+	u32 hash;
+	u32 refcount;
+};
+
 /*
  * Allocated for each swap slot, indexed by page no.
  * These table entries must fit exactly in a page.
+ *
+ * Compressed objects are identified by <handle, offset>: the handle is
+ * the one returned by zs_malloc() or, with xvmalloc, the struct page.
  */
 struct table {
-	struct page *page;
+	union {
+		struct page *page;		/* RZS_UNCOMPRESSED */
+		unsigned long handle;
+		unsigned long element;		/* RZS_SAME */
+		struct rzs_dedup *dedup;	/* RZS_DEDUP */
+	};
 	u16 offset;
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
 } __attribute__((aligned(4)));
 
+/*
+ * Compression workspace. There is one per possible CPU, so writers on
+ * different CPUs compress in parallel.
+ */
+struct ramzswap_stream {
+	struct mutex lock;
+	void *workmem;
+	void *buffer;
+};
+
 struct ramzswap_stats {
 	/* basic stats */
 	size_t compr_size;	/* compressed size of pages stored -
@@ -99,20 +152,30 @@ struct ramzswap_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-swap I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
+	u64 dedup_hits;		/* writes which found an identical object */
+	u64 bdev_num_reads;	/* reads from backing swap */
+	u64 bdev_num_writes;	/* writes to backing swap */
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of other same filled pages */
+	u32 pages_dedup;	/* no. of pages sharing another's object */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 pages_backed;	/* no. of pages on backing swap */
 #endif
 };
 
 struct ramzswap {
 	struct xv_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zs_pool *zs_pool;	/* replaces mem_pool if set */
+	struct delayed_work compact_work;
+	struct ramzswap_stream *streams;	/* per-CPU */
 	struct table *table;
-	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct mutex lock;
+	spinlock_t table_lock[RZS_TABLE_LOCKS];
+	struct hlist_head *dedup_table;
+	unsigned int dedup_bits;
+	spinlock_t dedup_lock;	/* protect dedup_table and refcounts */
+	spinlock_t stat_lock;	/* protect stats */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -123,6 +186,22 @@ struct ramzswap {
 	 */
 	size_t disksize;	/* bytes */
 
+	/*
+	 * Beyond memlimit bytes of compressed data, the least recently
+	 * used pages are written to the backing swap device. Slot n of
+	 * ramzswap is page n of the backing device.
+	 */
+	size_t memlimit;	/* bytes */
+	struct block_device *backing_swap;
+	char backing_swap_name[MAX_SWAP_NAME_LEN];
+	struct list_head lru;		/* slots stored in memory */
+	struct list_head *lru_nodes;	/* one per slot */
+	spinlock_t lru_lock;		/* protect lru */
+	struct work_struct writeback_work;
+	struct page *writeback_page;
+	u32 writeback_index;		/* slot being written back, or
+					 * RZS_NO_WRITEBACK */
+
 	struct ramzswap_stats stats;
 };
 
@@ -130,6 +209,7 @@ struct ramzswap {
 
 /* Debugging and Stats */
 #if defined(CONFIG_RAMZSWAP_STATS)
+/* 32-bit stats are updated with stat_lock held */
 static void rzs_stat_inc(u32 *v)
 {
 	*v = *v + 1;
@@ -142,18 +222,18 @@ static void rzs_stat_dec(u32 *v)
 
 static void rzs_stat64_inc(struct ramzswap *rzs, u64 *v)
 {
-	spin_lock(&rzs->stat64_lock);
+	spin_lock(&rzs->stat_lock);
 	*v = *v + 1;
-	spin_unlock(&rzs->stat64_lock);
+	spin_unlock(&rzs->stat_lock);
 }
 
 static u64 rzs_stat64_read(struct ramzswap *rzs, u64 *v)
 {
 	u64 val;
 
-	spin_lock(&rzs->stat64_lock);
+	spin_lock(&rzs->stat_lock);
 	val = *v;
-	spin_unlock(&rzs->stat64_lock);
+	spin_unlock(&rzs->stat_lock);
 
 	return val;
 }
@@ -15,6 +15,8 @@
 #ifndef _RAMZSWAP_IOCTL_H_
 #define _RAMZSWAP_IOCTL_H_
 
+#define MAX_SWAP_NAME_LEN 128
+
 struct ramzswap_ioctl_stats {
 	u64 disksize;		/* user specified or equal to backing swap
 				 * size (if present) */
@@ -32,11 +34,29 @@ struct ramzswap_ioctl_stats {
 	u64 orig_data_size;
 	u64 compr_data_size;
 	u64 mem_used_total;
+	u64 dedup_hits;		/* writes which found an identical object */
+	u32 pages_same;		/* no. of same filled non-zero pages */
+	u32 pages_dedup;	/* no. of pages sharing another's object */
+	u64 pages_compacted;	/* no. of pages freed by compaction */
+	u64 memlimit;		/* compressed data kept in memory */
+	u64 bdev_num_reads;	/* reads from backing swap */
+	u64 bdev_num_writes;	/* writes to backing swap */
+	u32 pages_backed;	/* no. of pages on backing swap */
 } __attribute__ ((packed, aligned(4)));
 
 #define RZSIO_SET_DISKSIZE_KB	_IOW('z', 0, size_t)
 #define RZSIO_GET_STATS		_IOR('z', 1, struct ramzswap_ioctl_stats)
 #define RZSIO_INIT		_IO('z', 2)
 #define RZSIO_RESET		_IO('z', 3)
+#define RZSIO_SET_MEMLIMIT_KB	_IOW('z', 4, size_t)
+#define RZSIO_SET_BACKING_SWAP	_IOW('z', 5, unsigned char[MAX_SWAP_NAME_LEN])
+
+/*
+ * Fields are only appended to struct ramzswap_ioctl_stats. Its size is part
+ * of the RZSIO_GET_STATS number, so tools built against the original layout
+ * still issue this one and get the fields up to mem_used_total.
+ */
+#define RZSIO_STATS_V1_SIZE	offsetof(struct ramzswap_ioctl_stats, dedup_hits)
+#define RZSIO_GET_STATS_V1	_IOC(_IOC_READ, 'z', 1, RZSIO_STATS_V1_SIZE)
 
 #endif
@@ -0,0 +1,414 @@
+/*
+ * Allocator replay for ramzswap
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Replays the same sequence of object allocations and frees against the
+ * xvmalloc and zsmalloc allocators and reports, for each of them, the
+ * average time per allocation and free, and how much memory the pool
+ * holds compared to the size of the live objects (peak and at the end of
+ * the replay). zsmalloc is also compacted afterwards. Every object is
+ * tagged with its slot number, which is checked when it is freed, so
+ * objects corrupted by compaction show up as errors.
+ *
+ * A trace is a file of little endian (u32 slot, u32 size) records, size
+ * zero freeing the slot. Storing to a live slot replaces its object, the
+ * way swap rewrites a slot. Without a trace, a workload of random page
+ * sized writes and frees to the given number of slots is generated: the
+ * first 80% of the operations mix both, the rest only frees, as when a
+ * memory pressure spike is over.
+ *
+ * Like tcrypt, the module reports its results in the kernel log and then
+ * fails to load on purpose, so it can simply be loaded again.
+ *
+ *	modprobe ramzswap_replay ops=1000000 slots=65536
+ *	modprobe ramzswap_replay trace=/data/swap.trace
+ */
+
+#define KMSG_COMPONENT "ramzswap_replay"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "xvmalloc.h"
+#include "zsmalloc.h"
+
+static char *trace;
+static unsigned int ops = 500000;
+static unsigned int slots = 32768;
+static unsigned int seed = 1;
+
+struct replay_op {
+	__le32 slot;
+	__le32 size;
+};
+
+struct replay_obj {
+	unsigned long handle;
+	u32 offset;
+	u32 size;
+};
+
+struct replay_allocator {
+	const char *name;
+	void *(*create)(void);
+	void (*destroy)(void *pool);
+	int (*alloc)(void *pool, u32 size, unsigned long *handle,
+			u32 *offset);
+	void (*free)(void *pool, unsigned long handle, u32 offset);
+	void *(*map)(void *pool, unsigned long handle, u32 offset);
+	void (*unmap)(void *pool, unsigned long handle, void *obj);
+	u64 (*total_size)(void *pool);
+	unsigned long (*compact)(void *pool);
+};
+
+static void *xv_create(void)
+{
+	return xv_create_pool();
+}
+
+static void xv_destroy(void *pool)
+{
+	xv_destroy_pool(pool);
+}
+
+static int xv_alloc(void *pool, u32 size, unsigned long *handle, u32 *offset)
+{
+	struct page *page;
+	int ret;
+
+	ret = xv_malloc(pool, size, &page, offset, GFP_KERNEL | __GFP_HIGHMEM);
+	*handle = (unsigned long)page;
+
+	return ret;
+}
+
+static void xv_release(void *pool, unsigned long handle, u32 offset)
+{
+	xv_free(pool, (struct page *)handle, offset);
+}
+
+static void *xv_map(void *pool, unsigned long handle, u32 offset)
+{
+	return kmap_atomic((struct page *)handle, KM_USER1) + offset;
+}
+
+static void xv_unmap(void *pool, unsigned long handle, void *obj)
+{
+	kunmap_atomic(obj, KM_USER1);
+}
+
+static u64 xv_total_size(void *pool)
+{
+	return xv_get_total_size_bytes(pool);
+}
+
+static void *zs_create(void)
+{
+	return zs_create_pool();
+}
+
+static void zs_destroy(void *pool)
+{
+	zs_destroy_pool(pool);
+}
+
+static int zs_alloc(void *pool, u32 size, unsigned long *handle, u32 *offset)
+{
+	*handle = zs_malloc(pool, size, GFP_KERNEL | __GFP_HIGHMEM);
+	*offset = 0;
+
+	return *handle ? 0 : -ENOMEM;
+}
+
+static void zs_release(void *pool, unsigned long handle, u32 offset)
+{
+	zs_free(pool, handle);
+}
+
+static void *zs_map(void *pool, unsigned long handle, u32 offset)
+{
+	return zs_map_object(pool, handle, ZS_MM_RW);
+}
+
+static void zs_unmap(void *pool, unsigned long handle, void *obj)
+{
+	zs_unmap_object(pool, handle);
+}
+
+static u64 zs_total_size(void *pool)
+{
+	return zs_get_total_size_bytes(pool);
+}
+
+static unsigned long zs_do_compact(void *pool)
+{
+	return zs_compact(pool);
+}
+
+static const struct replay_allocator allocators[] = {
+	{
+		.name		= "xvmalloc",
+		.create		= xv_create,
+		.destroy	= xv_destroy,
+		.alloc		= xv_alloc,
+		.free		= xv_release,
+		.map		= xv_map,
+		.unmap		= xv_unmap,
+		.total_size	= xv_total_size,
+	}, {
+		.name		= "zsmalloc",
+		.create		= zs_create,
+		.destroy	= zs_destroy,
+		.alloc		= zs_alloc,
+		.free		= zs_release,
+		.map		= zs_map,
+		.unmap		= zs_unmap,
+		.total_size	= zs_total_size,
+		.compact	= zs_do_compact,
+	},
+};
+
+static struct replay_op *replay_load(unsigned int *nr)
+{
+	struct replay_op *op;
+	struct file *file;
+	loff_t size;
+	int ret;
+
+	file = filp_open(trace, O_RDONLY, 0);
+	if (IS_ERR(file)) {
+		pr_err("Cannot open %s\n", trace);
+		return NULL;
+	}
+
+	size = i_size_read(file->f_path.dentry->d_inode);
+	*nr = size / sizeof(*op);
+	op = *nr ? vmalloc(*nr * sizeof(*op)) : NULL;
+	if (!op) {
+		pr_err("Cannot load %s\n", trace);
+		goto out;
+	}
+
+	ret = kernel_read(file, 0, (char *)op, *nr * sizeof(*op));
+	if (ret != *nr * sizeof(*op)) {
+		pr_err("Error reading %s: %d\n", trace, ret);
+		vfree(op);
+		op = NULL;
+	}
+
+out:
+	filp_close(file, NULL);
+	return op;
+}
+
+/* Compressed page sizes: a few small, mostly around 1-2K, some large */
+static u32 replay_size(struct rnd_state *rnd)
+{
+	u32 r = prandom32(rnd) % 100;
+
+	if (r < 30)
+		return 64 + prandom32(rnd) % (PAGE_SIZE / 4 - 64);
+	if (r < 85)
+		return PAGE_SIZE / 4 + prandom32(rnd) % (PAGE_SIZE / 4);
+	return PAGE_SIZE / 2 + prandom32(rnd) % (PAGE_SIZE / 4);
+}
+
+static struct replay_op *replay_generate(unsigned int *nr)
+{
+	struct replay_op *op;
+	struct rnd_state rnd;
+	unsigned int i;
+
+	*nr = ops;
+	op = vmalloc(*nr * sizeof(*op));
+	if (!op)
+		return NULL;
+
+	prandom32_seed(&rnd, seed);
+	for (i = 0; i < *nr; i++) {
+		op[i].slot = cpu_to_le32(prandom32(&rnd) % slots);
+		if (i < *nr / 5 * 4 && prandom32(&rnd) % 10 < 7)
+			op[i].size = cpu_to_le32(replay_size(&rnd));
+		else
+			op[i].size = 0;
+	}
+
+	return op;
+}
+
+static void replay_tag(const struct replay_allocator *a, void *pool,
+			struct replay_obj *obj, u32 tag)
+{
+	void *mem = a->map(pool, obj->handle, obj->offset);
+
+	memcpy(mem, &tag, sizeof(tag));
+	memcpy(mem + obj->size - sizeof(tag), &tag, sizeof(tag));
+	a->unmap(pool, obj->handle, mem);
+}
+
+static int replay_check(const struct replay_allocator *a, void *pool,
+			struct replay_obj *obj, u32 tag)
+{
+	void *mem = a->map(pool, obj->handle, obj->offset);
+	int ok;
+
+	ok = !memcmp(mem, &tag, sizeof(tag)) &&
+	     !memcmp(mem + obj->size - sizeof(tag), &tag, sizeof(tag));
+	a->unmap(pool, obj->handle, mem);
+
+	return ok;
+}
+
+static void replay_run(const struct replay_allocator *a,
+			const struct replay_op *op, unsigned int nr)
+{
+	struct replay_obj *objs, *obj;
+	u64 allocs = 0, frees = 0, failed = 0, errors = 0;
+	u64 live = 0, mem, peak = 0;
+	s64 alloc_ns = 0, free_ns = 0, compact_us;
+	unsigned long compacted;
+	unsigned int i, slot;
+	ktime_t start;
+	void *pool;
+	u32 size;
+
+	objs = vmalloc(slots * sizeof(*objs));
+	pool = a->create();
+	if (!objs || !pool) {
+		pr_err("%s: out of memory\n", a->name);
+		goto out;
+	}
+	memset(objs, 0, slots * sizeof(*objs));
+
+	for (i = 0; i < nr; i++) {
+		slot = le32_to_cpu(op[i].slot);
+		size = le32_to_cpu(op[i].size);
+		if (slot >= slots)
+			continue;
+		obj = &objs[slot];
+
+		if (obj->size) {
+			if (!replay_check(a, pool, obj, slot))
+				errors++;
+			start = ktime_get();
+			a->free(pool, obj->handle, obj->offset);
+			free_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+			frees++;
+			live -= obj->size;
+			obj->size = 0;
+		}
+
+		if (size) {
+			size = clamp_t(u32, size, sizeof(u32), PAGE_SIZE / 4 * 3);
+			start = ktime_get();
+			if (a->alloc(pool, size, &obj->handle, &obj->offset)) {
+				failed++;
+			} else {
+				alloc_ns += ktime_to_ns(ktime_sub(ktime_get(),
+								  start));
+				allocs++;
+				obj->size = size;
+				live += size;
+				replay_tag(a, pool, obj, slot);
+			}
+		}
+
+		mem = a->total_size(pool);
+		if (mem > peak)
+			peak = mem;
+
+		if (!(i % 1024))
+			cond_resched();
+	}
+
+	mem = a->total_size(pool);
+	pr_info("%s: %llu allocs, %llu ns/alloc, %llu frees, %llu ns/free, "
+		"%llu failed\n", a->name, allocs,
+		allocs ? div64_u64(alloc_ns, allocs) : 0, frees,
+		frees ? div64_u64(free_ns, frees) : 0, failed);
+	pr_info("%s: peak %llu KB, end %llu KB for %llu KB of objects "
+		"(%llu%% used)\n", a->name, peak >> 10, mem >> 10, live >> 10,
+		mem ? div64_u64(live * 100, mem) : 0);
+
+	if (a->compact) {
+		start = ktime_get();
+		compacted = a->compact(pool);
+		compact_us = ktime_us_delta(ktime_get(), start);
+		mem = a->total_size(pool);
+		pr_info("%s: compaction freed %lu pages in %lld us, %llu KB "
+			"(%llu%% used)\n", a->name, compacted, compact_us,
+			mem >> 10, mem ? div64_u64(live * 100, mem) : 0);
+	}
+
+	for (slot = 0; slot < slots; slot++) {
+		obj = &objs[slot];
+		if (!obj->size)
+			continue;
+		if (!replay_check(a, pool, obj, slot))
+			errors++;
+		a->free(pool, obj->handle, obj->offset);
+	}
+
+	if (errors)
+		pr_err("%s: %llu corrupted objects\n", a->name, errors);
+
+out:
+	if (pool)
+		a->destroy(pool);
+	vfree(objs);
+}
+
+static int __init ramzswap_replay_init(void)
+{
+	struct replay_op *op;
+	unsigned int i, nr;
+
+	if (!slots) {
+		pr_err("slots must not be zero\n");
+		return -EINVAL;
+	}
+
+	op = trace ? replay_load(&nr) : replay_generate(&nr);
+	if (!op)
+		return -ENOMEM;
+
+	pr_info("replaying %u operations on %u slots%s%s\n", nr, slots,
+		trace ? " from " : "", trace ? trace : "");
+
+	for (i = 0; i < ARRAY_SIZE(allocators); i++)
+		replay_run(&allocators[i], op, nr);
+
+	vfree(op);
+
+	/* Results are in the log, do not stay loaded */
+	return -EAGAIN;
+}
+
+static void __exit ramzswap_replay_exit(void)
+{
+}
+
+module_param(trace, charp, 0);
+MODULE_PARM_DESC(trace, "Trace file to replay (default: generated)");
+module_param(ops, uint, 0);
+MODULE_PARM_DESC(ops, "Number of operations to generate");
+module_param(slots, uint, 0);
+MODULE_PARM_DESC(slots, "Number of object slots");
+module_param(seed, uint, 0);
+MODULE_PARM_DESC(seed, "Seed of the generated workload");
+
+module_init(ramzswap_replay_init);
+module_exit(ramzswap_replay_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("ramzswap allocator replay");
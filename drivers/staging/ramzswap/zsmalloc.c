@@ -0,0 +1,602 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ * Objects are grouped by size class: all objects of a class have the same
+ * size (a multiple of ZS_SIZE_CLASS_DELTA) and are packed back to back in
+ * zspages, groups of up to ZS_MAX_PAGES_PER_ZSPAGE pages chosen to waste
+ * as little of the last page as possible. An object may thus straddle two
+ * pages; such objects are copied through a per-CPU buffer when mapped.
+ *
+ * Users only get a handle, which keeps the current location of the object.
+ * This lets zs_compact() move objects out of sparsely used zspages into
+ * fuller ones of the same class and release the pages freed that way,
+ * which xvmalloc can never do since its users hold <page, offset> pairs.
+ */
+
+#include <linux/errno.h>
+#include <linux/highmem.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/bit_spinlock.h>
+
+#include "zsmalloc.h"
+#include "zsmalloc_int.h"
+
+/* Handles of all pools come from one cache */
+static struct kmem_cache *zs_handle_cache;
+static unsigned int zs_nr_pools;
+static DEFINE_MUTEX(zs_pools_lock);
+
+/*
+ * Find the number of pages (up to ZS_MAX_PAGES_PER_ZSPAGE) in which
+ * objects of the given size leave the least unused space.
+ */
+static u16 get_pages_per_zspage(u32 size)
+{
+	u32 i, zspage_size, usedpc, max_usedpc = 0;
+	u16 pages = 1;
+
+	for (i = 1; i <= ZS_MAX_PAGES_PER_ZSPAGE; i++) {
+		zspage_size = i * PAGE_SIZE;
+		usedpc = (zspage_size - zspage_size % size) * 100
+				/ zspage_size;
+		if (usedpc > max_usedpc) {
+			max_usedpc = usedpc;
+			pages = i;
+		}
+	}
+
+	return pages;
+}
+
+static struct size_class *get_size_class(struct zs_pool *pool, u32 size)
+{
+	u32 index = 0;
+
+	if (size > ZS_MIN_ALLOC_SIZE)
+		index = DIV_ROUND_UP(size - ZS_MIN_ALLOC_SIZE,
+				     ZS_SIZE_CLASS_DELTA);
+
+	return &pool->classes[index];
+}
+
+static enum fullness_group get_fullness_group(struct size_class *class,
+					struct zspage *zspage)
+{
+	if (zspage->inuse == class->objs_per_zspage)
+		return ZS_FULL;
+
+	if (zspage->inuse * ZS_FULLNESS_FRAC >=
+			class->objs_per_zspage * (ZS_FULLNESS_FRAC - 1))
+		return ZS_ALMOST_FULL;
+
+	return ZS_ALMOST_EMPTY;
+}
+
+static void insert_zspage(struct size_class *class, struct zspage *zspage)
+{
+	zspage->fullness = get_fullness_group(class, zspage);
+	list_add(&zspage->list, &class->fullness_list[zspage->fullness]);
+}
+
+static void fix_fullness_group(struct size_class *class,
+					struct zspage *zspage)
+{
+	enum fullness_group fullness;
+
+	fullness = get_fullness_group(class, zspage);
+	if (fullness == zspage->fullness)
+		return;
+
+	list_move(&zspage->list, &class->fullness_list[fullness]);
+	zspage->fullness = fullness;
+}
+
+/* Fullest zspages first, so sparse ones get a chance to drain */
+static struct zspage *find_zspage(struct size_class *class)
+{
+	int i;
+
+	for (i = ZS_ALMOST_FULL; i >= ZS_ALMOST_EMPTY; i--) {
+		if (!list_empty(&class->fullness_list[i]))
+			return list_first_entry(&class->fullness_list[i],
+						struct zspage, list);
+	}
+
+	return NULL;
+}
+
+/*
+ * The first word of an object never straddles two pages since objects
+ * and pages are both ZS_SIZE_CLASS_DELTA aligned.
+ */
+static unsigned long obj_get_word(struct zspage *zspage, u16 obj)
+{
+	unsigned long off = obj * zspage->class->size, word;
+	unsigned char *vaddr;
+
+	vaddr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER0);
+	word = *(unsigned long *)(vaddr + (off & ~PAGE_MASK));
+	kunmap_atomic(vaddr, KM_USER0);
+
+	return word;
+}
+
+static void obj_set_word(struct zspage *zspage, u16 obj, unsigned long word)
+{
+	unsigned long off = obj * zspage->class->size;
+	unsigned char *vaddr;
+
+	vaddr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER0);
+	*(unsigned long *)(vaddr + (off & ~PAGE_MASK)) = word;
+	kunmap_atomic(vaddr, KM_USER0);
+}
+
+/* Copy len bytes at offset off of the zspage from or to buf */
+static void zs_copy(struct zspage *zspage, unsigned long off, void *buf,
+			u32 len, int write)
+{
+	unsigned char *vaddr;
+	u32 poff, n;
+
+	while (len) {
+		poff = off & ~PAGE_MASK;
+		n = min_t(u32, len, PAGE_SIZE - poff);
+
+		vaddr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER1);
+		if (write)
+			memcpy(vaddr + poff, buf, n);
+		else
+			memcpy(buf, vaddr + poff, n);
+		kunmap_atomic(vaddr, KM_USER1);
+
+		buf += n;
+		off += n;
+		len -= n;
+	}
+}
+
+static void obj_alloc(struct size_class *class, struct zspage *zspage,
+			struct zs_handle *handle)
+{
+	u16 obj = zspage->freeobj;
+
+	zspage->freeobj = obj_get_word(zspage, obj) >> 1;
+	obj_set_word(zspage, obj, (unsigned long)handle | ZS_OBJ_ALLOCATED);
+	zspage->inuse++;
+	class->objs_inuse++;
+
+	handle->zspage = zspage;
+	handle->obj = obj;
+
+	fix_fullness_group(class, zspage);
+}
+
+/* Caller fixes the fullness group or frees the zspage */
+static void obj_free(struct size_class *class, struct zspage *zspage,
+			u16 obj)
+{
+	obj_set_word(zspage, obj, (unsigned long)zspage->freeobj << 1);
+	zspage->freeobj = obj;
+	zspage->inuse--;
+	class->objs_inuse--;
+}
+
+static void free_zspage(struct zs_pool *pool, struct zspage *zspage)
+{
+	int i;
+
+	for (i = 0; i < zspage->class->pages_per_zspage; i++)
+		__free_page(zspage->pages[i]);
+
+	atomic_long_sub(zspage->class->pages_per_zspage,
+			&pool->pages_allocated);
+	atomic_long_sub(ksize(zspage), &pool->meta_bytes);
+	kfree(zspage);
+}
+
+static struct zspage *alloc_zspage(struct size_class *class, gfp_t flags)
+{
+	struct zspage *zspage;
+	u16 obj, next;
+	int i;
+
+	zspage = kzalloc(sizeof(*zspage), flags & ~__GFP_HIGHMEM);
+	if (!zspage)
+		return NULL;
+
+	INIT_LIST_HEAD(&zspage->list);
+	zspage->class = class;
+
+	for (i = 0; i < class->pages_per_zspage; i++) {
+		zspage->pages[i] = alloc_page(flags);
+		if (!zspage->pages[i])
+			goto fail;
+	}
+
+	/* Link all objects into the free list */
+	for (obj = 0; obj < class->objs_per_zspage; obj++) {
+		next = obj + 1 < class->objs_per_zspage ? obj + 1 : ZS_NO_OBJ;
+		obj_set_word(zspage, obj, (unsigned long)next << 1);
+	}
+	zspage->freeobj = 0;
+
+	return zspage;
+
+fail:
+	while (i--)
+		__free_page(zspage->pages[i]);
+	kfree(zspage);
+	return NULL;
+}
+
+/*
+ * Create a memory pool. Allocates the size classes and the per-CPU
+ * buffers used to map objects which straddle two pages.
+ */
+struct zs_pool *zs_create_pool(void)
+{
+	struct zs_pool *pool;
+	struct size_class *class;
+	struct zs_map_area *area;
+	int i, cpu;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = &pool->classes[i];
+		spin_lock_init(&class->lock);
+		class->size = ZS_MIN_ALLOC_SIZE + i * ZS_SIZE_CLASS_DELTA;
+		class->pages_per_zspage = get_pages_per_zspage(class->size);
+		class->objs_per_zspage = class->pages_per_zspage * PAGE_SIZE
+						/ class->size;
+		INIT_LIST_HEAD(&class->fullness_list[ZS_ALMOST_EMPTY]);
+		INIT_LIST_HEAD(&class->fullness_list[ZS_ALMOST_FULL]);
+		INIT_LIST_HEAD(&class->fullness_list[ZS_FULL]);
+	}
+
+	pool->map_area = alloc_percpu(struct zs_map_area);
+	if (!pool->map_area)
+		goto free_pool;
+
+	for_each_possible_cpu(cpu) {
+		area = per_cpu_ptr(pool->map_area, cpu);
+		area->buf = kmalloc(ZS_MAX_ALLOC_SIZE, GFP_KERNEL);
+		if (!area->buf)
+			goto free_areas;
+	}
+
+	mutex_lock(&zs_pools_lock);
+	if (!zs_nr_pools) {
+		zs_handle_cache = KMEM_CACHE(zs_handle, 0);
+		if (!zs_handle_cache) {
+			mutex_unlock(&zs_pools_lock);
+			goto free_areas;
+		}
+	}
+	zs_nr_pools++;
+	mutex_unlock(&zs_pools_lock);
+
+	return pool;
+
+free_areas:
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(pool->map_area, cpu)->buf);
+	free_percpu(pool->map_area);
+free_pool:
+	kfree(pool);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(zs_create_pool);
+
+void zs_destroy_pool(struct zs_pool *pool)
+{
+	struct zspage *zspage, *tmp;
+	int i, j, cpu;
+
+	/* Objects still allocated are lost along with their handles */
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		for (j = 0; j < __NR_FULLNESS_GROUPS; j++) {
+			list_for_each_entry_safe(zspage, tmp,
+				&pool->classes[i].fullness_list[j], list) {
+				WARN_ON_ONCE(1);
+				free_zspage(pool, zspage);
+			}
+		}
+	}
+
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(pool->map_area, cpu)->buf);
+	free_percpu(pool->map_area);
+
+	mutex_lock(&zs_pools_lock);
+	if (!--zs_nr_pools) {
+		kmem_cache_destroy(zs_handle_cache);
+		zs_handle_cache = NULL;
+	}
+	mutex_unlock(&zs_pools_lock);
+
+	kfree(pool);
+}
+EXPORT_SYMBOL_GPL(zs_destroy_pool);
+
+/**
+ * zs_malloc - Allocate object of given size from pool.
+ * @pool: pool to allocate from
+ * @size: size of object to allocate
+ * @flags: allocation flags for pages and metadata
+ *
+ * On success, returns the handle of the new object, to be passed to
+ * zs_map_object() to access it. Returns 0 on failure.
+ *
+ * Allocation requests with size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE
+ * will fail.
+ */
+unsigned long zs_malloc(struct zs_pool *pool, u32 size, gfp_t flags)
+{
+	struct zs_handle *handle;
+	struct size_class *class;
+	struct zspage *zspage;
+
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE))
+		return 0;
+
+	handle = kmem_cache_alloc(zs_handle_cache, flags & ~__GFP_HIGHMEM);
+	if (!handle)
+		return 0;
+	handle->lock = 0;
+	handle->size = size;
+	atomic_long_add(kmem_cache_size(zs_handle_cache), &pool->meta_bytes);
+
+	class = get_size_class(pool, size + ZS_HANDLE_SIZE);
+
+	spin_lock(&class->lock);
+	zspage = find_zspage(class);
+
+	if (!zspage) {
+		spin_unlock(&class->lock);
+		zspage = alloc_zspage(class, flags);
+		if (unlikely(!zspage)) {
+			atomic_long_sub(kmem_cache_size(zs_handle_cache),
+					&pool->meta_bytes);
+			kmem_cache_free(zs_handle_cache, handle);
+			return 0;
+		}
+		atomic_long_add(class->pages_per_zspage,
+				&pool->pages_allocated);
+		atomic_long_add(ksize(zspage), &pool->meta_bytes);
+
+		spin_lock(&class->lock);
+		insert_zspage(class, zspage);
+		class->zspages++;
+	}
+
+	obj_alloc(class, zspage, handle);
+	spin_unlock(&class->lock);
+
+	return (unsigned long)handle;
+}
+EXPORT_SYMBOL_GPL(zs_malloc);
+
+/* Enough objects are free to release at least one zspage */
+static int zs_can_compact(struct size_class *class)
+{
+	return class->zspages * class->objs_per_zspage - class->objs_inuse
+			>= class->objs_per_zspage;
+}
+
+/*
+ * Returns nonzero if the size class of the object is left with enough free
+ * space for zs_compact() to release a zspage.
+ */
+int zs_free(struct zs_pool *pool, unsigned long handle)
+{
+	struct zs_handle *h = (struct zs_handle *)handle;
+	struct size_class *class;
+	struct zspage *zspage;
+	int can_compact;
+
+	/* Pinned, the object cannot move to another zspage under us */
+	bit_spin_lock(ZS_HANDLE_PIN, &h->lock);
+	zspage = h->zspage;
+	class = zspage->class;
+
+	spin_lock(&class->lock);
+	obj_free(class, zspage, h->obj);
+	if (zspage->inuse) {
+		fix_fullness_group(class, zspage);
+		zspage = NULL;
+	} else {
+		list_del(&zspage->list);
+		class->zspages--;
+	}
+	can_compact = zs_can_compact(class);
+	spin_unlock(&class->lock);
+	bit_spin_unlock(ZS_HANDLE_PIN, &h->lock);
+
+	if (zspage)
+		free_zspage(pool, zspage);
+	atomic_long_sub(kmem_cache_size(zs_handle_cache), &pool->meta_bytes);
+	kmem_cache_free(zs_handle_cache, h);
+
+	return can_compact;
+}
+EXPORT_SYMBOL_GPL(zs_free);
+
+/*
+ * Only one object can be mapped at a time on a CPU. The object stays
+ * pinned, and preemption disabled, until zs_unmap_object().
+ */
+void *zs_map_object(struct zs_pool *pool, unsigned long handle,
+			enum zs_mapmode mm)
+{
+	struct zs_handle *h = (struct zs_handle *)handle;
+	struct zs_map_area *area;
+	struct zspage *zspage;
+	unsigned long off;
+	u32 size;
+
+	bit_spin_lock(ZS_HANDLE_PIN, &h->lock);
+
+	zspage = h->zspage;
+	size = zspage->class->size;
+	off = h->obj * size;
+	area = this_cpu_ptr(pool->map_area);
+
+	if ((off & ~PAGE_MASK) + size <= PAGE_SIZE) {
+		area->vaddr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT],
+					  KM_USER1);
+		return area->vaddr + (off & ~PAGE_MASK) + ZS_HANDLE_SIZE;
+	}
+
+	/* Object straddles two pages, hand out a copy */
+	area->vaddr = NULL;
+	area->mm = mm;
+	if (mm != ZS_MM_WO)
+		zs_copy(zspage, off + ZS_HANDLE_SIZE, area->buf, h->size, 0);
+
+	return area->buf;
+}
+EXPORT_SYMBOL_GPL(zs_map_object);
+
+void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
+{
+	struct zs_handle *h = (struct zs_handle *)handle;
+	struct zs_map_area *area;
+	unsigned long off;
+
+	area = this_cpu_ptr(pool->map_area);
+
+	if (area->vaddr) {
+		kunmap_atomic(area->vaddr, KM_USER1);
+	} else if (area->mm != ZS_MM_RO) {
+		off = h->obj * h->zspage->class->size;
+		zs_copy(h->zspage, off + ZS_HANDLE_SIZE, area->buf, h->size, 1);
+	}
+
+	bit_spin_unlock(ZS_HANDLE_PIN, &h->lock);
+}
+EXPORT_SYMBOL_GPL(zs_unmap_object);
+
+/* Move a pinned object to another zspage. Called with class lock held */
+static void move_object(struct zs_pool *pool, struct size_class *class,
+			struct zs_handle *h, struct zspage *dst)
+{
+	struct zspage *src = h->zspage;
+	u16 obj = h->obj;
+	char *buf;
+
+	/* Nothing else maps an object on this CPU while we hold a lock */
+	buf = this_cpu_ptr(pool->map_area)->buf;
+
+	zs_copy(src, obj * class->size + ZS_HANDLE_SIZE, buf, h->size, 0);
+	obj_alloc(class, dst, h);
+	zs_copy(dst, h->obj * class->size + ZS_HANDLE_SIZE, buf, h->size, 1);
+	obj_free(class, src, obj);
+}
+
+static unsigned long compact_class(struct zs_pool *pool,
+					struct size_class *class)
+{
+	struct list_head *sparse = &class->fullness_list[ZS_ALMOST_EMPTY];
+	struct zspage *src, *dst;
+	struct zs_handle *h;
+	unsigned long word, freed = 0;
+	u16 obj;
+
+	spin_lock(&class->lock);
+
+	while (zs_can_compact(class) && !list_empty(sparse)) {
+		/* Drain from the tail, allocations take from the head */
+		src = list_entry(sparse->prev, struct zspage, list);
+		list_del_init(&src->list);
+
+		for (obj = 0; src->inuse && obj < class->objs_per_zspage;
+				obj++) {
+			word = obj_get_word(src, obj);
+			if (!(word & ZS_OBJ_ALLOCATED))
+				continue;
+
+			dst = find_zspage(class);
+			if (!dst)
+				break;
+
+			/* Mapped right now, retry on the next run */
+			h = (struct zs_handle *)(word & ~ZS_OBJ_ALLOCATED);
+			if (!bit_spin_trylock(ZS_HANDLE_PIN, &h->lock))
+				break;
+
+			move_object(pool, class, h, dst);
+			bit_spin_unlock(ZS_HANDLE_PIN, &h->lock);
+		}
+
+		if (src->inuse) {
+			insert_zspage(class, src);
+			break;
+		}
+
+		class->zspages--;
+		free_zspage(pool, src);
+		freed += class->pages_per_zspage;
+
+		spin_unlock(&class->lock);
+		cond_resched();
+		spin_lock(&class->lock);
+	}
+
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+/*
+ * Move objects out of sparsely used zspages and free the pages emptied
+ * this way. Returns the number of pages freed. May sleep.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	unsigned long freed = 0;
+	int i;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++)
+		freed += compact_class(pool, &pool->classes[i]);
+
+	atomic_long_add(freed, &pool->pages_compacted);
+
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+u32 zs_get_object_size(struct zs_pool *pool, unsigned long handle)
+{
+	return ((struct zs_handle *)handle)->size;
+}
+EXPORT_SYMBOL_GPL(zs_get_object_size);
+
+/*
+ * Returns total memory used by allocator (userdata + metadata): the pages
+ * of all zspages, and the slab memory of the handles and zspage headers
+ */
+u64 zs_get_total_size_bytes(struct zs_pool *pool)
+{
+	return ((u64)atomic_long_read(&pool->pages_allocated) << PAGE_SHIFT) +
+		atomic_long_read(&pool->meta_bytes);
+}
+EXPORT_SYMBOL_GPL(zs_get_total_size_bytes);
+
+/*
+ * Returns the number of pages released by zs_compact() so far
+ */
+u64 zs_get_compacted_pages(struct zs_pool *pool)
+{
+	return atomic_long_read(&pool->pages_compacted);
+}
+EXPORT_SYMBOL_GPL(zs_get_compacted_pages);
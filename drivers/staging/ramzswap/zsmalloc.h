@@ -0,0 +1,42 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZS_MALLOC_H_
+#define _ZS_MALLOC_H_
+
+#include <linux/types.h>
+
+/*
+ * Objects are only reachable through their handle and must be mapped to
+ * be accessed. A mapping uses the KM_USER1 kmap slot and pins the object
+ * against compaction until it is unmapped, so keep it short and do not
+ * sleep meanwhile.
+ */
+enum zs_mapmode {
+	ZS_MM_RW,	/* read and write the object */
+	ZS_MM_RO,	/* changes are not written back */
+	ZS_MM_WO,	/* previous content is not read */
+};
+
+struct zs_pool;
+
+struct zs_pool *zs_create_pool(void);
+void zs_destroy_pool(struct zs_pool *pool);
+
+unsigned long zs_malloc(struct zs_pool *pool, u32 size, gfp_t flags);
+int zs_free(struct zs_pool *pool, unsigned long handle);
+
+void *zs_map_object(struct zs_pool *pool, unsigned long handle,
+			enum zs_mapmode mm);
+void zs_unmap_object(struct zs_pool *pool, unsigned long handle);
+
+unsigned long zs_compact(struct zs_pool *pool);
+
+u32 zs_get_object_size(struct zs_pool *pool, unsigned long handle);
+u64 zs_get_total_size_bytes(struct zs_pool *pool);
+u64 zs_get_compacted_pages(struct zs_pool *pool);
+
+#endif
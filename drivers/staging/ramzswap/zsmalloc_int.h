@@ -0,0 +1,103 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZS_MALLOC_INT_H_
+#define _ZS_MALLOC_INT_H_
+
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+/* User configurable params */
+
+/* Each object starts with a word pointing back to its handle */
+#define ZS_HANDLE_SIZE		sizeof(unsigned long)
+
+#define ZS_MIN_ALLOC_SIZE	32
+#define ZS_MAX_ALLOC_SIZE	PAGE_SIZE
+
+/* Size classes are separated by ZS_SIZE_CLASS_DELTA bytes */
+#define ZS_SIZE_CLASS_DELTA	16
+#define ZS_SIZE_CLASSES		((ZS_MAX_ALLOC_SIZE - ZS_MIN_ALLOC_SIZE) \
+					/ ZS_SIZE_CLASS_DELTA + 1)
+
+/* Objects of a class are packed into zspages of up to this many pages */
+#define ZS_MAX_PAGES_PER_ZSPAGE	4
+
+/* A zspage is almost full when 3/4 of its objects are in use */
+#define ZS_FULLNESS_FRAC	4
+
+/* End of user params */
+
+#define ZS_NO_OBJ		0xffff
+
+/* Tags the first word of allocated objects, free ones hold a link */
+#define ZS_OBJ_ALLOCATED	1UL
+
+/* Bit of zs_handle.lock held while the object is mapped or moved */
+#define ZS_HANDLE_PIN		0
+
+enum fullness_group {
+	ZS_ALMOST_EMPTY,
+	ZS_ALMOST_FULL,
+	ZS_FULL,
+	__NR_FULLNESS_GROUPS,
+};
+
+struct size_class;
+
+/*
+ * Group of pages holding objects of one size class. Objects may
+ * straddle the boundary between two of its pages.
+ */
+struct zspage {
+	struct list_head list;		/* in class->fullness_list */
+	struct size_class *class;
+	u16 inuse;			/* allocated objects */
+	u16 freeobj;			/* first free object or ZS_NO_OBJ */
+	u8 fullness;
+	struct page *pages[ZS_MAX_PAGES_PER_ZSPAGE];
+};
+
+struct size_class {
+	spinlock_t lock;
+	u32 size;			/* object size, handle word included */
+	u16 pages_per_zspage;
+	u16 objs_per_zspage;
+	struct list_head fullness_list[__NR_FULLNESS_GROUPS];
+
+	/* stats */
+	u32 zspages;
+	u32 objs_inuse;
+};
+
+/* Handed out to users, survives the object moving around */
+struct zs_handle {
+	unsigned long lock;
+	struct zspage *zspage;
+	u16 obj;
+	u16 size;			/* size requested by the user */
+};
+
+/* Per-CPU copy of objects which straddle two pages while mapped */
+struct zs_map_area {
+	char *buf;
+	void *vaddr;
+	enum zs_mapmode mm;
+};
+
+struct zs_pool {
+	struct size_class classes[ZS_SIZE_CLASSES];
+	struct zs_map_area *map_area;	/* per-CPU */
+
+	/* stats */
+	atomic_long_t pages_allocated;
+	atomic_long_t meta_bytes;	/* handles and struct zspage */
+	atomic_long_t pages_compacted;
+};
+
+#endif
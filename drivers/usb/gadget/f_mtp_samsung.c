@@ -35,6 +35,8 @@
 #include <linux/err.h>
 #include <linux/interrupt.h>
 #include <linux/types.h>
+#include <linux/file.h>
+#include <linux/fs.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 #include <linux/kernel.h>
@@ -46,6 +48,7 @@
 #include <linux/usb/ch9.h>
 #include <linux/usb/composite.h>
 #include <linux/usb/gadget.h>
+#include <linux/usb/f_mtp.h>
 
 #include <linux/sched.h>
 #include <asm-generic/siginfo.h>
@@ -94,11 +97,29 @@
 #endif
 /*-------------------------------------------------------------------------*/
 
-#define BULK_BUFFER_SIZE	 4096
+#define BULK_BUFFER_SIZE	 16384
+#define BULK_BUFFER_MAX		 65536
 
 /* number of rx and tx requests to allocate */
-#define RX_REQ_MAX		 4
-#define TX_REQ_MAX		 4
+#define RX_REQ_MAX		 8
+#define TX_REQ_MAX		 8
+#define REQ_MAX_LIMIT		 32
+
+/*
+ * Request size and queue depth are read at bind time. The request size
+ * is rounded up to the high speed bulk packet size.
+ */
+static unsigned int mtp_buf_size = BULK_BUFFER_SIZE;
+module_param(mtp_buf_size, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_buf_size, "size of each bulk request");
+
+static unsigned int mtp_rx_req_max = RX_REQ_MAX;
+module_param(mtp_rx_req_max, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_rx_req_max, "number of bulk out requests");
+
+static unsigned int mtp_tx_req_max = TX_REQ_MAX;
+module_param(mtp_tx_req_max, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_tx_req_max, "number of bulk in requests");
 
 #define DRIVER_NAME		 "usb_mtp_gadget"
 
@@ -416,7 +437,7 @@ static ssize_t mtpg_read(struct file *fp, char __user *buf,
 		DEBUG_MTPR("*********[%s]\t%d: get request \n", __FUNCTION__,__LINE__);
 		while ((req = req_get(dev, &dev->rx_idle))) {
 requeue_req:
-			req->length = BULK_BUFFER_SIZE;
+			req->length = mtp_buf_size;
 			DEBUG_MTPR("[%s]\t%d: ---------- usb-ep-queue \n", __FUNCTION__,__LINE__);
 			ret = usb_ep_queue(dev->bulk_out, req, GFP_ATOMIC);
 
@@ -546,8 +567,8 @@ static ssize_t mtpg_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > BULK_BUFFER_SIZE) {
-				xfer = BULK_BUFFER_SIZE;
+			if (count > mtp_buf_size) {
+				xfer = mtp_buf_size;
 			}
 			else{
 				xfer = count;
@@ -589,6 +610,205 @@ static ssize_t mtpg_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/*
+ * MTP_SEND_FILE / MTP_RECEIVE_FILE move a file range between the page
+ * cache and the bulk requests directly, keeping every request queued
+ * instead of bouncing each one through a read()/write() call. The
+ * container header and any ZLP are still sent by userspace.
+ */
+static int mtpg_send_file(struct mtpg_dev *dev, struct file *filp,
+				loff_t offset, size_t count)
+{
+	struct usb_request *req = 0;
+	mm_segment_t old_fs;
+	int r = 0, xfer;
+	int ret;
+
+	if (_lock(&dev->write_excl))
+		return -EBUSY;
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+
+	while (count > 0) {
+		if (dev->error) {
+			r = -EIO;
+			break;
+		}
+
+		/* get an idle tx request to use */
+		req = 0;
+		ret = wait_event_interruptible(dev->write_wq,
+			((req = req_get(dev, &dev->tx_idle)) || dev->error));
+		if (ret < 0) {
+			r = ret;
+			break;
+		}
+		if (!req)
+			continue;
+
+		xfer = min_t(size_t, count, mtp_buf_size);
+		ret = vfs_read(filp, req->buf, xfer, &offset);
+		if (ret <= 0) {
+			/* the file is shorter than the range */
+			r = ret ? ret : -EIO;
+			break;
+		}
+		xfer = ret;
+
+		req->length = xfer;
+		ret = usb_ep_queue(dev->bulk_in, req, GFP_KERNEL);
+		if (ret < 0) {
+			dev->error = 1;
+			r = -EIO;
+			break;
+		}
+
+		count -= xfer;
+
+		/* zero this so we don't try to free it on error exit */
+		req = 0;
+	}
+
+	set_fs(old_fs);
+
+	if (req)
+		req_put(dev, &dev->tx_idle, req);
+
+	_unlock(&dev->write_excl);
+
+	DEBUG_MTPW("[%s] %zu bytes left, r = %d\n", __func__, count, r);
+	return r;
+}
+
+static int mtpg_receive_file(struct mtpg_dev *dev, struct file *filp,
+				loff_t offset, size_t count)
+{
+	struct usb_request *req;
+	mm_segment_t old_fs;
+	int r = 0, xfer, short_pkt;
+	int ret;
+
+	if (_lock(&dev->read_excl))
+		return -EBUSY;
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+
+	/* data left over from the last mtpg_read() comes first */
+	if (dev->read_count > 0) {
+		xfer = min_t(size_t, dev->read_count, count);
+		ret = vfs_write(filp, dev->read_buf, xfer, &offset);
+		if (ret != xfer) {
+			r = ret < 0 ? ret : -EIO;
+			goto done;
+		}
+
+		dev->read_buf += xfer;
+		dev->read_count -= xfer;
+		count -= xfer;
+
+		if (dev->read_count == 0) {
+			req_put(dev, &dev->rx_idle, dev->read_req);
+			dev->read_req = 0;
+		}
+	}
+
+	while (count > 0) {
+		if (dev->error) {
+			r = -EIO;
+			break;
+		}
+
+		/* keep every idle request queued on the endpoint */
+		while ((req = req_get(dev, &dev->rx_idle))) {
+			req->length = mtp_buf_size;
+			ret = usb_ep_queue(dev->bulk_out, req, GFP_KERNEL);
+			if (ret < 0) {
+				dev->error = 1;
+				req_put(dev, &dev->rx_idle, req);
+				r = -EIO;
+				goto done;
+			}
+		}
+
+		req = 0;
+		ret = wait_event_interruptible(dev->read_wq,
+			((req = req_get(dev, &dev->rx_done)) || dev->error));
+		if (ret < 0) {
+			r = ret;
+			break;
+		}
+		if (!req)
+			continue;
+
+		xfer = min_t(size_t, req->actual, count);
+		ret = vfs_write(filp, req->buf, xfer, &offset);
+		if (ret != xfer) {
+			req_put(dev, &dev->rx_idle, req);
+			r = ret < 0 ? ret : -EIO;
+			break;
+		}
+		count -= xfer;
+
+		if (xfer < req->actual) {
+			/* the rest belongs to the next mtpg_read() */
+			dev->read_req = req;
+			dev->read_buf = (unsigned char *)req->buf + xfer;
+			dev->read_count = req->actual - xfer;
+			break;
+		}
+
+		/* a short packet ends the transfer early */
+		short_pkt = req->actual < req->length;
+		req_put(dev, &dev->rx_idle, req);
+
+		if (count > 0 && short_pkt) {
+			r = -EIO;
+			break;
+		}
+	}
+
+done:
+	set_fs(old_fs);
+
+	_unlock(&dev->read_excl);
+
+	DEBUG_MTPR("[%s] %zu bytes left, r = %d\n", __func__, count, r);
+	return r;
+}
+
+static int mtpg_file_ioctl(struct mtpg_dev *dev, unsigned int code,
+				unsigned long arg)
+{
+	struct mtp_file_range mfr;
+	struct file *filp;
+	int ret;
+
+	if (copy_from_user(&mfr, (void __user *)arg, sizeof(mfr)))
+		return -EFAULT;
+
+	filp = fget(mfr.fd);
+	if (!filp)
+		return -EBADF;
+
+	if (code == MTP_SEND_FILE) {
+		if (filp->f_mode & FMODE_READ)
+			ret = mtpg_send_file(dev, filp, mfr.offset, mfr.length);
+		else
+			ret = -EBADF;
+	} else {
+		if (filp->f_mode & FMODE_WRITE)
+			ret = mtpg_receive_file(dev, filp, mfr.offset,
+						mfr.length);
+		else
+			ret = -EBADF;
+	}
+
+	fput(filp);
+	return ret;
+}
+
 /*Fixme for Interrupt Transfer*/
 static void interrupt_complete(struct usb_ep *ep, struct usb_request *req )
 {
@@ -761,6 +981,11 @@ static long  mtpg_ioctl(struct file *fd, unsigned int code, unsigned long arg)
 
 			break;
 
+		case MTP_SEND_FILE:
+		case MTP_RECEIVE_FILE:
+			status = mtpg_file_ioctl(dev, code, arg);
+			break;
+
 		default:
 			status = -ENOTTY;
 	}
@@ -958,8 +1183,13 @@ static int __init mtpg_function_bind(struct usb_configuration *c, struct usb_fun
 	if (!mtpg->notify_req)
 		goto out;
 
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtpg_request_new(mtpg->bulk_out, BULK_BUFFER_SIZE);
+	mtp_buf_size = clamp_t(unsigned int, ALIGN(mtp_buf_size, 512),
+				512, BULK_BUFFER_MAX);
+	mtp_rx_req_max = clamp_t(unsigned int, mtp_rx_req_max, 1, REQ_MAX_LIMIT);
+	mtp_tx_req_max = clamp_t(unsigned int, mtp_tx_req_max, 1, REQ_MAX_LIMIT);
+
+	for (i = 0; i < mtp_rx_req_max; i++) {
+		req = mtpg_request_new(mtpg->bulk_out, mtp_buf_size);
 		if (!req){
 			goto out;
 		}
@@ -967,8 +1197,8 @@ static int __init mtpg_function_bind(struct usb_configuration *c, struct usb_fun
 		req_put(mtpg, &mtpg->rx_idle, req);
 	}
 
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtpg_request_new(mtpg->bulk_in, BULK_BUFFER_SIZE);
+	for (i = 0; i < mtp_tx_req_max; i++) {
+		req = mtpg_request_new(mtpg->bulk_in, mtp_buf_size);
 		if (!req){
 			goto out;
 		}
@@ -24,6 +24,8 @@
 #include <linux/slab.h>
 #include <linux/kernel.h>
 #include <linux/device.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 
 #include "g_zero.h"
 #include "gadget_chips.h"
@@ -42,12 +44,14 @@
  * mode is enabled, it provides good functional coverage for the "USBCV"
  * test harness from USB-IF.
  *
- * Note that because this doesn't queue more than one request at a time,
- * some other function must be used to test queueing logic.  The network
- * link (g_ether) is the best overall option for that, since its TX and RX
- * queues are relatively independent, will receive a range of packet sizes,
- * and can often be made to run out completely.  Those issues are important
- * when stress testing peripheral controller drivers.
+ * By default only one request is queued per endpoint; "qlen" keeps more
+ * of them queued so the peripheral controller never idles between
+ * requests.  Together with "buflen" this gives the throughput a function
+ * driver can expect for a given request size and queue depth, which is
+ * reported when the configuration is disabled.  The network link
+ * (g_ether) is still the best overall option for testing queueing logic,
+ * since its TX and RX queues are relatively independent, will receive a
+ * range of packet sizes, and can often be made to run out completely.
  *
  *
  * This is currently packaged as a configuration driver, which can't be
@@ -59,6 +63,11 @@ struct f_sourcesink {
 
 	struct usb_ep		*in_ep;
 	struct usb_ep		*out_ep;
+
+	/* throughput since the endpoints were enabled */
+	ktime_t			start;
+	u64			in_bytes;
+	u64			out_bytes;
 };
 
 static inline struct f_sourcesink *func_to_ss(struct usb_function *f)
@@ -70,6 +79,10 @@ static unsigned pattern;
 module_param(pattern, uint, 0);
 MODULE_PARM_DESC(pattern, "0 = all zeroes, 1 = mod63 ");
 
+static unsigned qlen = 1;
+module_param(qlen, uint, 0);
+MODULE_PARM_DESC(qlen, "requests queued per endpoint");
+
 /*-------------------------------------------------------------------------*/
 
 static struct usb_interface_descriptor source_sink_intf = {
@@ -260,10 +273,13 @@ static void source_sink_complete(struct usb_ep *ep, struct usb_request *req)
 
 	case 0:				/* normal completion? */
 		if (ep == ss->out_ep) {
+			ss->out_bytes += req->actual;
 			check_read_data(ss, req);
 			memset(req->buf, 0x55, req->length);
-		} else
+		} else {
+			ss->in_bytes += req->actual;
 			reinit_write_data(ep, req);
+		}
 		break;
 
 	/* this endpoint is normally active while we're configured */
@@ -303,39 +319,57 @@ static int source_sink_start_ep(struct f_sourcesink *ss, bool is_in)
 {
 	struct usb_ep		*ep;
 	struct usb_request	*req;
-	int			status;
+	int			i, status = 0;
 
 	ep = is_in ? ss->in_ep : ss->out_ep;
-	req = alloc_ep_req(ep);
-	if (!req)
-		return -ENOMEM;
+	for (i = 0; i < max(qlen, 1U) && status == 0; i++) {
+		req = alloc_ep_req(ep);
+		if (!req)
+			return -ENOMEM;
 
-	req->complete = source_sink_complete;
-	if (is_in)
-		reinit_write_data(ep, req);
-	else
-		memset(req->buf, 0x55, req->length);
+		req->complete = source_sink_complete;
+		if (is_in)
+			reinit_write_data(ep, req);
+		else
+			memset(req->buf, 0x55, req->length);
 
-	status = usb_ep_queue(ep, req, GFP_ATOMIC);
-	if (status) {
-		struct usb_composite_dev	*cdev;
+		status = usb_ep_queue(ep, req, GFP_ATOMIC);
+		if (status) {
+			struct usb_composite_dev	*cdev;
 
-		cdev = ss->function.config->cdev;
-		ERROR(cdev, "start %s %s --> %d\n",
-				is_in ? "IN" : "OUT",
-				ep->name, status);
-		free_ep_req(ep, req);
+			cdev = ss->function.config->cdev;
+			ERROR(cdev, "start %s %s --> %d\n",
+					is_in ? "IN" : "OUT",
+					ep->name, status);
+			free_ep_req(ep, req);
+		}
 	}
 
 	return status;
 }
 
+static unsigned report_rate(u64 bytes, s64 usecs)
+{
+	if (usecs <= 0)
+		return 0;
+
+	/* KB/s */
+	return div64_u64(bytes * 1000000, usecs) >> 10;
+}
+
 static void disable_source_sink(struct f_sourcesink *ss)
 {
 	struct usb_composite_dev	*cdev;
+	s64				usecs;
 
 	cdev = ss->function.config->cdev;
 	disable_endpoints(cdev, ss->in_ep, ss->out_ep);
+
+	usecs = ktime_us_delta(ktime_get(), ss->start);
+	INFO(cdev, "%s: IN %llu bytes (%u KB/s), OUT %llu bytes (%u KB/s)\n",
+			ss->function.name,
+			ss->in_bytes, report_rate(ss->in_bytes, usecs),
+			ss->out_bytes, report_rate(ss->out_bytes, usecs));
 	VDBG(cdev, "%s disabled\n", ss->function.name);
 }
 
@@ -349,6 +383,10 @@ enable_source_sink(struct usb_composite_dev *cdev, struct f_sourcesink *ss)
 	src = ep_choose(cdev->gadget, &hs_source_desc, &fs_source_desc);
 	sink = ep_choose(cdev->gadget, &hs_sink_desc, &fs_sink_desc);
 
+	ss->start = ktime_get();
+	ss->in_bytes = 0;
+	ss->out_bytes = 0;
+
 	/* one endpoint writes (sources) zeroes IN (to the host) */
 	ep = ss->in_ep;
 	result = usb_ep_enable(ep, src);
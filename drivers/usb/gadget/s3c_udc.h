@@ -115,6 +115,18 @@ struct s3c_request {
 	unsigned char mapped;
 };
 
+/* bulk/interrupt endpoint transfer statistics, EP0 is not counted */
+struct s3c_udc_stats {
+	unsigned long irqs;		/* handler invocations */
+	unsigned long ep_irqs;		/* transfer done events */
+	unsigned long coalesced;	/* events picked up without a new irq */
+	unsigned long chained;		/* started before the previous completion */
+	unsigned long tx_reqs;
+	unsigned long rx_reqs;
+	u64 tx_bytes;
+	u64 rx_bytes;
+};
+
 struct s3c_udc {
 	struct usb_gadget gadget;
 	struct usb_gadget_driver *driver;
@@ -133,6 +145,8 @@ struct s3c_udc {
 	int udc_enabled;
 
 	struct wake_lock	udc_wake_lock;
+
+	struct s3c_udc_stats	stats;
 };
 
 extern struct s3c_udc *the_controller;
@@ -28,6 +28,7 @@
 #include <plat/regs-otg.h>
 #include <linux/i2c.h>
 #include <linux/regulator/consumer.h>
+#include <linux/math64.h>
 
 #include <mach/cpu-freq-v210.h>
 
@@ -271,6 +272,53 @@ static ssize_t registers_show(struct device *dev, struct device_attribute *attr,
 
 static DEVICE_ATTR(registers, S_IRUGO, registers_show, NULL);
 
+static ssize_t xfer_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct s3c_udc *s3cdev = the_controller;
+	struct s3c_udc_stats stats;
+	unsigned long flags;
+	u64 bytes;
+	char *p = buf;
+
+	if (!s3cdev)
+		return -ENODEV;
+
+	spin_lock_irqsave(&s3cdev->lock, flags);
+	stats = s3cdev->stats;
+	spin_unlock_irqrestore(&s3cdev->lock, flags);
+
+	bytes = stats.tx_bytes + stats.rx_bytes;
+
+	p += sprintf(p, "irqs: %lu\n", stats.irqs);
+	p += sprintf(p, "ep_irqs: %lu\n", stats.ep_irqs);
+	p += sprintf(p, "coalesced: %lu\n", stats.coalesced);
+	p += sprintf(p, "chained: %lu\n", stats.chained);
+	p += sprintf(p, "tx: %lu reqs, %llu bytes\n", stats.tx_reqs, stats.tx_bytes);
+	p += sprintf(p, "rx: %lu reqs, %llu bytes\n", stats.rx_reqs, stats.rx_bytes);
+	p += sprintf(p, "irqs_per_mb: %llu\n",
+		bytes ? div64_u64((u64)stats.irqs << 20, bytes) : 0);
+
+	return p-buf;
+}
+
+static ssize_t xfer_stats_store(struct device *dev, struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct s3c_udc *s3cdev = the_controller;
+	unsigned long flags;
+
+	if (!s3cdev)
+		return -ENODEV;
+
+	spin_lock_irqsave(&s3cdev->lock, flags);
+	memset(&s3cdev->stats, 0, sizeof(s3cdev->stats));
+	spin_unlock_irqrestore(&s3cdev->lock, flags);
+
+	return count;
+}
+
+static DEVICE_ATTR(xfer_stats, S_IRUGO | S_IWUSR, xfer_stats_show, xfer_stats_store);
+
 /*
  *	udc_disable - disable USB device controller
  */
@@ -1321,6 +1369,9 @@ static int s3c_udc_probe(struct platform_device *pdev)
 	if (device_create_file(&pdev->dev, &dev_attr_registers) < 0)
 		pr_err("Failed to create device file(%s)!\n", dev_attr_registers.attr.name);
 
+	if (device_create_file(&pdev->dev, &dev_attr_xfer_stats) < 0)
+		pr_err("Failed to create device file(%s)!\n", dev_attr_xfer_stats.attr.name);
+
 	wake_lock_init(&dev->udc_wake_lock, WAKE_LOCK_SUSPEND, "udc_otg");
 
 	return retval;
@@ -1341,6 +1392,7 @@ static int s3c_udc_remove(struct platform_device *pdev)
 	wake_lock_destroy(&dev->udc_wake_lock);
 	remove_proc_files();
 	device_remove_file(&pdev->dev, &dev_attr_registers);
+	device_remove_file(&pdev->dev, &dev_attr_xfer_stats);
 	usb_gadget_unregister_driver(dev->driver);
 
 	free_irq(IRQ_OTG, dev);
@@ -28,6 +28,9 @@
 
 #define	DMA_ADDR_INVALID	(~(dma_addr_t)0)
 
+/* endpoint interrupt passes per handler invocation */
+#define EP_INTR_PASS_MAX	4
+
 static u8 clear_feature_num;
 static int clear_feature_flag;
 static int set_conf_done;
@@ -240,9 +243,26 @@ static void complete_rx(struct s3c_udc *dev, u8 ep_num)
 			s3c_udc_ep0_zlp();
 
 		} else {
+			struct s3c_request *next = NULL;
+
+			/*
+			 * Start the next queued request before giving this
+			 * one back, so the endpoint does not idle while the
+			 * gadget driver runs its completion.
+			 */
+			if (req->queue.next != &ep->queue) {
+				next = list_entry(req->queue.next, struct s3c_request, queue);
+				DEBUG_OUT_EP("%s: Next Rx request start...\n", __func__);
+				setdma_rx(ep, next);
+				dev->stats.chained++;
+			}
+
+			dev->stats.rx_reqs++;
+			dev->stats.rx_bytes += req->req.actual;
 			done(ep, req, 0);
 
-			if (!list_empty(&ep->queue)) {
+			/* the completion may have queued a new request */
+			if (!next && !list_empty(&ep->queue)) {
 				req = list_entry(ep->queue.next, struct s3c_request, queue);
 				DEBUG_OUT_EP("%s: Next Rx request start...\n", __func__);
 				setdma_rx(ep, req);
@@ -254,7 +274,7 @@ static void complete_rx(struct s3c_udc *dev, u8 ep_num)
 static void complete_tx(struct s3c_udc *dev, u8 ep_num)
 {
 	struct s3c_ep *ep = &dev->ep[ep_num];
-	struct s3c_request *req;
+	struct s3c_request *req, *next;
 	u32 ep_tsr = 0, xfer_size = 0, xfer_length, is_short = 0;
 	u32 last;
 
@@ -302,9 +322,21 @@ static void complete_tx(struct s3c_udc *dev, u8 ep_num)
 			write_fifo_ep0(ep,req);
 			return;
 		}
+		next = NULL;
+		if (ep_num > 0 && req->queue.next != &ep->queue) {
+			next = list_entry(req->queue.next, struct s3c_request, queue);
+			DEBUG_IN_EP("%s: Next Tx request start...\n", __func__);
+			setdma_tx(ep, next);
+			dev->stats.chained++;
+		}
+
+		if (ep_num > 0) {
+			dev->stats.tx_reqs++;
+			dev->stats.tx_bytes += req->req.actual;
+		}
 		done(ep, req, 0);
 
-		if (!list_empty(&ep->queue)) {
+		if (!next && !list_empty(&ep->queue)) {
 			req = list_entry(ep->queue.next, struct s3c_request, queue);
 			DEBUG_IN_EP("%s: Next Tx request start...\n", __func__);
 			setdma_tx(ep, req);
@@ -355,6 +387,8 @@ static void process_ep_in_intr(struct s3c_udc *dev)
 			writel(ep_intr_status, S3C_UDC_OTG_DIEPINT(ep_num));
 
 			if (ep_intr_status & TRANSFER_DONE) {
+				if (ep_num > 0)
+					dev->stats.ep_irqs++;
 				complete_tx(dev, ep_num);
 
 				if (ep_num == 0) {
@@ -417,8 +451,10 @@ static void process_ep_out_intr(struct s3c_udc *dev)
 				}
 
 			} else {
-				if (ep_intr_status & TRANSFER_DONE)
+				if (ep_intr_status & TRANSFER_DONE) {
+					dev->stats.ep_irqs++;
 					complete_rx(dev, ep_num);
+				}
 			}
 		}
 		ep_num++;
@@ -435,9 +471,12 @@ static irqreturn_t s3c_udc_irq(int irq, void *_dev)
 	u32 intr_status;
 	u32 usb_status, gintmsk;
 	unsigned long flags;
+	int pass;
 
 	spin_lock_irqsave(&dev->lock, flags);
 
+	dev->stats.irqs++;
+
 	intr_status = readl(S3C_UDC_OTG_GINTSTS);
 	gintmsk = readl(S3C_UDC_OTG_GINTMSK);
 
@@ -546,11 +585,23 @@ static irqreturn_t s3c_udc_irq(int irq, void *_dev)
 		}
 	}
 
-	if (intr_status & INT_IN_EP)
-		process_ep_in_intr(dev);
+	/*
+	 * With requests chained, the next transfer often finishes while
+	 * the completions of the previous one run. Pick those up here
+	 * instead of taking another interrupt for each of them.
+	 */
+	for (pass = 0; pass < EP_INTR_PASS_MAX; pass++) {
+		if (intr_status & INT_IN_EP)
+			process_ep_in_intr(dev);
+
+		if (intr_status & INT_OUT_EP)
+			process_ep_out_intr(dev);
 
-	if (intr_status & INT_OUT_EP)
-		process_ep_out_intr(dev);
+		intr_status = readl(S3C_UDC_OTG_GINTSTS) & (INT_IN_EP|INT_OUT_EP);
+		if (!intr_status)
+			break;
+		dev->stats.coalesced++;
+	}
 
 	spin_unlock_irqrestore(&dev->lock, flags);
 
@@ -239,14 +239,47 @@ static int s3cfb_draw_logo(struct fb_info *fb)
 #endif //defined(CONFIG_FB_S3C_LVDS) 
 
 #endif
+static void s3cfb_vsync_work(struct work_struct *work)
+{
+	struct s3cfb_global *fbdev =
+		container_of(work, struct s3cfb_global, vsync_work);
+
+	sysfs_notify(&fbdev->dev->kobj, NULL, "vsync_event");
+}
+
 static irqreturn_t s3cfb_irq_frame(int irq, void *data)
 {
 	struct s3cfb_global *fbdev = (struct s3cfb_global *)data;
+	struct s3c_platform_fb *pdata = to_fb_plat(fbdev->dev);
+	struct s3cfb_window *win;
+	int i, notify;
 
 	s3cfb_clear_interrupt(fbdev);
 
+	spin_lock(&fbdev->vsync_lock);
+
+	fbdev->vsync_time = ktime_get();
+	fbdev->vsync_count++;
+	notify = fbdev->vsync_notify;
+
+	/* the new addresses are latched at the start of the next frame */
+	for (i = 0; i < pdata->nr_wins; i++) {
+		win = fbdev->fb[i]->par;
+		if (win->flip_pending) {
+			fbdev->fb[i]->var.yoffset = win->flip_yoffset;
+			s3cfb_set_buffer_address(fbdev, i);
+			win->flip_pending = 0;
+			notify = 1;
+		}
+	}
+
+	spin_unlock(&fbdev->vsync_lock);
+
 	complete_all(&fbdev->fb_complete);
 
+	if (notify)
+		schedule_work(&fbdev->vsync_work);
+
 	return IRQ_HANDLED;
 }
 static void s3cfb_set_window(struct s3cfb_global *ctrl, int id, int enable)
@@ -607,6 +640,7 @@ static int s3cfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *fb)
 	struct s3cfb_window *win = fb->par;
 	struct s3cfb_global *fbdev =
 		platform_get_drvdata(to_platform_device(fb->device));
+	unsigned long flags;
 
 	if (var->yoffset + var->yres > var->yres_virtual) {
 		dev_err(fbdev->dev, "invalid yoffset value\n");
@@ -616,7 +650,11 @@ static int s3cfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *fb)
 	if (win->owner == DMA_MEM_OTHER)
 		fix->smem_start = win->other_mem_addr;
 
+	/* the frame interrupt also pans, for flips at vsync */
+	spin_lock_irqsave(&fbdev->vsync_lock, flags);
+
 	fb->var.yoffset = var->yoffset;
+	win->flip_pending = 0;
 
 	dev_dbg(fbdev->dev,
 		"[fb%d] yoffset for pan display: %d\n",
@@ -624,6 +662,8 @@ static int s3cfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *fb)
 
 	s3cfb_set_buffer_address(fbdev, win->id);
 
+	spin_unlock_irqrestore(&fbdev->vsync_lock, flags);
+
 	return 0;
 }
 
@@ -718,6 +758,7 @@ static int s3cfb_wait_for_vsync(struct s3cfb_global *ctrl)
 
 	dev_dbg(ctrl->dev, "waiting for VSYNC interrupt\n");
 
+	INIT_COMPLETION(ctrl->fb_complete);
 	ret = wait_for_completion_interruptible_timeout(
 		&ctrl->fb_complete, msecs_to_jiffies(100));
 	if (ret == 0)
@@ -729,6 +770,38 @@ static int s3cfb_wait_for_vsync(struct s3cfb_global *ctrl)
 
 	return ret;
 }
+
+static int s3cfb_flip_at_vsync(struct fb_info *fb, unsigned int yoffset)
+{
+	struct fb_fix_screeninfo *fix = &fb->fix;
+	struct s3cfb_window *win = fb->par;
+	struct s3cfb_global *fbdev =
+		platform_get_drvdata(to_platform_device(fb->device));
+	unsigned long flags;
+
+	if (yoffset + fb->var.yres > fb->var.yres_virtual) {
+		dev_err(fbdev->dev, "invalid yoffset value\n");
+		return -EINVAL;
+	}
+
+	if (win->owner == DMA_MEM_OTHER)
+		fix->smem_start = win->other_mem_addr;
+
+	spin_lock_irqsave(&fbdev->vsync_lock, flags);
+	win->flip_yoffset = yoffset;
+	win->flip_pending = 1;
+
+	/* the flip is applied by the frame interrupt, raise it at vsync */
+	s3cfb_set_vsync_interrupt(fbdev, 1);
+	s3cfb_set_global_interrupt(fbdev, 1);
+	spin_unlock_irqrestore(&fbdev->vsync_lock, flags);
+
+	dev_dbg(fbdev->dev,
+		"[fb%d] yoffset for flip at vsync: %d\n", win->id, yoffset);
+
+	return 0;
+}
+
 static int s3cfb_ioctl(struct fb_info *fb, unsigned int cmd, unsigned long arg)
 {
 	struct s3cfb_global *fbdev =
@@ -738,6 +811,7 @@ static int s3cfb_ioctl(struct fb_info *fb, unsigned int cmd, unsigned long arg)
 	struct s3cfb_lcd *lcd = fbdev->lcd;
 	struct fb_fix_screeninfo *fix = &fb->fix;
 	struct s3cfb_next_info next_fb_info;
+	unsigned long flags;
 
 	int ret = 0;
 
@@ -746,6 +820,7 @@ static int s3cfb_ioctl(struct fb_info *fb, unsigned int cmd, unsigned long arg)
 		struct s3cfb_user_plane_alpha user_alpha;
 		struct s3cfb_user_chroma user_chroma;
 		int vsync;
+		u32 yoffset;
 	} p;
 
 	switch (cmd) {
@@ -814,13 +889,22 @@ static int s3cfb_ioctl(struct fb_info *fb, unsigned int cmd, unsigned long arg)
 		if (get_user(p.vsync, (int __user *)arg))
 			ret = -EFAULT;
 		else {
+			spin_lock_irqsave(&fbdev->vsync_lock, flags);
 			if (p.vsync)
 				s3cfb_set_global_interrupt(fbdev, 1);
 
 			s3cfb_set_vsync_interrupt(fbdev, p.vsync);
+			spin_unlock_irqrestore(&fbdev->vsync_lock, flags);
 		}
 		break;
 
+	case S3CFB_FLIP_AT_VSYNC:
+		if (get_user(p.yoffset, (u32 __user *)arg))
+			ret = -EFAULT;
+		else
+			ret = s3cfb_flip_at_vsync(fb, p.yoffset);
+		break;
+
 	case S3CFB_GET_CURR_FB_INFO:
 		next_fb_info.phy_start_addr = fix->smem_start;
 		next_fb_info.xres = var->xres;
@@ -1062,6 +1146,51 @@ static int s3cfb_sysfs_store_win_power(struct device *dev,
 static DEVICE_ATTR(win_power, S_IRUGO | S_IWUSR,
 		   s3cfb_sysfs_show_win_power, s3cfb_sysfs_store_win_power);
 
+/*
+ * "<count> <time in ns>" of the last vsync. Pollable, it is notified on
+ * every vsync interrupt while writing 1 has enabled that, and on every
+ * flip at vsync. Writing 0 stops the per vsync notification.
+ */
+static int s3cfb_sysfs_show_vsync_event(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct s3cfb_global *fbdev = platform_get_drvdata(pdev);
+	unsigned int count;
+	ktime_t time;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fbdev->vsync_lock, flags);
+	count = fbdev->vsync_count;
+	time = fbdev->vsync_time;
+	spin_unlock_irqrestore(&fbdev->vsync_lock, flags);
+
+	return sprintf(buf, "%u %llu\n", count,
+			(unsigned long long)ktime_to_ns(time));
+}
+
+static int s3cfb_sysfs_store_vsync_event(struct device *dev,
+					 struct device_attribute *attr,
+					 const char *buf, size_t len)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct s3cfb_global *fbdev = platform_get_drvdata(pdev);
+	unsigned long flags, enable;
+
+	if (strict_strtoul(buf, 10, &enable) < 0)
+		return -EINVAL;
+
+	spin_lock_irqsave(&fbdev->vsync_lock, flags);
+	fbdev->vsync_notify = !!enable;
+	spin_unlock_irqrestore(&fbdev->vsync_lock, flags);
+
+	return len;
+}
+
+static DEVICE_ATTR(vsync_event, S_IRUGO | S_IWUSR,
+		   s3cfb_sysfs_show_vsync_event, s3cfb_sysfs_store_vsync_event);
+
 
 static void s3cfb_update_framebuffer(struct fb_info *fb,
 									int x, int y, void *buffer, 
@@ -1298,6 +1427,10 @@ static int __devinit s3cfb_probe(struct platform_device *pdev)
 		goto err_mem;
 	}
 
+	/* not in s3cfb_init_global(), which runs again on every resume */
+	spin_lock_init(&fbdev->vsync_lock);
+	INIT_WORK(&fbdev->vsync_work, s3cfb_vsync_work);
+
 	s3cfb_set_vsync_interrupt(fbdev, 1);
 	s3cfb_set_global_interrupt(fbdev, 1);
 	s3cfb_init_global(fbdev);  // Froyo  ġ ٸ 
@@ -1367,6 +1500,10 @@ static int __devinit s3cfb_probe(struct platform_device *pdev)
 	ret = device_create_file(&(pdev->dev), &dev_attr_win_power);
 	if (ret < 0)
 		dev_err(fbdev->dev, "failed to add sysfs entries\n");
+
+	ret = device_create_file(&(pdev->dev), &dev_attr_vsync_event);
+	if (ret < 0)
+		dev_err(fbdev->dev, "failed to add sysfs entries\n");
 #if defined(CONFIG_TARGET_LOCALE_KOR)
     ret = device_create_file(&(pdev->dev), &dev_attr_pclk_mode);
     if (ret < 0)    {
@@ -1431,12 +1568,14 @@ static int __devexit s3cfb_remove(struct platform_device *pdev)
 	int i;
 
 	device_remove_file(&(pdev->dev), &dev_attr_win_power);
+	device_remove_file(&(pdev->dev), &dev_attr_vsync_event);
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	unregister_early_suspend(&fbdev->early_suspend);
 #endif
 
 	free_irq(fbdev->irq, fbdev);
+	cancel_work_sync(&fbdev->vsync_work);
 	iounmap(fbdev->regs);
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -1473,6 +1612,10 @@ void s3cfb_early_suspend(struct early_suspend *h)
 {
 	struct s3cfb_global *fbdev =
 		container_of(h, struct s3cfb_global, early_suspend);
+	struct s3c_platform_fb *pdata = to_fb_plat(fbdev->dev);
+	struct s3cfb_window *win;
+	unsigned long flags;
+	int i;
 
 	pr_debug("[LCD] s3cfb_early_suspend is called\n");
 
@@ -1492,6 +1635,16 @@ void s3cfb_early_suspend(struct early_suspend *h)
 	#endif
 
 	s3cfb_display_off(fbdev);
+
+	/* a flip still pending refers to the state before suspend */
+	spin_lock_irqsave(&fbdev->vsync_lock, flags);
+	for (i = 0; i < pdata->nr_wins; i++) {
+		win = fbdev->fb[i]->par;
+		win->flip_pending = 0;
+	}
+	spin_unlock_irqrestore(&fbdev->vsync_lock, flags);
+	cancel_work_sync(&fbdev->vsync_work);
+
 	#ifdef CONFIG_FB_S3C_MDNIE
 	s3c_mdnie_off();
 	#endif 
@@ -16,6 +16,9 @@
 #ifdef __KERNEL__
 #include <linux/wait.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 #include <linux/fb.h>
 #ifdef CONFIG_HAS_WAKELOCK
 #include <linux/wakelock.h>
@@ -191,6 +194,8 @@ struct s3cfb_lcd {
  * @pseudo_pal:		pseudo palette for fb layer
  * @alpha:		alpha blending structure
  * @chroma:		chroma key structure
+ * @flip_pending:	if a flip waits for the next vsync
+ * @flip_yoffset:	yoffset to be set by the pending flip
 */
 struct s3cfb_window {
 	int			id;
@@ -207,6 +212,8 @@ struct s3cfb_window {
 	unsigned int		pseudo_pal[16];
 	struct			s3cfb_alpha alpha;
 	struct			s3cfb_chroma chroma;
+	int			flip_pending;
+	unsigned int		flip_yoffset;
 };
 
 /*
@@ -219,6 +226,11 @@ struct s3cfb_window {
  * @output:		output path (RGB/I80/Etc)
  * @rgb_mode:		RGB mode
  * @lcd:		pointer to lcd structure
+ * @vsync_lock:		protects the vsync state, pending flips and yoffsets
+ * @vsync_time:		time of the last vsync interrupt
+ * @vsync_count:	number of vsync interrupts
+ * @vsync_notify:	if vsync_event is notified on every vsync
+ * @vsync_work:		notifies vsync_event readers
 */
 struct s3cfb_global {
 	/* general */
@@ -239,6 +251,13 @@ struct s3cfb_global {
 	enum s3cfb_rgb_mode_t	rgb_mode;
 	struct s3cfb_lcd	*lcd;
 
+	/* vsync */
+	spinlock_t		vsync_lock;
+	ktime_t			vsync_time;
+	unsigned int		vsync_count;
+	int			vsync_notify;
+	struct work_struct	vsync_work;
+
 #ifdef CONFIG_HAS_WAKELOCK
 	struct early_suspend	early_suspend;
 	struct wake_lock	idle_lock;
@@ -310,6 +329,11 @@ struct s3cfb_next_info {
 #define S3CFB_SET_WIN_ADDR		_IOW('F', 309, unsigned long)
 #define S3CFB_SET_WIN_MEM		_IOW('F', 310, \
 						enum s3cfb_mem_owner_t)
+/*
+ * Pan to the given yoffset at the next vsync interrupt instead of right
+ * away. A later flip before that vsync replaces the pending one.
+ */
+#define S3CFB_FLIP_AT_VSYNC		_IOW('F', 311, u32)
 
 /*
  * E X T E R N S
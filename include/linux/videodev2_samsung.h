@@ -623,6 +623,62 @@ struct v4l2_recognition {
 #define VIDIOC_S_RECOGNITION	_IOWR('V', 85, struct v4l2_recognition)
 #define VIDIOC_G_RECOGNITION	_IOR('V', 86, struct v4l2_recognition)
 
+/* Atomic update of several TV out layers, latched at the same TV vsync */
+#define V4L2_TV_LAYERS_MAX		3
+#define V4L2_TV_LAYERS_STAMPS		8
+
+/* v4l2_tv_layer.layer */
+#define V4L2_TV_LAYER_GRP0		0
+#define V4L2_TV_LAYER_GRP1		1
+#define V4L2_TV_LAYER_VIDEO		2
+
+/* v4l2_tv_layer.flags, fields to change */
+#define V4L2_TV_LAYER_ADDR		0x0001	/* y_addr and c_addr */
+#define V4L2_TV_LAYER_SRC		0x0002	/* window in the buffer */
+#define V4L2_TV_LAYER_DST		0x0004	/* position (video: and size) */
+#define V4L2_TV_LAYER_ALPHA		0x0008
+
+struct v4l2_tv_layer {
+	__u32 layer;
+	__u32 flags;
+	__u32 y_addr;		/* graphic layers: base address */
+	__u32 c_addr;		/* video layer only */
+	struct v4l2_rect src;
+	struct v4l2_rect dst;	/* graphic layers: width/height unused */
+	__u32 alpha;
+	__u32 reserved[3];
+};
+
+/* v4l2_tv_layers.flags */
+#define V4L2_TV_LAYERS_WAIT		0x0001	/* return once latched */
+
+struct v4l2_tv_layers {
+	__u32 count;
+	__u32 flags;
+	__u32 sequence;		/* read only: id of this update */
+	__u32 reserved;
+	struct v4l2_tv_layer layer[V4L2_TV_LAYERS_MAX];
+};
+
+struct v4l2_tv_layers_stamp {
+	__u32 sequence;
+	struct timeval queued;
+	struct timeval applied;	/* vsync the update was latched at */
+};
+
+struct v4l2_tv_layers_status {
+	__u32 sequence;		/* last queued update */
+	__u32 applied;		/* last latched update */
+	__u32 vsyncs;		/* vsync interrupts handled */
+	__u32 merged;		/* updates replaced before they were latched */
+	__u32 count;		/* valid entries in stamp, newest first */
+	__u32 reserved[3];
+	struct v4l2_tv_layers_stamp stamp[V4L2_TV_LAYERS_STAMPS];
+};
+
+#define VIDIOC_S_TV_LAYERS	_IOWR('V', 106, struct v4l2_tv_layers)
+#define VIDIOC_G_TV_LAYERS_STATUS	_IOR('V', 107, struct v4l2_tv_layers_status)
+
 /* We use this struct as the v4l2_streamparm raw_data for
  * VIDIOC_G_PARM and VIDIOC_S_PARM
  */
@@ -0,0 +1,108 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpufreq_interactive
+
+#if !defined(_TRACE_CPUFREQ_INTERACTIVE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPUFREQ_INTERACTIVE_H
+
+#include <linux/tracepoint.h>
+
+/* one per sample, also when the target does not change */
+TRACE_EVENT(cpufreq_interactive_target,
+
+	TP_PROTO(u32 cpu_id, unsigned long load, unsigned long curfreq,
+		 unsigned long targfreq),
+
+	TP_ARGS(cpu_id, load, curfreq, targfreq),
+
+	TP_STRUCT__entry(
+		__field(	u32,		cpu_id		)
+		__field(	unsigned long,	load		)
+		__field(	unsigned long,	curfreq		)
+		__field(	unsigned long,	targfreq	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->load = load;
+		__entry->curfreq = curfreq;
+		__entry->targfreq = targfreq;
+	),
+
+	TP_printk("cpu=%u load=%lu cur=%lu targ=%lu", __entry->cpu_id,
+		  __entry->load, __entry->curfreq, __entry->targfreq)
+);
+
+/* time spent at a frequency, emitted when the cpu leaves it */
+TRACE_EVENT(cpufreq_interactive_time_in_state,
+
+	TP_PROTO(u32 cpu_id, unsigned long freq, u64 time_us),
+
+	TP_ARGS(cpu_id, freq, time_us),
+
+	TP_STRUCT__entry(
+		__field(	u32,		cpu_id		)
+		__field(	unsigned long,	freq		)
+		__field(	u64,		time_us		)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->freq = freq;
+		__entry->time_us = time_us;
+	),
+
+	TP_printk("cpu=%u freq=%lu time=%llu us", __entry->cpu_id,
+		  __entry->freq, (unsigned long long)__entry->time_us)
+);
+
+/* from the demand that caused a ramp up to the new frequency running */
+TRACE_EVENT(cpufreq_interactive_ramp,
+
+	TP_PROTO(u32 cpu_id, unsigned long from, unsigned long to,
+		 u64 latency_us, int boost),
+
+	TP_ARGS(cpu_id, from, to, latency_us, boost),
+
+	TP_STRUCT__entry(
+		__field(	u32,		cpu_id		)
+		__field(	unsigned long,	from		)
+		__field(	unsigned long,	to		)
+		__field(	u64,		latency_us	)
+		__field(	int,		boost		)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->from = from;
+		__entry->to = to;
+		__entry->latency_us = latency_us;
+		__entry->boost = boost;
+	),
+
+	TP_printk("cpu=%u from=%lu to=%lu latency=%llu us%s", __entry->cpu_id,
+		  __entry->from, __entry->to,
+		  (unsigned long long)__entry->latency_us,
+		  __entry->boost ? " boost" : "")
+);
+
+TRACE_EVENT(cpufreq_interactive_boost,
+
+	TP_PROTO(const char *source),
+
+	TP_ARGS(source),
+
+	TP_STRUCT__entry(
+		__string(	source,		source		)
+	),
+
+	TP_fast_assign(
+		__assign_str(source, source);
+	),
+
+	TP_printk("%s", __get_str(source))
+);
+
+#endif /* _TRACE_CPUFREQ_INTERACTIVE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
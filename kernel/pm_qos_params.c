@@ -40,6 +40,10 @@
 #include <linux/string.h>
 #include <linux/platform_device.h>
 #include <linux/init.h>
+#include <linux/plist.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/uaccess.h>
 
@@ -48,59 +52,96 @@
  * or pm_qos_object list and pm_qos_objects need to happen with pm_qos_lock
  * held, taken with _irqsave.  One lock to rule them all
  */
+static DEFINE_SPINLOCK(pm_qos_lock);
+
+/*
+ * Requests are kept sorted by value in a plist, so the target is read off
+ * one end of the list instead of rescanning every request. A request is
+ * active while its value differs from the class default, and pins the
+ * target while it is the one defining it. Both are accounted per request
+ * for the debugfs pm_qos/ files.
+ */
 struct pm_qos_request_list {
-	struct list_head list;
-	union {
-		s32 value;
-		s32 usec;
-		s32 kbps;
-	};
+	struct plist_node list;
 	int pm_qos_class;
+	char name[PM_QOS_NAME_LEN];
+	void *caller;
+
+	ktime_t active_since;
+	ktime_t active_time;
+	unsigned int active_count;
+	ktime_t pinning_since;
+	ktime_t pinning_time;
 };
 
-static s32 max_compare(s32 v1, s32 v2);
-static s32 min_compare(s32 v1, s32 v2);
+enum pm_qos_type {
+	PM_QOS_MAX,		/* return the largest value */
+	PM_QOS_MIN,		/* return the smallest value */
+};
 
 struct pm_qos_object {
-	struct pm_qos_request_list requests;
+	struct plist_head requests;
 	struct blocking_notifier_head *notifiers;
 	struct miscdevice pm_qos_power_miscdev;
 	char *name;
 	s32 default_value;
 	atomic_t target_value;
-	s32 (*comparitor)(s32, s32);
+	enum pm_qos_type type;
+	struct pm_qos_request_list *pinning;
 };
 
 static struct pm_qos_object null_pm_qos;
 static BLOCKING_NOTIFIER_HEAD(cpu_dma_lat_notifier);
 static struct pm_qos_object cpu_dma_pm_qos = {
-	.requests = {LIST_HEAD_INIT(cpu_dma_pm_qos.requests.list)},
+	.requests = PLIST_HEAD_INIT(cpu_dma_pm_qos.requests, pm_qos_lock),
 	.notifiers = &cpu_dma_lat_notifier,
 	.name = "cpu_dma_latency",
 	.default_value = 2000 * USEC_PER_SEC,
 	.target_value = ATOMIC_INIT(2000 * USEC_PER_SEC),
-	.comparitor = min_compare
+	.type = PM_QOS_MIN,
 };
 
 static BLOCKING_NOTIFIER_HEAD(network_lat_notifier);
 static struct pm_qos_object network_lat_pm_qos = {
-	.requests = {LIST_HEAD_INIT(network_lat_pm_qos.requests.list)},
+	.requests = PLIST_HEAD_INIT(network_lat_pm_qos.requests, pm_qos_lock),
 	.notifiers = &network_lat_notifier,
 	.name = "network_latency",
 	.default_value = 2000 * USEC_PER_SEC,
 	.target_value = ATOMIC_INIT(2000 * USEC_PER_SEC),
-	.comparitor = min_compare
+	.type = PM_QOS_MIN,
 };
 
 
 static BLOCKING_NOTIFIER_HEAD(network_throughput_notifier);
 static struct pm_qos_object network_throughput_pm_qos = {
-	.requests = {LIST_HEAD_INIT(network_throughput_pm_qos.requests.list)},
+	.requests = PLIST_HEAD_INIT(network_throughput_pm_qos.requests,
+				    pm_qos_lock),
 	.notifiers = &network_throughput_notifier,
 	.name = "network_throughput",
 	.default_value = 0,
 	.target_value = ATOMIC_INIT(0),
-	.comparitor = max_compare
+	.type = PM_QOS_MAX,
+};
+
+/* cpu frequency floor and ceiling in kHz, applied to all cpufreq policies */
+static BLOCKING_NOTIFIER_HEAD(cpu_freq_min_notifier);
+static struct pm_qos_object cpu_freq_min_pm_qos = {
+	.requests = PLIST_HEAD_INIT(cpu_freq_min_pm_qos.requests, pm_qos_lock),
+	.notifiers = &cpu_freq_min_notifier,
+	.name = "cpu_freq_min",
+	.default_value = 0,
+	.target_value = ATOMIC_INIT(0),
+	.type = PM_QOS_MAX,
+};
+
+static BLOCKING_NOTIFIER_HEAD(cpu_freq_max_notifier);
+static struct pm_qos_object cpu_freq_max_pm_qos = {
+	.requests = PLIST_HEAD_INIT(cpu_freq_max_pm_qos.requests, pm_qos_lock),
+	.notifiers = &cpu_freq_max_notifier,
+	.name = "cpu_freq_max",
+	.default_value = INT_MAX,
+	.target_value = ATOMIC_INIT(INT_MAX),
+	.type = PM_QOS_MIN,
 };
 
 
@@ -108,11 +149,11 @@ static struct pm_qos_object *pm_qos_array[] = {
 	&null_pm_qos,
 	&cpu_dma_pm_qos,
 	&network_lat_pm_qos,
-	&network_throughput_pm_qos
+	&network_throughput_pm_qos,
+	&cpu_freq_min_pm_qos,
+	&cpu_freq_max_pm_qos,
 };
 
-static DEFINE_SPINLOCK(pm_qos_lock);
-
 static ssize_t pm_qos_power_write(struct file *filp, const char __user *buf,
 		size_t count, loff_t *f_pos);
 static int pm_qos_power_open(struct inode *inode, struct file *filp);
@@ -125,44 +166,87 @@ static const struct file_operations pm_qos_power_fops = {
 };
 
 /* static helper functions */
-static s32 max_compare(s32 v1, s32 v2)
+
+/* the request defining the target, NULL if the default does */
+static struct pm_qos_request_list *pm_qos_extreme(struct pm_qos_object *o)
 {
-	return max(v1, v2);
+	struct pm_qos_request_list *req;
+
+	if (plist_head_empty(&o->requests))
+		return NULL;
+
+	switch (o->type) {
+	case PM_QOS_MIN:
+		req = plist_first_entry(&o->requests,
+				struct pm_qos_request_list, list);
+		return req->list.prio < o->default_value ? req : NULL;
+	case PM_QOS_MAX:
+		req = plist_last_entry(&o->requests,
+				struct pm_qos_request_list, list);
+		return req->list.prio > o->default_value ? req : NULL;
+	}
+
+	return NULL;
 }
 
-static s32 min_compare(s32 v1, s32 v2)
+/* must be called with pm_qos_lock held */
+static void pm_qos_set_value(struct pm_qos_object *o,
+		struct pm_qos_request_list *req, s32 value, ktime_t now)
 {
-	return min(v1, v2);
+	int was_active = req->list.prio != o->default_value;
+	int active = value != o->default_value;
+
+	if (active && !was_active) {
+		req->active_since = now;
+		req->active_count++;
+	} else if (!active && was_active) {
+		req->active_time = ktime_add(req->active_time,
+				ktime_sub(now, req->active_since));
+	}
+
+	plist_del(&req->list, &o->requests);
+	plist_node_init(&req->list, value);
+	plist_add(&req->list, &o->requests);
 }
 
+/* must be called with pm_qos_lock held */
+static void pm_qos_set_pinning(struct pm_qos_object *o,
+		struct pm_qos_request_list *req, ktime_t now)
+{
+	if (o->pinning == req)
+		return;
+
+	if (o->pinning)
+		o->pinning->pinning_time = ktime_add(o->pinning->pinning_time,
+				ktime_sub(now, o->pinning->pinning_since));
+	if (req)
+		req->pinning_since = now;
+	o->pinning = req;
+}
 
 static void update_target(int pm_qos_class)
 {
+	struct pm_qos_object *o = pm_qos_array[pm_qos_class];
+	struct pm_qos_request_list *pinning;
 	s32 extreme_value;
-	struct pm_qos_request_list *node;
 	unsigned long flags;
 	int call_notifier = 0;
 
 	spin_lock_irqsave(&pm_qos_lock, flags);
-	extreme_value = pm_qos_array[pm_qos_class]->default_value;
-	list_for_each_entry(node,
-			&pm_qos_array[pm_qos_class]->requests.list, list) {
-		extreme_value = pm_qos_array[pm_qos_class]->comparitor(
-				extreme_value, node->value);
-	}
-	if (atomic_read(&pm_qos_array[pm_qos_class]->target_value) !=
-			extreme_value) {
+	pinning = pm_qos_extreme(o);
+	extreme_value = pinning ? pinning->list.prio : o->default_value;
+	pm_qos_set_pinning(o, pinning, ktime_get());
+
+	if (atomic_read(&o->target_value) != extreme_value) {
 		call_notifier = 1;
-		atomic_set(&pm_qos_array[pm_qos_class]->target_value,
-				extreme_value);
+		atomic_set(&o->target_value, extreme_value);
 		pr_debug(KERN_ERR "new target for qos %d is %d\n", pm_qos_class,
-			atomic_read(&pm_qos_array[pm_qos_class]->target_value));
+			atomic_read(&o->target_value));
 	}
 	spin_unlock_irqrestore(&pm_qos_lock, flags);
 
 	if (call_notifier)
-		blocking_notifier_call_chain(
-				pm_qos_array[pm_qos_class]->notifiers,
+		blocking_notifier_call_chain(o->notifiers,
 					(unsigned long) extreme_value, NULL);
 }
 
@@ -200,41 +284,68 @@ int pm_qos_request(int pm_qos_class)
 }
 EXPORT_SYMBOL_GPL(pm_qos_request);
 
-/**
- * pm_qos_add_request - inserts new qos request into the list
- * @pm_qos_class: identifies which list of qos request to us
- * @value: defines the qos request
- *
- * This function inserts a new entry in the pm_qos_class list of requested qos
- * performance characteristics.  It recomputes the aggregate QoS expectations
- * for the pm_qos_class of parameters, and returns the pm_qos_request list
- * element as a handle for use in updating and removal.  Call needs to save
- * this handle for later use.
- */
-struct pm_qos_request_list *pm_qos_add_request(int pm_qos_class, s32 value)
+static struct pm_qos_request_list *__pm_qos_add_request(int pm_qos_class,
+		s32 value, const char *name, void *caller)
 {
+	struct pm_qos_object *o = pm_qos_array[pm_qos_class];
 	struct pm_qos_request_list *dep;
 	unsigned long flags;
 
 	dep = kzalloc(sizeof(struct pm_qos_request_list), GFP_KERNEL);
 	if (dep) {
 		if (value == PM_QOS_DEFAULT_VALUE)
-			dep->value = pm_qos_array[pm_qos_class]->default_value;
-		else
-			dep->value = value;
+			value = o->default_value;
 		dep->pm_qos_class = pm_qos_class;
+		if (name)
+			strlcpy(dep->name, name, sizeof(dep->name));
+		dep->caller = caller;
+		plist_node_init(&dep->list, o->default_value);
 
 		spin_lock_irqsave(&pm_qos_lock, flags);
-		list_add(&dep->list,
-			&pm_qos_array[pm_qos_class]->requests.list);
+		plist_add(&dep->list, &o->requests);
+		pm_qos_set_value(o, dep, value, ktime_get());
 		spin_unlock_irqrestore(&pm_qos_lock, flags);
 		update_target(pm_qos_class);
 	}
 
 	return dep;
 }
+
+/**
+ * pm_qos_add_request - inserts new qos request into the list
+ * @pm_qos_class: identifies which list of qos request to us
+ * @value: defines the qos request
+ *
+ * This function inserts a new entry in the pm_qos_class list of requested qos
+ * performance characteristics.  It recomputes the aggregate QoS expectations
+ * for the pm_qos_class of parameters, and returns the pm_qos_request list
+ * element as a handle for use in updating and removal.  Call needs to save
+ * this handle for later use.
+ */
+struct pm_qos_request_list *pm_qos_add_request(int pm_qos_class, s32 value)
+{
+	return __pm_qos_add_request(pm_qos_class, value, NULL,
+			__builtin_return_address(0));
+}
 EXPORT_SYMBOL_GPL(pm_qos_add_request);
 
+/**
+ * pm_qos_add_request_named - inserts new qos request into the list
+ * @pm_qos_class: identifies which list of qos request to us
+ * @value: defines the qos request
+ * @name: requester shown in debugfs, the caller is shown if NULL
+ *
+ * Same as pm_qos_add_request(), for requesters which are not told apart
+ * by their caller, e.g. one request per client of a shared helper.
+ */
+struct pm_qos_request_list *pm_qos_add_request_named(int pm_qos_class,
+		s32 value, const char *name)
+{
+	return __pm_qos_add_request(pm_qos_class, value, name,
+			__builtin_return_address(0));
+}
+EXPORT_SYMBOL_GPL(pm_qos_add_request_named);
+
 /**
  * pm_qos_update_request - modifies an existing qos request
  * @pm_qos_req : handle to list element holding a pm_qos request to use
@@ -248,20 +359,23 @@ EXPORT_SYMBOL_GPL(pm_qos_add_request);
 void pm_qos_update_request(struct pm_qos_request_list *pm_qos_req,
 		s32 new_value)
 {
+	struct pm_qos_object *o;
 	unsigned long flags;
 	int pending_update = 0;
 	s32 temp;
 
 	if (pm_qos_req) { /*guard against callers passing in null */
+		o = pm_qos_array[pm_qos_req->pm_qos_class];
+
 		spin_lock_irqsave(&pm_qos_lock, flags);
 		if (new_value == PM_QOS_DEFAULT_VALUE)
-			temp = pm_qos_array[pm_qos_req->pm_qos_class]->default_value;
+			temp = o->default_value;
 		else
 			temp = new_value;
 
-		if (temp != pm_qos_req->value) {
+		if (temp != pm_qos_req->list.prio) {
 			pending_update = 1;
-			pm_qos_req->value = temp;
+			pm_qos_set_value(o, pm_qos_req, temp, ktime_get());
 		}
 		spin_unlock_irqrestore(&pm_qos_lock, flags);
 		if (pending_update)
@@ -280,6 +394,7 @@ EXPORT_SYMBOL_GPL(pm_qos_update_request);
  */
 void pm_qos_remove_request(struct pm_qos_request_list *pm_qos_req)
 {
+	struct pm_qos_object *o;
 	unsigned long flags;
 	int qos_class;
 
@@ -288,8 +403,12 @@ void pm_qos_remove_request(struct pm_qos_request_list *pm_qos_req)
 		/* silent return to keep pcm code cleaner */
 
 	qos_class = pm_qos_req->pm_qos_class;
+	o = pm_qos_array[qos_class];
+
 	spin_lock_irqsave(&pm_qos_lock, flags);
-	list_del(&pm_qos_req->list);
+	if (o->pinning == pm_qos_req)
+		o->pinning = NULL;
+	plist_del(&pm_qos_req->list, &o->requests);
 	kfree(pm_qos_req);
 	spin_unlock_irqrestore(&pm_qos_lock, flags);
 	update_target(qos_class);
@@ -340,8 +459,9 @@ static int pm_qos_power_open(struct inode *inode, struct file *filp)
 
 	pm_qos_class = find_pm_qos_object_by_minor(iminor(inode));
 	if (pm_qos_class >= 0) {
-		filp->private_data = (void *) pm_qos_add_request(pm_qos_class,
-				PM_QOS_DEFAULT_VALUE);
+		filp->private_data = (void *) __pm_qos_add_request(
+				pm_qos_class, PM_QOS_DEFAULT_VALUE,
+				current->comm, NULL);
 
 		if (filp->private_data)
 			return 0;
@@ -388,10 +508,81 @@ static ssize_t pm_qos_power_write(struct file *filp, const char __user *buf,
 }
 
 
+#ifdef CONFIG_DEBUG_FS
+static int pm_qos_debug_show(struct seq_file *s, void *unused)
+{
+	struct pm_qos_object *o = s->private;
+	struct pm_qos_request_list *req;
+	unsigned long flags;
+	ktime_t now, active, pinning;
+
+	seq_printf(s, "target: %d\n", atomic_read(&o->target_value));
+	seq_printf(s, "%-16s %11s %3s %8s %10s %10s\n", "requester", "value",
+			"pin", "count", "active_ms", "pinning_ms");
+
+	spin_lock_irqsave(&pm_qos_lock, flags);
+	now = ktime_get();
+	plist_for_each_entry(req, &o->requests, list) {
+		active = req->active_time;
+		if (req->list.prio != o->default_value)
+			active = ktime_add(active,
+					ktime_sub(now, req->active_since));
+		pinning = req->pinning_time;
+		if (o->pinning == req)
+			pinning = ktime_add(pinning,
+					ktime_sub(now, req->pinning_since));
+
+		if (req->name[0])
+			seq_printf(s, "%-16s", req->name);
+		else
+			seq_printf(s, "%-16pf", req->caller);
+		seq_printf(s, " %11d %3s %8u %10lld %10lld\n", req->list.prio,
+				o->pinning == req ? "*" : "",
+				req->active_count, ktime_to_ms(active),
+				ktime_to_ms(pinning));
+	}
+	spin_unlock_irqrestore(&pm_qos_lock, flags);
+
+	return 0;
+}
+
+static int pm_qos_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pm_qos_debug_show, inode->i_private);
+}
+
+static const struct file_operations pm_qos_debug_fops = {
+	.open		= pm_qos_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init pm_qos_debug_init(void)
+{
+	struct dentry *dir;
+	int pm_qos_class;
+
+	dir = debugfs_create_dir("pm_qos", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	for (pm_qos_class = 1; pm_qos_class < PM_QOS_NUM_CLASSES;
+			pm_qos_class++)
+		debugfs_create_file(pm_qos_array[pm_qos_class]->name, S_IRUGO,
+				dir, pm_qos_array[pm_qos_class],
+				&pm_qos_debug_fops);
+}
+#else
+static inline void pm_qos_debug_init(void) { }
+#endif
+
 static int __init pm_qos_power_init(void)
 {
 	int ret = 0;
 
+	pm_qos_debug_init();
+
 	ret = register_pm_qos_misc(&cpu_dma_pm_qos);
 	if (ret < 0) {
 		printk(KERN_ERR "pm_qos_param: cpu_dma_latency setup failed\n");
@@ -403,9 +594,19 @@ static int __init pm_qos_power_init(void)
 		return ret;
 	}
 	ret = register_pm_qos_misc(&network_throughput_pm_qos);
-	if (ret < 0)
+	if (ret < 0) {
 		printk(KERN_ERR
 			"pm_qos_param: network_throughput setup failed\n");
+		return ret;
+	}
+	ret = register_pm_qos_misc(&cpu_freq_min_pm_qos);
+	if (ret < 0) {
+		printk(KERN_ERR "pm_qos_param: cpu_freq_min setup failed\n");
+		return ret;
+	}
+	ret = register_pm_qos_misc(&cpu_freq_max_pm_qos);
+	if (ret < 0)
+		printk(KERN_ERR "pm_qos_param: cpu_freq_max setup failed\n");
 
 	return ret;
 }
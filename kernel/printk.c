@@ -335,6 +335,39 @@ int log_buf_copy(char *dest, int idx, int len)
 	return ret;
 }
 
+/*
+ * Copy characters from the log buffer starting at the absolute position
+ * *pos, as counted by log_end. Characters which were overwritten since are
+ * skipped. *pos is advanced past the copied characters.
+ */
+int log_buf_copy_from(char *dest, unsigned int *pos, int len)
+{
+	unsigned int start;
+	bool took_lock = false;
+	int ret;
+
+	if (!oops_in_progress) {
+		spin_lock_irq(&logbuf_lock);
+		took_lock = true;
+	}
+
+	start = log_end - log_buf_get_len();
+	if ((int)(*pos - start) < 0)
+		*pos = start;
+
+	ret = min_t(int, len, log_end - *pos);
+	if (ret > 0) {
+		for (len = 0; len < ret; len++)
+			dest[len] = LOG_BUF(*pos + len);
+		*pos += ret;
+	}
+
+	if (took_lock)
+		spin_unlock_irq(&logbuf_lock);
+
+	return ret;
+}
+
 /*
  * Commands to do_syslog:
  *
@@ -96,6 +96,7 @@ struct lpam_i2s_pdata {
 	dma_addr_t	end;
 	dma_addr_t	period;
 	dma_addr_t	periodsz;
+	unsigned int	byte_rate;
 	void		*token;
 	void		(*cb)(void *dt, int bytes_xfer);
 };
@@ -106,6 +107,10 @@ struct lpam_i2s_pdata {
 static struct s3c_idma_info {
 	spinlock_t    lock;
 	void __iomem  *regs;
+
+	/* statistics, under lock */
+	struct s3c_idma_stats stats;
+	u64		latency_sum;
 } s3c_idma;
 
 static void s3c_idma_getpos(dma_addr_t *src)
@@ -199,9 +204,82 @@ static void s3c_idma_done(void *id, int bytes_xfer)
 
 	pr_debug("%s:%d\n", __func__, __LINE__);
 
-	if (prtd && (prtd->state & ST_RUNNING))
+	if (prtd && (prtd->state & ST_RUNNING)) {
 		snd_pcm_period_elapsed(substream);
+
+		if (substream->runtime->status->state == SNDRV_PCM_STATE_XRUN) {
+			spin_lock(&s3c_idma.lock);
+			s3c_idma.stats.xruns++;
+			spin_unlock(&s3c_idma.lock);
+		}
+	}
+}
+
+/*
+ * Account how far the DMA had moved past the level interrupt address
+ * by the time the interrupt was serviced. Past a whole period the next
+ * level interrupt was due already, the interrupt is counted late.
+ */
+#define IDMA_TRAIL_BYTES	128
+
+static void s3c_idma_irq_stats(struct lpam_i2s_pdata *prtd, u32 irq_addr)
+{
+	struct snd_pcm_substream *substream = prtd->token;
+	unsigned long bytes;
+	dma_addr_t pos;
+	u64 us;
+
+	if (!substream || !prtd->byte_rate)
+		return;
+
+	bytes = substream->runtime->dma_bytes;
+	s3c_idma_getpos(&pos);
+	bytes = (pos + bytes - irq_addr) % bytes;
+
+	/* the counter may trail the level interrupt by a few words */
+	if (bytes > substream->runtime->dma_bytes - IDMA_TRAIL_BYTES)
+		bytes = 0;
+
+	us = (u64)bytes * 1000000;
+	do_div(us, prtd->byte_rate);
+
+	spin_lock(&s3c_idma.lock);
+	s3c_idma.stats.periods++;
+	if (bytes >= prtd->periodsz)
+		s3c_idma.stats.late++;
+	if (us > s3c_idma.stats.irq_latency_max)
+		s3c_idma.stats.irq_latency_max = us;
+	s3c_idma.latency_sum += us;
+	spin_unlock(&s3c_idma.lock);
+}
+
+void s3c_idma_get_stats(struct s3c_idma_stats *stats)
+{
+	unsigned long flags;
+	u64 avg;
+
+	spin_lock_irqsave(&s3c_idma.lock, flags);
+	*stats = s3c_idma.stats;
+	avg = s3c_idma.latency_sum;
+	spin_unlock_irqrestore(&s3c_idma.lock, flags);
+
+	if (stats->periods) {
+		do_div(avg, stats->periods);
+		stats->irq_latency_avg = avg;
+	}
+}
+EXPORT_SYMBOL_GPL(s3c_idma_get_stats);
+
+void s3c_idma_reset_stats(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&s3c_idma.lock, flags);
+	memset(&s3c_idma.stats, 0, sizeof(s3c_idma.stats));
+	s3c_idma.latency_sum = 0;
+	spin_unlock_irqrestore(&s3c_idma.lock, flags);
 }
+EXPORT_SYMBOL_GPL(s3c_idma_reset_stats);
 
 static int s3c_idma_hw_params(struct snd_pcm_substream *substream,
 				struct snd_pcm_hw_params *params)
@@ -219,6 +297,8 @@ static int s3c_idma_hw_params(struct snd_pcm_substream *substream,
 	prtd->period = params_periods(params);
 	prtd->periodsz = params_period_bytes(params);
 	prtd->end = LP_TXBUFF_ADDR + runtime->dma_bytes;
+	prtd->byte_rate = params_rate(params) * params_channels(params) *
+		snd_pcm_format_physical_width(params_format(params)) / 8;
 
 	s3c_idma_setcallbk(substream, s3c_idma_done);
 
@@ -243,7 +323,10 @@ static int s3c_idma_prepare(struct snd_pcm_substream *substream)
 
 	pr_debug("Entered %s\n", __func__);
 
+	/* read by the pointer callback while the clock is gated */
+	spin_lock_irq(&prtd->lock);
 	prtd->pos = prtd->start;
+	spin_unlock_irq(&prtd->lock);
 
 	/* flush the DMA channel */
 	s3c_idma_ctrl(LPAM_DMA_STOP);
@@ -295,17 +378,29 @@ static snd_pcm_uframes_t
 	dma_addr_t src;
 	unsigned long res;
 
+	/*
+	 * The transfer counter advances with every word the DMA fetches,
+	 * so the position is exact within a period. Apps may then use
+	 * large periods, i.e. few interrupts, and still keep only a small
+	 * part of the buffer filled.
+	 */
 	spin_lock(&prtd->lock);
 
-	s3c_idma_getpos(&src);
-	res = src - prtd->start;
+	if (audio_clk_stat) {
+		s3c_idma_getpos(&src);
+		prtd->pos = src;
+	} else {
+		/* registers are not readable with the clock gated */
+		src = prtd->pos;
+	}
 
 	spin_unlock(&prtd->lock);
 
-	if (res >= snd_pcm_lib_buffer_bytes(substream)) {
-		if (res == snd_pcm_lib_buffer_bytes(substream))
-			res = 0;
-	}
+	spin_lock(&s3c_idma.lock);
+	s3c_idma.stats.pointer_reads++;
+	spin_unlock(&s3c_idma.lock);
+
+	res = (src - prtd->start) % snd_pcm_lib_buffer_bytes(substream);
 
 	return bytes_to_frames(substream->runtime, res);
 }
@@ -357,6 +452,10 @@ static irqreturn_t s3c_iis_irq(int irqno, void *dev_id)
 		writel(iiscon, s3c_idma.regs + S3C2412_IISCON);
 		pr_debug("TX_P underrun interrupt IISCON = 0x%08x\n",
 				readl(s3c_idma.regs + S3C2412_IISCON));
+
+		spin_lock(&s3c_idma.lock);
+		s3c_idma.stats.underruns++;
+		spin_unlock(&s3c_idma.lock);
 	}
 
 	/* Check internal DMA level interrupt. */
@@ -370,6 +469,7 @@ static irqreturn_t s3c_iis_irq(int irqno, void *dev_id)
 		writel(iisahb, s3c_idma.regs + S5P_IISAHB);
 
 		addr = readl(s3c_idma.regs + S5P_IISADDR0);
+		s3c_idma_irq_stats(prtd, addr);
 		addr += prtd->periodsz;
 
 		if (addr >= prtd->end)
@@ -29,8 +29,21 @@
 #define LPAM_DMA_STOP    0
 #define LPAM_DMA_START   1
 
+/* playback statistics, kept across streams until reset */
+struct s3c_idma_stats {
+	unsigned long	periods;	/* level interrupts */
+	unsigned long	late;		/* serviced a period or more late */
+	unsigned long	xruns;		/* xruns found at period time */
+	unsigned long	underruns;	/* I2S TX FIFO underruns */
+	unsigned long	pointer_reads;
+	unsigned int	irq_latency_max;	/* us */
+	unsigned int	irq_latency_avg;	/* us */
+};
+
 extern struct snd_soc_platform idma_soc_platform;
 extern void s5p_idma_init(void *);
+extern void s3c_idma_get_stats(struct s3c_idma_stats *stats);
+extern void s3c_idma_reset_stats(void);
 extern int i2s_trigger_stop;
 extern bool audio_clk_stat;
 #endif /* __S3C_IDMA_H_ */
@@ -22,6 +22,7 @@
 #include "s3c-dma.h"
 #include "s5pc1xx-i2s.h"
 #include "s3c-i2s-v2.h"
+#include "s3c-idma.h"
 
 #include <linux/io.h>
 
@@ -320,6 +321,37 @@ static struct snd_soc_device smdkc1xx_snd_devdata = {
 	.codec_data = &smdkc110_wm8994_setup,
 };
 
+/* playback xrun and interrupt latency statistics, write to reset */
+static ssize_t idma_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct s3c_idma_stats stats;
+
+	s3c_idma_get_stats(&stats);
+
+	return sprintf(buf, "periods: %lu\n"
+			"late: %lu\n"
+			"xruns: %lu\n"
+			"underruns: %lu\n"
+			"pointer_reads: %lu\n"
+			"irq_latency_avg_us: %u\n"
+			"irq_latency_max_us: %u\n",
+			stats.periods, stats.late, stats.xruns,
+			stats.underruns, stats.pointer_reads,
+			stats.irq_latency_avg, stats.irq_latency_max);
+}
+
+static ssize_t idma_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	s3c_idma_reset_stats();
+
+	return count;
+}
+
+static DEVICE_ATTR(idma_stats, S_IRUGO | S_IWUSR,
+		idma_stats_show, idma_stats_store);
+
 static struct platform_device *smdkc1xx_snd_device;
 static int __init smdkc110_audio_init(void)
 {
@@ -335,16 +367,23 @@ static int __init smdkc110_audio_init(void)
 	smdkc1xx_snd_devdata.dev = &smdkc1xx_snd_device->dev;
 	ret = platform_device_add(smdkc1xx_snd_device);
 
-	if (ret)
+	if (ret) {
 		platform_device_put(smdkc1xx_snd_device);
+		return ret;
+	}
+
+	if (device_create_file(&smdkc1xx_snd_device->dev,
+				&dev_attr_idma_stats) < 0)
+		pr_err("%s: failed to create idma_stats\n", __func__);
 
-	return ret;
+	return 0;
 }
 
 static void __exit smdkc110_audio_exit(void)
 {
 	debug_msg("%s\n", __func__);
 
+	device_remove_file(&smdkc1xx_snd_device->dev, &dev_attr_idma_stats);
 	platform_device_unregister(smdkc1xx_snd_device);
 }
 